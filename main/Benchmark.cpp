@@ -0,0 +1,371 @@
+#include <stdint.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#include "esp_log.h"
+#include "esp_cpu.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "globals.h"
+#include "geometry.h"
+#include "structures.h"
+
+#include "CameraWork.h"
+#include "CheckTriangles.h"
+#include "ChunkChooser.h"
+#include "ClipBound.h"
+#include "RasteriseBox.h"
+#include "TriangleQueues.h"
+#include "Benchmark.h"
+
+// Kernel benchmarks
+// Run once by app_main before the tasks start so that nothing else is competing, and each case is
+// repeated with the best time kept. The world cases use the chunk the eye starts in, the synthetic
+// cases are walls of a grid of quads in front of the eye so that triangle size, orientation, fog
+// and texturing can each be varied. Times are given per triangle or face and per pixel of the
+// bounding boxes rasterised, as the kernels visit every pixel of a box, in nanoseconds. Each case
+// also times every variant of the raster kernel its items were given four pixels at a time against
+// one at a time, which is what QUAD_KERNELS should be set from.
+// Kernels run here on core 0 rather than core 1 but the two cores are the same.
+
+#ifdef CONFIG_AMAZE_BENCHMARK
+
+#ifdef CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ
+#define BENCH_MHZ CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ
+#else
+#define BENCH_MHZ 240
+#endif
+#define BENCH_REPEATS 8 // The best of these is reported
+
+static const char *TAG = "Benchmark";
+
+static volatile float bench_sink; // Results are kept here so the work isn't optimised away
+
+extern TriQueue BlockA[4];
+extern uint16_t * frame_buffer_A;
+extern uint16_t * frame_buffer_this;
+extern Matrix44f proj;
+extern bool flipped;
+
+// A wall of grid x grid quads of the given side, centred ahead of the eye and turned about its upright
+struct Bench_wall
+{
+    const char * name;
+    uint32_t grid;
+    float side;
+    float distance;
+    float angle;    // Degrees
+    bool textured;
+};
+
+static const Bench_wall walls[] = {
+    { "flat 8 large", 2, 3.0f, 4.0f, 0.0f, false },
+    { "flat 128 medium", 8, 3.0f, 4.0f, 0.0f, false },
+    { "flat 2048 small", 32, 3.0f, 4.0f, 0.0f, false },
+    { "flat 128 turned 60", 8, 3.0f, 4.0f, 60.0f, false },
+    { "flat 128 fogged", 8, 9.0f, 12.0f, 0.0f, false },
+    { "flat 32 near tiled", 4, 12.0f, 2.0f, 0.0f, false },
+    { "textured 128 medium", 8, 3.0f, 4.0f, 0.0f, true },
+    { "textured 2048 small", 32, 3.0f, 4.0f, 0.0f, true },
+    { "textured 128 turned 60", 8, 3.0f, 4.0f, 60.0f, true },
+    { "textured 32 near tiled", 4, 12.0f, 2.0f, 0.0f, true },
+};
+
+// Runs work BENCH_REPEATS times, with prepare before each outside the timing, returning the fewest cycles
+template<typename Prepare, typename Work>
+static uint32_t BestCycles(Prepare prepare, Work work)
+{
+    uint32_t best = UINT32_MAX;
+    for (uint32_t repeat = 0; repeat < BENCH_REPEATS; repeat++)
+    {
+        prepare();
+        const uint32_t before = esp_cpu_get_cycle_count();
+        work();
+        best = std::min(best, esp_cpu_get_cycle_count() - before);
+    }
+    return (best);
+}
+
+static int Nanoseconds(const uint32_t cycles, const uint32_t count)
+{
+    if (count == 0) return (0);
+    return ((int)((uint64_t)cycles * 1000 / ((uint64_t)BENCH_MHZ * count)));
+}
+
+static void NoPrepare() {}
+
+// Bounding box pixels inside the view port of an item
+static uint32_t ItemPixels(const TriToRaster & item)
+{
+    const Rect2D & box = item.BoBox;
+    const float width = std::min(box.m_MaxX, (float)g_scWidth) - std::max(box.m_MinX, 0.0f);
+    const float height = std::min(box.m_MaxY, (float)g_scHeight) - std::max(box.m_MinY, 0.0f);
+    return ((width > 0.0f && height > 0.0f) ? (uint32_t)(width * height) : 0);
+}
+
+// Bounding box pixels inside the view port of the items in a queue
+static uint32_t BoxPixels(const uint32_t block)
+{
+    uint32_t pixels = 0;
+    for (uint32_t item = 0; item < BlockA[block].count; item++) pixels += ItemPixels(BlockA[block].itemptr[item]);
+    return (pixels);
+}
+
+// Times each of the kernel variants that items of a queue were given, in the four-lane and the
+// per-pixel form, on just those items. Variants with no items are left out
+static void BenchVariants(const char * name, const uint32_t block, const bool edge_test)
+{
+    const TriQueue & queue = BlockA[block];
+    auto clear = []() { ClearDepthBuffer(DEPTH_FAR); };
+    for (uint32_t variant = 0; variant < 4; variant++)
+    {
+        const bool textured = variant & 2;
+        const bool fogged = variant & 1;
+        const uint32_t kernel = KernelIndex(edge_test, textured, fogged);
+        const Raster_kernel quad_kernel = KernelVariant(edge_test, textured, fogged);
+        const Raster_kernel pixel_kernel = KernelVariant(edge_test, textured, fogged, true);
+
+        std::vector<uint32_t> items;
+        uint32_t pixels = 0;
+        for (uint32_t item = 0; item < queue.count; item++)
+        {
+            if (queue.itemptr[item].kernel != kernel) continue;
+            items.push_back(item);
+            pixels += ItemPixels(queue.itemptr[item]);
+        }
+        if (items.empty()) continue;
+
+        const uint32_t quad = BestCycles(clear, [&]() { for (const uint32_t item : items) quad_kernel(queue.itemptr[item]); });
+        const uint32_t pixel = BestCycles(clear, [&]() { for (const uint32_t item : items) pixel_kernel(queue.itemptr[item]); });
+        ESP_LOGI(TAG, "%s: %s %s %s %d items, four-lane %dns each %dns per pixel, per-pixel %dns each %dns per pixel, %d%% of the time",
+            name, edge_test ? "edge" : "tile", textured ? "textured" : "flat", fogged ? "fogged" : "clear", (int)items.size(),
+            Nanoseconds(quad, items.size()), Nanoseconds(quad, pixels), Nanoseconds(pixel, items.size()), Nanoseconds(pixel, pixels),
+            pixel ? (int)((uint64_t)quad * 100 / pixel) : 0);
+    }
+}
+
+// Times CheckTriangles on a chunk and then RasteriseBox and NotRasteriseBox on what it queued
+static void BenchChunk(const char * name, const Vec3f eye, const Vec3f direction, const WorldLayout * layout, const uint32_t chunk)
+{
+    const uint32_t faces = layout->TheChunks[chunk].face_count;
+    const uint32_t triangle_block = flipped ? 2 : 0; // As CheckTriangles chooses
+    const uint32_t tile_block = triangle_block + 1;
+
+    const uint32_t check = BestCycles(EmptyQueues, [&]() { bench_sink = CheckTriangles(eye, direction, chunk, layout); });
+
+    const TriQueue & triangles = BlockA[triangle_block];
+    const TriQueue & tiles = BlockA[tile_block];
+    auto clear = []() { ClearDepthBuffer(DEPTH_FAR); };
+    const uint32_t raster = BestCycles(clear, [&]() { for (uint32_t i = 0; i < triangles.count; i++) RasteriseBox(triangles.itemptr[i]); });
+    const uint32_t not_raster = BestCycles(clear, [&]() { for (uint32_t i = 0; i < tiles.count; i++) NotRasteriseBox(tiles.itemptr[i]); });
+
+    ESP_LOGI(TAG, "%s: CheckTriangles %d faces %dns each", name, (int)faces, Nanoseconds(check, faces));
+    ESP_LOGI(TAG, "%s: RasteriseBox %d triangles %dns each %dns per pixel", name, (int)triangles.count,
+        Nanoseconds(raster, triangles.count), Nanoseconds(raster, BoxPixels(triangle_block)));
+    ESP_LOGI(TAG, "%s: NotRasteriseBox %d tiles %dns each %dns per pixel", name, (int)tiles.count,
+        Nanoseconds(not_raster, tiles.count), Nanoseconds(not_raster, BoxPixels(tile_block)));
+    BenchVariants(name, triangle_block, true);
+    BenchVariants(name, tile_block, false);
+    EmptyQueues();
+    vTaskDelay(1); // Let the idle task feed the watchdog
+}
+
+// Times the parts of the set up of each face of a chunk
+static void BenchSetup(const Vec3f eye, const Vec3f direction, const WorldLayout * layout, const uint32_t chunk)
+{
+    const ChunkFaces & chunk_faces = layout->TheChunks[chunk];
+    const uint32_t faces = chunk_faces.face_count;
+    std::vector<uint32_t> face_list(chunk_faces.faces_ptr, chunk_faces.faces_ptr + faces);
+    for (uint32_t & face : face_list) face += chunk_faces.face_base;
+
+    Matrix44f view;
+    make_camera(direction, eye, view);
+    const Matrix44f view_proj = view * proj;
+
+    std::vector<Vec4f> clip(faces * 3);
+    std::vector<Matrix33f> vertex_matrices(faces);
+    for (uint32_t face = 0; face < faces; face++)
+    {
+        for (uint32_t corner = 0; corner < 3; corner++)
+        {
+            view_proj.multVecMatrix(FaceVertex(layout, chunk, face_list[face], corner), clip[face * 3 + corner]);
+        }
+        const Vec4f & v0 = clip[face * 3];
+        const Vec4f & v1 = clip[face * 3 + 1];
+        const Vec4f & v2 = clip[face * 3 + 2];
+        vertex_matrices[face] = { v0.x, v1.x, v2.x, v0.y, v1.y, v2.y, v0.w, v1.w, v2.w };
+    }
+
+    const uint32_t clipping = BestCycles(NoPrepare, [&]()
+    {
+        Rect2D box;
+        for (uint32_t face = 0; face < faces; face++) bench_sink = ExecuteFullTriangleClipping(clip[face * 3], clip[face * 3 + 1], clip[face * 3 + 2], &box);
+    });
+    const uint32_t inverse = BestCycles(NoPrepare, [&]()
+    {
+        for (uint32_t face = 0; face < faces; face++) bench_sink = vertex_matrices[face].inverse()[0][0];
+    });
+    const uint32_t shade = BestCycles(NoPrepare, [&]()
+    {
+        Shade_params shade_params;
+        for (uint32_t face = 0; face < faces; face++) MakeShade(face_list[face], eye, direction, layout, chunk, &shade_params);
+        bench_sink = shade_params.lamb;
+    });
+    const uint32_t base = BestCycles(NoPrepare, [&]() { bench_sink = BaseTriangles(eye, direction, chunk, layout); });
+
+    ESP_LOGI(TAG, "ExecuteFullTriangleClipping %dns per face", Nanoseconds(clipping, faces));
+    ESP_LOGI(TAG, "Matrix33::inverse %dns", Nanoseconds(inverse, faces));
+    ESP_LOGI(TAG, "MakeShade %dns per face", Nanoseconds(shade, faces));
+    ESP_LOGI(TAG, "BaseTriangles %dns per face", Nanoseconds(base, faces));
+    vTaskDelay(1);
+}
+
+// Times IndexChunkChooser through the whole chunk sequence
+static void BenchChunkChooser(const Vec3f eye, const Vec3f direction, const WorldLayout * layout)
+{
+    uint32_t calls = 0;
+    const uint32_t cycles = BestCycles(NoPrepare, [&]()
+    {
+        calls = 0;
+        while (IndexChunkChooser(eye, direction, calls, layout) != LAST_CHUNK && calls < 0x10000) calls++;
+    });
+    ESP_LOGI(TAG, "IndexChunkChooser %d calls %dns each", (int)calls, Nanoseconds(cycles, calls));
+}
+
+// Times WritePixel2Fog888 over the whole view port with depths running into the fog
+static void BenchWritePixel()
+{
+    constexpr uint32_t pixels = g_scWidth * g_scHeight;
+    const uint32_t cycles = BestCycles(NoPrepare, [&]()
+    {
+        for (uint32_t pixel = 0; pixel < pixels; pixel++) WritePixel2Fog888(pixel, 0x80a06040, (float)(pixel & 0x1f));
+    });
+    ESP_LOGI(TAG, "WritePixel2Fog888 %dns per pixel", Nanoseconds(cycles, pixels));
+}
+
+// Builds a wall as a layout of one chunk, texture being a textured palette entry from the world
+static void BenchWall(const Bench_wall & wall, const faceMaterials * texture)
+{
+    const Vec3f eye = { 0.0f, 0.0f, 0.0f };
+    const Vec3f direction = { 0.0f, 0.0f, 1.0f }; // Looking along +z, so +x is to the left
+    const uint32_t across = wall.grid + 1;
+    const float step = wall.side / wall.grid;
+    const float turn = wall.angle * (float)M_PI / 180.0f;
+
+    std::vector<Vec3f> vertices;
+    std::vector<Vec2f> uvs;
+    for (uint32_t row = 0; row < across; row++)
+    {
+        for (uint32_t column = 0; column < across; column++)
+        {
+            const float x = wall.side * 0.5f - column * step;
+            vertices.push_back({ x * cosf(turn), wall.side * 0.5f - row * step, wall.distance + x * sinf(turn) });
+            uvs.push_back({ (float)column / wall.grid, (float)row / wall.grid });
+        }
+    }
+
+    // Two faces per quad, anticlockwise as seen from the eye so they face it
+    std::vector<uint16_t> corners, face_list, attributes;
+    for (uint32_t row = 0; row < wall.grid; row++)
+    {
+        for (uint32_t column = 0; column < wall.grid; column++)
+        {
+            const uint16_t top_left = row * across + column;
+            const uint16_t quad[6] = { top_left, (uint16_t)(top_left + across), (uint16_t)(top_left + 1),
+                                       (uint16_t)(top_left + across), (uint16_t)(top_left + across + 1), (uint16_t)(top_left + 1) };
+            corners.insert(corners.end(), quad, quad + 6);
+        }
+    }
+    for (uint32_t face = 0; face < corners.size() / 3; face++)
+    {
+        face_list.push_back(face);
+        attributes.push_back(wall.textured ? 1 : 0);
+    }
+
+    const faceMaterials flat = { 0x80a06040, 0, 0, nullptr, 0 };
+    faceMaterials palette[2] = { flat, texture ? *texture : flat };
+    ChunkFaces chunk = { face_list.data(), (uint32_t)face_list.size(), 0, vertices.data(), uvs.data(),
+        { -wall.side, -wall.side, 0.0f }, { wall.side, wall.side, wall.distance + wall.side } };
+
+    WorldLayout layout;
+    layout.vertices = vertices.data();
+    layout.nvertices = corners.data();
+    layout.texel_verts = corners.data(); // Each vertex has its own UV
+    layout.vts = uvs.data();
+    layout.palette = palette;
+    layout.attributes = attributes.data();
+    layout.TheChunks = &chunk;
+    layout.ChAr = { 0, 0, 1, 1, 10 };
+    layout.pvs = nullptr;
+    layout.pvs_words = 0;
+    layout.vertex_step = 0.0f;
+
+    BenchChunk(wall.name, eye, direction, &layout, 0);
+}
+
+void RunBenchmarks(const Vec3f eye, const Vec3f direction)
+{
+    extern std::vector<EachLayout> world;
+
+    ESP_LOGI(TAG, "Benchmarking at %dMHz, best of %d", (int)BENCH_MHZ, (int)BENCH_REPEATS);
+
+    // Frames are cleared rather than resolved, the depth encoding being the plain one
+    const bool clear_free = clear_free_frames;
+    clear_free_frames = false;
+    depth_base = 0;
+    depth_sign = 1;
+    frame_buffer_this = frame_buffer_A;
+    EmptyQueues();
+
+    BenchWritePixel();
+
+    const WorldLayout * layout = &world[0].frame_layouts[0];
+    const uint32_t chunk = ChunkChooser(eye, direction, true, layout);
+    if (chunk != INVALID_CHUNK && layout->TheChunks[chunk].face_count)
+    {
+        BenchSetup(eye, direction, layout, chunk);
+        BenchChunkChooser(eye, direction, layout);
+        BenchChunk("world eye chunk", eye, direction, layout, chunk);
+    }
+    else ESP_LOGI(TAG, "The eye isn't over a chunk with faces, world cases skipped");
+
+    // Textured walls borrow the first texture found in the world
+    const faceMaterials * texture = nullptr;
+    for (const EachLayout & each : world)
+    {
+        const WorldLayout & first = each.frame_layouts[0];
+        const uint32_t chunks = first.ChAr.xcount * first.ChAr.zcount;
+        for (uint32_t each_chunk = 0; !texture && each_chunk < chunks; each_chunk++)
+        {
+            const ChunkFaces & faces = first.TheChunks[each_chunk];
+            for (uint32_t face = 0; !texture && face < faces.face_count; face++)
+            {
+                const faceMaterials & material = first.palette[first.attributes[faces.face_base + faces.faces_ptr[face]]];
+                if (material.width) texture = &material;
+            }
+        }
+    }
+    for (const Bench_wall & wall : walls)
+    {
+        if (wall.textured && !texture) continue;
+        BenchWall(wall, wall.textured ? texture : nullptr);
+    }
+    if (!texture) ESP_LOGI(TAG, "No texture found in the world, textured cases skipped");
+
+    // Leave the buffers as MakeDepthBuffer did
+    ClearDepthBuffer(DEPTH_FAR);
+    clear_free_frames = clear_free;
+    EmptyQueues();
+    ESP_LOGI(TAG, "Benchmarks done");
+} // End of RunBenchmarks
+
+#else
+
+void RunBenchmarks(const Vec3f eye, const Vec3f direction)
+{
+}
+
+#endif
@@ -12,27 +12,29 @@
 #include "ClipBound.h"
 #include "CheckTriangles.h"
 #include "ChunkChooser.h"
+#include "OcclusionCull.h"
+#include "RenderScale.h"
+#include "Profile.h"
 
 // A global pingpong flag
 extern bool flipped;
 
 // Transform a given vertex in clip-space [-w,w] to raster-space [0, {w|h}]
-constexpr float half_width = g_scWidth/2;
-constexpr float half_height = g_scHeight/2;
+// The raster size is the one chosen for this frame by RenderScaleNewFrame()
+#define half_width (render_width * 0.5f)
+#define half_height (render_height * 0.5f)
 
 #define TO_RASTER(v) Vec4f((half_width * (v.x + v.w)), (half_height * (v.w - v.y)), v.z, v.w)
 
 #define FOV 60.0f // field of view in degrees, will be compiled into radians
 
-// If the triangle crosses the view frustrum it will be tiled before rasterisation and
-// clearly there's a trade-off as smaller allows more elimination but extended to 1px square it's
-// literally back to square one. Needs optimising on a platform and may depend on the world model too. 
-const unsigned int g_xTile = 8; // Tile size needs to be optimised for screen size
-const unsigned int g_yTile = 8; // 8x8 for 128x128 a maybe 32 x 24 for 320x240
+// Tiles for triangles that cross the view frustrum, g_xTile and g_yTile, are in globals.h
+// as they follow the view port size
 
 Rect2D TriBoundBox;
+Check_tracked check_report;
 //float farPlane = 100.0f;
-const float nearPlane = 0.1f;
+//const float nearPlane = 0.1f; // Now in globals.h as occlusion culling also needs it
 
 Matrix44f view = {
     1.0f,0.0f,0.0f,0.0f,
@@ -86,19 +88,20 @@ float BaseTriangles(const Vec3f eye, const Vec3f direction, const uint32_t this_
     if (layo_ptr->TheChunks[this_chunk].face_count == 0) return (0.0f); // Quit as this chunk is empty with zero faces, which is valid?
 
     // Projection calculation removed as a simple othographic view will be used
-    const uint16_t* this_list = layo_ptr->TheChunks[this_chunk].faces_ptr; // fetch the list of faces applicable to this chunk
+    const ChunkFaces & chunk = layo_ptr->TheChunks[this_chunk];
+    const uint16_t* this_list = chunk.faces_ptr; // fetch the list of faces applicable to this chunk
 
     // Currently there is no knowledge of whether there is more than one triangle beneath eye
     // so the height returned simply reflects the last that was hit from the list
-    for (uint32_t get_face = 0; get_face < layo_ptr->TheChunks[this_chunk].face_count; get_face++)
+    for (uint32_t get_face = 0; get_face < chunk.face_count; get_face++)
     {
         // The chunk list is a subset of all triangles so pull the global index for rendering
-        uint32_t idx = this_list[get_face]; // Keep a plain idx so code is easier to read in rest of this function
+        uint32_t idx = chunk.face_base + this_list[get_face]; // Keep a plain idx so code is easier to read in rest of this function
 
         // Fetch object-space vertices from the vertex buffer indexed by the values in index buffer
-        const Vec3f v0 = layo_ptr->vertices[layo_ptr->nvertices[idx * 3]];
-        const Vec3f v1 = layo_ptr->vertices[layo_ptr->nvertices[idx * 3 + 1]];
-        const Vec3f v2 = layo_ptr->vertices[layo_ptr->nvertices[idx * 3 + 2]];
+        const Vec3f v0 = FaceVertex(layo_ptr, this_chunk, idx, 0);
+        const Vec3f v1 = FaceVertex(layo_ptr, this_chunk, idx, 1);
+        const Vec3f v2 = FaceVertex(layo_ptr, this_chunk, idx, 2);
 
         // Simple non-homogenous edge functions are used as there is no need to consider issues such as clip space
         // One could do a bounding box calculation first but only a benefit if many triangles to check per chunk
@@ -175,24 +178,52 @@ uint32_t CheckTriangles(const Vec3f eye, const Vec3f direction, const uint32_t t
     // Multiply view and projection matrices here as there is no need to do this within the triangle loop
     Matrix44f ViewProj = view * proj;
 
-    const uint16_t* this_list = layo_ptr->TheChunks[this_chunk].faces_ptr; // fetch the list of faces applicable to this chunk
+    // Quantised vertices are scaled and moved to the chunk's corner by the same matrix, so they only
+    // need converting to float
+    const float step = layo_ptr->vertex_step;
+    if (step)
+    {
+        const Vec3f origin = ChunkOrigin(layo_ptr, this_chunk);
+        const Matrix44f dequantise = { step, 0.0f, 0.0f, 0.0f, 0.0f, step, 0.0f, 0.0f, 0.0f, 0.0f, step, 0.0f, origin.x, origin.y, origin.z, 1.0f };
+        ViewProj = dequantise * ViewProj;
+    }
+
+    const ChunkFaces & chunk = layo_ptr->TheChunks[this_chunk];
+    const uint16_t* this_list = chunk.faces_ptr; // fetch the list of faces applicable to this chunk
+    this_tri.layout = layo_ptr; // Pass the layout as ptr to the queue on a per triangle basis
+    this_tri.vts = chunk.vts;
 
-    for (uint32_t get_face = 0; get_face < layo_ptr->TheChunks[this_chunk].face_count; get_face++)
+    for (uint32_t get_face = 0; get_face < chunk.face_count; get_face++)
     {
         time_report.triangles++; // Keep count of primitives processed
+        check_report.faces++;
         // The chunk list is a subset of all triangles so pull the global index for rendering
-        uint32_t idx = this_list[get_face]; // Keep a plain idx so code is easier to read in rest of this function
+        uint32_t idx = chunk.face_base + this_list[get_face]; // Keep a plain idx so code is easier to read in rest of this function
 
-        this_tri.idx = this_list[get_face]; // For passing to rasteriser stuct
-        this_tri.layout = layo_ptr; // Pass the layout as ptr to the queue on a per triangle basis
+        this_tri.idx = idx; // For passing to rasteriser stuct
 
         // Fetch object-space vertices from the vertex buffer indexed by the values in index buffer
         // and pass them directly to each VS invocation
-        const Vec3f v0 = layo_ptr->vertices[layo_ptr->nvertices[idx * 3]];
-        const Vec3f v1 = layo_ptr->vertices[layo_ptr->nvertices[idx * 3 + 1]];
-        const Vec3f v2 = layo_ptr->vertices[layo_ptr->nvertices[idx * 3 + 2]];
+        const uint16_t * const corners = &layo_ptr->nvertices[idx * 3];
+        Vec3f v0, v1, v2;
+        if (step)
+        {
+            const Quant_vertex & q0 = chunk.qvertices[corners[0]];
+            const Quant_vertex & q1 = chunk.qvertices[corners[1]];
+            const Quant_vertex & q2 = chunk.qvertices[corners[2]];
+            v0 = Vec3f(q0.x, q0.y, q0.z);
+            v1 = Vec3f(q1.x, q1.y, q1.z);
+            v2 = Vec3f(q2.x, q2.y, q2.z);
+        }
+        else
+        {
+            v0 = chunk.vertices[corners[0]];
+            v1 = chunk.vertices[corners[1]];
+            v2 = chunk.vertices[corners[2]];
+        }
 
         // Invoke function for each vertex of the triangle to transform them from object-space to clip-space (-w, w)
+        PROFILE_MARK(vertex_start);
         Vec4f v0Clip = VS(v0, ViewProj);
         Vec4f v1Clip = VS(v1, ViewProj);
         Vec4f v2Clip = VS(v2, ViewProj);
@@ -204,6 +235,8 @@ uint32_t CheckTriangles(const Vec3f eye, const Vec3f direction, const uint32_t t
         Vec4f v0Homogen = TO_RASTER(v0Clip);
         Vec4f v1Homogen = TO_RASTER(v1Clip);
         Vec4f v2Homogen = TO_RASTER(v2Clip);
+        PROFILE_SINCE(PROF_VERTEX, vertex_start);
+        PROFILE_MARK(setup_start);
 
         // Base vertex matrix
         Matrix33f M =
@@ -221,7 +254,8 @@ uint32_t CheckTriangles(const Vec3f eye, const Vec3f direction, const uint32_t t
         float det = M.determinant();
         if (det >= 0.0f)
         {
-            //tri_backface++; // Track how many are facing away
+            check_report.backfacing++; // Track how many are facing away
+            PROFILE_SINCE(PROF_SETUP, setup_start);
             continue;
         }
 
@@ -229,7 +263,7 @@ uint32_t CheckTriangles(const Vec3f eye, const Vec3f direction, const uint32_t t
 
         // Work out brightness of the face
         //this_tri.face_brightness = MakeShade(idx, eye, direction, layo_ptr);
-        MakeShade(idx, eye, direction, layo_ptr,& this_tri.face_brightness);
+        MakeShade(idx, eye, direction, layo_ptr, this_chunk, & this_tri.face_brightness);
 
         // Compute the inverse of vertex matrix to use it for setting up edge & constant functions
         Matrix33f invM = M.inverse();
@@ -240,12 +274,16 @@ uint32_t CheckTriangles(const Vec3f eye, const Vec3f direction, const uint32_t t
         invM.multVecMatrix(Vec3f(1, 1, 1), this_tri.C);
         // Calculate z interpolation vector
         invM.multVecMatrix(this_tri.clip_zs, this_tri.Z);
+        PROFILE_SINCE(PROF_SETUP, setup_start);
 
         //switch (ExecuteFullTriangleClipping(idx, v0Clip, v1Clip, v2Clip, &TriBoundBox))
-        switch (ExecuteFullTriangleClipping(v0Clip, v1Clip, v2Clip, &TriBoundBox))
+        PROFILE_MARK(clip_start);
+        const uint32_t clip_result = ExecuteFullTriangleClipping(v0Clip, v1Clip, v2Clip, &TriBoundBox);
+        PROFILE_SINCE(PROF_CLIP, clip_start);
+        switch (clip_result)
         {
         case CLIP_TR:
-            //tri_not_rendered++;
+            check_report.clip_rejected++;
             continue; // Bounding box is totally off screen
         case CLIP_TA:
             // the simplest function parameter passing approach is illustrated, 
@@ -253,12 +291,26 @@ uint32_t CheckTriangles(const Vec3f eye, const Vec3f direction, const uint32_t t
             // pixels_done += RasteriseBox(idx, v0Clip, v1Clip, v2Clip, TileBox, M);
 
             this_tri.BoBox = TriBoundBox; // The other parameters have been pre-populated
+
+            // Large near faces also hide the chunks behind them
+            if (OcclusionIsOccluder(this_tri)) OcclusionAddOccluder(this_tri);
+            else if (OcclusionTestTriangle(this_tri))
+            {
+                check_report.occluded++;
+                continue; // Hidden in the previous frame
+            }
+            check_report.triangles++;
 //            pixels_done += RasteriseBox(this_tri);
             if (flipped) pixels_done += QueueTriangle(this_tri,2);
             else pixels_done += QueueTriangle(this_tri,0);
 
             break;
         case CLIP_MC:
+            // A triangle crossing the frustrum is likely to be a near wall, so try it as an occluder
+            // using the full screen box before it is broken into tiles
+            this_tri.BoBox = TriBoundBox;
+            if (OcclusionIsOccluder(this_tri)) OcclusionAddOccluder(this_tri);
+
             // Make the edge cooefficients for this triangle
  
             // Set up edge functions based on the vertex matrix
@@ -329,7 +381,7 @@ uint32_t CheckTriangles(const Vec3f eye, const Vec3f direction, const uint32_t t
 
                     if (TRForEdge0 || TRForEdge1 || TRForEdge2)
                     {
-                        //tile_rejected++;
+                        check_report.tiles_rejected++;
                         // TrivialReject
                         // Tile is completely outside of one or more edges
                         continue; // Skip to next tile now
@@ -349,7 +401,7 @@ uint32_t CheckTriangles(const Vec3f eye, const Vec3f direction, const uint32_t t
 
                     if (TAForEdge0 && TAForEdge1 && TAForEdge2)
                     {
-                        //tile_accepted++;
+                        check_report.tiles_accepted++;
                         pixels_done += (g_xTile * g_yTile); // No need to count individual pixerls as it's all rasterised
 
                         // TrivialAccept
@@ -364,7 +416,7 @@ uint32_t CheckTriangles(const Vec3f eye, const Vec3f direction, const uint32_t t
                         continue; // Skip to next tile now
                     }
                     // By default the tile must be only partially covered
-                    //tile_partial++;
+                    check_report.tiles_partial++;
                     // Make a box for each tile within the full screen bound box
                     this_tri.BoBox = { (float)(tx * g_xTile),(float)(ty * g_yTile),(float)((tx + 1) * g_xTile),(float)((ty + 1) * g_yTile) };
                     // and do normal rasterisation with edge checking
@@ -385,14 +437,14 @@ uint32_t CheckTriangles(const Vec3f eye, const Vec3f direction, const uint32_t t
 // and is called as a triangle is processed so passed to rasteriser via queue
 // The model uses embedded roughness to calculate uint32_t multipliers
 
-void MakeShade(uint32_t idx, const Vec3f eye, const Vec3f direction, const WorldLayout* layo_ptr, Shade_params* surface_shade)
+void MakeShade(uint32_t idx, const Vec3f eye, const Vec3f direction, const WorldLayout* layo_ptr, const uint32_t chunk, Shade_params* surface_shade)
 {
     static const char *TAG = "MakeShade";
 
-    // Fetch object-space vertices from the vertex buffer indexed by the values in index buffer
-    const Vec3f& v0 = layo_ptr->vertices[layo_ptr->nvertices[idx * 3]];
-    const Vec3f& v1 = layo_ptr->vertices[layo_ptr->nvertices[idx * 3 + 1]];
-    const Vec3f& v2 = layo_ptr->vertices[layo_ptr->nvertices[idx * 3 + 2]];
+    // Fetch object-space vertices from the chunk's vertex buffer indexed by the values in index buffer
+    const Vec3f v0 = FaceVertex(layo_ptr, chunk, idx, 0);
+    const Vec3f v1 = FaceVertex(layo_ptr, chunk, idx, 1);
+    const Vec3f v2 = FaceVertex(layo_ptr, chunk, idx, 2);
 
     // Read the face colour from the palette
     // which has high order byte Ns for block colours and textures from mtl file   
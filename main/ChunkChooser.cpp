@@ -10,7 +10,6 @@
 
 #include <stdint.h>
 #include <math.h>
-#include "esp_log.h"
 //static const char *TAG = "ChunkChooser";
 
 
@@ -51,6 +50,17 @@ uint32_t chunk_index(const Vec2i chunk, const ChunkArr& chunk_param)
 	return (chunk.x + chunk_param.xcount * chunk.y);
 }
 
+// Check the layout's potentially visible set, if it has one, to see if a chunk can be seen from
+// anywhere in the eye's chunk. An eye outside the layout has no set so everything is possible
+bool chunk_visible(const Vec2i eye_chunk, const uint32_t chosen_chunk, const WorldLayout* layo_ptr)
+{
+	if (layo_ptr->pvs == nullptr) return (true);
+	if (!test_chunk(eye_chunk, layo_ptr->ChAr)) return (true);
+
+	const uint32_t * bits = layo_ptr->pvs + chunk_index(eye_chunk, layo_ptr->ChAr) * layo_ptr->pvs_words;
+	return ((bits[chosen_chunk >> 5] >> (chosen_chunk & 0x1f)) & 0x01);
+}
+
 // An array of offsets to use to pick the next chunk for display
 const uint32_t test_zones = 32; // The number of chunks listed in decreasing priority
 const uint32_t test_sectors = 8; // The sectors into which a 2D horizontal circle is divided
@@ -120,6 +130,8 @@ uint32_t ChunkChooser(const Vec3f eye, Vec3f direction, const bool eye_moved, co
 	if (test_chunk(new_chunk,layo_ptr->ChAr))
 	{
 		chosen_chunk= chunk_index(new_chunk,layo_ptr->ChAr); // The chunk is in range so send that back
+		// but it is treated as out of range if it can't be seen from where the eye is
+		if (!chunk_visible(this_chunk, chosen_chunk, layo_ptr)) chosen_chunk = INVALID_CHUNK;
 	}
 	else chosen_chunk = INVALID_CHUNK; // Return that the chunk is out of range and then it won't be rendered
 
@@ -172,6 +184,8 @@ uint32_t IndexChunkChooser(const Vec3f eye, Vec3f direction, uint32_t index, con
 	if (test_chunk(new_chunk,layo_ptr->ChAr))
 	{
 		chosen_chunk= chunk_index(new_chunk,layo_ptr->ChAr); // The chunk is in range so send that back
+		// but it is treated as out of range if it can't be seen from where the eye is
+		if (!chunk_visible(this_chunk, chosen_chunk, layo_ptr)) chosen_chunk = INVALID_CHUNK;
 	}
 	else chosen_chunk = INVALID_CHUNK; // Return that the chunk is out of range and then it won't be rendered
 
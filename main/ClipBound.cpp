@@ -4,6 +4,7 @@
 #include "geometry.h"
 #include "structures.h"
 #include "CheckTriangles.h"
+#include "RenderScale.h"
 
 #include "ClipBound.h"
 
@@ -90,8 +91,8 @@ unsigned int ExecuteFullTriangleClipping(const Vec4f& v0Clip, const Vec4f& v1Cli
         (v1Clip.z <= v1Clip.w) &&
         (v2Clip.z <= v2Clip.w);
 
-    float width = g_scWidth; // Not ideal but quick and easy
-    float height = g_scHeight;
+    float width = render_width; // The size this frame is rasterised at
+    float height = render_height;
 
     if (allOutsideLeftPlane ||
         allOutsideRightPlane ||
@@ -160,9 +161,9 @@ unsigned int ExecuteFullTriangleClipping(const Vec4f& v0Clip, const Vec4f& v1Cli
 
 Rect2D ComputeBoundingBox(const Vec4f& v0Clip, const Vec4f& v1Clip, const Vec4f& v2Clip, float width, float height)
 {
-    Vec2f v0Raster = Vec2f((g_scWidth * (v0Clip.x + v0Clip.w) / (2 * v0Clip.w)), (g_scHeight * (v0Clip.w - v0Clip.y) / (2 * v0Clip.w)));
-    Vec2f v1Raster = Vec2f((g_scWidth * (v1Clip.x + v1Clip.w) / (2 * v1Clip.w)), (g_scHeight * (v1Clip.w - v1Clip.y) / (2 * v1Clip.w)));
-    Vec2f v2Raster = Vec2f((g_scWidth * (v2Clip.x + v2Clip.w) / (2 * v2Clip.w)), (g_scHeight * (v2Clip.w - v2Clip.y) / (2 * v2Clip.w)));
+    Vec2f v0Raster = Vec2f((width * (v0Clip.x + v0Clip.w) / (2 * v0Clip.w)), (height * (v0Clip.w - v0Clip.y) / (2 * v0Clip.w)));
+    Vec2f v1Raster = Vec2f((width * (v1Clip.x + v1Clip.w) / (2 * v1Clip.w)), (height * (v1Clip.w - v1Clip.y) / (2 * v1Clip.w)));
+    Vec2f v2Raster = Vec2f((width * (v2Clip.x + v2Clip.w) / (2 * v2Clip.w)), (height * (v2Clip.w - v2Clip.y) / (2 * v2Clip.w)));
 
 
     // Find min/max in X & Y
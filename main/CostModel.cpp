@@ -0,0 +1,173 @@
+#include <stdint.h>
+#include <algorithm>
+
+#include "esp_log.h"
+
+#include "globals.h"
+#include "structures.h"
+
+#include "CostModel.h"
+
+// Frame cost model
+// Each queued triangle or tile is predicted to take setup + per_pixel * area cycles on the raster
+// core, with separate figures for each cost class as texturing and edge checks change both terms.
+// The raster core times every primitive with the cycle counter and the figures are refitted each
+// frame by least squares over sums that decay, so they follow the world and the view. What isn't
+// in a kernel, the resolve, impostors and upscale, is tracked as a per frame overhead.
+
+// The quality governor uses the share of kernel time spent texturing, so the model runs for it too
+bool cost_model_enabled = (FRAME_CONTROL == FRAME_CONTROL_COST) || (FRAME_CONTROL == FRAME_CONTROL_QUALITY);
+
+#define COST_TARGET_PERCENT 90  // Share of MAX_FRAME_DURATION that the raster core is planned to fill
+#define COST_DECAY 0.9          // Weight kept by the running sums each frame, about ten frames of memory
+#define COST_MIN_SAMPLES 8.0    // Primitives of a class before its fit replaces the starting figures
+
+#ifdef CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ
+#define COST_CPU_MHZ CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ
+#else
+#define COST_CPU_MHZ 240
+#endif
+
+// Rough starting figures in cycles which calibration soon replaces
+static float setup_cycles[COST_CLASSES] = { 1500.0f, 2500.0f, 800.0f, 1200.0f };
+static float pixel_cycles[COST_CLASSES] = { 60.0f, 120.0f, 50.0f, 100.0f };
+static float overhead_us = 2000.0f;
+
+// Sums for the fit of cycles t against area a, this frame's are filled on the raster core
+struct Cost_sums
+{
+    float n;
+    float a;
+    float aa;
+    float t;
+    float at;
+};
+static Cost_sums frame_sums[COST_CLASSES];
+static uint32_t frame_kernel_cycles = 0;
+
+// Kept in double on core 0 as the fit subtracts products of large sums, only a few operations a frame
+struct Cost_running
+{
+    double n;
+    double a;
+    double aa;
+    double t;
+    double at;
+};
+static Cost_running running_sums[COST_CLASSES];
+
+static float predicted_cycles[2]; // Of the primitives queued for each list
+
+uint32_t cost_predicted_us = 0;
+uint32_t cost_actual_us = 0;
+uint32_t cost_textured_percent = 50; // Until measured
+
+Cost_tracked cost_report;
+static uint32_t setup_report[COST_CLASSES]; // Integer copies for the timer task
+static uint32_t pixel_report[COST_CLASSES];
+
+static inline float PrimitiveArea(const TriToRaster & tri)
+{
+    return ((tri.BoBox.m_MaxX - tri.BoBox.m_MinX) * (tri.BoBox.m_MaxY - tri.BoBox.m_MinY));
+}
+
+// Start the prediction for the list about to be built on core 0
+void CostModelNewFrame(const uint32_t list)
+{
+    predicted_cycles[list] = 0.0f;
+}
+
+// Add a primitive that QueueTriangle has just queued, its cost_class must be set
+void CostModelQueued(const TriToRaster & tri, const uint32_t list)
+{
+    predicted_cycles[list] += setup_cycles[tri.cost_class] + pixel_cycles[tri.cost_class] * PrimitiveArea(tri);
+}
+
+// Whether the list being built is still predicted to rasterise within the frame
+bool CostModelUnderBudget(const uint32_t list)
+{
+    constexpr float target_us = MAX_FRAME_DURATION * 1000.0f * COST_TARGET_PERCENT / 100.0f;
+    return ((predicted_cycles[list] / COST_CPU_MHZ) + overhead_us < target_us);
+}
+
+// Record the cycles a kernel took, called on the raster core for every primitive
+void CostModelSample(const TriToRaster & tri, const uint32_t cycles)
+{
+    const float area = PrimitiveArea(tri);
+    const float t = (float)cycles;
+    Cost_sums & sums = frame_sums[tri.cost_class];
+    sums.n += 1.0f;
+    sums.a += area;
+    sums.aa += area * area;
+    sums.t += t;
+    sums.at += area * t;
+    frame_kernel_cycles += cycles;
+}
+
+// Compare the prediction for the list just rasterised with what it took and refit the figures
+// Called on core 0 once RASTER_DONE is seen, so nothing is being sampled or predicted meanwhile
+void CostModelCalibrate(const uint32_t list)
+{
+    extern uint32_t raster_frame_us; // Measured by rasteriseTask
+
+    if (!cost_model_enabled) return;
+
+    const uint32_t frame_raster_us = raster_frame_us;
+    const uint32_t predicted_us = (uint32_t)(predicted_cycles[list] / COST_CPU_MHZ + overhead_us);
+    cost_predicted_us = predicted_us;
+    cost_actual_us = frame_raster_us;
+    cost_report.frames++;
+    cost_report.predicted_us += predicted_us;
+    cost_report.actual_us += frame_raster_us;
+    cost_report.error_us += (predicted_us > frame_raster_us) ? predicted_us - frame_raster_us : frame_raster_us - predicted_us;
+
+    const float textured_cycles = frame_sums[COST_CLASS_TEXTURED].t + frame_sums[COST_CLASS_TILE + COST_CLASS_TEXTURED].t;
+    if (frame_kernel_cycles) cost_textured_percent = (uint32_t)(100.0f * textured_cycles / (float)frame_kernel_cycles);
+
+    const float kernel_us = (float)frame_kernel_cycles / COST_CPU_MHZ;
+    overhead_us = 0.9f * overhead_us + 0.1f * std::max((float)frame_raster_us - kernel_us, 0.0f);
+    frame_kernel_cycles = 0;
+
+    for (uint32_t c = 0; c < COST_CLASSES; c++)
+    {
+        Cost_running & run = running_sums[c];
+        Cost_sums & frame = frame_sums[c];
+        run.n = run.n * COST_DECAY + frame.n;
+        run.a = run.a * COST_DECAY + frame.a;
+        run.aa = run.aa * COST_DECAY + frame.aa;
+        run.t = run.t * COST_DECAY + frame.t;
+        run.at = run.at * COST_DECAY + frame.at;
+        frame = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+
+        if (run.n < COST_MIN_SAMPLES) continue;
+
+        // Tiles are all one size so only the total per tile can be found, the per pixel figure is kept
+        const double spread = run.n * run.aa - run.a * run.a;
+        double per_pixel = pixel_cycles[c];
+        if (spread > 1.0e-3 * run.n * run.aa) per_pixel = (run.n * run.at - run.a * run.t) / spread;
+        per_pixel = std::max(per_pixel, 0.0);
+        const double setup = std::max((run.t - per_pixel * run.a) / run.n, 0.0);
+
+        setup_cycles[c] = (float)setup;
+        pixel_cycles[c] = (float)per_pixel;
+        setup_report[c] = (uint32_t)setup;
+        pixel_report[c] = (uint32_t)(per_pixel * 10.0);
+    }
+} // End of CostModelCalibrate
+
+// Log the average predicted and measured raster times and the fitted figures, integer only for the timer task
+void ReportCostModel()
+{
+    static const char *TAG = "CostModel";
+
+    if (!cost_model_enabled || (cost_report.frames == 0)) return;
+
+    ESP_LOGI(TAG, "Raster predicted %dus actual %dus error %dus",
+        (int)(cost_report.predicted_us / cost_report.frames), (int)(cost_report.actual_us / cost_report.frames),
+        (int)(cost_report.error_us / cost_report.frames));
+    ESP_LOGI(TAG, "Cycles setup and per 10px, flat %d %d textured %d %d flat tile %d %d textured tile %d %d",
+        (int)setup_report[0], (int)pixel_report[0], (int)setup_report[1], (int)pixel_report[1],
+        (int)setup_report[2], (int)pixel_report[2], (int)setup_report[3], (int)pixel_report[3]);
+
+    cost_report = {0, 0, 0, 0};
+} // End of ReportCostModel
@@ -21,6 +21,11 @@
 #include "GradientBar.h"
 #include "numberfont.h" // 10 digits as a bitmap for use as a 'font' and 'game over'
 #include "EventManager.h"
+#include "ImpostorCache.h"
+#include "HorizonPanorama.h"
+#include "RasteriseBox.h"
+#include "Profile.h"
+#include "Trace.h"
 
 extern QueueHandle_t game_event_queue; // A FreeRTOS queue to pass game play events from world to manager
 extern std::vector<EachLayout> world; // An unsized vector of layouts each of which can contain multiple frames
@@ -49,6 +54,8 @@ void GetGameEvent(void * parameter)
     {
         // Block until a queue item is available
         xQueueReceive( game_event_queue, & this_event_pix, portMAX_DELAY);
+        PROFILE_SCOPE(PROF_EVENTS); // Until the end of this event's handling
+        TRACE_SCOPE(TRACE_EVENT_TASK, TRACE_EVENT);
         uint32_t event_code = this_event_pix.event;
         //ESP_LOGI(TAG,"Event is %04x",(int)event_code);
         // Nested if allows actions to be accumulated rather than isolated with switch
@@ -158,8 +165,9 @@ void EvntDeleteFaces(Near_pix this_event_pix)
         // Loop through all chunks
         for (uint32_t chnk = 0; chnk < chunk_number; chnk ++)
             {
-            // Fetch the base address of the list of faces
+            // Fetch the base address of the list of faces, whose entries are from the chunk's face base
             uint16_t * face_ptr = this_world_ptr->TheChunks[chnk].faces_ptr;
+            const uint16_t * chunk_attributes = this_world_ptr->attributes + this_world_ptr->TheChunks[chnk].face_base;
             
             uint32_t i = 0; // A counter to step into chunk array
 
@@ -169,7 +177,7 @@ void EvntDeleteFaces(Near_pix this_event_pix)
                 // It is an option to use the face idx to retrieve the attribute but that isn't
                 // reprodcibile across layouts, whereas checking for the specific event code is more indorection
                 // but actually does what is wanted without making assumptions about the event code and attribute ampping
-                while (this_world_ptr->palette[this_world_ptr->attributes[face_ptr[i]]].event == this_event_pix.event)
+                while (this_world_ptr->palette[chunk_attributes[face_ptr[i]]].event == this_event_pix.event)
                 {
                     // Yes it is, so copy last face into the space and decrement face count in chunk table
                     //ESP_LOGI(TAG, "Deleting face %d at %i",(int)face_ptr[i],(int)i);
@@ -183,6 +191,8 @@ void EvntDeleteFaces(Near_pix this_event_pix)
     } // End of for through chunks
         } // End of frame loop
     } // End of world loop
+    ImpostorFlush(); // Cached images of distant chunks may show the deleted faces
+    HorizonRedraw(); // And so may the panoramas
 } // End of EvntDeleteFaces
 
 void EvntHealthBar(const uint16_t health)
@@ -257,6 +267,8 @@ for (auto h = 0; h < this_overlay.height; h++)
         if (pix_write) frame_buffer_this[h * g_scWidth + w + start_index] = pix_write;
     }
 }
+// The clear-free resolve can't skip the tiles under the overlay as background now that it is in them
+if (this_overlay.height) ForgetFrameRows(flipped ? 0 : 1, start_index / g_scWidth, (start_index + (this_overlay.height - 1) * g_scWidth + this_overlay.width - 1) / g_scWidth);
 } // End of Overlay2D
 
 void StopOverlayTwoD(TimerHandle_t tracked_handle)
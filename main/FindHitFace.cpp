@@ -10,7 +10,7 @@
 #include "ShowError.h"
 
 #include "FindHitFace.h"
-#include "RasteriseBox.h" // For CheckEdgeFunction
+#include "RasteriseBox.h" // For CheckEdgeFunction and the depth format
 
 // ************************************************************************************************
 // Checks if a triangle is intersected by the viewer pixel test_x and test_y
@@ -52,6 +52,7 @@ float CheckHitFace(const TriToRaster & tri, const uint32_t test_x, const uint32_
         // Find z that will be used for depth test
         const float w = 1/((C.x * Sample.x) + (C.y * Sample.y) + C.z);
         z = w * ((Z.x * Sample.x) + (Z.y * Sample.y) + Z.z);
+        z = DepthQuantise(z); // As the depth buffer holds it so ties resolve as they were drawn
         }
     return (z); // LARGE_FLOAT if not contained
 } // End of CheckFace
@@ -75,7 +76,7 @@ float CheckHitTile(const TriToRaster & tri, const uint32_t test_x, const uint32_
     // Find z that will be used for depth test
     const float w = 1/((C.x * Sample.x) + (C.y * Sample.y) + C.z);
     const float z = w * ((Z.x * Sample.x) + (Z.y * Sample.y) + Z.z);
-return (z);
+return (DepthQuantise(z));
 } // End of CheckHitTile
 
 // For hit checking, basic test if the test pixel is within the bounding box for rendering
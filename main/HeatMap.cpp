@@ -0,0 +1,139 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#include "esp_log.h"
+
+#include "globals.h"
+#include "structures.h"
+
+#include "RasteriseBox.h"
+#include "RenderScale.h"
+#include "HeatMap.h"
+
+// Overdraw and cost heat map
+// Whilst a view is on, the raster kernels add to a buffer of a count per screen pixel: each pixel
+// that passes the depth test for overdraw, or for cost the cycles of each quad shared between the
+// pixels it covered, including those that then failed the depth test. Before the resolved frame is
+// upscaled it is replaced by a false colour ramp of the counts, so the chunks and objects that cost
+// the most stand out and can be split or simplified. Only the kernels are counted, so impostors, the
+// panorama and the background show as black. Views are changed between frames on the raster core.
+
+#if HEAT_MAP_ON
+
+#define HEAT_COST_STEP 64 // Cycles per pixel for each step of the ramp in the cost view
+
+static const char *TAG = "HeatMap";
+
+// Black for nothing then blue, cyan, green, yellow, orange, red and white for the most
+#define HEAT_COLOURS 8
+static const uint16_t heat_colours[HEAT_COLOURS] = { 0x0000, 0x001f, 0x07ff, 0x07e0, 0xffe0, 0xfd20, 0xf800, 0xffff };
+
+uint32_t heat_raster_mode = HEAT_OFF;
+uint16_t * heat_buffer = nullptr;
+
+static volatile uint32_t heat_mode = HEAT_OFF; // As chosen on core 0, taken up by the next raster frame
+
+// Sums for the report over the frames of a second
+static uint32_t heat_frames = 0;
+static uint64_t heat_total = 0;
+static uint32_t heat_pixels = 0;
+static uint32_t heat_max = 0;
+
+// Called each frame on core 0 with whether A and B are both held, a new press steps the view
+void HeatMapControl(const bool held)
+{
+    static bool was_held = false;
+
+    if (held && !was_held)
+    {
+        heat_mode = (heat_mode + 1) % HEAT_MODES;
+        ESP_LOGI(TAG, "View %s", (heat_mode == HEAT_OVERDRAW) ? "overdraw" : (heat_mode == HEAT_COST) ? "cost" : "off");
+    }
+    was_held = held;
+} // End of HeatMapControl
+
+// Called on the raster core before anything is drawn, the buffer is kept zeroed between frames
+void HeatMapNewFrame()
+{
+    heat_raster_mode = heat_mode;
+    if ((heat_raster_mode == HEAT_OFF) || heat_buffer) return;
+
+    heat_buffer = (uint16_t *)calloc(g_scWidth * g_scHeight, sizeof(uint16_t));
+    if (!heat_buffer)
+    {
+        ESP_LOGI(TAG, "No memory for the heat map");
+        heat_raster_mode = HEAT_OFF;
+        heat_mode = HEAT_OFF;
+    }
+} // End of HeatMapNewFrame
+
+// Replace the drawn region of the frame with the heat map and zero the counts for the next frame
+void HeatMapFrame(uint16_t * frame_buffer, const uint32_t list)
+{
+    if (heat_raster_mode == HEAT_OFF) return;
+
+    const uint32_t region_width = render_size[list].width;
+    const uint32_t region_height = render_size[list].height;
+    const uint32_t step = (heat_raster_mode == HEAT_COST) ? HEAT_COST_STEP : 1;
+
+    for (uint32_t y = 0; y < region_height; y++)
+    {
+        for (uint32_t x = 0; x < region_width; x++)
+        {
+            const uint32_t index = y * g_scWidth + x;
+            const uint32_t count = heat_buffer[index];
+            frame_buffer[index] = heat_colours[std::min((count + step - 1) / step, (uint32_t)(HEAT_COLOURS - 1))];
+            if (count)
+            {
+                heat_total += count;
+                heat_pixels++;
+                heat_max = std::max(heat_max, count);
+            }
+        }
+        memset(&heat_buffer[y * g_scWidth], 0, region_width * sizeof(uint16_t));
+    }
+    heat_frames++;
+
+    // The background left by the resolve has been written over
+    ForgetFrameBackground(list);
+} // End of HeatMapFrame
+
+void ReportHeatMap()
+{
+    if (!heat_frames) return;
+
+    // Overdraw is given in tenths of a write
+    const uint32_t scale = (heat_raster_mode == HEAT_COST) ? 1 : 10;
+    const uint32_t mean = heat_pixels ? (uint32_t)(heat_total * scale / heat_pixels) : 0;
+    if (heat_raster_mode == HEAT_COST) ESP_LOGI(TAG, "Cost mean %d max %d cycles per pixel drawn, %d pixels per frame",
+        (int)mean, (int)heat_max, (int)(heat_pixels / heat_frames));
+    else ESP_LOGI(TAG, "Overdraw mean %d.%d max %d per pixel drawn, %d pixels per frame",
+        (int)(mean / 10), (int)(mean % 10), (int)heat_max, (int)(heat_pixels / heat_frames));
+
+    heat_frames = 0;
+    heat_total = 0;
+    heat_pixels = 0;
+    heat_max = 0;
+} // End of ReportHeatMap
+
+#else
+
+void HeatMapControl(const bool held)
+{
+}
+
+void HeatMapNewFrame()
+{
+}
+
+void HeatMapFrame(uint16_t * frame_buffer, const uint32_t list)
+{
+}
+
+void ReportHeatMap()
+{
+}
+
+#endif
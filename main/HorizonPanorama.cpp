@@ -0,0 +1,355 @@
+// Horizon panorama for the world beyond the chunks that are drawn live
+//
+// Chunks are only sent from a fixed sequence around the eye and fog is complete at 30m, so
+// without this the distant world is just the background colour. At startup the whole world is
+// drawn, from a grid of reference positions, onto a cylinder around each of them. Only faces
+// further away than the live chunks can be from a reference are drawn and they are mixed with
+// the fog colour. ClearWorldFrame is then replaced by a copy of the slice of the nearest panorama
+// that the view direction faces. Deleting faces in play redraws the panoramas without them.
+//
+// A chunk is only left out of the live draw when it is wholly fogged by view depth and also wholly
+// outside the near radius of the panorama in use, so every face it drops is on that panorama.
+//
+// The copy maps each screen column to an angle so the horizon is placed correctly across the screen,
+// rows are copied as they are which bends the cylinder slightly towards the screen edges.
+
+#include <stdint.h>
+#include <algorithm>
+
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+
+#include "globals.h"
+#include "geometry.h"
+#include "structures.h"
+
+#include "ChunkChooser.h"
+#include "CheckTriangles.h"
+#include "RasteriseBox.h"
+
+#include "HorizonPanorama.h"
+#include "RenderScale.h"
+
+// Chunks wholly beyond this are only fog when drawn live, it is the fog end at full quality
+const float HORIZON_LIVE_RADIUS = 30.0f;
+
+// The share of the panorama colour out of 255, the rest being fog
+const uint32_t HORIZON_FOG_MIX = 64;
+
+// Chosen in menuconfig under Amaze renderer, off by default so the distance is the flat fog colour
+#ifdef CONFIG_AMAZE_HORIZON
+bool horizon_enabled = true;
+#else
+bool horizon_enabled = false;
+#endif
+bool horizon_ready = false; // Set once the panoramas are made
+
+uint16_t * panorama[PANO_GRID * PANO_GRID]; // rgb565 images, PANO_WIDTH by PANO_HEIGHT
+Vec3f pano_ref[PANO_GRID * PANO_GRID];      // Where each was made from
+
+int16_t pano_column[g_scWidth]; // Panorama column offset of each screen column from the view direction
+
+struct Horizon_view // The slice to copy, set by core 0 for the frame that core 1 will clear
+{
+    const uint16_t * image;
+    int32_t start_column;
+    int32_t row_shift;
+};
+Horizon_view horizon_view[2];   // Pingpong to match the queues
+
+float pano_near;            // Faces nearer than this to a reference aren't on its panorama
+uint32_t pano_build_ref;    // The reference of the frame core 0 is building, for HorizonChunkBeyond
+
+// Draw one face onto the cylinder around ref if it is far enough away
+static void PanoramaFace(const Vec3f ref, const WorldLayout* layo_ptr, const uint32_t chunk, const uint32_t idx, const float near,
+                         const float focal_y, uint16_t * image, float * depth)
+{
+    extern const uint32_t fog;
+
+    float col[3], row[3], dist[3];
+    Vec3f centre = { 0.0f, 0.0f, 0.0f };
+    for (uint32_t corner = 0; corner < 3; corner++)
+    {
+        const Vec3f vertex = FaceVertex(layo_ptr, chunk, idx, corner);
+        const Vec3f relative = vertex - ref;
+        dist[corner] = sqrtf(relative.x * relative.x + relative.z * relative.z);
+        if (dist[corner] < near) return; // Near enough to be drawn live somewhere around this reference
+
+        // Angle is zero looking along -z and increases to the right as on screen
+        col[corner] = atan2f(relative.x, -relative.z) * (PANO_WIDTH / (2 * M_PI));
+        if (col[corner] < 0.0f) col[corner] += PANO_WIDTH;
+        row[corner] = PANO_HEIGHT / 2 - (relative.y / dist[corner]) * focal_y;
+        centre = centre + vertex;
+    }
+
+    // A face across the join is moved to the right of it and wrapped as it is drawn
+    if (std::max(std::max(col[0], col[1]), col[2]) - std::min(std::min(col[0], col[1]), col[2]) > PANO_WIDTH / 2)
+    {
+        for (uint32_t corner = 0; corner < 3; corner++) if (col[corner] < PANO_WIDTH / 2) col[corner] += PANO_WIDTH;
+    }
+
+    // Back faces are skipped with the same sign as CheckTriangles uses
+    const float area = col[0] * (row[1] - row[2]) - col[1] * (row[0] - row[2]) + col[2] * (row[0] - row[1]);
+    if (area >= 0.0f) return;
+
+    Shade_params shade;
+    MakeShade(idx, ref, centre * (1.0f / 3.0f) - ref, layo_ptr, chunk, &shade);
+    const uint32_t rgb888 = spec_shade_pixel(layo_ptr->palette[layo_ptr->attributes[idx]].rgb888, shade);
+
+    // Mix with fog as WritePixel2Fog888 does but with a fixed share, intmix() is inline in RasteriseBox.cpp
+    constexpr uint32_t fog_share = 255 - HORIZON_FOG_MIX;
+    const uint32_t red = ((fog & 0x00ff0000) >> 16) * fog_share + ((rgb888 & 0x00ff0000) >> 16) * HORIZON_FOG_MIX;
+    const uint32_t green = ((fog & 0x0000ff00) >> 8) * fog_share + ((rgb888 & 0x0000ff00) >> 8) * HORIZON_FOG_MIX;
+    const uint32_t blue = (fog & 0x000000ff) * fog_share + (rgb888 & 0x000000ff) * HORIZON_FOG_MIX;
+    const uint16_t rgb565 = (red & 0b1111100000000000) | ((green >> 5) & 0b0000011111100000) | ((blue >> 11) & 0b0000000000011111);
+
+    const int32_t x_start = (int32_t)floorf(std::min(std::min(col[0], col[1]), col[2]));
+    const int32_t x_end = (int32_t)ceilf(std::max(std::max(col[0], col[1]), col[2]));
+    const int32_t y_start = std::max((int32_t)floorf(std::min(std::min(row[0], row[1]), row[2])), (int32_t)0);
+    const int32_t y_end = std::min((int32_t)ceilf(std::max(std::max(row[0], row[1]), row[2])), (int32_t)PANO_HEIGHT);
+
+    const float area_inv = 1.0f / area;
+    for (int32_t y = y_start; y < y_end; y++)
+    {
+        const float sy = y + 0.5f;
+        for (int32_t x = x_start; x < x_end; x++)
+        {
+            const float sx = x + 0.5f;
+            const float b0 = ((col[1] - sx) * (row[2] - sy) - (col[2] - sx) * (row[1] - sy)) * area_inv;
+            const float b1 = ((col[2] - sx) * (row[0] - sy) - (col[0] - sx) * (row[2] - sy)) * area_inv;
+            const float b2 = 1.0f - b0 - b1;
+            if ((b0 < 0.0f) || (b1 < 0.0f) || (b2 < 0.0f)) continue;
+
+            const float distance = b0 * dist[0] + b1 * dist[1] + b2 * dist[2];
+            const uint32_t pixel = y * PANO_WIDTH + (x % PANO_WIDTH);
+            if (distance < depth[pixel])
+            {
+                depth[pixel] = distance;
+                image[pixel] = rgb565;
+            }
+        }
+    }
+} // End of PanoramaFace
+
+// Draw every panorama from the first frame of every layout as the faces are now
+// Returns false if there is no memory for the depths
+static bool DrawPanoramas()
+{
+    extern std::vector<EachLayout> world;
+    extern Matrix44f proj;
+    extern const uint16_t BackgroundColour;
+
+    float * depth = (float *) heap_caps_malloc(PANO_WIDTH * PANO_HEIGHT * sizeof(float), MALLOC_CAP_SPIRAM);
+    if (depth == NULL) return (false);
+
+    const float focal_y = proj[1][1] * g_scHeight / 2;
+    for (uint32_t ref = 0; ref < PANO_GRID * PANO_GRID; ref++)
+    {
+        for (uint32_t pixel = 0; pixel < PANO_WIDTH * PANO_HEIGHT; pixel++)
+        {
+            panorama[ref][pixel] = BackgroundColour;
+            depth[pixel] = 1.0e6f;
+        }
+
+        for (uint32_t worlds = 0; worlds < world.size(); worlds++)
+        {
+            const WorldLayout* layo_ptr = &world[worlds].frame_layouts[0];
+            for (uint32_t chunk = 0; chunk < (uint32_t)(layo_ptr->ChAr.xcount * layo_ptr->ChAr.zcount); chunk++)
+            {
+                const ChunkFaces & faces = layo_ptr->TheChunks[chunk];
+                for (uint32_t face = 0; face < faces.face_count; face++)
+                {
+                    PanoramaFace(pano_ref[ref], layo_ptr, chunk, faces.face_base + faces.faces_ptr[face], pano_near, focal_y, panorama[ref], depth);
+                }
+            }
+        }
+    }
+    free(depth);
+    return (true);
+} // End of DrawPanoramas
+
+// Make the panoramas from the first frame of every layout, called once the world is parsed
+void HorizonSetup()
+{
+    static const char *TAG = "HorizonSetup";
+    extern std::vector<EachLayout> world;
+    extern Matrix44f proj;
+    extern float eye_level;
+
+    if (!horizon_enabled) return;
+    const int64_t start_time = esp_timer_get_time();
+
+    // The extent of the world across all of the layouts
+    float min_x = 1.0e6f, min_z = 1.0e6f, max_x = -1.0e6f, max_z = -1.0e6f;
+    for (uint32_t worlds = 0; worlds < world.size(); worlds++)
+    {
+        const ChunkArr & ChAr = world[worlds].frame_layouts[0].ChAr;
+        min_x = std::min(min_x, (float)ChAr.xmin);
+        min_z = std::min(min_z, (float)ChAr.zmin);
+        max_x = std::max(max_x, (float)(ChAr.xmin + ChAr.xcount * ChAr.size));
+        max_z = std::max(max_z, (float)(ChAr.zmin + ChAr.zcount * ChAr.size));
+    }
+
+    // Faces that could be drawn live from anywhere in a reference's cell are left out
+    const float cell_x = (max_x - min_x) / PANO_GRID;
+    const float cell_z = (max_z - min_z) / PANO_GRID;
+    pano_near = HORIZON_LIVE_RADIUS + 0.5f * sqrtf(cell_x * cell_x + cell_z * cell_z);
+
+    for (uint32_t ref = 0; ref < PANO_GRID * PANO_GRID; ref++)
+    {
+        panorama[ref] = (uint16_t *) heap_caps_malloc(PANO_WIDTH * PANO_HEIGHT * sizeof(uint16_t), MALLOC_CAP_SPIRAM);
+        if (panorama[ref] == NULL)
+        {
+            ESP_LOGI(TAG, "No memory for the horizon so it is disabled");
+            for (uint32_t i = 0; i < ref; i++) free(panorama[i]);
+            horizon_enabled = false;
+            return;
+        }
+
+        // The reference is at eye level above the base layout at the centre of its cell
+        Vec3f position = { min_x + cell_x * ((ref % PANO_GRID) + 0.5f), 0.0f, min_z + cell_z * ((ref / PANO_GRID) + 0.5f) };
+        const WorldLayout* base_ptr = &world[0].frame_layouts[0];
+        const Vec2i base_chunk = find_chunk(position, base_ptr->ChAr);
+        if (test_chunk(base_chunk, base_ptr->ChAr))
+        {
+            position.y = BaseTriangles(position, Vec3f(0.0f, 0.0f, -1.0f), chunk_index(base_chunk, base_ptr->ChAr), base_ptr);
+        }
+        position.y += eye_level;
+        pano_ref[ref] = position;
+    }
+
+    if (!DrawPanoramas())
+    {
+        ESP_LOGI(TAG, "No memory to make the horizon so it is disabled");
+        for (uint32_t ref = 0; ref < PANO_GRID * PANO_GRID; ref++) free(panorama[ref]);
+        horizon_enabled = false;
+        return;
+    }
+
+    // Each screen column looks along an angle from the view direction
+    const float focal_x = proj[0][0] * g_scWidth / 2;
+    for (uint32_t x = 0; x < g_scWidth; x++)
+    {
+        pano_column[x] = (int16_t)lroundf(atanf((x + 0.5f - g_scWidth / 2) / focal_x) * (PANO_WIDTH / (2 * M_PI)));
+    }
+
+    horizon_ready = true;
+    ESP_LOGI(TAG, "Horizon made for faces beyond %dm in %dms", (int)pano_near, (int)((esp_timer_get_time() - start_time) / 1000));
+} // End of HorizonSetup
+
+// Faces have been deleted so redraw the panoramas without them, called by the event task
+// Until they are redrawn every chunk is drawn live over the flat background, as without the panorama,
+// a frame already copying a slice may show it part drawn
+void HorizonRedraw()
+{
+    static const char *TAG = "HorizonRedraw";
+
+    if (!horizon_ready) return;
+    horizon_ready = false;
+    const int64_t start_time = esp_timer_get_time();
+
+    if (!DrawPanoramas())
+    {
+        ESP_LOGI(TAG, "No memory to redraw the horizon so it is disabled");
+        horizon_enabled = false;
+        return;
+    }
+    horizon_ready = true;
+    ESP_LOGI(TAG, "Horizon redrawn in %dms", (int)((esp_timer_get_time() - start_time) / 1000));
+} // End of HorizonRedraw
+
+// Choose the panorama and slice for the queues that core 0 is about to build
+void HorizonNewFrame(const Vec3f eye, const Vec3f direction)
+{
+    extern bool flipped;
+
+    if (!horizon_ready) return;
+
+    uint32_t nearest = 0;
+    float nearest_distance = 1.0e12f;
+    for (uint32_t ref = 0; ref < PANO_GRID * PANO_GRID; ref++)
+    {
+        const float dx = eye.x - pano_ref[ref].x;
+        const float dz = eye.z - pano_ref[ref].z;
+        if (dx * dx + dz * dz < nearest_distance)
+        {
+            nearest_distance = dx * dx + dz * dz;
+            nearest = ref;
+        }
+    }
+
+    pano_build_ref = nearest;
+    Horizon_view & view = horizon_view[flipped ? 1 : 0];
+    view.image = panorama[nearest];
+    view.start_column = (int32_t)lroundf(atan2f(direction.x, -direction.z) * (PANO_WIDTH / (2 * M_PI)));
+    if (view.start_column < 0) view.start_column += PANO_WIDTH;
+
+    // Looking up moves the horizon down the screen
+    extern Matrix44f proj;
+    const float level = sqrtf(direction.x * direction.x + direction.z * direction.z);
+    view.row_shift = (int32_t)lroundf((direction.y / level) * proj[1][1] * g_scHeight / 2);
+} // End of HorizonNewFrame
+
+// Returns true for a chunk that would be completely fogged and whose faces are all on the panorama
+bool HorizonChunkBeyond(const Vec3f eye, const Vec3f direction, const WorldLayout* layo_ptr, const uint32_t this_chunk)
+{
+    if (!horizon_ready) return (false);
+
+    const ChunkFaces & chunk = layo_ptr->TheChunks[this_chunk];
+    if (chunk.face_count == 0) return (false);
+
+    // Fog is by view depth, off to the side a chunk can be further away than this and still show
+    if (ChunkNearestDepth(chunk, eye, direction) <= HORIZON_LIVE_RADIUS) return (false);
+
+    // PanoramaFace() leaves out faces with a corner within pano_near of the reference across the ground
+    const Vec3f ref = pano_ref[pano_build_ref];
+    const float dx = std::max(std::max(chunk.bound_min.x - ref.x, ref.x - chunk.bound_max.x), 0.0f);
+    const float dz = std::max(std::max(chunk.bound_min.z - ref.z, ref.z - chunk.bound_max.z), 0.0f);
+    return (dx * dx + dz * dz >= pano_near * pano_near);
+}
+
+// Copy the slice of panorama into the frame buffer on core 1, returns false if there is no panorama
+// Only the region the frame is rasterised at is filled, UpscaleFrame() writes the rest
+bool HorizonClearFrame(uint16_t * frame_buffer, const uint32_t list)
+{
+    if (!horizon_ready) return (false);
+    if (horizon_view[list].image == nullptr) return (false); // No frame has been set up yet
+
+    for (uint32_t y = 0; y < render_size[list].height; y++) HorizonSpan(&frame_buffer[y * g_scWidth], list, 0, y, render_size[list].width);
+    return (true);
+} // End of HorizonClearFrame
+
+// Copy part of a row of the panorama for the clear-free resolve, which only fills the pixels that
+// nothing was drawn to. Returns false when there is no panorama so the flat colour is used instead
+bool HorizonSpan(uint16_t * out, const uint32_t list, const uint32_t x, const uint32_t y, const uint32_t count)
+{
+    extern const uint16_t BackgroundColour;
+
+    if (!horizon_ready) return (false);
+
+    const Horizon_view & view = horizon_view[list];
+    if (view.image == nullptr) return (false);
+
+    // Positions in a frame drawn at a lower resolution are scaled to the full size view
+    const uint32_t width = render_size[list].width;
+    const bool scaled = (width != g_scWidth);
+    // A row above the panorama wraps to a large value so one test covers both edges
+    const uint32_t source_row = (y * g_scHeight) / render_size[list].height - view.row_shift;
+    if (source_row >= PANO_HEIGHT)
+    {
+        for (uint32_t i = 0; i < count; i++) out[i] = BackgroundColour;
+        return (true);
+    }
+
+    const uint16_t * source = &view.image[source_row * PANO_WIDTH];
+    for (uint32_t i = 0; i < count; i++)
+    {
+        // The offset is within a screen's width of the start so a column before the join wraps to beyond twice the width
+        uint32_t column = view.start_column + pano_column[scaled ? ((x + i) * g_scWidth) / width : x + i];
+        if (column >= 2 * PANO_WIDTH) column += PANO_WIDTH;
+        else if (column >= PANO_WIDTH) column -= PANO_WIDTH;
+        out[i] = source[column];
+    }
+    return (true);
+} // End of HorizonSpan
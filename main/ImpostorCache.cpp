@@ -0,0 +1,417 @@
+// Impostors for distant chunks
+//
+// Chunks further away than the texture threshold are drawn in flat colours and are mostly fog
+// yet each of their faces still costs a full set up in CheckTriangles and the rasteriser.
+// Here a distant chunk is drawn once, from the eye at the time, into a small image with a depth
+// for each texel. The image lies on a square through the centre of the chunk facing that eye.
+// Later frames draw the square with depth testing instead of the faces, until the eye has moved
+// enough to change the view of the chunk, when it is drawn again.
+//
+// Images are kept in a cache of IMPOSTOR_ENTRIES with the least recently used replaced. As core 1
+// draws the list from the previous frame, an image used in either frame is never replaced.
+
+#include <stdint.h>
+#include <algorithm>
+
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+
+#include "globals.h"
+#include "geometry.h"
+#include "structures.h"
+
+#include "CameraWork.h"
+#include "CheckTriangles.h"
+#include "RasteriseBox.h"
+#include "RenderScale.h"
+#include "Trace.h"
+
+#include "ImpostorCache.h"
+
+// Chunks with any point nearer than this in view depth are drawn normally, it is at or beyond the
+// texture depth of every quality level so no texture detail is lost
+const float IMPOSTOR_DISTANCE = 22.0f;
+
+// An image is made again when the direction to the chunk changes by this many radians
+// or the distance to it by this fraction
+const float IMPOSTOR_MAX_ANGLE = 0.03f;
+const float IMPOSTOR_MAX_SCALE = 0.1f;
+
+// The most images made in a frame as each costs about as much as drawing the chunk
+const uint32_t IMPOSTOR_BUILDS = 2;
+
+// Depth of a texel that no face covers
+const float IMPOSTOR_EMPTY = 1.0e6f;
+
+// Chosen in menuconfig under Amaze renderer, off by default so distant chunks are drawn face by face
+#ifdef CONFIG_AMAZE_IMPOSTORS
+bool impostors_enabled = true;
+#else
+bool impostors_enabled = false;
+#endif
+
+struct Impostor
+{
+    const WorldLayout* layout;  // nullptr when the image isn't of anything
+    uint32_t chunk;
+    Vec3f eye;                  // The eye that the image was made from
+    Vec3f centre;               // Centre of the chunk bounds and of the image square
+    Vec3f right;                // Unit axes of the square
+    Vec3f up;
+    float half_size;            // Half of the width of the square
+    float distance;             // From the eye to the centre
+    uint32_t last_used;         // Frame when last drawn
+    uint32_t * image;           // Shaded rgb888 without fog
+    float * depth;              // Distance from the eye along the view of the centre
+};
+
+struct Impostor_draw // An impostor placed on screen for the rasteriser
+{
+    const Impostor * entry;
+    Vec3f U, V, W;              // Screen x, y, 1 to u * w, v * w and w across the image
+    Rect2D BoBox;
+    float depth_offset;         // Moves the image depth to depth in the current view
+};
+
+Impostor impostors[IMPOSTOR_ENTRIES];
+Impostor_draw impostor_list[2][IMPOSTOR_ENTRIES]; // Pingpong lists to match the queues
+uint32_t impostor_count[2] = { 0, 0 };
+
+uint32_t impostor_frame = 1;
+uint32_t impostor_builds = 0;
+uint32_t impostor_building = 0; // Which list core 0 is filling
+volatile bool impostor_flush = false;
+
+Matrix44f imp_view_proj; // This frame's view and projection
+
+Impostor_tracked imp_report;
+
+// Make the memory for the images, impostors are turned off if it can't be had
+void ImpostorSetup()
+{
+    static const char *TAG = "ImpostorSetup";
+    constexpr uint32_t texels = IMPOSTOR_SIZE * IMPOSTOR_SIZE;
+
+    if (!impostors_enabled) return;
+    uint32_t * images = (uint32_t *) heap_caps_malloc(IMPOSTOR_ENTRIES * texels * sizeof(uint32_t), MALLOC_CAP_SPIRAM);
+    float * depths = (float *) heap_caps_malloc(IMPOSTOR_ENTRIES * texels * sizeof(float), MALLOC_CAP_SPIRAM);
+    if ((images == NULL) || (depths == NULL))
+    {
+        ESP_LOGI(TAG, "No memory for impostors so they are disabled");
+        impostors_enabled = false;
+        return;
+    }
+    for (uint32_t i = 0; i < IMPOSTOR_ENTRIES; i++)
+    {
+        impostors[i].layout = nullptr;
+        impostors[i].last_used = 0;
+        impostors[i].image = images + i * texels;
+        impostors[i].depth = depths + i * texels;
+    }
+} // End of ImpostorSetup
+
+// Called when faces are deleted as the images may show them, from any task
+void ImpostorFlush()
+{
+    impostor_flush = true;
+}
+
+// Start the list for the queues that core 0 is about to build
+void ImpostorNewFrame(const Vec3f eye, const Vec3f direction)
+{
+    extern Matrix44f proj; // Built by ProjectionMatrix()
+    extern bool flipped;
+
+    if (!impostors_enabled) return;
+
+    impostor_frame++;
+    impostor_builds = 0;
+    impostor_building = flipped ? 1 : 0;
+    impostor_count[impostor_building] = 0;
+
+    // Forget the images but leave last_used so that the one being drawn isn't overwritten
+    if (impostor_flush)
+    {
+        impostor_flush = false;
+        for (uint32_t i = 0; i < IMPOSTOR_ENTRIES; i++) impostors[i].layout = nullptr;
+    }
+
+    Matrix44f imp_view;
+    make_camera(direction, eye, imp_view);
+    imp_view_proj = imp_view * proj;
+} // End of ImpostorNewFrame
+
+// Draw the faces of a chunk into an image from the eye
+static void BuildImpostor(Impostor & imp, const Vec3f eye, const WorldLayout* layo_ptr, const uint32_t this_chunk)
+{
+    const ChunkFaces & chunk = layo_ptr->TheChunks[this_chunk];
+    const Vec3f centre = (chunk.bound_min + chunk.bound_max) * 0.5f;
+    const float radius = (chunk.bound_max - chunk.bound_min).length() * 0.5f;
+    Vec3f forward = centre - eye;
+    const float distance = forward.length();
+    forward /= distance;
+
+    imp.layout = layo_ptr;
+    imp.chunk = this_chunk;
+    imp.eye = eye;
+    imp.centre = centre;
+    imp.distance = distance;
+    imp.right = forward.crossProduct(Vec3f(0.0f, 1.0f, 0.0f)).normalize();
+    imp.up = imp.right.crossProduct(forward);
+    // The outline of the bounding sphere seen from the eye is a little larger than its radius
+    imp.half_size = radius * distance / sqrtf(distance * distance - radius * radius);
+
+    for (uint32_t texel = 0; texel < IMPOSTOR_SIZE * IMPOSTOR_SIZE; texel++) imp.depth[texel] = IMPOSTOR_EMPTY;
+
+    const float texel_scale = IMPOSTOR_SIZE / (2.0f * imp.half_size);
+    for (uint32_t get_face = 0; get_face < chunk.face_count; get_face++)
+    {
+        const uint32_t idx = chunk.face_base + chunk.faces_ptr[get_face];
+
+        // Project each vertex from the eye onto the square, y is downwards as on screen
+        float tx[3], ty[3], td[3];
+        for (uint32_t corner = 0; corner < 3; corner++)
+        {
+            const Vec3f relative = FaceVertex(layo_ptr, this_chunk, idx, corner) - eye;
+            td[corner] = relative.dotProduct(forward);
+            const Vec3f on_square = relative * (distance / td[corner]) - (centre - eye);
+            tx[corner] = IMPOSTOR_SIZE / 2 + on_square.dotProduct(imp.right) * texel_scale;
+            ty[corner] = IMPOSTOR_SIZE / 2 - on_square.dotProduct(imp.up) * texel_scale;
+        }
+
+        // Back faces are skipped with the same sign as CheckTriangles uses
+        const float area = tx[0] * (ty[1] - ty[2]) - tx[1] * (ty[0] - ty[2]) + tx[2] * (ty[0] - ty[1]);
+        if (area >= 0.0f) continue;
+
+        Shade_params shade;
+        MakeShade(idx, eye, forward, layo_ptr, this_chunk, &shade);
+        const uint32_t colour = spec_shade_pixel(layo_ptr->palette[layo_ptr->attributes[idx]].rgb888, shade);
+
+        const int32_t x_start = std::max((int32_t)floorf(std::min(std::min(tx[0], tx[1]), tx[2])), (int32_t)0);
+        const int32_t y_start = std::max((int32_t)floorf(std::min(std::min(ty[0], ty[1]), ty[2])), (int32_t)0);
+        const int32_t x_end = std::min((int32_t)ceilf(std::max(std::max(tx[0], tx[1]), tx[2])), (int32_t)IMPOSTOR_SIZE);
+        const int32_t y_end = std::min((int32_t)ceilf(std::max(std::max(ty[0], ty[1]), ty[2])), (int32_t)IMPOSTOR_SIZE);
+
+        // Barycentric weights at each texel centre, depth is close enough to affine this far away
+        const float area_inv = 1.0f / area;
+        for (int32_t y = y_start; y < y_end; y++)
+        {
+            const float sy = y + 0.5f;
+            for (int32_t x = x_start; x < x_end; x++)
+            {
+                const float sx = x + 0.5f;
+                const float b0 = ((tx[1] - sx) * (ty[2] - sy) - (tx[2] - sx) * (ty[1] - sy)) * area_inv;
+                const float b1 = ((tx[2] - sx) * (ty[0] - sy) - (tx[0] - sx) * (ty[2] - sy)) * area_inv;
+                const float b2 = 1.0f - b0 - b1;
+                if ((b0 < 0.0f) || (b1 < 0.0f) || (b2 < 0.0f)) continue;
+
+                const float depth = b0 * td[0] + b1 * td[1] + b2 * td[2];
+                const uint32_t texel = y * IMPOSTOR_SIZE + x;
+                if (depth < imp.depth[texel])
+                {
+                    imp.depth[texel] = depth;
+                    imp.image[texel] = colour;
+                }
+            }
+        }
+    }
+    imp_report.builds++;
+} // End of BuildImpostor
+
+// Is the image still a fair view of the chunk from this eye?
+static bool ImpostorValid(const Impostor & imp, const Vec3f eye)
+{
+    const Vec3f now = imp.centre - eye;
+    const float distance = now.length();
+    if (fabsf(distance / imp.distance - 1.0f) > IMPOSTOR_MAX_SCALE) return (false);
+
+    const float cosine = now.dotProduct(imp.centre - imp.eye) / (distance * imp.distance);
+    return (cosine > cosf(IMPOSTOR_MAX_ANGLE));
+}
+
+// Find the least recently used image that neither core is using
+static Impostor * ImpostorSlot()
+{
+    Impostor * slot = nullptr;
+    for (uint32_t i = 0; i < IMPOSTOR_ENTRIES; i++)
+    {
+        Impostor & imp = impostors[i];
+        if (imp.last_used + 1 >= impostor_frame) continue; // In this or the list being drawn
+        if ((slot == nullptr) || ((imp.layout == nullptr) && (slot->layout != nullptr)) ||
+            (((imp.layout == nullptr) == (slot->layout == nullptr)) && (imp.last_used < slot->last_used)))
+        {
+            slot = &imp;
+        }
+    }
+    return (slot);
+}
+
+// Put the image on screen for this frame's view, returns false if it can't be
+static bool ImpostorPlace(const Impostor & imp, Impostor_draw & draw)
+{
+    const float h = imp.half_size;
+    const Vec3f corners[4] = {
+        imp.centre - imp.right * h + imp.up * h,    // u = 0, v = 0 at the top left
+        imp.centre + imp.right * h + imp.up * h,    // u = 1
+        imp.centre - imp.right * h - imp.up * h,    // v = 1
+        imp.centre + imp.right * h - imp.up * h };
+
+    // Homogeneous screen coordinates in the same way as TO_RASTER
+    Vec3f screen[4];
+    const float width = render_width; // The size this frame is rasterised at
+    const float height = render_height;
+    float min_x = width, min_y = height, max_x = 0.0f, max_y = 0.0f;
+    for (uint32_t corner = 0; corner < 4; corner++)
+    {
+        Vec4f clip;
+        imp_view_proj.multVecMatrix(corners[corner], clip);
+        if (clip.w < nearPlane) return (false);
+        screen[corner] = { width * (clip.x + clip.w) / 2, height * (clip.w - clip.y) / 2, clip.w };
+        min_x = std::min(min_x, screen[corner].x / clip.w);
+        max_x = std::max(max_x, screen[corner].x / clip.w);
+        min_y = std::min(min_y, screen[corner].y / clip.w);
+        max_y = std::max(max_y, screen[corner].y / clip.w);
+    }
+
+    // The square maps u, v, 1 to screen x * w, y * w and w, so the inverse maps back
+    const Matrix33f M = {
+        screen[1].x - screen[0].x, screen[1].y - screen[0].y, screen[1].z - screen[0].z,
+        screen[2].x - screen[0].x, screen[2].y - screen[0].y, screen[2].z - screen[0].z,
+        screen[0].x, screen[0].y, screen[0].z };
+    Matrix33f inv = M;
+    inv = inv.inverse();
+    draw.U = { inv[0][0], inv[1][0], inv[2][0] };
+    draw.V = { inv[0][1], inv[1][1], inv[2][1] };
+    draw.W = { inv[0][2], inv[1][2], inv[2][2] };
+
+    draw.BoBox = { std::max(floorf(min_x), 0.0f), std::max(floorf(min_y), 0.0f),
+                   std::min(ceilf(max_x), width), std::min(ceilf(max_y), height) };
+
+    // Depth in the image is from its own eye so shift it by the change at the centre
+    Vec4f centre_clip;
+    imp_view_proj.multVecMatrix(imp.centre, centre_clip);
+    draw.depth_offset = centre_clip.z - imp.distance;
+    draw.entry = &imp;
+    return (true);
+} // End of ImpostorPlace
+
+// Returns true if the chunk has been drawn as an impostor so that its faces aren't needed
+bool ImpostorDrawChunk(const Vec3f eye, const Vec3f direction, const WorldLayout* layo_ptr, const uint32_t this_chunk)
+{
+    if (!impostors_enabled) return (false);
+
+    const ChunkFaces & chunk = layo_ptr->TheChunks[this_chunk];
+    if (chunk.face_count == 0) return (false);
+
+    // Only chunks that are wholly beyond the texture depth, which the rasteriser tests by view depth
+    // so a chunk off to the side can be further away than this and still have textured pixels
+    if (ChunkNearestDepth(chunk, eye, direction) < IMPOSTOR_DISTANCE) return (false);
+
+    Impostor * imp = nullptr;
+    for (uint32_t i = 0; i < IMPOSTOR_ENTRIES; i++)
+    {
+        if ((impostors[i].layout == layo_ptr) && (impostors[i].chunk == this_chunk))
+        {
+            imp = &impostors[i];
+            break;
+        }
+    }
+
+    // A stale image is dropped, it can't be redrawn in place if core 1 is still using it
+    if (imp && !ImpostorValid(*imp, eye))
+    {
+        imp->layout = nullptr;
+        imp = nullptr;
+    }
+
+    if (imp == nullptr)
+    {
+        if (impostor_builds >= IMPOSTOR_BUILDS) return (false);
+        imp = ImpostorSlot();
+        if (imp == nullptr)
+        {
+            imp_report.no_slot++;
+            return (false);
+        }
+        if (imp->layout) imp_report.evictions++;
+        BuildImpostor(*imp, eye, layo_ptr, this_chunk);
+        impostor_builds++;
+    }
+
+    // The chunk sequence can offer a chunk twice, it is already in the list
+    if (imp->last_used == impostor_frame) return (true);
+
+    Impostor_draw & draw = impostor_list[impostor_building][impostor_count[impostor_building]];
+    if (!ImpostorPlace(*imp, draw)) return (false);
+
+    imp->last_used = impostor_frame;
+    if ((draw.BoBox.m_MinX < draw.BoBox.m_MaxX) && (draw.BoBox.m_MinY < draw.BoBox.m_MaxY)) impostor_count[impostor_building]++;
+    imp_report.chunks++;
+    imp_report.faces_skipped += chunk.face_count;
+    return (true);
+} // End of ImpostorDrawChunk
+
+// Rasterise the impostors of a list on core 1, after the queues so that depth testing still works
+void SendImpostors(const uint32_t list)
+{
+    extern depth_t* depthBuffer;
+
+    if (!impostors_enabled) return;
+    TRACE_SCOPE(TRACE_RASTER_TASK, TRACE_IMPOSTORS);
+
+    const depth_key_t depth_b = depth_base; // The depth encoding for this frame
+    const depth_key_t depth_s = depth_sign;
+
+    for (uint32_t item = 0; item < impostor_count[list]; item++)
+    {
+        const Impostor_draw & draw = impostor_list[list][item];
+        DepthTouchRect(draw.BoBox);
+        const Impostor & imp = *draw.entry;
+        const Vec3f U = draw.U;
+        const Vec3f V = draw.V;
+        const Vec3f W = draw.W;
+
+        for (uint32_t y = (uint32_t)draw.BoBox.m_MinY; y < draw.BoBox.m_MaxY; y++)
+        {
+            const float sy = y + 0.5f;
+            const float sx = draw.BoBox.m_MinX + 0.5f;
+            float uw = U.x * sx + U.y * sy + U.z;
+            float vw = V.x * sx + V.y * sy + V.z;
+            float w = W.x * sx + W.y * sy + W.z;
+
+            for (uint32_t x = (uint32_t)draw.BoBox.m_MinX; x < draw.BoBox.m_MaxX; x++)
+            {
+                const float u = uw / w;
+                const float v = vw / w;
+                uw += U.x;
+                vw += V.x;
+                w += W.x;
+                if ((u < 0.0f) || (u >= 1.0f) || (v < 0.0f) || (v >= 1.0f)) continue;
+
+                const uint32_t texel = (uint32_t)(v * IMPOSTOR_SIZE) * IMPOSTOR_SIZE + (uint32_t)(u * IMPOSTOR_SIZE);
+                if (imp.depth[texel] == IMPOSTOR_EMPTY) continue;
+
+                const float z = imp.depth[texel] + draw.depth_offset;
+                const depth_key_t key = DepthKey(z);
+                if (key <= depth_s * (depthBuffer[x + y * g_scWidth] - depth_b))
+                {
+                    depthBuffer[x + y * g_scWidth] = (depth_t)(depth_b + depth_s * key);
+                    WritePixel2Fog888(g_scWidth * y + x, imp.image[texel], z);
+                }
+            }
+        }
+    }
+} // End of SendImpostors
+
+// Log the impostor counters since the last call and reset them, integer only for the timer task
+void ReportImpostors()
+{
+    static const char *TAG = "Impostors";
+
+    if (!impostors_enabled) return;
+
+    ESP_LOGI(TAG, "Chunks drawn as impostors %d, faces skipped %d, images made %d replaced %d, no space %d",
+        (int)imp_report.chunks, (int)imp_report.faces_skipped, (int)imp_report.builds,
+        (int)imp_report.evictions, (int)imp_report.no_slot);
+    imp_report = {};
+} // End of ReportImpostors
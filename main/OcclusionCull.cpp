@@ -0,0 +1,477 @@
+// Software occlusion culling of chunks
+//
+// Mazes and buildings hide most of the chunks in the render sequence behind a few nearby walls
+// yet every one of them would be transformed, set up, queued and then rejected pixel by pixel
+// in the rasteriser. Here the large faces of the nearest chunks, and any faces with a material
+// flagged as an occluder by the world designer, are drawn into a small depth buffer first.
+// The bounding box of each later chunk is then tested against it before CheckTriangles runs.
+//
+// The buffer is conservative: a cell only takes a depth when a single triangle covers all of it
+// and then stores the furthest depth of that triangle within the cell. A chunk is culled only when
+// its nearest point is behind the occluders in every cell that its bounding box covers.
+//
+// Optionally the depth buffer left by the previous frame is also kept, reduced to the same cells by
+// taking the furthest depth in each, and tested with margins for how far the camera has moved and
+// turned since. Those margins are estimates so a chunk hidden this way is always drawn on the next
+// frame, which limits any popping to a single frame.
+
+#include <stdint.h>
+#include <algorithm>
+
+#include "esp_log.h"
+
+#include "globals.h"
+#include "geometry.h"
+#include "structures.h"
+
+#include "CameraWork.h"
+#include "EventManager.h"
+#include "RasteriseBox.h"
+#include "RenderScale.h"
+
+#include "OcclusionCull.h"
+
+// The number of steps of the chunk sequence whose large faces are used as occluders
+const uint32_t OCC_NEAR_CHUNKS = 6;
+
+// A face must cover at least this bounding box area in pixels to be used as an occluder
+// unless its material is flagged, small faces rarely cover a whole cell
+const float OCC_MIN_AREA = 12.0f * 12.0f;
+
+// Cleared to the same depth as the depth buffer so an empty cell hides nothing
+const float OCC_CLEAR_DEPTH = 200.0f;
+
+// The previous frame is not used when the view has turned further than this in radians
+// or when the movement margin grows beyond a quarter of the screen as little would be culled
+const float OCC_TEMPORAL_MAX_TURN = 0.1f;
+const float OCC_TEMPORAL_MAX_MARGIN = g_scWidth / 4;
+
+// The most chunks that can be culled from the previous frame, each has to be remembered
+// so that it is drawn in the next frame
+const uint32_t OCC_TEMPORAL_LIST = 64;
+
+constexpr uint32_t occ_cell_width = OCC_CELL;
+constexpr uint32_t occ_cell_height = OCC_CELL;
+
+// Chosen in menuconfig under Amaze renderer, off by default so every chunk is drawn as before
+#if defined(CONFIG_AMAZE_OCCLUSION_ON)
+uint32_t occlusion_mode = OCCLUSION_ON;
+#elif defined(CONFIG_AMAZE_OCCLUSION_ALTERNATE)
+uint32_t occlusion_mode = OCCLUSION_ALTERNATE;
+#else
+uint32_t occlusion_mode = OCCLUSION_OFF;
+#endif
+
+float occ_depth[OCC_SIZE_X * OCC_SIZE_Y]; // Only used on core 0 so kept in internal RAM
+
+Matrix44f occ_view_proj; // The same view and projection that CheckTriangles uses this frame
+
+bool occ_active = false; // Whether culling applies to this frame
+bool occ_near_chunk = false; // Whether the chunk being checked is near enough to supply occluders
+
+// Also cull against the previous frame's depth buffer, chosen in menuconfig and off by default
+#ifdef CONFIG_AMAZE_OCCLUSION_TEMPORAL
+bool occlusion_temporal = true;
+#else
+bool occlusion_temporal = false;
+#endif
+
+// The views of this and the previous frame, the depth buffer is one frame behind the queues being built
+struct Occ_view
+{
+    Vec3f eye;
+    Vec3f direction;
+};
+Occ_view occ_this_view, occ_last_view;
+uint32_t occ_views_made = 0;
+
+float temporal_depth[OCC_SIZE_X * OCC_SIZE_Y]; // Furthest depth in each cell of the previous frame
+Occ_view temporal_view; // The view that temporal_depth was rendered from
+float temporal_nearest = 0.0f; // The nearest depth anywhere in the previous frame
+bool temporal_valid = false; // Set once a frame has been captured
+Render_size temporal_size; // The resolution the captured frame was drawn at
+
+bool temporal_use = false; // Whether the previous frame is used for this frame
+float temporal_margin_pixels = 0.0f; // How far screen positions may have moved
+float temporal_margin_depth = 0.0f; // How much closer anything may have become
+
+// Chunks culled from the previous frame in this and the last frame
+struct Occ_culled
+{
+    const WorldLayout* layout;
+    uint32_t chunk;
+};
+Occ_culled temporal_culled[2][OCC_TEMPORAL_LIST];
+uint32_t temporal_culled_count[2] = { 0, 0 };
+uint32_t temporal_culled_now = 0; // Which list is for this frame
+bool temporal_exempt = false; // The chunk being checked was culled last frame so is drawn regardless
+
+Occlusion_tracked occ_report;
+
+// Keep the previous frame's depth buffer as the furthest depth in each cell, it must be called
+// whilst the rasteriser is idle and before the depth buffer is cleared or its encoding swapped
+void OcclusionCapturePrevious()
+{
+    extern depth_t* depthBuffer;
+
+    temporal_valid = false;
+    if (!occlusion_temporal || (occ_views_made < 2)) return; // The buffer isn't from a known view yet
+
+    float nearest = OCC_CLEAR_DEPTH;
+    for (uint32_t cy = 0; cy < OCC_SIZE_Y; cy++)
+    {
+        for (uint32_t cx = 0; cx < OCC_SIZE_X; cx++)
+        {
+            float furthest = 0.0f;
+            const depth_t* row = &depthBuffer[(cy * occ_cell_height * g_scWidth) + (cx * occ_cell_width)];
+            for (uint32_t y = 0; y < occ_cell_height; y++)
+            {
+                for (uint32_t x = 0; x < occ_cell_width; x++)
+                {
+                    const float depth = DepthDecode(row[x]);
+                    furthest = std::max(furthest, depth);
+                    nearest = std::min(nearest, depth);
+                }
+                row += g_scWidth;
+            }
+            temporal_depth[cy * OCC_SIZE_X + cx] = furthest;
+        }
+    }
+
+    // The depth buffer holds the queues built in the frame before last, which is the list
+    // about to be built again so its size is still recorded
+    extern bool flipped;
+    temporal_size = render_size[flipped ? 1 : 0];
+    temporal_view = occ_last_view;
+    temporal_nearest = nearest;
+    temporal_valid = true;
+} // End of OcclusionCapturePrevious
+
+// Work out whether the previous frame can be used for this view and with what margins
+static void TemporalNewFrame(const Vec3f eye, const Vec3f direction)
+{
+    extern Matrix44f proj; // Built by ProjectionMatrix()
+
+    temporal_use = false;
+
+    // Start a new list of culled chunks keeping the last one as chunks to draw regardless
+    temporal_culled_now ^= 0x01;
+    temporal_culled_count[temporal_culled_now] = 0;
+
+    if (!temporal_valid) return;
+
+    // Screen positions can't be compared if the resolution has changed
+    if ((temporal_size.width != render_width) || (temporal_size.height != render_height))
+    {
+        occ_report.temporal_skipped++;
+        return;
+    }
+
+    const float moved = (eye - temporal_view.eye).length();
+    const float cosine = direction.dotProduct(temporal_view.direction) /
+                        (direction.length() * temporal_view.direction.length());
+    const float turned = acosf(std::clamp(cosine, -1.0f, 1.0f));
+
+    // A nearby edge moves across the screen further than a distant one as the eye moves,
+    // the player can't be closer than the collision distance so that limits the parallax
+    const float focal = proj[0][0] * render_width / 2;
+    const float closest = std::max(temporal_nearest, COLLISION_DISTANCE);
+    temporal_margin_pixels = focal * (turned + (moved / closest));
+    temporal_margin_depth = moved;
+
+    if ((turned > OCC_TEMPORAL_MAX_TURN) || (temporal_margin_pixels > OCC_TEMPORAL_MAX_MARGIN))
+    {
+        occ_report.temporal_skipped++;
+        return;
+    }
+    temporal_use = true;
+} // End of TemporalNewFrame
+
+// Start a frame by emptying the buffer and making the matrix for projecting chunk bounds
+void OcclusionNewFrame(const Vec3f eye, const Vec3f direction)
+{
+    extern Matrix44f proj; // Built by ProjectionMatrix()
+    static uint32_t frame_count = 0;
+
+    // Track the views so that the captured depth buffer can be matched to its view
+    occ_last_view = occ_this_view;
+    occ_this_view = { eye, direction };
+    if (occ_views_made < 2) occ_views_made++;
+
+    TemporalNewFrame(eye, direction);
+
+    frame_count++;
+    occ_active = (occlusion_mode == OCCLUSION_ON) || ((occlusion_mode == OCCLUSION_ALTERNATE) && (frame_count & 0x01));
+    if (!occ_active && !temporal_use) return;
+
+    for (uint32_t cell = 0; cell < OCC_SIZE_X * OCC_SIZE_Y; cell++)
+    {
+        occ_depth[cell] = OCC_CLEAR_DEPTH;
+    }
+
+    Matrix44f occ_view;
+    make_camera(direction, eye, occ_view);
+    occ_view_proj = occ_view * proj;
+} // End of OcclusionNewFrame
+
+// ShowWorld says which step of the chunk sequence is being worked on
+// as only the nearest steps give large faces as occluders
+void OcclusionSequenceStep(const uint32_t step)
+{
+    occ_near_chunk = (step < OCC_NEAR_CHUNKS);
+}
+
+// Decide whether a triangle that CheckTriangles has set up should also be drawn as an occluder
+bool OcclusionIsOccluder(const TriToRaster & tri)
+{
+    if (!occ_active) return (false);
+
+    // The designer can ask for any face to be an occluder through its material's event code
+    const uint32_t event = tri.layout->palette[tri.layout->attributes[tri.idx]].event;
+    if ((event & (EVNT_RENDER | ER_OCCLUDER)) == (EVNT_RENDER | ER_OCCLUDER)) return (true);
+
+    const float area = (tri.BoBox.m_MaxX - tri.BoBox.m_MinX) * (tri.BoBox.m_MaxY - tri.BoBox.m_MinY);
+    return (occ_near_chunk && (area >= OCC_MIN_AREA));
+} // End of OcclusionIsOccluder
+
+// Draw a triangle into the occlusion buffer using the edge and depth functions from its set up
+// A cell is only written if all four corners are inside all three edges, and as the triangle is
+// convex the whole cell is then covered. Depth is not linear in screen space but is monotonic along
+// any line across the triangle so its furthest point in the cell is at one of the corners.
+void OcclusionAddOccluder(const TriToRaster & tri)
+{
+    const Matrix33f& invM = tri.invM;
+    const Vec3f E0 = { invM[0][0], invM[0][1], invM[0][2] };
+    const Vec3f E1 = { invM[1][0], invM[1][1], invM[1][2] };
+    const Vec3f E2 = { invM[2][0], invM[2][1], invM[2][2] };
+    const Vec3f C = tri.C;
+    const Vec3f Z = tri.Z;
+
+    // Only cells that lie completely inside the bounding box can be completely covered
+    const uint32_t cx_start = (uint32_t)ceilf(tri.BoBox.m_MinX / occ_cell_width);
+    const uint32_t cy_start = (uint32_t)ceilf(tri.BoBox.m_MinY / occ_cell_height);
+    const uint32_t cx_end = std::min((uint32_t)(tri.BoBox.m_MaxX / occ_cell_width), (uint32_t)OCC_SIZE_X);
+    const uint32_t cy_end = std::min((uint32_t)(tri.BoBox.m_MaxY / occ_cell_height), (uint32_t)OCC_SIZE_Y);
+    if ((cx_start >= cx_end) || (cy_start >= cy_end)) return; // Too small to cover any cell
+
+    occ_report.occluders++;
+
+    // Corner results are shared between neighbouring cells so keep the previous row
+    bool inside_above[OCC_SIZE_X + 1];
+    float depth_above[OCC_SIZE_X + 1];
+
+    for (uint32_t cy = cy_start; cy <= cy_end; cy++)
+    {
+        const float y = (float)(cy * occ_cell_height);
+        bool inside_left = false;
+        float depth_left = 0.0f;
+        for (uint32_t cx = cx_start; cx <= cx_end; cx++)
+        {
+            const float x = (float)(cx * occ_cell_width);
+
+            // Evaluate this corner, a point behind the viewer has 1/w below zero
+            const float oneOverW = (C.x * x) + (C.y * y) + C.z;
+            const bool inside = (oneOverW > 0.0f) &&
+                                ((E0.x * x) + (E0.y * y) + E0.z >= 0.0f) &&
+                                ((E1.x * x) + (E1.y * y) + E1.z >= 0.0f) &&
+                                ((E2.x * x) + (E2.y * y) + E2.z >= 0.0f);
+            const float depth = inside ? ((Z.x * x) + (Z.y * y) + Z.z) / oneOverW : 0.0f;
+
+            // Now this is the bottom right corner of a cell whose other three corners are known
+            if ((cy > cy_start) && (cx > cx_start) && inside && inside_left && inside_above[cx] && inside_above[cx - 1])
+            {
+                const float furthest = std::max(std::max(depth, depth_left), std::max(depth_above[cx], depth_above[cx - 1]));
+                float & cell = occ_depth[(cy - 1) * OCC_SIZE_X + (cx - 1)];
+                cell = std::min(cell, furthest);
+            }
+
+            // Move along, keeping the corner for the cell to the right and for the next row
+            if (cx > cx_start)
+            {
+                inside_above[cx - 1] = inside_left;
+                depth_above[cx - 1] = depth_left;
+            }
+            inside_left = inside;
+            depth_left = depth;
+        }
+        inside_above[cx_end] = inside_left;
+        depth_above[cx_end] = depth_left;
+    }
+} // End of OcclusionAddOccluder
+
+// Test a screen rectangle against the previous frame, widened by the margins for the camera's movement
+// Any part of the widened rectangle that is off screen was not seen last frame so can't be hidden
+static bool TemporalTestRect(const float min_x, const float min_y, const float max_x, const float max_y, const float nearest)
+{
+    const float left = min_x - temporal_margin_pixels;
+    const float top = min_y - temporal_margin_pixels;
+    const float right = max_x + temporal_margin_pixels;
+    const float bottom = max_y + temporal_margin_pixels;
+    if ((left < 0.0f) || (top < 0.0f) || (right >= render_width) || (bottom >= render_height)) return (false);
+
+    const float closest = nearest - temporal_margin_depth;
+    for (uint32_t cy = (uint32_t)top / occ_cell_height; cy <= (uint32_t)bottom / occ_cell_height; cy++)
+    {
+        for (uint32_t cx = (uint32_t)left / occ_cell_width; cx <= (uint32_t)right / occ_cell_width; cx++)
+        {
+            if (closest <= temporal_depth[cy * OCC_SIZE_X + cx]) return (false);
+        }
+    }
+    return (true);
+} // End of TemporalTestRect
+
+// Was this chunk culled by the previous frame on the last frame?
+static bool TemporalWasCulled(const WorldLayout* layo_ptr, const uint32_t this_chunk)
+{
+    const uint32_t last = temporal_culled_now ^ 0x01;
+    for (uint32_t i = 0; i < temporal_culled_count[last]; i++)
+    {
+        if ((temporal_culled[last][i].layout == layo_ptr) && (temporal_culled[last][i].chunk == this_chunk)) return (true);
+    }
+    return (false);
+}
+
+// Returns true if the chunk's bounding box is completely hidden by occluders or is off screen
+bool OcclusionTestChunk(const WorldLayout* layo_ptr, const uint32_t this_chunk)
+{
+    temporal_exempt = true; // Until the chunk is known the previous frame can't cull its faces
+    if (!occ_active && !temporal_use) return (false);
+
+    const ChunkFaces & chunk = layo_ptr->TheChunks[this_chunk];
+    if (chunk.face_count == 0) return (false); // Nothing to save and the bounds aren't set
+
+    occ_report.chunks_tested++;
+
+    // Project the eight corners, depth is affine in world space so its minimum is at a corner
+    const float width = render_width; // The size this frame is rasterised at
+    const float height = render_height;
+    float min_x = width, min_y = height, max_x = 0.0f, max_y = 0.0f;
+    float nearest = OCC_CLEAR_DEPTH;
+    for (uint32_t corner = 0; corner < 8; corner++)
+    {
+        const Vec3f point = {
+            (corner & 0x01) ? chunk.bound_max.x : chunk.bound_min.x,
+            (corner & 0x02) ? chunk.bound_max.y : chunk.bound_min.y,
+            (corner & 0x04) ? chunk.bound_max.z : chunk.bound_min.z };
+        Vec4f clip;
+        occ_view_proj.multVecMatrix(point, clip);
+
+        // If any part of the box is close to or behind the viewer its screen extent can't be bounded
+        if (clip.w < nearPlane) return (false);
+
+        const float x = width * (clip.x + clip.w) / (2 * clip.w);
+        const float y = height * (clip.w - clip.y) / (2 * clip.w);
+        min_x = std::min(min_x, x);
+        max_x = std::max(max_x, x);
+        min_y = std::min(min_y, y);
+        max_y = std::max(max_y, y);
+        nearest = std::min(nearest, clip.z);
+    }
+
+    // A box that is off screen can't be seen at all
+    if ((max_x < 0.0f) || (max_y < 0.0f) || (min_x >= width) || (min_y >= height))
+    {
+        occ_report.chunks_outside++;
+        occ_report.faces_skipped += chunk.face_count;
+        return (true);
+    }
+
+    // A chunk culled by the previous frame last time is drawn now, both whole and face by face
+    temporal_exempt = !temporal_use || TemporalWasCulled(layo_ptr, this_chunk);
+
+    // Test each cell that the box touches, any cell where the box could be in front ends the test
+    if (occ_active)
+    {
+        const uint32_t cx_start = (uint32_t)std::max(min_x, 0.0f) / occ_cell_width;
+        const uint32_t cy_start = (uint32_t)std::max(min_y, 0.0f) / occ_cell_height;
+        const uint32_t cx_end = (uint32_t)std::min(max_x, width - 1) / occ_cell_width;
+        const uint32_t cy_end = (uint32_t)std::min(max_y, height - 1) / occ_cell_height;
+
+        bool hidden = true;
+        for (uint32_t cy = cy_start; hidden && (cy <= cy_end); cy++)
+        {
+            for (uint32_t cx = cx_start; cx <= cx_end; cx++)
+            {
+                if (nearest <= occ_depth[cy * OCC_SIZE_X + cx])
+                {
+                    hidden = false;
+                    break;
+                }
+            }
+        }
+        if (hidden)
+        {
+            occ_report.chunks_culled++;
+            occ_report.faces_skipped += chunk.face_count;
+            return (true);
+        }
+    }
+
+    // Then against the previous frame, remembering the chunk so that it is drawn next frame
+    const uint32_t now = temporal_culled_now;
+    if (!temporal_exempt && (temporal_culled_count[now] < OCC_TEMPORAL_LIST) &&
+        TemporalTestRect(min_x, min_y, max_x, max_y, nearest))
+    {
+        temporal_culled[now][temporal_culled_count[now]++] = { layo_ptr, this_chunk };
+        occ_report.temporal_chunks++;
+        occ_report.faces_skipped += chunk.face_count;
+        return (true);
+    }
+
+    return (false);
+} // End of OcclusionTestChunk
+
+// Returns true if a large triangle that CheckTriangles has set up was hidden in the previous frame
+// Triangles aren't remembered, so only those from chunks that could themselves be culled are tested
+bool OcclusionTestTriangle(const TriToRaster & tri)
+{
+    if (!temporal_use || temporal_exempt) return (false);
+
+    const float area = (tri.BoBox.m_MaxX - tri.BoBox.m_MinX) * (tri.BoBox.m_MaxY - tri.BoBox.m_MinY);
+    if (area < OCC_MIN_AREA) return (false); // Small triangles cost less to draw than to test
+
+    const float nearest = std::min(std::min(tri.clip_zs.x, tri.clip_zs.y), tri.clip_zs.z);
+    if (!TemporalTestRect(tri.BoBox.m_MinX, tri.BoBox.m_MinY, tri.BoBox.m_MaxX, tri.BoBox.m_MaxY, nearest)) return (false);
+
+    occ_report.temporal_triangles++;
+    return (true);
+} // End of OcclusionTestTriangle
+
+// Record the time taken for the frame so that OCCLUSION_ALTERNATE can compare frames with and without culling
+void OcclusionFrameTime(const uint32_t frame_time)
+{
+    if (occlusion_mode != OCCLUSION_ALTERNATE) return;
+    if (occ_active)
+    {
+        occ_report.culled_frames++;
+        occ_report.culled_ms += frame_time;
+    }
+    else
+    {
+        occ_report.unculled_frames++;
+        occ_report.unculled_ms += frame_time;
+    }
+}
+
+// Log the culling counters since the last call and reset them, integer only for the timer task
+void ReportOcclusion()
+{
+    static const char *TAG = "Occlusion";
+
+    if ((occlusion_mode == OCCLUSION_OFF) && !occlusion_temporal) return;
+
+    ESP_LOGI(TAG, "Chunks tested %d culled %d off screen %d, faces skipped %d, occluders %d",
+        (int)occ_report.chunks_tested, (int)occ_report.chunks_culled, (int)occ_report.chunks_outside,
+        (int)occ_report.faces_skipped, (int)occ_report.occluders);
+    if (occlusion_temporal)
+    {
+        ESP_LOGI(TAG, "Previous frame culled chunks %d triangles %d, unused for %d frames",
+            (int)occ_report.temporal_chunks, (int)occ_report.temporal_triangles, (int)occ_report.temporal_skipped);
+    }
+    if (occ_report.culled_frames && occ_report.unculled_frames)
+    {
+        ESP_LOGI(TAG, "Frame time culled %dms unculled %dms",
+            (int)(occ_report.culled_ms / occ_report.culled_frames), (int)(occ_report.unculled_ms / occ_report.unculled_frames));
+    }
+    occ_report = {};
+} // End of ReportOcclusion
@@ -1,4 +1,5 @@
 #include <vector>
+#include <algorithm>
 
 #include "structures.h"
 #include "ParseWorld.h"
@@ -59,12 +60,12 @@ static const char *TAG = "ParseWorld";
         
         //ESP_LOGI(TAG, "member is %x", (unsigned int) member);
         // The first read member SHOULD be a descriptor
-        if (! (member & 0x10000000)) assert ("Error parsing descriptor");
+        if (! (member & WORLD_DESC_LAYOUT)) assert ("Error parsing descriptor");
 
         // It is a descriptor so a fresh layout follows
             
         temp_layout.frame_layouts.clear(); // Clear the vector part of the temp_layout for each new layout
-        const uint32_t frames = (member & 0x00ff0000) >> 16; // Extract the frame count
+        const uint32_t frames = (member & WORLD_DESC_FRAMES) >> WORLD_DESC_FRAMES_SHIFT; // Extract the frame count
         temp_layout.frames = frames; // Store how many frames are in this layout 
 
         descriptor_ptr ++ ; // Step to first offset value
@@ -81,6 +82,29 @@ static const char *TAG = "ParseWorld";
 
             descriptor_ptr++; // Go to the next offset
             }
+
+        // A potentially visible set may follow with an offset for each of the frames
+        if (* descriptor_ptr & WORLD_DESC_PVS)
+            {
+            const uint32_t pvs_frames = (* descriptor_ptr & WORLD_DESC_FRAMES) >> WORLD_DESC_FRAMES_SHIFT;
+            descriptor_ptr++; // Step to first offset value
+
+            if (pvs_frames == frames)
+                {
+                for (unsigned int frame_i = 0 ; frame_i < pvs_frames ; frame_i++)
+                    {
+                    ReadPVS(w_ptr + * descriptor_ptr, & temp_layout.frame_layouts[frame_i]);
+                    descriptor_ptr++;
+                    }
+                }
+            else
+                {
+                // A mismatched set can't be matched to frames so step over it and leave every chunk visible
+                ESP_LOGI(TAG,"PVS has %d frames but its layout has %d, ignoring it",(int)pvs_frames,(int)frames);
+                descriptor_ptr += pvs_frames;
+                }
+            }
+
         // All of the offsets have been read now so push that layout
         world.push_back(temp_layout); // Store the layout we have just read
     } // End of while (member)
@@ -109,6 +133,8 @@ WorldLayout ReadWorld(const void * w_ptr , const void * texture_map_ptr)
     temp_world.vts = (Vec2f *) (w_map_ptr + world_header_ptr->vts);
     temp_world.texel_verts = (uint16_t *) (w_map_ptr + world_header_ptr->texels);
     temp_world.attributes = (uint16_t *) (w_map_ptr + world_header_ptr->attributes);
+    temp_world.pvs = nullptr; // Every chunk is visible unless a PVS follows in the descriptors
+    temp_world.pvs_words = 0;
 
     ESP_LOGI(TAG,"Attributes are at %p",temp_world.attributes);
 
@@ -185,9 +211,17 @@ WorldLayout ReadWorld(const void * w_ptr , const void * texture_map_ptr)
     temp_world.ChAr.xcount =  * (chunk_param_ptr + 2);
     temp_world.ChAr.zcount =  * (chunk_param_ptr + 3);
     temp_world.ChAr.size =  * (chunk_param_ptr + 4);
+    const int16_t chunk_format = * (chunk_param_ptr + 5); // The padding of older worlds reads as CHUNK_FORMAT_LISTS
+    const bool chunk_bases = (chunk_format == CHUNK_FORMAT_BASES) || (chunk_format == CHUNK_FORMAT_QUANTISED);
+    const uint32_t entry_words = chunk_bases ? 5 : 2;
+    if (chunk_bases) ESP_LOGI(TAG,"Chunk entries have face, vertex and UV bases");
+
+    // Quantised vertices are found through FaceVertex() and the UVs scaled in the kernels
+    temp_world.vertex_step = (chunk_format == CHUNK_FORMAT_QUANTISED) ? (float)temp_world.ChAr.size / QUANT_CHUNK_STEPS : 0.0f;
+    if (temp_world.vertex_step) ESP_LOGI(TAG,"Vertices and UVs are quantised");
 
     // calculate the size of the chunk map array based on its components
-    int16_t chunk_map_size = temp_world.ChAr.xcount * temp_world.ChAr.zcount * (sizeof(uint16_t *) + sizeof(uint32_t));
+    const uint32_t chunk_map_size = temp_world.ChAr.xcount * temp_world.ChAr.zcount * sizeof(ChunkFaces);
 
     //ESP_LOGI(TAG, "Chunk map size in bytes is %d",chunk_map_size);
 
@@ -196,32 +230,44 @@ WorldLayout ReadWorld(const void * w_ptr , const void * texture_map_ptr)
     if (temp_world.TheChunks == NULL) assert ("Chunk table malloc failed");
 
     // Find the start of the chunk map in the partition
-    constexpr uint32_t chunk_header_size = sizeof(uint16_t) * 6; // 5 values plus 1 padding
+    constexpr uint32_t chunk_header_size = sizeof(uint16_t) * 6; // 5 values plus the format
 
     uint8_t * temp_ch_ptr = (uint8_t *) chunk_param_ptr; // Cast to byte size to keep arithetic in line  
     uint32_t * chunk_map_ptr = (uint32_t *) (temp_ch_ptr + chunk_header_size); // Ptr to read from the map
 
     // Do a looped copy so that pointers can be updated as it happens using offsets in the binary
     // The chunk map will then point to chunk list in flash partition
-    for (uint32_t ch_index = 0; ch_index < temp_world.ChAr.xcount * temp_world.ChAr.zcount ; ch_index++)
+    for (uint32_t ch_index = 0; ch_index < temp_world.ChAr.xcount * temp_world.ChAr.zcount ; ch_index++, chunk_map_ptr += entry_words)
     {
         // Adapt to copy face lists into arrays in heap
 
-        // Fetch the pointer to the list of faces, and step to the count
-        uint16_t * const faces_ptr = (uint16_t *)(temp_ch_ptr + (* chunk_map_ptr)); chunk_map_ptr++;
+        // Fetch the pointer to the list of faces and the count
+        uint16_t * const faces_ptr = (uint16_t *)(temp_ch_ptr + chunk_map_ptr[0]);
+        const uint32_t face_count = chunk_map_ptr[1];
 
-        // Fetch the count and step for next chunk
-        const uint32_t face_count = * chunk_map_ptr; chunk_map_ptr++; 
+        // Without bases every index is into the whole layout
+        ChunkFaces & this_chunk = temp_world.TheChunks[ch_index];
+        this_chunk.face_base = chunk_bases ? chunk_map_ptr[2] : 0;
+        if (temp_world.vertex_step)
+        {
+            this_chunk.qvertices = (const Quant_vertex *)temp_world.vertices + chunk_map_ptr[3];
+            this_chunk.qvts = (const Quant_uv *)temp_world.vts + chunk_map_ptr[4];
+        }
+        else
+        {
+            this_chunk.vertices = temp_world.vertices + (chunk_bases ? chunk_map_ptr[3] : 0);
+            this_chunk.vts = temp_world.vts + (chunk_bases ? chunk_map_ptr[4] : 0);
+        }
 
         //ESP_LOGI(TAG,"Chunk index %d and face count is %d",(int)ch_index, (int)face_count);
 
-        temp_world.TheChunks[ch_index].face_count = face_count;
+        this_chunk.face_count = face_count;
         if (face_count == 0) continue; // No faces in this chunk so don't do malloc etc
  
         // malloc enough space for the count and put the address in the pointer area
         uint16_t * temp_chunk_face_ptr = (uint16_t *) heap_caps_malloc(face_count * sizeof(uint16_t) , MALLOC_CAP_INTERNAL);
         if (temp_chunk_face_ptr == NULL) assert ("Chunk face list malloc failed");
-        temp_world.TheChunks[ch_index].faces_ptr = temp_chunk_face_ptr; 
+        this_chunk.faces_ptr = temp_chunk_face_ptr; 
         
         // Copy array of faces from the partition to the RAM
         for (uint32_t i = 0; i < face_count; i++)
@@ -229,8 +275,41 @@ WorldLayout ReadWorld(const void * w_ptr , const void * texture_map_ptr)
             //ESP_LOGI(TAG,"face in chunk %d",(int)faces_ptr[i]);
             temp_chunk_face_ptr[i] = faces_ptr[i]; 
         }
+
+        // Find the bounding box of every vertex used by the chunk for culling
+        // Faces are allocated by centroid so can overhang the chunk's own square
+        Vec3f bound_min = FaceVertex(&temp_world, ch_index, this_chunk.face_base + temp_chunk_face_ptr[0], 0);
+        Vec3f bound_max = bound_min;
+        for (uint32_t i = 0; i < face_count * 3; i++)
+        {
+            const Vec3f vertex = FaceVertex(&temp_world, ch_index, this_chunk.face_base + temp_chunk_face_ptr[i / 3], i % 3);
+            bound_min = { std::min(bound_min.x, vertex.x), std::min(bound_min.y, vertex.y), std::min(bound_min.z, vertex.z) };
+            bound_max = { std::max(bound_max.x, vertex.x), std::max(bound_max.y, vertex.y), std::max(bound_max.z, vertex.z) };
+        }
+        this_chunk.bound_min = bound_min;
+        this_chunk.bound_max = bound_max;
     } // End of for to each chunk
 
     // Return the world layout that's been built
     return(temp_world);
-}; // End of ReadWorld
\ No newline at end of file
+}; // End of ReadWorld
+
+// Link a potentially visible set to the layout frame that it describes
+// It is left in the partition as it is only read a word at a time for each chunk chosen
+void ReadPVS(const void * pvs_ptr, WorldLayout * layo_ptr)
+{
+    static const char *TAG = "ReadPVS";
+
+    const pvs_header * pvs_header_ptr = (const pvs_header *) pvs_ptr;
+    const uint32_t chunk_count = layo_ptr->ChAr.xcount * layo_ptr->ChAr.zcount;
+
+    // A set made for a different build of the world would hide the wrong chunks so ignore it
+    if ((pvs_header_ptr->chunk_count != chunk_count) || (pvs_header_ptr->words < (chunk_count + 31) / 32))
+    {
+        ESP_LOGI(TAG,"PVS for %d chunks doesn't match layout with %d chunks, ignored",(int)pvs_header_ptr->chunk_count,(int)chunk_count);
+        return;
+    }
+    layo_ptr->pvs = (const uint32_t *)(pvs_header_ptr + 1);
+    layo_ptr->pvs_words = pvs_header_ptr->words;
+    ESP_LOGI(TAG,"PVS linked for %d chunks",(int)chunk_count);
+}; // End of ReadPVS
\ No newline at end of file
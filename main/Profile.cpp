@@ -0,0 +1,88 @@
+#include <stdint.h>
+#include <algorithm>
+
+#include "esp_log.h"
+
+#include "globals.h"
+
+#include "Profile.h"
+
+// Frame stage profiling
+// Each stage's time is summed over a frame, whichever core or task it ran on, and at the end of the
+// frame the sums become one sample per stage. Samples are gathered for a second into one of two
+// records while the timer task reports the other, so the report never sorts samples being written.
+
+#if PROFILE_ON
+
+#define PROFILE_FRAMES 64 // Samples kept per second, more frames still count towards min, avg and max
+
+struct Profile_second
+{
+    uint32_t frames;
+    uint32_t total[PROF_STAGES];    // Microseconds
+    uint32_t least[PROF_STAGES];
+    uint32_t most[PROF_STAGES];
+    uint32_t samples[PROF_STAGES][PROFILE_FRAMES];
+};
+
+static uint32_t frame_ticks[PROF_STAGES];
+static Profile_second seconds[2];
+static volatile uint32_t second_now = 0; // The record being gathered
+
+void ProfileAdd(const uint32_t stage, const uint32_t ticks)
+{
+    frame_ticks[stage] += ticks;
+}
+
+// Called by ShowWorld at the end of each frame whilst the rasteriser is idle
+void ProfileEndFrame()
+{
+    Profile_second & second = seconds[second_now];
+    const uint32_t slot = second.frames;
+    for (uint32_t stage = 0; stage < PROF_STAGES; stage++)
+    {
+        const uint32_t us = frame_ticks[stage] / PROFILE_TICKS_PER_US;
+        frame_ticks[stage] = 0;
+        second.total[stage] += us;
+        second.least[stage] = (slot == 0) ? us : std::min(second.least[stage], us);
+        second.most[stage] = std::max(second.most[stage], us);
+        if (slot < PROFILE_FRAMES) second.samples[stage][slot] = us;
+    }
+    second.frames++;
+}
+
+// Log each stage for the last second, integer only for the timer task
+void ReportProfile()
+{
+    static const char *TAG = "Profile";
+    static const char * const stage_names[PROF_STAGES] = {
+        "chunk choose", "base triangles", "vertex", "setup", "clip", "queue",
+        "flat kernel", "textured kernel", "flat tile kernel", "textured tile kernel",
+        "clear", "raster wait", "DMA wait", "events" };
+
+    const uint32_t reported = second_now;
+    second_now = reported ^ 0x01;
+    Profile_second & second = seconds[reported];
+    if (second.frames == 0) return;
+
+    const uint32_t kept = std::min(second.frames, (uint32_t)PROFILE_FRAMES);
+    for (uint32_t stage = 0; stage < PROF_STAGES; stage++)
+    {
+        if (second.most[stage] == 0) continue; // Not timed or too short to see
+
+        uint32_t * const samples = second.samples[stage];
+        std::sort(samples, samples + kept);
+        const uint32_t p99 = samples[(kept * 99 + 99) / 100 - 1];
+        ESP_LOGI(TAG, "%s min %dus avg %dus max %dus p99 %dus", stage_names[stage], (int)second.least[stage],
+            (int)(second.total[stage] / second.frames), (int)second.most[stage], (int)p99);
+    }
+    second = {};
+} // End of ReportProfile
+
+#else
+
+void ReportProfile()
+{
+}
+
+#endif
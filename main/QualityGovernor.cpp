@@ -0,0 +1,155 @@
+#include <stdint.h>
+
+#include "esp_log.h"
+
+#include "globals.h"
+#include "geometry.h"
+#include "structures.h"
+
+#include "RasteriseBox.h"
+#include "HorizonPanorama.h"
+#include "CostModel.h"
+#include "QualityGovernor.h"
+
+// Quality governor
+// Dynamic resolution and the chunk budget can't help every world, one with many large textured
+// faces is limited by texturing and one with many small chunks by how far the view reaches.
+// The texture and distance knobs below are turned down one level at a time when frames are slow,
+// choosing the texture knob when the raster core is the bottleneck and textures take much of it,
+// and turned back up after a long run of fast frames. The counts before a change are unequal and
+// a change is held for a while, so the view doesn't flicker between levels.
+// The distance knob moves the fog, and with it where chunks stop being sent. farPlane isn't
+// governed, it is fixed in the projection and the depth keys, so the fog end is the reach that
+// is traded. With the horizon panorama chunks beyond the fog are still drawn over it, the
+// panorama being drawn once at a fixed radius, so only the texture knob is governed then.
+
+uint32_t quality_mode = (FRAME_CONTROL == FRAME_CONTROL_QUALITY) ? QUALITY_GOVERNED : QUALITY_FIXED;
+Quality_levels quality_fixed = { 0, 0 };
+
+// Level 0 is the settings that were compile time constants
+static const float texture_depths[QUALITY_LEVELS] = { 22.0f, 16.0f, 11.0f, 7.0f };
+static const float texture_min_triangles[QUALITY_LEVELS] = { 6.0f, 8.0f, 11.0f, 15.0f };
+static const float texture_min_tiles[QUALITY_LEVELS] = { 3.0f, 4.0f, 6.0f, 8.0f };
+static const float fog_starts[QUALITY_LEVELS] = { 5.0f, 4.0f, 3.2f, 2.5f };
+static const float fog_ends[QUALITY_LEVELS] = { 30.0f, 24.0f, 19.0f, 15.0f };
+
+#define QUALITY_DOWN_FRAMES 4       // Slow frames in a row before a knob is turned down
+#define QUALITY_UP_FRAMES 30        // Fast frames in a row before one is turned up
+#define QUALITY_HOLD_FRAMES 20      // Frames after any change before another
+#define QUALITY_UP_PERCENT 70       // A fast frame is within this share of MAX_FRAME_DURATION
+#define QUALITY_TEXTURE_PERCENT 40  // Share of kernel time in textured classes that makes texturing the bottleneck
+
+static Quality_levels levels = { 0, 0 };
+static uint32_t slow_frames = 0;
+static uint32_t fast_frames = 0;
+static uint32_t hold_frames = 0;
+
+Quality_params quality_build = { texture_depths[0], texture_min_triangles[0], texture_min_tiles[0], fog_starts[0], fog_ends[0] };
+static Quality_params quality_list[2] = { quality_build, quality_build }; // What each list was built with
+
+// Frame times at each level of each knob, so the effect of a knob can be seen
+static uint32_t texture_frames[QUALITY_LEVELS], texture_ms[QUALITY_LEVELS];
+static uint32_t distance_frames[QUALITY_LEVELS], distance_ms[QUALITY_LEVELS];
+static uint32_t changes = 0;
+
+// Choose the levels for the frame about to be built on core 0 from the timings of the last one
+void QualityNewFrame(const uint32_t frame_time, const uint32_t build_us, const uint32_t raster_us)
+{
+    extern bool flipped;
+
+    texture_frames[levels.texture]++;
+    texture_ms[levels.texture] += frame_time;
+    distance_frames[levels.distance]++;
+    distance_ms[levels.distance] += frame_time;
+
+    // Beyond the fog chunks are only skipped when there is no panorama, so the knob does nothing with one
+    // and is left at level 0 rather than turning the fog in for no saving
+    const bool distance_useful = !horizon_enabled;
+
+    if (quality_mode == QUALITY_FIXED) levels = quality_fixed;
+    else if (hold_frames > 0) hold_frames--;
+    else if (frame_time > MAX_FRAME_DURATION)
+    {
+        fast_frames = 0;
+        if (++slow_frames >= QUALITY_DOWN_FRAMES)
+        {
+            const bool texture_bound = (raster_us > build_us) && (cost_textured_percent >= QUALITY_TEXTURE_PERCENT);
+            const bool texture_left = levels.texture < QUALITY_LEVELS - 1;
+            const bool distance_left = distance_useful && (levels.distance < QUALITY_LEVELS - 1);
+            if (texture_left && (texture_bound || !distance_left)) levels.texture++;
+            else if (distance_left) levels.distance++;
+            if (texture_left || distance_left)
+            {
+                hold_frames = QUALITY_HOLD_FRAMES;
+                changes++;
+            }
+            slow_frames = 0;
+        }
+    }
+    else if ((frame_time * 100) < (MAX_FRAME_DURATION * QUALITY_UP_PERCENT))
+    {
+        slow_frames = 0;
+        if (++fast_frames >= QUALITY_UP_FRAMES)
+        {
+            // View distance is the more noticeable so it comes back first
+            if ((levels.distance > 0) || (levels.texture > 0))
+            {
+                if (levels.distance > 0) levels.distance--;
+                else levels.texture--;
+                hold_frames = QUALITY_HOLD_FRAMES;
+                changes++;
+            }
+            fast_frames = 0;
+        }
+    }
+    else
+    {
+        slow_frames = 0;
+        fast_frames = 0;
+    }
+
+    quality_build.texture_depth = texture_depths[levels.texture];
+    quality_build.texture_min_triangle = texture_min_triangles[levels.texture];
+    quality_build.texture_min_tile = texture_min_tiles[levels.texture];
+    quality_build.fog_start = fog_starts[levels.distance];
+    quality_build.fog_end = fog_ends[levels.distance];
+    quality_list[flipped ? 1 : 0] = quality_build;
+} // End of QualityNewFrame
+
+// Give the rasteriser the settings that the list it's about to draw was built with, on core 1
+void QualityRasterFrame(const uint32_t list)
+{
+    SetRasterQuality(quality_list[list]);
+}
+
+// Returns true for a chunk wholly beyond the end of the fog, which would be drawn as fog colour over the fog background
+// Fog is by view depth so the nearest depth of the chunk is tested, not its distance
+bool QualityChunkBeyond(const Vec3f eye, const Vec3f direction, const WorldLayout* layo_ptr, const uint32_t this_chunk)
+{
+    if (horizon_enabled) return (false); // There is panorama rather than fog behind it
+
+    const ChunkFaces & chunk = layo_ptr->TheChunks[this_chunk];
+    if (chunk.face_count == 0) return (false);
+
+    return (ChunkNearestDepth(chunk, eye, direction) > quality_build.fog_end);
+}
+
+// Log the levels in use and the average frame time at each level seen, integer only for the timer task
+void ReportQuality()
+{
+    static const char *TAG = "Quality";
+
+    if (quality_mode != QUALITY_GOVERNED) return;
+
+    ESP_LOGI(TAG, "Texture level %d distance level %d, changes %d", (int)levels.texture, (int)levels.distance, (int)changes);
+    for (uint32_t level = 0; level < QUALITY_LEVELS; level++)
+    {
+        if (texture_frames[level]) ESP_LOGI(TAG, "Texture level %d %d frames %dms", (int)level,
+            (int)texture_frames[level], (int)(texture_ms[level] / texture_frames[level]));
+        if (distance_frames[level]) ESP_LOGI(TAG, "Distance level %d %d frames %dms", (int)level,
+            (int)distance_frames[level], (int)(distance_ms[level] / distance_frames[level]));
+        texture_frames[level] = texture_ms[level] = 0;
+        distance_frames[level] = distance_ms[level] = 0;
+    }
+    changes = 0;
+} // End of ReportQuality
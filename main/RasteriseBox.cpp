@@ -1,8 +1,10 @@
 #include <stdint.h>
 #include <algorithm>
+#include <cmath>
 
 #include "esp_log.h" 
 #include "esp_random.h"
+#include "esp_heap_caps.h"
 //#include "esp_dsp.h"
 
 #include "globals.h"
@@ -12,45 +14,241 @@
 #include "ShowError.h"
 
 #include "RasteriseBox.h"
+#include "PixelSimd.h"
+#include "HorizonPanorama.h"
+#include "RenderScale.h"
+#include "HeatMap.h"
 
-float* depthBuffer; // depthBuffer restricted in scope to this unit, albeit globally
+depth_t* depthBuffer; // depthBuffer restricted in scope to this unit, albeit globally
 extern uint16_t * frame_buffer_this;
 
-#define TEXTURE_DEPTH_THRESHOLD 22.f // Depth at which textures are disabled and base colour sent
+// When set neither the depth buffer nor the frame is cleared before drawing, instead the pixels
+// that nothing was drawn to are found at the end of the frame, see ResolveFrame()
+// Chosen in menuconfig under Amaze renderer, off by default so both are cleared as before
+#ifdef CONFIG_AMAZE_CLEAR_FREE
+bool clear_free_frames = true;
+#else
+bool clear_free_frames = false;
+#endif
+depth_key_t depth_base = 0; // The depth encoding, swapped by DepthNewFrame() on the rasteriser core
+depth_key_t depth_sign = 1;
+
+uint8_t tile_touched[DEPTH_TILES]; // Something was rasterised over the tile this frame
+uint8_t tile_far[DEPTH_TILES]; // Every depth in the tile is DEPTH_FAR, which is far in either encoding
+uint8_t tile_background[2][DEPTH_TILES]; // The tile is flat background in frame buffer A or B
+
+Clear_tracked clear_report;
+
+// The settings from the quality governor for the list being rasterised, its level 0 until it sets them
+static Quality_params raster_quality = { 22.0f, 6.0f, 3.0f, 5.0f, 30.0f };
+static float texture_inverse_depth = 1.0f / 22.0f; // Textures are used where 1/w is above this
+static float fog_divisor = 1.0f / (30.0f - 5.0f); // 1 / (fog end - fog start), so FogFunction() has no divide
+
+// Fog by 1/w so that flat pixels don't need w, the last entry covers the start of fog and nearer
+#define FOG_LUT_SIZE 256
+static float fog_lut_scale = (FOG_LUT_SIZE - 1) * 5.0f; // (FOG_LUT_SIZE - 1) * fog start
+uint8_t fog_lut[FOG_LUT_SIZE];
+
+// The share of a pixel against fog, 255 being clear
+inline uint32_t FogShareW(const float oneOverW)
+{
+    return (fog_lut[std::min((uint32_t)(oneOverW * fog_lut_scale), (uint32_t)(FOG_LUT_SIZE - 1))]);
+}
 
 // ************************************************************************************************
 // Start with various support functions for rasteriser
 
 void MakeDepthBuffer()
 {
-    depthBuffer = (float*)malloc(sizeof(float) * g_scWidth * g_scHeight);
+#if DEPTH_FORMAT == DEPTH_FLOAT
+    depthBuffer = (depth_t*)malloc(sizeof(depth_t) * g_scWidth * g_scHeight);
+#else
+    // Small enough now to be kept in internal SRAM with the frame buffers, PSRAM will do otherwise
+    depthBuffer = (depth_t*)heap_caps_malloc(sizeof(depth_t) * g_scWidth * g_scHeight, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!depthBuffer) depthBuffer = (depth_t*)malloc(sizeof(depth_t) * g_scWidth * g_scHeight);
+#endif
     if (!depthBuffer)
     {
         show_error("Failed to allocate depth buffer");
     }
+    MakeFogTable();
+
+    // The clear-free frames need a known start
+    ClearDepthBuffer(DEPTH_FAR);
+    for (uint32_t tile = 0; tile < DEPTH_TILES; tile++)
+    {
+        tile_far[tile] = true;
+        tile_background[0][tile] = false;
+        tile_background[1][tile] = false;
+    }
 }
 
 void ClearDepthBuffer(float farPlane)
 {
     // Passing farPlane as we may use it dynamically to affect redraw speed
     // Clear the depth buffer to a high z now we are using this rather than 1/w
+    const depth_t far_value = (depth_t)DepthKey(farPlane); // The plain encoding is used when clearing
     for (int pixel = 0; pixel < g_scWidth * g_scHeight; ++pixel)
     {
-        depthBuffer[pixel] = farPlane;
+        depthBuffer[pixel] = far_value;
+    }
+}
+
+// Called on the rasteriser core before anything is drawn, swaps the depth encoding between
+// the key and (2 * DEPTH_KEY_FAR - key) so that whatever is left from the last frame fails the depth test
+void DepthNewFrame()
+{
+    if (!clear_free_frames) return; // The depth buffer was cleared with the plain encoding
+
+    depth_sign = -depth_sign;
+    depth_base = (depth_sign < 0) ? 2 * DEPTH_KEY_FAR : 0;
+    for (uint32_t tile = 0; tile < DEPTH_TILES; tile++) tile_touched[tile] = false;
+}
+
+// Record the tiles under a box that is about to be rasterised
+void DepthTouchRect(const Rect2D & box)
+{
+    if (!clear_free_frames) return;
+
+    const uint32_t min_x = (uint32_t)std::max(box.m_MinX, 0.0f) / DEPTH_TILE;
+    const uint32_t min_y = (uint32_t)std::max(box.m_MinY, 0.0f) / DEPTH_TILE;
+    const uint32_t max_x = std::min((uint32_t)std::max(box.m_MaxX, 1.0f) - 1, (uint32_t)g_scWidth - 1) / DEPTH_TILE;
+    const uint32_t max_y = std::min((uint32_t)std::max(box.m_MaxY, 1.0f) - 1, (uint32_t)g_scHeight - 1) / DEPTH_TILE;
+    for (uint32_t ty = min_y; ty <= max_y; ty++)
+    {
+        for (uint32_t tx = min_x; tx <= max_x; tx++) tile_touched[ty * (g_scWidth / DEPTH_TILE) + tx] = true;
     }
 }
 
+// Fill the pixels of a frame that nothing was drawn to this frame, which replaces clearing the depth
+// buffer and frame beforehand. Untouched tiles are filled as a block, or skipped if they already are,
+// and in touched tiles only the pixels whose depth is left from the previous frame are written.
+// Every depth is then either from this frame or DEPTH_FAR, so nothing older survives to the next.
+// A frame drawn at a lower resolution only has colour resolved in its own region, the rest of the
+// frame buffer is written by UpscaleFrame(), but the depth of every tile is still reset.
+void ResolveFrame(uint16_t * frame_buffer, const uint32_t list)
+{
+    extern const uint16_t BackgroundColour;
+    constexpr uint32_t tiles_across = g_scWidth / DEPTH_TILE;
+
+    if (!clear_free_frames) return;
+
+    const uint32_t region_width = render_size[list].width;
+    const uint32_t region_height = render_size[list].height;
+
+    const depth_key_t depth_b = depth_base; // Locals as the depth buffer stores might otherwise alias them
+    const depth_key_t depth_s = depth_sign;
+    uint32_t bytes_read = 0, bytes_written = 0;
+
+    for (uint32_t tile = 0; tile < DEPTH_TILES; tile++)
+    {
+        const uint32_t x0 = (tile % tiles_across) * DEPTH_TILE;
+        const uint32_t y0 = (tile / tiles_across) * DEPTH_TILE;
+
+        if (tile_touched[tile])
+        {
+            tile_far[tile] = false;
+            tile_background[list][tile] = false;
+            for (uint32_t y = y0; y < y0 + DEPTH_TILE; y++)
+            {
+                for (uint32_t x = x0; x < x0 + DEPTH_TILE; x++)
+                {
+                    const uint32_t i = y * g_scWidth + x;
+                    if (depth_s * (depthBuffer[i] - depth_b) < DEPTH_KEY_FAR) continue; // Drawn this frame
+
+                    depthBuffer[i] = DEPTH_KEY_FAR;
+                    if (!HorizonSpan(&frame_buffer[i], list, x, y, 1)) frame_buffer[i] = BackgroundColour;
+                    bytes_written += sizeof(depth_t) + sizeof(uint16_t);
+                }
+            }
+            bytes_read += DEPTH_TILE * DEPTH_TILE * sizeof(depth_t);
+            continue;
+        }
+
+        const bool was_far = tile_far[tile];
+        if (!was_far)
+        {
+            for (uint32_t y = y0; y < y0 + DEPTH_TILE; y++)
+            {
+                for (uint32_t x = x0; x < x0 + DEPTH_TILE; x++) depthBuffer[y * g_scWidth + x] = DEPTH_KEY_FAR;
+            }
+            tile_far[tile] = true;
+            bytes_written += DEPTH_TILE * DEPTH_TILE * sizeof(depth_t);
+        }
+
+        if ((x0 >= region_width) || (y0 >= region_height)) continue; // Outside the rasterised region
+
+        // The panorama moves with the view so has to be copied every frame
+        if (HorizonSpan(&frame_buffer[y0 * g_scWidth + x0], list, x0, y0, DEPTH_TILE))
+        {
+            for (uint32_t y = y0 + 1; y < y0 + DEPTH_TILE; y++) HorizonSpan(&frame_buffer[y * g_scWidth + x0], list, x0, y, DEPTH_TILE);
+            bytes_written += DEPTH_TILE * DEPTH_TILE * sizeof(uint16_t);
+        }
+        else if (!tile_background[list][tile])
+        {
+            for (uint32_t y = y0; y < y0 + DEPTH_TILE; y++)
+            {
+                for (uint32_t x = x0; x < x0 + DEPTH_TILE; x++) frame_buffer[y * g_scWidth + x] = BackgroundColour;
+            }
+            tile_background[list][tile] = true;
+            bytes_written += DEPTH_TILE * DEPTH_TILE * sizeof(uint16_t);
+        }
+        else if (was_far) clear_report.tiles_skipped++;
+    }
+
+    clear_report.frames++;
+    clear_report.bytes_read += bytes_read;
+    clear_report.bytes_written += bytes_written;
+} // End of ResolveFrame
+
+// The frame buffer for a list has been written over outside of the raster so its tiles
+// can no longer be assumed to hold the background
+void ForgetFrameBackground(const uint32_t list)
+{
+    for (uint32_t tile = 0; tile < DEPTH_TILES; tile++) tile_background[list][tile] = false;
+}
+
+// As ForgetFrameBackground() but only for the tiles of rows first_row to last_row, as the 2D overlay
+// needs when the clear-free resolve would otherwise leave it on screen
+void ForgetFrameRows(const uint32_t list, const uint32_t first_row, const uint32_t last_row)
+{
+    constexpr uint32_t tiles_across = g_scWidth / DEPTH_TILE;
+    const uint32_t first_tile = (first_row / DEPTH_TILE) * tiles_across;
+    const uint32_t end_tile = std::min((last_row / DEPTH_TILE + 1) * tiles_across, (uint32_t)DEPTH_TILES);
+    for (uint32_t tile = first_tile; tile < end_tile; tile++) tile_background[list][tile] = false;
+}
+
+// Log the average traffic of the resolve against clearing both buffers, integer only for the timer task
+void ReportClearFree()
+{
+    static const char *TAG = "ClearFree";
+    constexpr uint32_t clear_bytes = g_scWidth * g_scHeight * (sizeof(depth_t) + sizeof(uint16_t));
+
+    if (!clear_free_frames || (clear_report.frames == 0)) return;
+
+    const uint32_t read_avg = clear_report.bytes_read / clear_report.frames;
+    const uint32_t written_avg = clear_report.bytes_written / clear_report.frames;
+    ESP_LOGI(TAG, "Per frame clears would write %d bytes, resolve read %d wrote %d, saving %d, tiles skipped %d",
+        (int)clear_bytes, (int)read_avg, (int)written_avg, (int)clear_bytes - (int)read_avg - (int)written_avg,
+        (int)(clear_report.tiles_skipped / clear_report.frames));
+
+    clear_report = {0, 0, 0, 0};
+} // End of ReportClearFree
+
 void CheckCollide(Near_pix * near)
 {
     // Just scan part of the area as an 'eyeline'
     
     //uint32_t collide_colour;
     
-    // Aim to do calculation at compile time, divides invovled!
-    constexpr uint32_t y_start = g_scHeight / 5;
-    constexpr uint32_t y_end = 3 * g_scHeight / 5;
-    constexpr uint32_t x_start = g_scWidth / 4;
-    constexpr uint32_t x_end = 3 * g_scWidth / 4;
+    // The frame just rasterised may have been drawn at a lower resolution
+    extern bool flipped;
+    const uint32_t width = render_size[flipped ? 0 : 1].width;
+    const uint32_t height = render_size[flipped ? 0 : 1].height;
+    const uint32_t y_start = height / 5;
+    const uint32_t y_end = 3 * height / 5;
+    const uint32_t x_start = width / 4;
+    const uint32_t x_end = 3 * width / 4;
 
     near->depth = farPlane; // Initial value for nearest is farClip of view
 
@@ -58,17 +256,18 @@ void CheckCollide(Near_pix * near)
     {
         for (uint32_t x = x_start + (y%4); x < x_end; x = x + 4) 
         {
-            if (depthBuffer[y * g_scWidth + x] < near->depth)
+            const float depth = DepthDecode(depthBuffer[y * g_scWidth + x]);
+            if (depth < near->depth)
             {
-                near->depth = depthBuffer[y * g_scWidth + x];
-                near->x = x; // Store the point that is the nearest
-                near->y = y; 
+                near->depth = depth;
+                near->x = (x * g_scWidth) / width; // Store the point that is the nearest, as a full size position
+                near->y = (y * g_scHeight) / height;
             }
             /*
             { // Just for illustration, colour each test point
                 collide_colour = 0x0000ff00;
-                if (depthBuffer[y * g_scWidth + x] < COLLISION_DISTANCE * 1.5f) collide_colour = 0x000000ff;
-                if (depthBuffer[y * g_scWidth + x] < COLLISION_DISTANCE) collide_colour = 0x00ff0000;
+                if (depth < COLLISION_DISTANCE * 1.5f) collide_colour = 0x000000ff;
+                if (depth < COLLISION_DISTANCE) collide_colour = 0x00ff0000;
             }
             WritePixel888(y * g_scWidth + x, collide_colour, 1.0f);
             */
@@ -95,71 +294,101 @@ bool CheckEdgeFunction(const Vec3f& E, const float result)
     else return true;
 }
 
+// The depth keys of four pixels, without a divide in the reciprocal format
+#if DEPTH_FORMAT == DEPTH_RECIPROCAL16
+typedef Pixel::quad_i quad_key;
+inline quad_key QuadDepthKey(const Pixel::quad_f oneOverW, const Pixel::quad_f zOverW)
+{
+    const float low = DepthOneOverW(DEPTH_FAR), high = DepthOneOverW(DEPTH_NEAR);
+    return (Pixel::QuadKeyReciprocal(oneOverW, low, high, high, DEPTH_KEY_FAR / (high - low)));
+}
+#else
+#if DEPTH_FORMAT == DEPTH_FLOAT
+typedef Pixel::quad_f quad_key;
+#else
+typedef Pixel::quad_i quad_key;
+#endif
+inline quad_key QuadDepthKey(const Pixel::quad_f oneOverW, const Pixel::quad_f zOverW)
+{
+    quad_key key;
+    for (uint32_t k = 0; k < 4; k++) Pixel::QuadSetLane(key, k, DepthKeyInterp(Pixel::QuadLane(oneOverW, k), Pixel::QuadLane(zOverW, k)));
+    return (key);
+}
+#endif
+
 // ************************************************************************************************
-// Rasterises a primitive triangle using passed struct with edge checking and
-// interpolating z and UV mapping
-//uint32_t RasteriseBox(const TriToRaster& tri)
-void RasteriseBox(const TriToRaster & tri)
-{    
-    //static const char *TAG = "RasteriseBox";
-     const uint32_t idx = tri.idx; // idx is used so many times it makes sense to have this stage, compiler might delete it?
+// The raster kernel family, each combination of edge checking, texturing and fog is compiled
+// separately so that none of those choices is made per pixel. ChooseKernel() picks one when a
+// triangle or tile is queued and SendQueue() calls it through the queue record.
+//  EdgeTest: false for TA (totally accepted) tiles that need no edge checking
+//  Textured: the material has an image and the box is large enough for it to be seen
+//  Fogged:   some of the triangle is beyond the start of fog
+// Each comes in two forms, RasteriseKernel() taking pixels four at a time through PixelSimd.h for
+// the edges, interpolation, depth test and packing and RasteriseKernelPixel() taking them one at a
+// time. QUAD_KERNELS chooses between them per variant.
+template <bool EdgeTest, bool Textured, bool Fogged>
+void RasteriseKernel(const TriToRaster & tri)
+{
+    extern const uint32_t fog; // The background colour which is also the fog
+
     const Rect2D TriBoundBox = tri.BoBox;
     const Matrix33f invM = tri.invM;
-    uint32_t this_colour = 0; // This will be filled with face or texture colour
-
-    //WorldLayout layo = *tri.layout; // Find the layout structure from the ptr passed to here
-    const WorldLayout* layo_ptr = tri.layout;
+    const WorldLayout* layo_ptr = tri.layout; // Find the layout structure from the ptr passed to here
 
-    //uint32_t pixels_done = 0; // Track the load
+    // The material is resolved once here rather than through the palette and attributes per pixel
+    const faceMaterials & material = layo_ptr->palette[layo_ptr->attributes[tri.idx]];
+    const uint32_t tex_width = material.width;
+    const uint32_t tex_height = material.height;
+    const uint32_t * const tex_image = material.image;
 
     // M determinant and inverse used to be calculated here but better to pass invM in and backface cull in CheckTriangles
-
-    // Set up edge functions based on the vertex matrix
-    Vec3f E0 = { invM[0][0], invM[0][1], invM[0][2] };
-    Vec3f E1 = { invM[1][0], invM[1][1], invM[1][2] };
-    Vec3f E2 = { invM[2][0], invM[2][1], invM[2][2] };
-
-
-   // Calculate constant function to interpolate 1/w
-    //Vec3f C;
-    //invM.multVecMatrix(Vec3f(1, 1, 1), C);
-    const Vec3f C = tri.C;
-
-    // Calculate z interpolation vector
-    // tri.clip_zs is equivalent of sample Vec3f shown
-    // invM.multVecMatrix(Vec3f(v0Clip.z, v1Clip.z, v2Clip.z), Z);
-
-    // Calculate z interpolation vector
-    //Vec3f Z;
-    //invM.multVecMatrix(tri.clip_zs, Z);
-    const Vec3f Z = tri.Z;
+    // Likewise C and Z fetched rather than calcuated
+    const Vec3f C = tri.C;    // Constant function to interpolate 1/w
+    const Vec3f Z = tri.Z;    // Fetch z interpolation vector
 
     // Fetch the shading overview for the triangle
     const Shade_params surface = tri.face_brightness;
-    
-    // This has been pulled out of the pixel loop as it is sufficient to do once per box (or actually per triangle) 
-    Vec3f PUVS, PUVT; // They have to be declared is the later IF doesn't know if they are needed!
-    bool Texturise = false; // Is the box valid for a texture, a size test was trialled but at 128x128px some triangles are only 1 px!
-                            // If it is small then just use base colour
 
-    if (layo_ptr->palette[layo_ptr->attributes[idx]].width && (TriBoundBox.m_MaxX-TriBoundBox.m_MinX) > 6 && (TriBoundBox.m_MaxY-TriBoundBox.m_MinY) > 6)
+    // The depth encoding for this frame, as locals so the depth buffer stores don't force reloads
+    const depth_key_t depth_b = depth_base;
+    const depth_key_t depth_s = depth_sign;
+    DepthTouchRect(TriBoundBox);
+
+    // Untextured primitives, and textured ones too far away for the image, use the shaded base colour
+    const uint32_t flat_colour = spec_shade_pixel(material.rgb888, surface);
+    const float texture_inverse = texture_inverse_depth;
+
+    // This has been pulled out of the pixel loop as it is sufficient to do once per box (or actually per triangle)
+    Vec3f PUVS, PUVT;
+    if constexpr (Textured)
     {
-        Texturise = true;
+        const uint16_t * const texels = &layo_ptr->texel_verts[tri.idx * 3];
+        Vec3f us, vs; // From the chunk's UV base
+        if (layo_ptr->vertex_step)
+        {
+            constexpr float uv_step = 1.0f / QUANT_UV_STEPS;
+            const Quant_uv * const qvts = tri.qvts;
+            us = Vec3f(qvts[texels[0]].u, qvts[texels[1]].u, qvts[texels[2]].u) * uv_step;
+            vs = Vec3f(qvts[texels[0]].v, qvts[texels[1]].v, qvts[texels[2]].v) * uv_step;
+        }
+        else
+        {
+            const Vec2f * const vts = tri.vts;
+            us = Vec3f(vts[texels[0]].x, vts[texels[1]].x, vts[texels[2]].x);
+            vs = Vec3f(vts[texels[0]].y, vts[texels[1]].y, vts[texels[2]].y);
+        }
         // Calculate UV interpolation vector
-        invM.multVecMatrix(Vec3f(layo_ptr->vts[layo_ptr->texel_verts[idx * 3 + 0]].x, layo_ptr->vts[layo_ptr->texel_verts[idx * 3 + 1]].x, layo_ptr->vts[layo_ptr->texel_verts[idx * 3 + 2]].x), PUVS);
-        invM.multVecMatrix(Vec3f(layo_ptr->vts[layo_ptr->texel_verts[idx * 3 + 0]].y, layo_ptr->vts[layo_ptr->texel_verts[idx * 3 + 1]].y, layo_ptr->vts[layo_ptr->texel_verts[idx * 3 + 2]].y), PUVT);
+        invM.multVecMatrix(us, PUVS);
+        invM.multVecMatrix(vs, PUVT);
     }
-    else
-    {   
-        // Read the face colour from the palette which will be used for untextured primitives
-        this_colour = layo_ptr->palette[layo_ptr->attributes[idx]].rgb888;
-        // Adjust primitive colour based on surface diffuse and specular components
 
-        this_colour = spec_shade_pixel (this_colour, surface);
-    }
-    //if ( &(layo_ptr->attributes[idx]) & 0x01 ) ESP_LOGI(TAG, "Odd attribute address ****");
-    // sample for the edge function at the first pixel for this rectangle
-    Vec3f StartSample = { (unsigned int)TriBoundBox.m_MinX + 0.5f, (unsigned int)TriBoundBox.m_MinY + 0.5f, 1.0f };
+    // Set up edge functions based on the vertex matrix, unused for tiles
+    const Vec3f E0 = { invM[0][0], invM[0][1], invM[0][2] };
+    const Vec3f E1 = { invM[1][0], invM[1][1], invM[1][2] };
+    const Vec3f E2 = { invM[2][0], invM[2][1], invM[2][2] };
+
+    // sample for the edge function and UV mapping at the first pixel for this rectangle
+    const Vec3f StartSample = { (unsigned int)TriBoundBox.m_MinX + 0.5f, (unsigned int)TriBoundBox.m_MinY + 0.5f, 1.0f };
 
     // Do the first EvaluateEdgeFunction
     float EdgeFirst0 = (E0.x * StartSample.x) + (E0.y * StartSample.y) + E0.z;
@@ -171,7 +400,16 @@ void RasteriseBox(const TriToRaster & tri)
 
     // Interpolate z that will be used for depth test
     float zOverWFirst = (Z.x * StartSample.x) + (Z.y * StartSample.y) + Z.z;
-   
+
+    // Edges where a zero result counts as inside, as CheckEdgeFunction() decides
+    const bool zero_inside0 = CheckEdgeFunction(E0, 0.0f);
+    const bool zero_inside1 = CheckEdgeFunction(E1, 0.0f);
+    const bool zero_inside2 = CheckEdgeFunction(E2, 0.0f);
+
+    // The pixels are taken four at a time, x_end is the first x outside the box
+    const unsigned int x_start = (unsigned int)TriBoundBox.m_MinX;
+    const unsigned int x_end = std::min((unsigned int)std::ceil(TriBoundBox.m_MaxX), (unsigned int)g_scWidth);
+
     // Start rasterizing by looping over pixels to output a per-pixel color
     for (unsigned int y = (unsigned int)TriBoundBox.m_MinY; y < TriBoundBox.m_MaxY; y++)
     {
@@ -182,111 +420,99 @@ void RasteriseBox(const TriToRaster & tri)
         float oneOverW = oneOverWFirst;
         float zOverW = zOverWFirst;
 
-        // Once the edge function shows that the scan has exited the triangles then the line can be quit
-        bool x_inside = 0;
-        for (unsigned int x = (unsigned int)TriBoundBox.m_MinX; x < TriBoundBox.m_MaxX; x++)
-        {
-            //pixels_scanned++; // How many pixels in all of the bounding boxes
-            // sample for the edge function at every pixel
-            Vec3f sample = { x + 0.5f, y + 0.5f, 1.0f };
-
-            // In simplest implementation the edge functions would be evaluated here for every pixel
-            // but as they are linear functions it is more efficient to increment by pre-calculated
-            // values for each x and y step
-            // The result is slightly different which isn't surprising with floating point math
-
-
-            // Edge function incremented at end of both x and y pixel loops
-            // These checks in function is shown as a major impact in the profiler
-            // So give opportunities to not take the test, reduces load from 12% to 8 %
-            // The progressive 'if' is faster than doing all 3 everytime
-
-            bool inside0 = 0, inside1 = 0, inside2 = 0;
+        bool x_inside = false; // Becomes true once the scan has entered the triangle
 
-            if ( (inside0 = CheckEdgeFunction(E0, EdgeRes0)) )
+        for (unsigned int x = x_start; x < x_end; x += 4)
+        {
+#if HEAT_MAP_ON
+            const uint32_t heat_start = HeatTicks();
+#endif
+            const uint32_t lanes = std::min(x_end - x, 4u);
+            Pixel::quad_i covered = Pixel::QuadLaneMask(lanes);
+            if constexpr (EdgeTest)
             {
-                if ( (inside1 = CheckEdgeFunction(E1, EdgeRes1)) )
-                {
-                    inside2 = CheckEdgeFunction(E2, EdgeRes2);
-                }
+                covered = Pixel::QuadAnd(covered, Pixel::QuadEdgeMask(Pixel::QuadRamp(EdgeRes0, E0.x), zero_inside0));
+                covered = Pixel::QuadAnd(covered, Pixel::QuadEdgeMask(Pixel::QuadRamp(EdgeRes1, E1.x), zero_inside1));
+                covered = Pixel::QuadAnd(covered, Pixel::QuadEdgeMask(Pixel::QuadRamp(EdgeRes2, E2.x), zero_inside2));
+
+                // Inside before and outside now means that, with a convex triangle, no more
+                // edge tests are required on this x scan so break to next y
+                const bool any_covered = Pixel::QuadAny(covered);
+                if (!any_covered && x_inside) break; // This gives up to 9% reduction when box is applied previously
+                x_inside = any_covered;
             }
 
-            // If sample is "inside" of all three half-spaces bounded by the three edges of the triangle
-            // it's 'on' the triangle
-            // This test is redundant after the tests above but there is an 'else' dependent on it
-            if (inside0 && inside1 && inside2)
-                // Perhaps need to add stuff from https://tayfunkayhan.wordpress.com/2019/07/26/chasing-triangles-in-a-tile-based-rasterizer/
+            if (Pixel::QuadAny(covered))
             {
-                // We are drawing pixels inside now;
-                x_inside = 1;
-
-                // w and z are estimated incrementally too which saves multiplication
-                // as per the edge function they will be incremented at the end of each loop
+                // Previously 1/w was used as a surrogate for depth but that doesn't allow true
+                // prespective mapping so true z interpolation added as per 'GoWild.h' sample.
+                // The depth key is found without a divide when the format allows it and w is only
+                // worked out for the textured pixels that need it
+                const Pixel::quad_f quad_oneOverW = Pixel::QuadRamp(oneOverW, C.x);
+                const quad_key key = QuadDepthKey(quad_oneOverW, Pixel::QuadRamp(zOverW, Z.x));
 
-                float w = 1 / oneOverW;
-                float z = zOverW * w;
+                depth_t * const depth_ptr = &depthBuffer[x + y * g_scWidth];
+                const Pixel::quad_i passed = Pixel::QuadAnd(covered,
+                    Pixel::QuadDepthPass(key, Pixel::QuadLoadDepth(depth_ptr, lanes), depth_b, depth_s));
 
-                // Previously 1/w was used as a surrogate for depth but that doesn't allow true
-                // prespective mapping so true z interpolation added as per 'GoWild.h' sample
-                // as this is crucial for correct texture or normal mapping 
-                if (z <= depthBuffer[x + y * g_scWidth])
+                if (Pixel::QuadAny(passed))
                 {
-                    // Sensible to only consider texture if depth test passed
+                    // Depth test passed; update depth buffer values
+                    Pixel::QuadStoreDepth(depth_ptr, key, passed, depth_b, depth_s, lanes);
 
-                    // Depth test passed; update depth buffer value
-                    depthBuffer[x + y * g_scWidth] = z;// oneOverW previously;
-               
-                    // If the Texture table has a width then the flag will be set and the material is texture mapped
-                    if (Texturise)
+                    Pixel::quad_u colour = {}, share = {};
+                    for (uint32_t k = 0; k < lanes; k++)
                     {
-                        if (z < TEXTURE_DEPTH_THRESHOLD) // Don't texturise if too far away
+                        if (!Pixel::QuadLane(passed, k)) continue;
+
+                        const float lane_oneOverW = Pixel::QuadLane(quad_oneOverW, k);
+                        uint32_t this_colour = flat_colour;
+                        if constexpr (Textured)
                         {
-                        // Interpolate texture coordinates
-                        float uOverW = abs((PUVS.x * sample.x) + (PUVS.y * sample.y) + PUVS.z);
-                        float vOverW = abs((PUVT.x * sample.x) + (PUVT.y * sample.y) + PUVT.z);
+                            if (lane_oneOverW > texture_inverse) // Don't texturise if too far away
+                            {
+                                const float w = 1 / lane_oneOverW;
+                                const Vec3f sample = { x + k + 0.5f, y + 0.5f, 1.0f };
 
-                        Vec2f texCoords = Vec2f(uOverW, vOverW) * w; // {u/w, v/w} * w -> {u, v}
-                        // Now fetch from the image
+                                // Interpolate texture coordinates
+                                const float uOverW = abs((PUVS.x * sample.x) + (PUVS.y * sample.y) + PUVS.z);
+                                const float vOverW = abs((PUVT.x * sample.x) + (PUVT.y * sample.y) + PUVT.z);
 
-                        uint32_t idxS = static_cast<uint32_t>((texCoords.x - static_cast<uint32_t>(texCoords.x)) * layo_ptr->palette[layo_ptr->attributes[idx]].width - 0.5f);
-                        uint32_t idxT = static_cast<uint32_t>((texCoords.y - static_cast<uint32_t>(texCoords.y)) * layo_ptr->palette[layo_ptr->attributes[idx]].height - 0.5f);
+                                const Vec2f texCoords = Vec2f(uOverW, vOverW) * w; // {u/w, v/w} * w -> {u, v}
 
-                        // Flip y over as world and bitmap have opposite y-axes, it isn't expensive in time, less than 1ms per frame
-                        // uint32_t image_idx = ((layo_ptr->palette[layo_ptr->attributes[idx]].height - idxT) * layo_ptr->palette[layo_ptr->attributes[idx]].width + idxS);
-                        // The flip is not required actually, no bad thing, one fewer operation per pixel!
-                        uint32_t image_idx = (idxT * layo_ptr->palette[layo_ptr->attributes[idx]].width + idxS);
+                                // Now fetch from the image, world and bitmap have opposite y-axes but the flip isn't required
+                                const uint32_t idxS = static_cast<uint32_t>((texCoords.x - static_cast<uint32_t>(texCoords.x)) * tex_width - 0.5f);
+                                const uint32_t idxT = static_cast<uint32_t>((texCoords.y - static_cast<uint32_t>(texCoords.y)) * tex_height - 0.5f);
 
-                        // Fetch the pointer to the texture image and then get the relevant pixel
-                        const uint32_t* this_colour_ptr = layo_ptr->palette[layo_ptr->attributes[idx]].image;
-                        this_colour = this_colour_ptr[image_idx];
-                        }
-                      else
-                        {
-                        // Read the face colour
-                        this_colour = layo_ptr->palette[layo_ptr->attributes[idx]].rgb888; // read the palette
+                                this_colour = spec_shade_pixel(tex_image[idxT * tex_width + idxS], surface);
+                            }
                         }
-                    this_colour = spec_shade_pixel (this_colour, surface);
+                        Pixel::QuadSetLane(colour, k, this_colour);
+
+                        // Near triangles have no fog so are mixed at full share
+                        if constexpr (Fogged) Pixel::QuadSetLane(share, k, FogShareW(lane_oneOverW));
+                        else Pixel::QuadSetLane(share, k, 255);
                     }
-                    // Send the pixel and its shading
-                WritePixel2Fog888(g_scWidth * y + x, this_colour, z);
-                } // end of depth check
 
+                    // Send the pixels and their shading
+                    const Pixel::quad_u rgb565 = Pixel::QuadPack565(colour, share, fog);
+                    uint16_t * const frame_ptr = &frame_buffer_this[x + y * g_scWidth];
+                    for (uint32_t k = 0; k < lanes; k++)
+                    {
+                        if (Pixel::QuadLane(passed, k)) frame_ptr[k] = (uint16_t)Pixel::QuadLane(rgb565, k);
+                    }
+                } // end of depth check
+#if HEAT_MAP_ON
+                if (heat_raster_mode) HeatQuad(x + y * g_scWidth, covered, passed, lanes, heat_start);
+#endif
             } // end of inside check
-            else
-            {
-                if (x_inside)
-                    // This is true if last check was inside and now we're outside, with a convex triangle
-                    // it indicates that no more edge tests are required on this x scan so break to next y
-                {
-                    break; // This gives up to 9% reduction when box is applied previously
-                }
-            } //end of being outside triangle 
-            EdgeRes0 += E0.x; // Incremental increase on x axis
-            EdgeRes1 += E1.x;
-            EdgeRes2 += E2.x;
 
-            oneOverW += C.x; // Incremental increase of barycentric coordinates on x axis
-            zOverW += Z.x;
+            EdgeRes0 += 4 * E0.x; // Incremental increase on x axis
+            EdgeRes1 += 4 * E1.x;
+            EdgeRes2 += 4 * E2.x;
+
+            oneOverW += 4 * C.x; // Incremental increase of barycentric coordinates on x axis
+            zOverW += 4 * Z.x;
         } // end of x pixel scan
         EdgeFirst0 += E0.y; // Incremental increase on y axis
         EdgeFirst1 += E1.y;
@@ -295,132 +521,206 @@ void RasteriseBox(const TriToRaster & tri)
         oneOverWFirst += C.y; // Incremental increase of barycentric coordinates on y axis
         zOverWFirst += Z.y;
     } // end of y pixel scan
-//    return(pixels_done); // Return how much was shown
-} // End of RasteriseBox
+} // End of RasteriseKernel
 
-// ************************************************************************************************
-// Rasterises a primitive triangle using passed struct WITHOUT edge checking as it's 
-// only called for TA (totally accepted) tiles, it does interpolate z and UV mapping
-void NotRasteriseBox(const TriToRaster & tri)
+// The per-pixel form of the kernels, the default for every variant. It takes the same set up as
+// RasteriseKernel() and draws the same pixels, bar float rounding of the edges and interpolants
+// stepped one pixel rather than four at a time, which moves a few pixels on triangle edges
+template <bool EdgeTest, bool Textured, bool Fogged>
+void RasteriseKernelPixel(const TriToRaster & tri)
 {
-// Rasterise without edge checking as tile is 'Trivial Accept', but otherwise as RasteriseBox
-    //static const char *TAG = "NotRasteriseBox";
-    const uint32_t idx = tri.idx;
     const Rect2D TriBoundBox = tri.BoBox;
     const Matrix33f invM = tri.invM;
-    bool Texturise = false; // Is the box valid for a texture, a size test was trialled but at 128x128px some triangles are only 1 px!
-    uint32_t this_colour = 0; // This will be filled with face or texture colour
-
-    const WorldLayout* layo_ptr = tri.layout; // Find the layout structure from the ptr passed to here
+    const WorldLayout* layo_ptr = tri.layout;
 
-    // M determinant and inverse used to be calculated here but better to pass invM in and backface cull in CheckTriangles
-    // Likewise C and Z fetched rather than calcuated
-    const Vec3f C = tri.C;    // Constant function to interpolate 1/w
-    const Vec3f Z = tri.Z;    // Fetch z interpolation vector
+    const faceMaterials & material = layo_ptr->palette[layo_ptr->attributes[tri.idx]];
+    const uint32_t tex_width = material.width;
+    const uint32_t tex_height = material.height;
+    const uint32_t * const tex_image = material.image;
 
+    const Vec3f C = tri.C;
+    const Vec3f Z = tri.Z;
     const Shade_params surface = tri.face_brightness;
 
-    // This has been pulled out of the pixel loop as it is sufficient to do once per box (or actually per triangle) 
-    Vec3f PUVS, PUVT; // They have to be declared is the later IF doesn't know if they are needed!
-    if (layo_ptr->palette[layo_ptr->attributes[idx]].width && (TriBoundBox.m_MaxX-TriBoundBox.m_MinX)>3 && (TriBoundBox.m_MaxY-TriBoundBox.m_MinY)>3)
-    {
-        // Calculate UV interpolation vector
-        invM.multVecMatrix(Vec3f(layo_ptr->vts[layo_ptr->texel_verts[idx * 3 + 0]].x, layo_ptr->vts[layo_ptr->texel_verts[idx * 3 + 1]].x, layo_ptr->vts[layo_ptr->texel_verts[idx * 3 + 2]].x), PUVS);
-        invM.multVecMatrix(Vec3f(layo_ptr->vts[layo_ptr->texel_verts[idx * 3 + 0]].y, layo_ptr->vts[layo_ptr->texel_verts[idx * 3 + 1]].y, layo_ptr->vts[layo_ptr->texel_verts[idx * 3 + 2]].y), PUVT);
+    const depth_key_t depth_b = depth_base;
+    const depth_key_t depth_s = depth_sign;
+    DepthTouchRect(TriBoundBox);
 
-        //diffuse = MakeShade(idx,layo_ptr);
+    const uint32_t flat_colour = spec_shade_pixel(material.rgb888, surface);
+    const float texture_inverse = texture_inverse_depth;
 
-        Texturise=true;
-    }
-    else
+    Vec3f PUVS, PUVT;
+    if constexpr (Textured)
     {
-        // Read the face colour from the palette which will be used for untextured primitives
-        this_colour = layo_ptr->palette[layo_ptr->attributes[idx]].rgb888;
-        // Adjust primitve colur based on surface diffuse and psecular components
-        this_colour = spec_shade_pixel (this_colour, surface);
+        const uint16_t * const texels = &layo_ptr->texel_verts[tri.idx * 3];
+        Vec3f us, vs;
+        if (layo_ptr->vertex_step)
+        {
+            constexpr float uv_step = 1.0f / QUANT_UV_STEPS;
+            const Quant_uv * const qvts = tri.qvts;
+            us = Vec3f(qvts[texels[0]].u, qvts[texels[1]].u, qvts[texels[2]].u) * uv_step;
+            vs = Vec3f(qvts[texels[0]].v, qvts[texels[1]].v, qvts[texels[2]].v) * uv_step;
+        }
+        else
+        {
+            const Vec2f * const vts = tri.vts;
+            us = Vec3f(vts[texels[0]].x, vts[texels[1]].x, vts[texels[2]].x);
+            vs = Vec3f(vts[texels[0]].y, vts[texels[1]].y, vts[texels[2]].y);
+        }
+        invM.multVecMatrix(us, PUVS);
+        invM.multVecMatrix(vs, PUVT);
     }
 
-    //if (layo_ptr->attributes[idx] > 20) ESP_LOGI(TAG, "Attribute is %x",layo_ptr->attributes[idx]);
+    const Vec3f E0 = { invM[0][0], invM[0][1], invM[0][2] };
+    const Vec3f E1 = { invM[1][0], invM[1][1], invM[1][2] };
+    const Vec3f E2 = { invM[2][0], invM[2][1], invM[2][2] };
 
-    // sample for UV mapping at the first pixel for this rectangle
-    Vec3f StartSample = { (unsigned int)TriBoundBox.m_MinX + 0.5f, (unsigned int)TriBoundBox.m_MinY + 0.5f, 1.0f };
+    const Vec3f StartSample = { (unsigned int)TriBoundBox.m_MinX + 0.5f, (unsigned int)TriBoundBox.m_MinY + 0.5f, 1.0f };
 
-    // w and z can be estimated incrementally too which saves multiplication
+    float EdgeFirst0 = (E0.x * StartSample.x) + (E0.y * StartSample.y) + E0.z;
+    float EdgeFirst1 = (E1.x * StartSample.x) + (E1.y * StartSample.y) + E1.z;
+    float EdgeFirst2 = (E2.x * StartSample.x) + (E2.y * StartSample.y) + E2.z;
     float oneOverWFirst = (C.x * StartSample.x) + (C.y * StartSample.y) + C.z;
-
-    // Interpolate z that will be used for depth test
     float zOverWFirst = (Z.x * StartSample.x) + (Z.y * StartSample.y) + Z.z;
 
-    // An incremented x and y was tried but made no speed difference
-    // but it was harder to read code so removed
+    const unsigned int x_end = std::min((unsigned int)std::ceil(TriBoundBox.m_MaxX), (unsigned int)g_scWidth);
 
     for (unsigned int y = (unsigned int)TriBoundBox.m_MinY; y < TriBoundBox.m_MaxY; y++)
     {
+        float EdgeRes0 = EdgeFirst0;
+        float EdgeRes1 = EdgeFirst1;
+        float EdgeRes2 = EdgeFirst2;
         float oneOverW = oneOverWFirst;
         float zOverW = zOverWFirst;
 
-        for (unsigned int x = (unsigned int)TriBoundBox.m_MinX; x < TriBoundBox.m_MaxX; x++)
+        bool x_inside = false;
+
+        for (unsigned int x = (unsigned int)TriBoundBox.m_MinX; x < x_end; x++)
         {
-            //pixels_scanned++; // How many pixels in all of the bounding boxes
-            // sample for interpolation at every pixel
-            Vec3f sample = { x + 0.5f, y + 0.5f, 1.0f };
+            bool covered = true;
+            if constexpr (EdgeTest)
+            {
+                covered = CheckEdgeFunction(E0, EdgeRes0) && CheckEdgeFunction(E1, EdgeRes1) && CheckEdgeFunction(E2, EdgeRes2);
+                if (!covered && x_inside) break;
+                x_inside = covered;
+            }
+
+            if (covered)
+            {
+#if HEAT_MAP_ON
+                const uint32_t heat_start = HeatTicks();
+#endif
+                const depth_key_t key = DepthKeyInterp(oneOverW, zOverW);
+                const bool passed = (key <= depth_s * (depthBuffer[x + y * g_scWidth] - depth_b));
+                if (passed)
+                {
+                    depthBuffer[x + y * g_scWidth] = (depth_t)(depth_b + depth_s * key);
+
+                    uint32_t this_colour = flat_colour;
+                    if constexpr (Textured)
+                    {
+                        if (oneOverW > texture_inverse)
+                        {
+                            const float w = 1 / oneOverW;
+                            const Vec3f sample = { x + 0.5f, y + 0.5f, 1.0f };
+                            const float uOverW = abs((PUVS.x * sample.x) + (PUVS.y * sample.y) + PUVS.z);
+                            const float vOverW = abs((PUVT.x * sample.x) + (PUVT.y * sample.y) + PUVT.z);
+                            const Vec2f texCoords = Vec2f(uOverW, vOverW) * w;
+                            const uint32_t idxS = static_cast<uint32_t>((texCoords.x - static_cast<uint32_t>(texCoords.x)) * tex_width - 0.5f);
+                            const uint32_t idxT = static_cast<uint32_t>((texCoords.y - static_cast<uint32_t>(texCoords.y)) * tex_height - 0.5f);
+                            this_colour = spec_shade_pixel(tex_image[idxT * tex_width + idxS], surface);
+                        }
+                    }
 
-            // w and z are estimated incrementally too which saves multiplication
-            // as per the edge function they will be incremented at the end of each loop
+                    if constexpr (Fogged) WritePixelFogW(g_scWidth * y + x, this_colour, oneOverW);
+                    else WritePixelMix(g_scWidth * y + x, this_colour, 255);
+                }
+#if HEAT_MAP_ON
+                if (heat_raster_mode) HeatPixel(x + y * g_scWidth, passed, heat_start);
+#endif
+            }
 
-            float w = 1 / oneOverW;
-            float z = zOverW * w;
+            EdgeRes0 += E0.x;
+            EdgeRes1 += E1.x;
+            EdgeRes2 += E2.x;
+            oneOverW += C.x;
+            zOverW += Z.x;
+        }
+        EdgeFirst0 += E0.y;
+        EdgeFirst1 += E1.y;
+        EdgeFirst2 += E2.y;
+        oneOverWFirst += C.y;
+        zOverWFirst += Z.y;
+    }
+} // End of RasteriseKernelPixel
 
-            if (z <= depthBuffer[x + y * g_scWidth])
-            {
-                // Sensible to only consider texture if depth test passed
+// The form of a variant that QUAD_KERNELS chooses, only that one being compiled
+template <bool EdgeTest, bool Textured, bool Fogged>
+constexpr Raster_kernel ChosenKernel()
+{
+    if constexpr ((QUAD_KERNELS >> KernelIndex(EdgeTest, Textured, Fogged)) & 1) return (RasteriseKernel<EdgeTest, Textured, Fogged>);
+    else return (RasteriseKernelPixel<EdgeTest, Textured, Fogged>);
+}
 
-                // Depth test passed; update depth buffer value
-                depthBuffer[x + y * g_scWidth] = z;
+// The kernels in the order of KernelIndex()
+const Raster_kernel raster_kernels[RASTER_KERNELS] = {
+    ChosenKernel<true, false, false>(), ChosenKernel<true, false, true>(),
+    ChosenKernel<true, true, false>(), ChosenKernel<true, true, true>(),
+    ChosenKernel<false, false, false>(), ChosenKernel<false, false, true>(),
+    ChosenKernel<false, true, false>(), ChosenKernel<false, true, true>() };
 
-                // Starting on Texture
-                // If the Texture table has a width then the material is texture mapped
-                if (Texturise)
-                {
-                  if (z<TEXTURE_DEPTH_THRESHOLD) // Don't texturise if too far away
-                  // Not done as an AND so non-textured primitives can be coloured outside the loop
-                    {
-                    // Interpolate texture coordinates
-                    float uOverW = abs((PUVS.x * sample.x) + (PUVS.y * sample.y) + PUVS.z);
-                    float vOverW = abs((PUVT.x * sample.x) + (PUVT.y * sample.y) + PUVT.z);
+// Choose the kernel for a triangle or tile as it's queued, tile_accepted is for the odd queues
+// and textured_out, if given, reports whether it will be texture mapped
+uint32_t ChooseKernel(const TriToRaster & tri, const bool tile_accepted, bool * textured_out)
+{
 
-                    Vec2f texCoords = Vec2f(uOverW, vOverW) * w; // {u/w, v/w} * w -> {u, v}
-                    // Now fetch from the image
-                    // Simplifed from 64 bit, can't see a point in this!
-                    // uint32_t idxS = static_cast<uint32_t>((texCoords.x - static_cast<int64_t>(texCoords.x)) * layo_ptr->palette[layo_ptr->attributes[idx]].width - 0.5f);
-                    // uint32_t idxT = static_cast<uint32_t>((texCoords.y - static_cast<int64_t>(texCoords.y)) * layo_ptr->palette[layo_ptr->attributes[idx]].height - 0.5f);
+    // A size test was trialled but at 128x128px some triangles are only 1 px! So small ones
+    // just use base colour, tiles are a known size so have a lower limit
+    const float min_size = tile_accepted ? quality_build.texture_min_tile : quality_build.texture_min_triangle;
+    const bool textured = tri.layout->palette[tri.layout->attributes[tri.idx]].width &&
+                          (tri.BoBox.m_MaxX - tri.BoBox.m_MinX) > min_size &&
+                          (tri.BoBox.m_MaxY - tri.BoBox.m_MinY) > min_size;
 
-                    uint32_t idxS = static_cast<uint32_t>((texCoords.x - static_cast<uint32_t>(texCoords.x)) * layo_ptr->palette[layo_ptr->attributes[idx]].width - 0.5f);
-                    uint32_t idxT = static_cast<uint32_t>((texCoords.y - static_cast<uint32_t>(texCoords.y)) * layo_ptr->palette[layo_ptr->attributes[idx]].height - 0.5f);
+    // Clip z is a little less than w, so a margin keeps the whole triangle clear of fog
+    const float furthest = std::max(tri.clip_zs.x, std::max(tri.clip_zs.y, tri.clip_zs.z));
+    const bool fogged = furthest > (quality_build.fog_start * 0.9f);
 
+    if (textured_out) *textured_out = textured;
+    return (KernelIndex(!tile_accepted, textured, fogged));
+} // End of ChooseKernel
 
-                    uint32_t image_idx = (idxT * layo_ptr->palette[layo_ptr->attributes[idx]].width + idxS);
+#ifdef CONFIG_AMAZE_BENCHMARK
+// One of the kernel family by its template arguments in either form, whatever QUAD_KERNELS chooses
+Raster_kernel KernelVariant(const bool edge_test, const bool textured, const bool fogged, const bool per_pixel)
+{
+    static const Raster_kernel quad_kernels[RASTER_KERNELS] = {
+        RasteriseKernel<true, false, false>, RasteriseKernel<true, false, true>,
+        RasteriseKernel<true, true, false>, RasteriseKernel<true, true, true>,
+        RasteriseKernel<false, false, false>, RasteriseKernel<false, false, true>,
+        RasteriseKernel<false, true, false>, RasteriseKernel<false, true, true> };
+    static const Raster_kernel pixel_kernels[RASTER_KERNELS] = {
+        RasteriseKernelPixel<true, false, false>, RasteriseKernelPixel<true, false, true>,
+        RasteriseKernelPixel<true, true, false>, RasteriseKernelPixel<true, true, true>,
+        RasteriseKernelPixel<false, false, false>, RasteriseKernelPixel<false, false, true>,
+        RasteriseKernelPixel<false, true, false>, RasteriseKernelPixel<false, true, true> };
+
+    const uint32_t kernel = KernelIndex(edge_test, textured, fogged);
+    return (per_pixel ? pixel_kernels[kernel] : quad_kernels[kernel]);
+} // End of KernelVariant
+#endif
 
-                    // Fetch the pointer to the texture image and then get the relevant pixel
-                    const uint32_t* this_colour_ptr = layo_ptr->palette[layo_ptr->attributes[idx]].image;
-                    this_colour = this_colour_ptr[image_idx];
-                    }
-                else
-                    {
-                    // Read the face colour for distant textured primitive
-                    this_colour = layo_ptr->palette[layo_ptr->attributes[idx]].rgb888; // read the palette
-                    }
-                this_colour = spec_shade_pixel (this_colour, surface);
-                }
-                //Put the pixel into a 16 bit sprite buffer, using previous shading and z for fog
-                WritePixel2Fog888(g_scWidth * y + x, this_colour, z);
-            } // end of depth check
-            oneOverW += C.x; // Incremental increase of barycentric coordinates on x axis
-            zOverW += Z.x;
-        } // end of x pixel scan
-        oneOverWFirst += C.y; // Incremental increase of barycentric coordinates on y axis
-        zOverWFirst += Z.y;
-    } // end of y pixel scan
+// Rasterises a primitive triangle using passed struct with edge checking and
+// interpolating z and UV mapping
+void RasteriseBox(const TriToRaster & tri)
+{
+    raster_kernels[ChooseKernel(tri, false)](tri);
+} // End of RasteriseBox
+
+// Rasterises a primitive triangle using passed struct WITHOUT edge checking as it's
+// only called for TA (totally accepted) tiles, it does interpolate z and UV mapping
+void NotRasteriseBox(const TriToRaster & tri)
+{
+    raster_kernels[ChooseKernel(tri, true)](tri);
 } // End of NotRasteriseBox
 
 // ************************************************************************************************
@@ -438,35 +738,37 @@ void WritePixel2Fog888(const uint32_t frame_index, const uint32_t rgb888, const
 // It was tried with a struct that contained seperate rgb to save the unpacking and packing between
 // functions but there was no apparent speed improvement and it's less adaptable 
 {
-    // The background colour for clearing screen which will also be fog
-    extern const uint32_t fog;
-    
-    // These would be nice as constexpr but can't make it work
-    // Static makes it VERY slow!!
-    const uint32_t fog_red = (fog & 0x00ff0000) >> 16;
-    const uint32_t fog_green = (fog & 0x0000ff00) >> 8;
-    const uint32_t fog_blue = (fog & 0x000000ff);
-
-    // There may be vector math optimisation to make here but previous attempts not encouraging
-    const uint32_t pix_red = (rgb888 & 0x00ff0000) >> 16;
-    const uint32_t pix_green = (rgb888 & 0x0000ff00) >> 8;
-    const uint32_t pix_blue = (rgb888 & 0x000000ff) >> 0;
-
-    uint32_t fog_depth = (uint32_t) (255.f * FogFunction(depth));
-
-    // intmix is for integers and has 'a' of 0 to 255, returns with value <<8
-    const uint32_t fogged_red = intmix(fog_red , pix_red , fog_depth);
-    const uint32_t fogged_green = intmix(fog_green , pix_green , fog_depth);
-    const uint32_t fogged_blue = intmix(fog_blue , pix_blue , fog_depth);
-    
-    // Shift to divide by 'a' in intmix
-    uint16_t rgb565 = ((fogged_red) & 0b1111100000000000) | ((fogged_green >> 5) & 0b0000011111100000) | ((fogged_blue >> 11) & 0b0000000000011111);
-    
-    // Using ESP-IDF the DMA routine will do the byte swap so here can be standard pack to 565
-    // We have a pixel in 565 format so send it to the appropriate viewer
-    frame_buffer_this[frame_index] = rgb565;
+    // Mix of the pixel against fog, 255 being clear
+    WritePixelMix(frame_index, rgb888, (uint32_t) (255.f * FogFunction(depth)));
 } // end of WritePixel2Fog888
 
+// As WritePixel2Fog888 but the fog is looked up from 1/w, which the rasteriser has without a divide
+void WritePixelFogW(const uint32_t frame_index, const uint32_t rgb888, const float oneOverW)
+{
+    WritePixelMix(frame_index, rgb888, FogShareW(oneOverW));
+} // end of WritePixelFogW
+
+// Fill the fog table that WritePixelFogW() uses, entry i being for 1/w of i / fog_lut_scale
+void MakeFogTable()
+{
+    fog_lut_scale = (FOG_LUT_SIZE - 1) * raster_quality.fog_start;
+    fog_lut[0] = 0; // Infinitely far
+    for (uint32_t i = 1; i < FOG_LUT_SIZE; i++)
+    {
+        fog_lut[i] = (uint8_t)(255.f * FogFunction(fog_lut_scale / (float)i));
+    }
+} // End of MakeFogTable
+
+// Take the quality settings for the list about to be rasterised, the fog table is only remade when the range changes
+void SetRasterQuality(const Quality_params & params)
+{
+    const bool fog_changed = (params.fog_start != raster_quality.fog_start) || (params.fog_end != raster_quality.fog_end);
+    raster_quality = params;
+    texture_inverse_depth = 1.0f / params.texture_depth;
+    fog_divisor = 1.0f / (params.fog_end - params.fog_start);
+    if (fog_changed) MakeFogTable();
+} // End of SetRasterQuality
+
 // adjusts input rgb according to surface shade for simple specular and diffuse illumination
 // ideally worked on a face level for non-textured primitives
 //uint32_t spec_shade_pixel (const uint32_t rgb888, const Vec2f surface_shade)
@@ -475,19 +777,21 @@ uint32_t spec_shade_pixel (const uint32_t rgb888, const Shade_params surface_sha
     const uint32_t intShade = surface_shade.lamb;
     const uint32_t intSpecular = surface_shade.spec; // Adds white/grey rather than an incident light colour
 
-    // I'm not sure if these values can overflow??
-    // Assumes that the reflected light is white so equal addition to each rgb channel
+    // Assumes that the reflected light is white so equal addition to each rgb channel.
+    // Red and blue are shaded together with a spare byte above each to take the carry
+    // from the specular addition, which then saturates them, and green likewise
+    const uint32_t shade_rb = ((intShade * (rgb888 & 0x00ff00ff)) >> 8) & 0x00ff00ff;
+    const uint32_t shade_g = ((intShade * (rgb888 & 0x0000ff00)) >> 8) & 0x0000ff00;
+
+    const uint32_t sum_rb = shade_rb + (intSpecular * 0x00010001);
+    const uint32_t sum_g = shade_g + (intSpecular << 8);
 
-    /*
-    const uint32_t pix_red = std::min(((intShade * (rgb888 & 0x00ff0000)) >> 24) + intSpecular, (uint32_t) 0xff);
-    const uint32_t pix_green = std::min(((intShade * (rgb888 & 0x0000ff00)) >> 16) + intSpecular, (uint32_t) 0xff);
-    const uint32_t pix_blue = std::min(((intShade * (rgb888 & 0x000000ff)) >> 8) + intSpecular, (uint32_t) 0xff);
-    */
-    const uint32_t pix_red = ((intShade * (rgb888 & 0x00ff0000)) >> 24) + intSpecular;
-    const uint32_t pix_green = ((intShade * (rgb888 & 0x0000ff00)) >> 16) + intSpecular;
-    const uint32_t pix_blue = ((intShade * (rgb888 & 0x000000ff)) >> 8) + intSpecular;
+    // A carry into the spare byte becomes a full channel
+    const uint32_t carry_rb = sum_rb & 0x01000100;
+    const uint32_t carry_g = sum_g & 0x00010000;
 
-    const uint32_t temp_rgb888 = (pix_red << 16) | (pix_green << 8) | (pix_blue);
+    const uint32_t temp_rgb888 = ((sum_rb | (carry_rb - (carry_rb >> 8))) & 0x00ff00ff) |
+                                 ((sum_g | (carry_g - (carry_g >> 8))) & 0x0000ff00);
 
     return (temp_rgb888);
 } // End of spec_shade_pixel
@@ -504,11 +808,7 @@ inline uint32_t intmix(const uint32_t x, const uint32_t y, const uint32_t a)
 // Linear fog presently, calculated live
 float FogFunction(float const depth)
 {
-    constexpr float start = 5.0f;
-    constexpr float end = 30.0f;
-    constexpr float divisor = 1/(end-start); // Known at compile time, a division avoided
-
-    float fog_temp = (end-depth) * divisor;
+    float fog_temp = (raster_quality.fog_end - depth) * fog_divisor;
     return (std::clamp(fog_temp , 0.f , 1.f));
 }
 
@@ -0,0 +1,247 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#include "esp_log.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "globals.h"
+#include "geometry.h"
+#include "structures.h"
+
+#include "ChunkChooser.h"
+#include "CheckTriangles.h"
+#include "RasteriseBox.h"
+#include "TriangleQueues.h"
+#include "QualityGovernor.h"
+#include "RenderScale.h"
+#include "RenderCheck.h"
+#include "RenderGoldens.h"
+
+// Rendering check
+// Changes to the raster kernels can break the image without slowing it, such as cracks between
+// triangles, texture wrap or fog banding. Before the tasks start each view in render_poses is drawn
+// with every chunk in the sequence, at full size and quality level 0 and without occlusion, impostors
+// or the panorama, so the result depends only on CheckTriangles and the kernels. The frame and depth
+// buffers are reduced to a grid of cell means, which a rounding change can't move far but a crack or
+// wrong texel will, and these and the CheckTriangles counters are compared with RenderGoldens.h.
+// Each view logs its values as a table entry so the goldens can be replaced after an intended change.
+// The host test in tools/RenderTest draws the same views through these functions and compares the
+// whole frame and depth buffers with its own goldens, and it records the entries of RenderGoldens.h.
+
+#ifdef CONFIG_AMAZE_RENDER_CHECK
+
+#define RENDER_COUNT_PERCENT 2  // Counters may differ by this share, plus RENDER_COUNT_SLACK
+#define RENDER_COUNT_SLACK 2
+#define RENDER_CELL_TOLERANCE 6 // Largest difference of a cell mean, of 255
+
+static const char *TAG = "RenderCheck";
+
+extern uint16_t * frame_buffer_A;
+extern uint16_t * frame_buffer_this;
+extern bool flipped;
+
+// Views relative to the world's starting eye and direction
+struct Render_pose
+{
+    float turn;     // Degrees to the left
+    float forward;  // Metres along the turned direction
+    float pitch;    // Degrees up
+};
+
+static const Render_pose render_poses[RENDER_POSES] = {
+    { 0.0f, 0.0f, 0.0f },
+    { 90.0f, 0.0f, 0.0f },
+    { 180.0f, 0.0f, 0.0f },
+    { 270.0f, 0.0f, 0.0f },
+    { 0.0f, 4.0f, 0.0f },
+    { 45.0f, 8.0f, -15.0f },
+};
+
+// Draws one view into frame_buffer_A and the depth buffer
+static void RenderView(const Vec3f eye, const Vec3f direction)
+{
+    extern std::vector<EachLayout> world;
+
+    ClearWorldFrame(frame_buffer_this);
+    ClearDepthBuffer(DEPTH_FAR);
+    EmptyQueues();
+    check_report = {};
+
+    for (uint32_t index = 0; ; index++)
+    {
+        for (const EachLayout & layout : world)
+        {
+            const WorldLayout * layo_ptr = &layout.frame_layouts[0]; // Animations are checked at their first frame
+            const uint32_t chunk = IndexChunkChooser(eye, direction, index, layo_ptr);
+            if (chunk == LAST_CHUNK) goto ChunksDone; // As ShowWorld
+            CheckTriangles(eye, direction, chunk, layo_ptr);
+        }
+    }
+ChunksDone:
+    const uint32_t block = flipped ? 2 : 0; // As CheckTriangles chooses
+    SendQueue(block);
+    SendQueue(block + 1);
+}
+
+// The fixed set up that the goldens are made with, RunRenderCheck() restores clear_free_frames afterwards
+void RenderCheckSetup()
+{
+    clear_free_frames = false;
+    depth_base = 0;
+    depth_sign = 1;
+    render_width = g_scWidth;
+    render_height = g_scHeight;
+    SetRasterQuality(quality_build); // Level 0 as the governor hasn't run yet
+    frame_buffer_this = frame_buffer_A;
+}
+
+// Draws a view of render_poses, relative to the world's starting eye and direction
+void RenderCheckPose(const uint32_t pose, const Vec3f eye, const Vec3f direction)
+{
+    const Render_pose & this_pose = render_poses[pose];
+    const float turn = this_pose.turn * (float)M_PI / 180.0f;
+    Vec3f view = { direction.x * cosf(turn) + direction.z * sinf(turn), 0.0f, direction.z * cosf(turn) - direction.x * sinf(turn) };
+    view.normalize();
+    const Vec3f pose_eye = eye + view * this_pose.forward;
+    view.y = tanf(this_pose.pitch * (float)M_PI / 180.0f);
+
+    RenderView(pose_eye, view);
+}
+
+// Reduces the buffers to cell means and copies the counters
+void RenderCheckMeasure(Render_golden & measured)
+{
+    extern depth_t * depthBuffer;
+    constexpr uint32_t cell_width = g_scWidth / RENDER_CELLS;
+    constexpr uint32_t cell_height = g_scHeight / RENDER_CELLS;
+    const depth_t far_value = (depth_t)DepthKey(DEPTH_FAR);
+
+    measured.triangles = check_report.triangles;
+    measured.tiles_accepted = check_report.tiles_accepted;
+    measured.tiles_partial = check_report.tiles_partial;
+    measured.tiles_rejected = check_report.tiles_rejected;
+    measured.pixels = 0;
+
+    for (uint32_t cell = 0; cell < RENDER_CELLS * RENDER_CELLS; cell++)
+    {
+        const uint32_t left = (cell % RENDER_CELLS) * cell_width;
+        const uint32_t top = (cell / RENDER_CELLS) * cell_height;
+        uint32_t luma = 0;
+        float depth = 0.0f;
+        for (uint32_t y = top; y < top + cell_height; y++)
+        {
+            for (uint32_t x = left; x < left + cell_width; x++)
+            {
+                const uint16_t rgb565 = frame_buffer_this[y * g_scWidth + x];
+                const uint32_t r = ((rgb565 >> 11) & 0x1f) * 255 / 31;
+                const uint32_t g = ((rgb565 >> 5) & 0x3f) * 255 / 63;
+                const uint32_t b = (rgb565 & 0x1f) * 255 / 31;
+                luma += (r * 77 + g * 150 + b * 29) >> 8;
+
+                const depth_t stored = depthBuffer[y * g_scWidth + x];
+                depth += (float)stored;
+                if (stored != far_value) measured.pixels++;
+            }
+        }
+        measured.luma[cell] = (uint8_t)(luma / (cell_width * cell_height));
+        measured.depth[cell] = (uint8_t)(depth * 255.0f / ((float)DEPTH_KEY_FAR * cell_width * cell_height));
+    }
+}
+
+static bool CountClose(const char * name, const uint32_t measured, const uint32_t golden)
+{
+    const uint32_t difference = (measured > golden) ? measured - golden : golden - measured;
+    if (difference <= golden * RENDER_COUNT_PERCENT / 100 + RENDER_COUNT_SLACK) return (true);
+    ESP_LOGI(TAG, "  %s %d, golden %d", name, (int)measured, (int)golden);
+    return (false);
+}
+
+static bool CellsClose(const char * name, const uint8_t * measured, const uint8_t * golden)
+{
+    uint32_t worst = 0, worst_cell = 0, total = 0;
+    for (uint32_t cell = 0; cell < RENDER_CELLS * RENDER_CELLS; cell++)
+    {
+        const uint32_t difference = abs((int)measured[cell] - (int)golden[cell]);
+        total += difference;
+        if (difference > worst)
+        {
+            worst = difference;
+            worst_cell = cell;
+        }
+    }
+    if (worst <= RENDER_CELL_TOLERANCE) return (true);
+    ESP_LOGI(TAG, "  %s differs by up to %d at cell %d,%d, mean %d", name, (int)worst,
+        (int)(worst_cell % RENDER_CELLS), (int)(worst_cell / RENDER_CELLS), (int)(total / (RENDER_CELLS * RENDER_CELLS)));
+    return (false);
+}
+
+// Logs the measurement as it would be written in RenderGoldens.h
+void RenderCheckLog(const uint32_t pose, const Render_golden & measured)
+{
+    char cells[RENDER_CELLS * RENDER_CELLS * 4 + 1];
+    ESP_LOGI(TAG, "Pose %d golden:", (int)pose);
+    ESP_LOGI(TAG, "    { %d, %d, %d, %d, %d,", (int)measured.triangles, (int)measured.tiles_accepted,
+        (int)measured.tiles_partial, (int)measured.tiles_rejected, (int)measured.pixels);
+    for (const uint8_t * values : { measured.luma, measured.depth })
+    {
+        char * out = cells;
+        for (uint32_t cell = 0; cell < RENDER_CELLS * RENDER_CELLS; cell++) out += sprintf(out, "%d,", (int)values[cell]);
+        ESP_LOGI(TAG, "      { %s },", cells);
+    }
+    ESP_LOGI(TAG, "    },");
+}
+
+void RunRenderCheck(const Vec3f eye, const Vec3f direction)
+{
+    const bool goldens_apply = (RENDER_GOLDEN_WIDTH == g_scWidth) && (RENDER_GOLDEN_HEIGHT == g_scHeight);
+    if (!goldens_apply) ESP_LOGI(TAG, "The goldens are for %dx%d so are only logged", RENDER_GOLDEN_WIDTH, RENDER_GOLDEN_HEIGHT);
+
+    // A fixed set up, restored afterwards
+    const bool clear_free = clear_free_frames;
+    RenderCheckSetup();
+
+    uint32_t failures = 0;
+    for (uint32_t pose = 0; pose < RENDER_POSES; pose++)
+    {
+        RenderCheckPose(pose, eye, direction);
+        Render_golden measured;
+        RenderCheckMeasure(measured);
+
+        bool passed = true;
+        if (goldens_apply)
+        {
+            const Render_golden & golden = render_goldens[pose];
+            ESP_LOGI(TAG, "Pose %d checking", (int)pose);
+            passed &= CountClose("triangles", measured.triangles, golden.triangles);
+            passed &= CountClose("tiles accepted", measured.tiles_accepted, golden.tiles_accepted);
+            passed &= CountClose("tiles partial", measured.tiles_partial, golden.tiles_partial);
+            passed &= CountClose("tiles rejected", measured.tiles_rejected, golden.tiles_rejected);
+            passed &= CountClose("pixels", measured.pixels, golden.pixels);
+            passed &= CellsClose("brightness", measured.luma, golden.luma);
+            passed &= CellsClose("depth", measured.depth, golden.depth);
+            ESP_LOGI(TAG, "Pose %d %s", (int)pose, passed ? "passed" : "FAILED");
+        }
+        if (!passed) failures++;
+        if (!passed || !goldens_apply) RenderCheckLog(pose, measured);
+        vTaskDelay(1); // Let the idle task feed the watchdog
+    }
+    if (goldens_apply) ESP_LOGI(TAG, "%d of %d poses failed", (int)failures, (int)RENDER_POSES);
+
+    // Leave the buffers as MakeDepthBuffer did
+    ClearDepthBuffer(DEPTH_FAR);
+    clear_free_frames = clear_free;
+    EmptyQueues();
+} // End of RunRenderCheck
+
+#else
+
+void RunRenderCheck(const Vec3f eye, const Vec3f direction)
+{
+}
+
+#endif
@@ -0,0 +1,130 @@
+#include <stdint.h>
+#include <algorithm>
+
+#include "esp_log.h"
+
+#include "globals.h"
+#include "structures.h"
+
+#include "RasteriseBox.h"
+#include "RenderScale.h"
+
+// Dynamic resolution
+// Rather than shortening the chunk sequence when frames are slow, which makes the world visibly
+// shrink as the player moves, the view is rasterised at a lower resolution. The projection is
+// unchanged, only the mapping from clip space to pixels, so a frame drawn at a smaller size is the
+// same view and UpscaleFrame() stretches it back over the whole frame buffer on the raster core.
+
+bool render_scale_enabled = (FRAME_CONTROL == FRAME_CONTROL_SCALE);
+
+// A share of a side of the view port rounded down to whole tiles
+constexpr uint32_t RenderSide(const uint32_t side, const uint32_t tile, const uint32_t quarters)
+{
+    return ((side * quarters / 4) / tile * tile);
+}
+
+// Largest first, stepping down through both axes in turn
+static const Render_size render_sizes[RENDER_SIZES] = {
+    { g_scWidth, g_scHeight },
+    { g_scWidth, RenderSide(g_scHeight, g_yTile, 3) },
+    { RenderSide(g_scWidth, g_xTile, 3), RenderSide(g_scHeight, g_yTile, 3) },
+    { RenderSide(g_scWidth, g_xTile, 3), RenderSide(g_scHeight, g_yTile, 2) },
+    { RenderSide(g_scWidth, g_xTile, 2), RenderSide(g_scHeight, g_yTile, 2) } };
+
+#define RENDER_DOWN_FRAMES 2   // Slow frames in a row before the size is reduced
+#define RENDER_UP_FRAMES 8     // Fast frames in a row before it is increased
+#define RENDER_UP_PERCENT 70   // A fast frame is within this share of MAX_FRAME_DURATION
+
+uint32_t render_width = g_scWidth;
+uint32_t render_height = g_scHeight;
+Render_size render_size[2] = { { g_scWidth, g_scHeight }, { g_scWidth, g_scHeight } };
+
+static uint32_t render_level = 0; // Index into render_sizes
+static uint32_t slow_frames = 0;
+static uint32_t fast_frames = 0;
+
+static uint32_t frames_at_level[RENDER_SIZES]; // Reported each second
+
+// Choose the size for the frame about to be built on core 0 from the time of the last one
+void RenderScaleNewFrame(const uint32_t frame_time)
+{
+    extern bool flipped;
+
+    if (render_scale_enabled)
+    {
+        if (frame_time > MAX_FRAME_DURATION)
+        {
+            fast_frames = 0;
+            if ((++slow_frames >= RENDER_DOWN_FRAMES) && (render_level < RENDER_SIZES - 1))
+            {
+                render_level++;
+                slow_frames = 0;
+            }
+        }
+        else if ((frame_time * 100) < (MAX_FRAME_DURATION * RENDER_UP_PERCENT))
+        {
+            slow_frames = 0;
+            if ((++fast_frames >= RENDER_UP_FRAMES) && (render_level > 0))
+            {
+                render_level--;
+                fast_frames = 0;
+            }
+        }
+        else
+        {
+            slow_frames = 0;
+            fast_frames = 0;
+        }
+    }
+    else render_level = 0;
+
+    render_width = render_sizes[render_level].width;
+    render_height = render_sizes[render_level].height;
+    render_size[flipped ? 1 : 0] = render_sizes[render_level];
+    frames_at_level[render_level]++;
+} // End of RenderScaleNewFrame
+
+// The pixel budget for the chunk sequence is scaled with the area so the draw distance stays the same
+uint32_t RenderScaleBudget(const uint32_t full_budget)
+{
+    return ((uint32_t)(((uint64_t)full_budget * render_width * render_height) / (g_scWidth * g_scHeight)));
+}
+
+// Stretch a frame that was rasterised at a lower resolution over the whole buffer by repeating pixels
+// Working back from the last pixel means that a source pixel is never overwritten before it's read
+void UpscaleFrame(uint16_t * frame_buffer, const uint32_t list)
+{
+    const uint32_t width = render_size[list].width;
+    const uint32_t height = render_size[list].height;
+    if ((width == g_scWidth) && (height == g_scHeight)) return;
+
+    uint32_t source_column[g_scWidth];
+    for (uint32_t x = 0; x < g_scWidth; x++) source_column[x] = (x * width) / g_scWidth;
+
+    for (int32_t y = g_scHeight - 1; y >= 0; y--)
+    {
+        const uint16_t * source = &frame_buffer[((y * height) / g_scHeight) * g_scWidth];
+        uint16_t * out = &frame_buffer[y * g_scWidth];
+        for (int32_t x = g_scWidth - 1; x >= 0; x--) out[x] = source[source_column[x]];
+    }
+
+    // The background left by the resolve has been written over
+    ForgetFrameBackground(list);
+} // End of UpscaleFrame
+
+// Log how many frames were drawn at each size since the last call, integer only for the timer task
+void ReportRenderScale()
+{
+    static const char *TAG = "RenderScale";
+
+    if (!render_scale_enabled) return;
+
+    ESP_LOGI(TAG, "Frames at %dx%d %d, %dx%d %d, %dx%d %d, %dx%d %d, %dx%d %d",
+        (int)render_sizes[0].width, (int)render_sizes[0].height, (int)frames_at_level[0],
+        (int)render_sizes[1].width, (int)render_sizes[1].height, (int)frames_at_level[1],
+        (int)render_sizes[2].width, (int)render_sizes[2].height, (int)frames_at_level[2],
+        (int)render_sizes[3].width, (int)render_sizes[3].height, (int)frames_at_level[3],
+        (int)render_sizes[4].width, (int)render_sizes[4].height, (int)frames_at_level[4]);
+
+    for (uint32_t level = 0; level < RENDER_SIZES; level++) frames_at_level[level] = 0;
+} // End of ReportRenderScale
@@ -28,6 +28,15 @@
 #include "CheckTriangles.h"
 #include "RasteriseBox.h"
 #include "EventManager.h"
+#include "OcclusionCull.h"
+#include "ImpostorCache.h"
+#include "HorizonPanorama.h"
+#include "RenderScale.h"
+#include "CostModel.h"
+#include "QualityGovernor.h"
+#include "Profile.h"
+#include "Trace.h"
+#include "HeatMap.h"
 
 #include "ShowWorld.h"
 
@@ -40,6 +49,7 @@ extern Vec3f direction;
 
 extern Time_tracked time_report; // Health and fps etc for reporting
 extern QueueHandle_t game_event_queue; // A FreeRTOS queue to pass game play events from world to manager
+extern uint32_t raster_frame_us; // How long the rasteriser took over the last frame
 
 // This module maintains the 2D overlay description but not the actual buffer
 TwoD_overlay score_overlay;
@@ -52,6 +62,7 @@ static const char *TAG = "ShowWorld";
 static uint32_t max_pixel_count = 5 * g_scHeight * g_scWidth ; // Pick a start value to initialise
 static int64_t elapsed_time = esp_timer_get_time(); // Internal microsecond clock
 static uint32_t frame_time;
+static uint32_t build_time; // Microseconds spent building the queues, for the quality governor
 
 
 static  Vec3f scaled_direction;
@@ -75,14 +86,25 @@ while(1)
 // Manage pingpong
 flipped = ! flipped;
 
+// Keep a coarse copy of the last depth buffer for occlusion culling whilst the rasteriser is idle
+OcclusionCapturePrevious();
+
 // Needs depth buffer cleared before sending, depth could be adjusted to limit rendering
-ClearDepthBuffer(200.0f); // Just the one to clear before rasterise
+// unless the rasteriser is resolving the frames instead
+if (!clear_free_frames)
+{
+  PROFILE_SCOPE(PROF_CLEAR);
+  TRACE_SCOPE(TRACE_BUILD_TASK, TRACE_CLEAR);
+  ClearDepthBuffer(DEPTH_FAR); // Just the one to clear before rasterise
+}
 
 // Oddly the rasterising is started at the start of the loop which seems unexpected but sets
 // the two threads working nicely
 xEventGroupSetBits( raster_event_group, START_RASTER);
+TRACE_INSTANT(TRACE_BUILD_TASK, TRACE_START_RASTER);
 
 SendFlippedFrame();
+TRACE_INSTANT(TRACE_BUILD_TASK, TRACE_SEND_FRAME);
 
         // Start a new screen render
         uint32_t this_frame; // Track frame index
@@ -95,13 +117,16 @@ SendFlippedFrame();
 
         // Which chunk is the eye in? We don't need to check deeper
         // The moved flag is set true to force check of [0,0] offset
+        PROFILE_MARK(choose_start);
         uint32_t base_chunk = ChunkChooser(eye, direction, true, this_world_ptr);
+        PROFILE_SINCE(PROF_CHUNK_CHOOSE, choose_start);
 
         // Is the location in the world? If not, assume same as before !zero
         if (base_chunk == INVALID_CHUNK) spot_height = old_spot_height; // 0.0f;
         else
         {
           // Current location is in the world so find height
+          PROFILE_SCOPE(PROF_BASE_TRIANGLES);
           spot_height = BaseTriangles(eye, direction, base_chunk, this_world_ptr);
           delta_height = spot_height - old_spot_height; // This is an absolute change and will be scaled later
           old_spot_height = spot_height;
@@ -116,15 +141,31 @@ SendFlippedFrame();
     // reduce the search but don't let it get too small or needlessly big
     // 99ms is an arbitrary maximum
     // The MCU clock can't be used to limit this as this thread is not rate limiting 
-    max_pixel_count = std::clamp(max_pixel_count+(MAX_FRAME_DURATION-frame_time)*100,(g_scWidth * g_scHeight * 2),(g_scWidth * g_scHeight * 5));
+    // With dynamic resolution the frame time is held by the render size instead, and the budget
+    // follows its area so that the same chunks are reached at every size. Any other control of the
+    // frame time leaves the budget at its largest so the two don't fight
+    RenderScaleNewFrame(frame_time);
+    CostModelNewFrame(flipped ? 1 : 0);
+    QualityNewFrame(frame_time, build_time, raster_frame_us);
+    const int64_t build_start = esp_timer_get_time();
+    TRACE_BEGIN(TRACE_BUILD_TASK, TRACE_BUILD);
+    if (render_scale_enabled) max_pixel_count = RenderScaleBudget(g_scWidth * g_scHeight * 5);
+    else if (FRAME_CONTROL != FRAME_CONTROL_PIXELS) max_pixel_count = g_scWidth * g_scHeight * 5;
+    else max_pixel_count = std::clamp(max_pixel_count+(MAX_FRAME_DURATION-frame_time)*100,(g_scWidth * g_scHeight * 2),(g_scWidth * g_scHeight * 5));
 
 
     // Start a new screen render
     uint32_t count=0; // use as a workload indicator
 
+    // Empty the occlusion buffer, the nearest chunks will fill it as they are checked
+    OcclusionNewFrame(eye, direction);
+    ImpostorNewFrame(eye, direction);
+    HorizonNewFrame(eye, direction); // Background slice to match this view
+
     uint32_t chunk_index_count = 0;
     do
     {
+        OcclusionSequenceStep(chunk_index_count); // Large faces of the nearest chunks become occluders
         // Loop through all of the world layouts to draw the world(s)
         for (uint32_t worlds=0 ; worlds < world.size() ; worlds++)
           {
@@ -139,8 +180,15 @@ SendFlippedFrame();
           // set the pointer to the layout in use
           this_world_ptr = & (world[worlds].frame_layouts[this_frame]);
 
+          PROFILE_MARK(index_start);
           uint32_t my_chunk = IndexChunkChooser(eye, direction,chunk_index_count,this_world_ptr);
+          PROFILE_SINCE(PROF_CHUNK_CHOOSE, index_start);
           if (my_chunk == LAST_CHUNK) goto ChunksDone; // There is nothing more to be found so move on
+          if ((my_chunk != INVALID_CHUNK) && HorizonChunkBeyond(eye, direction, this_world_ptr, my_chunk)) continue; // Only fog, the panorama shows it
+          if ((my_chunk != INVALID_CHUNK) && QualityChunkBeyond(eye, direction, this_world_ptr, my_chunk)) continue; // Only fog over the fog background
+          if ((my_chunk != INVALID_CHUNK) && OcclusionTestChunk(this_world_ptr, my_chunk)) continue; // Hidden so skip it
+          // A distant chunk of a layout that isn't animated can be drawn from a cached image
+          if ((my_chunk != INVALID_CHUNK) && (world[worlds].frames == 1) && ImpostorDrawChunk(eye, direction, this_world_ptr, my_chunk)) continue;
             {
               // CheckTriangles returns itself if the chunk is invalid
               count += CheckTriangles(eye, direction, my_chunk,this_world_ptr); // Which pushes onto rasteriser queues
@@ -152,22 +200,38 @@ SendFlippedFrame();
     // Adjust how many chunks are included by pixel estimate
     // But keep going if no control pressed
     // This will also affect render depth when a key is pressed as complexity is still being estimated
-      while ((count < max_pixel_count) || control_not_pressed); 
+      // The cost model, if chosen, instead stops when the raster core is predicted to be busy for the frame
+      while (((FRAME_CONTROL == FRAME_CONTROL_COST) ? CostModelUnderBudget(flipped ? 1 : 0) : (count < max_pixel_count)) || control_not_pressed); 
     
 ChunksDone: // A goto is used to reach here to exit from a depth of two loops
+    build_time = (uint32_t)(esp_timer_get_time() - build_start);
+    TRACE_END(TRACE_BUILD_TASK, TRACE_BUILD);
               // Wait for rasterisation of queue to be finished, that's is the bigger job
 
     // It is possible that Core 0 does not idle if rasteriser is quick so fore a wdt reset
     // so Core 0 WDT is disabled in SDK configuration editor
     // as adding a 1 tck vTaskDelay didn't help
 
+    // The bits are waited for in turn, which is the same as together as neither is cleared,
+    // so that the raster and DMA waits can be profiled apart
+              PROFILE_MARK(raster_wait_start);
+              TRACE_BEGIN(TRACE_BUILD_TASK, TRACE_WAIT_RASTER_DONE);
               xEventGroupWaitBits(
                        raster_event_group,               // event group handle
-                       RASTER_DONE | CLEAR_READY | GAME_RUNNING,          // bits to wait for
+                       RASTER_DONE | GAME_RUNNING,          // bits to wait for
                        pdFALSE,                            // don't clear the bit once we've started
                        pdTRUE,                           //  AND for any of the defined bits
                        portMAX_DELAY );                   //  block forever
+              PROFILE_SINCE(PROF_RASTER_WAIT, raster_wait_start);
+              TRACE_END(TRACE_BUILD_TASK, TRACE_WAIT_RASTER_DONE);
+              PROFILE_MARK(dma_wait_start);
+              TRACE_BEGIN(TRACE_BUILD_TASK, TRACE_WAIT_CLEAR_READY);
+              xEventGroupWaitBits(raster_event_group, CLEAR_READY, pdFALSE, pdTRUE, portMAX_DELAY);
+              PROFILE_SINCE(PROF_DMA_WAIT, dma_wait_start);
+              TRACE_END(TRACE_BUILD_TASK, TRACE_WAIT_CLEAR_READY);
+              TRACE_BEGIN(TRACE_BUILD_TASK, TRACE_PLAY);
               xEventGroupClearBits(raster_event_group, RASTER_DONE | CLEAR_READY); // Clear the bits we want to allow game play
+              CostModelCalibrate(flipped ? 0 : 1); // The list just rasterised was built in the last loop
 
       // Collision is checked by sampling depth buffer in a field of view
       // A struct is sent and updated
@@ -239,6 +303,9 @@ if (!gpio_get_level(CONTROL_UP))
       // Checking of which face is impacted is only done on forward motion
       // Note that projected triangle/tile queues are re-used by SendImpactQueue and not reset here
       // As before, chose buffers based on flipped status of pingpong buffers
+      // The point is at full size so is moved to the resolution the queues were built at
+      test_pix.x = (test_pix.x * render_width) / g_scWidth;
+      test_pix.y = (test_pix.y * render_height) / g_scHeight;
       if (flipped)
       {
         found = SendImpactQueue(2, & test_pix) || SendImpactQueue(3, & test_pix); 
@@ -319,9 +386,13 @@ if (!gpio_get_level(CONTROL_LEFT))
       //ESP_LOGI(TAG,"LEFT");
   }
 
+// A and B together step the heat map view, if it's configured
+if (HEAT_MAP_ON) HeatMapControl(!gpio_get_level(CONTROL_A) && !gpio_get_level(CONTROL_B));
+
 // Find frame refresh duration and update the time
   frame_time=(esp_timer_get_time()-elapsed_time)>>10; // Divide by 1024 is near enough and faster
   elapsed_time=esp_timer_get_time();
+  OcclusionFrameTime(frame_time); // Only kept when comparing frames with and without culling
   //ESP_LOGI(TAG, "Frame time is %d ",(int)frame_time); 
   // Record the frame in the reporting structure
   time_report.frames++;
@@ -330,6 +401,8 @@ if (!gpio_get_level(CONTROL_LEFT))
   // is the time to do 2D information overlays if needed
 
   if (OverlayFlag) OverlayTwoD(score_overlay);
+  TRACE_END(TRACE_BUILD_TASK, TRACE_PLAY);
+  PROFILE_END_FRAME(); // Whilst the rasteriser is waiting for START_RASTER
   //taskYIELD();
 } // end of loop forever
 
@@ -346,13 +419,13 @@ xEventGroupClearBits( raster_event_group, CLEAR_READY);
 // The queues may be needed in this module so removed reset in SendQueue
 if (flipped)
   {
-    ESP_ERROR_CHECK(esp_lcd_panel_draw_bitmap(panel_handle, 0, 0, g_scWidth, g_scWidth, frame_buffer_B));
+    ESP_ERROR_CHECK(esp_lcd_panel_draw_bitmap(panel_handle, 0, 0, g_scWidth, g_scHeight, frame_buffer_B));
     EmptyQueue(2);
     EmptyQueue(3);
   }
 else
   {
-    ESP_ERROR_CHECK(esp_lcd_panel_draw_bitmap(panel_handle, 0, 0, g_scWidth, g_scWidth, frame_buffer_A));
+    ESP_ERROR_CHECK(esp_lcd_panel_draw_bitmap(panel_handle, 0, 0, g_scWidth, g_scHeight, frame_buffer_A));
     EmptyQueue(0);
     EmptyQueue(1);
   }
@@ -10,6 +10,16 @@
 
 #include "events_global.h"
 #include "EventManager.h"
+#include "TriangleQueues.h"
+#include "OcclusionCull.h"
+#include "ImpostorCache.h"
+#include "RasteriseBox.h"
+#include "RenderScale.h"
+#include "CostModel.h"
+#include "QualityGovernor.h"
+#include "Profile.h"
+#include "Trace.h"
+#include "HeatMap.h"
 
 #include "TimeTracker.h"
 
@@ -32,4 +42,16 @@ void TimeTrack (TimerHandle_t tracked_handle)
     ESP_LOGI(TAG, "Framerate is %d fps and %d triangles",time_report.frames,(int)time_report.triangles);
     time_report.frames = 0;
     time_report.triangles = 0;
+    ReportQueueSort(); // Only reports if any queue is being sorted
+    ReportQueueUse();
+    ReportOcclusion();
+    ReportImpostors();
+    ReportClearFree();
+    ReportRenderScale();
+    ReportCostModel();
+    ReportQuality();
+    ReportProfile(); // Only reports if profiling is configured
+    ReportTrace(); // Sends the trace once if it is configured
+    ReportHeatMap(); // Only reports whilst a heat map is viewed
+
 } // End of TimeTrack
\ No newline at end of file
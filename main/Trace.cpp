@@ -0,0 +1,144 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "globals.h"
+
+#include "Trace.h"
+
+// Timeline trace
+// Each task has a ring of the latest events, timed with esp_timer as the cycle counters of the two
+// cores aren't in step. Once, CONFIG_AMAZE_TRACE_SECONDS after the first report, recording stops and
+// the rings are sent as one binary block. The console translates line endings so the block is sent
+// as base64 in log lines starting "AMZT", which can sit amongst the other logs in a capture:
+//   "AMZT begin <bytes>", then lines of up to 64 base64 characters, then "AMZT end"
+// The block, little endian as on the ESP, is
+//   "AMZT", uint16_t version, uint8_t task count, uint8_t name count,
+//   the task names then the event names each ending with a zero,
+//   uint32_t event count, then the events as Trace_event, each task's oldest first
+// tools/TraceToChrome reads it, so change both together and bump TRACE_VERSION.
+
+#if TRACE_ON
+
+#define TRACE_VERSION 1
+#define TRACE_EVENTS CONFIG_AMAZE_TRACE_EVENTS // Per task
+static_assert((TRACE_EVENTS & (TRACE_EVENTS - 1)) == 0, "Trace events per task must be a power of 2");
+
+struct Trace_event
+{
+    uint32_t time_us;   // Low 32 bits of esp_timer, which wraps after 71 minutes
+    uint16_t name;
+    uint8_t task;
+    uint8_t phase;
+};
+static_assert(sizeof(Trace_event) == 8, "Trace events are sent as 8 bytes");
+
+struct Trace_ring
+{
+    uint32_t written;   // Events ever written, the next goes at written & (TRACE_EVENTS - 1)
+    Trace_event events[TRACE_EVENTS];
+};
+
+static const char * const trace_task_names[TRACE_TASKS] = { "ShowWorld core 0", "rasteriseTask core 1", "GetGameEvent" };
+static const char * const trace_names[TRACE_NAMES] = {
+    "build", "wait RASTER_DONE", "wait CLEAR_READY", "play", "clear", "START_RASTER", "send frame",
+    "wait START_RASTER", "triangles", "tiles", "impostors", "resolve", "game event" };
+
+static Trace_ring rings[TRACE_TASKS];
+static volatile bool recording = true;
+
+// Only ever called by the task that owns the ring
+void TraceAdd(const uint32_t task, const uint32_t name, const uint8_t phase)
+{
+    if (!recording) return;
+    Trace_ring & ring = rings[task];
+    ring.events[ring.written & (TRACE_EVENTS - 1)] = { (uint32_t)esp_timer_get_time(), (uint16_t)name, (uint8_t)task, phase };
+    ring.written++;
+}
+
+// Bytes are gathered into lines of 48 which are 64 characters of base64
+#define TRACE_LINE_BYTES 48
+static uint8_t line_bytes[TRACE_LINE_BYTES];
+static uint32_t line_used = 0;
+
+static void SendLine()
+{
+    static const char *TAG = "Trace";
+    static const char base64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    char text[TRACE_LINE_BYTES / 3 * 4 + 1];
+    char * out = text;
+
+    for (uint32_t i = 0; i < line_used; i += 3)
+    {
+        const uint32_t left = line_used - i;
+        const uint32_t group = (line_bytes[i] << 16) | ((left > 1 ? line_bytes[i + 1] : 0) << 8) | (left > 2 ? line_bytes[i + 2] : 0);
+        *out++ = base64[(group >> 18) & 0x3f];
+        *out++ = base64[(group >> 12) & 0x3f];
+        *out++ = (left > 1) ? base64[(group >> 6) & 0x3f] : '=';
+        *out++ = (left > 2) ? base64[group & 0x3f] : '=';
+    }
+    *out = 0;
+    ESP_LOGI(TAG, "AMZT %s", text);
+    line_used = 0;
+}
+
+static void SendBytes(const void * data, const uint32_t size)
+{
+    const uint8_t * bytes = (const uint8_t *)data;
+    for (uint32_t i = 0; i < size; i++)
+    {
+        line_bytes[line_used++] = bytes[i];
+        if (line_used == TRACE_LINE_BYTES) SendLine();
+    }
+}
+
+// Called each second by the timer task, sends the trace once
+void ReportTrace()
+{
+    static const char *TAG = "Trace";
+    static uint32_t seconds = 0;
+
+    if (!recording) return; // Already sent
+    if (++seconds < CONFIG_AMAZE_TRACE_SECONDS) return;
+
+    // An event being written as this is set may be missed, which a trace of seconds can spare
+    recording = false;
+
+    uint32_t total = 0, size = 8 + sizeof(total);
+    for (uint32_t task = 0; task < TRACE_TASKS; task++)
+    {
+        total += (rings[task].written < TRACE_EVENTS) ? rings[task].written : TRACE_EVENTS;
+        size += strlen(trace_task_names[task]) + 1;
+    }
+    for (uint32_t name = 0; name < TRACE_NAMES; name++) size += strlen(trace_names[name]) + 1;
+    size += total * sizeof(Trace_event);
+
+    // Takes a second or two at the default console speed, a one off stall of the timer task
+    ESP_LOGI(TAG, "AMZT begin %d", (int)size);
+    const uint16_t version = TRACE_VERSION;
+    const uint8_t counts[2] = { TRACE_TASKS, TRACE_NAMES };
+    SendBytes("AMZT", 4);
+    SendBytes(&version, sizeof(version));
+    SendBytes(counts, sizeof(counts));
+    for (uint32_t task = 0; task < TRACE_TASKS; task++) SendBytes(trace_task_names[task], strlen(trace_task_names[task]) + 1);
+    for (uint32_t name = 0; name < TRACE_NAMES; name++) SendBytes(trace_names[name], strlen(trace_names[name]) + 1);
+    SendBytes(&total, sizeof(total));
+    for (uint32_t task = 0; task < TRACE_TASKS; task++)
+    {
+        const Trace_ring & ring = rings[task];
+        const uint32_t first = (ring.written < TRACE_EVENTS) ? 0 : ring.written - TRACE_EVENTS;
+        for (uint32_t i = first; i < ring.written; i++) SendBytes(&ring.events[i & (TRACE_EVENTS - 1)], sizeof(Trace_event));
+    }
+    if (line_used) SendLine();
+    ESP_LOGI(TAG, "AMZT end");
+} // End of ReportTrace
+
+#else
+
+void ReportTrace()
+{
+}
+
+#endif
@@ -1,6 +1,9 @@
 #include <stdint.h>
+#include <algorithm>
 
 #include "esp_log.h" 
+#include "esp_timer.h"
+#include "esp_cpu.h"
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
@@ -14,6 +17,14 @@
 #include "FindHitFace.h"
 #include "ShowError.h"
 #include "RasteriseBox.h"
+#include "ImpostorCache.h"
+#include "HorizonPanorama.h"
+#include "RenderScale.h"
+#include "CostModel.h"
+#include "QualityGovernor.h"
+#include "Profile.h"
+#include "Trace.h"
+#include "HeatMap.h"
 
 #include "TriangleQueues.h"
 
@@ -25,12 +36,25 @@ extern uint16_t * frame_buffer_B;
 
 uint16_t *frame_buffer_this;
 
-unsigned int max_raster_buf[4];
+unsigned int max_raster_buf[4]; // The most items in each queue since the last ReportQueueUse
 
 // Reserve space for a minimum of two queues of primitives using struct of TriToRaster
 // One for Rasterise triangles and one for NotRasterise tiles
 TriQueue BlockA[4];
 
+// A single scratch area shared by all sorted queues as they are only sorted one at a time on the rasteriser core
+TriToRaster * sort_scratch = NULL;
+uint32_t sort_scratch_size = 0;
+
+// Sorting costs and raster times, even and odd queues are the triangle and tile queues respectively
+Sort_tracked sort_report[2];
+
+// Counts frames so that SORT_ALTERNATE can switch between sorted and unsorted rasterisation
+uint32_t sort_frame = 0;
+
+// Microseconds from START_RASTER to RASTER_DONE of the last frame, for the cost model and quality governor
+uint32_t raster_frame_us = 0;
+
 static const char *TAG = "TriangleQueues";
 
 
@@ -41,29 +65,60 @@ void rasteriseTask(void * parameter)
 
   while(1)
   {
+    TRACE_BEGIN(TRACE_RASTER_TASK, TRACE_WAIT_START_RASTER);
     xEventGroupWaitBits(
                        raster_event_group,               // event group handle
                        START_RASTER,                        // bits to wait for
                        pdTRUE,                            // clear the bit once we've started
                        pdTRUE,                           //  AND for any of the defined bits
                        portMAX_DELAY );                   //  block forever
+    TRACE_END(TRACE_RASTER_TASK, TRACE_WAIT_START_RASTER);
     //xEventGroupClearBits(raster_event_group, START_RASTER); // retain GAME_RUNNING BIT
+    const int64_t raster_start = esp_timer_get_time();
+
+    QualityRasterFrame(flipped ? 0 : 1); // The settings the list was built with
+    sort_frame++; // Used to alternate sorting if requested
+    DepthNewFrame(); // Swap the depth encoding unless the depth buffer was cleared
+    HeatMapNewFrame(); // Take up a change of the debug view
 
     if (flipped)
     {
         frame_buffer_this=frame_buffer_A; // Set the target frame buffer
-        ClearWorldFrame(frame_buffer_this); // Perhaps not ideal to do this on rasteriser core?
+        if (!clear_free_frames)
+        {
+            PROFILE_SCOPE(PROF_CLEAR);
+            TRACE_SCOPE(TRACE_RASTER_TASK, TRACE_CLEAR);
+            if (!HorizonClearFrame(frame_buffer_this, 0)) ClearWorldFrame(frame_buffer_this); // Perhaps not ideal to do this on rasteriser core?
+        }
 
         SendQueue(0); // Send both queues to the rasteriser
         SendQueue(1);
+        SendImpostors(0); // and the distant chunks that were built with them
+        PROFILE_SCOPE(PROF_CLEAR);
+        TRACE_SCOPE(TRACE_RASTER_TASK, TRACE_RESOLVE);
+        ResolveFrame(frame_buffer_this, 0); // Background where nothing was drawn if the clears were skipped
+        HeatMapFrame(frame_buffer_this, 0); // Replaced by the heat map if one is being viewed
+        UpscaleFrame(frame_buffer_this, 0); // Stretched over the frame if it was drawn smaller
     }
     else
     {
         frame_buffer_this=frame_buffer_B; // Set the target frame buffer
-        ClearWorldFrame(frame_buffer_this); // Perhaps not ideal to do this on rasteriser core?
+        if (!clear_free_frames)
+        {
+            PROFILE_SCOPE(PROF_CLEAR);
+            TRACE_SCOPE(TRACE_RASTER_TASK, TRACE_CLEAR);
+            if (!HorizonClearFrame(frame_buffer_this, 1)) ClearWorldFrame(frame_buffer_this); // Perhaps not ideal to do this on rasteriser core?
+        }
         SendQueue(2); // Send both queues to the rasteriser
         SendQueue(3);
+        SendImpostors(1);
+        PROFILE_SCOPE(PROF_CLEAR);
+        TRACE_SCOPE(TRACE_RASTER_TASK, TRACE_RESOLVE);
+        ResolveFrame(frame_buffer_this, 1);
+        HeatMapFrame(frame_buffer_this, 1);
+        UpscaleFrame(frame_buffer_this, 1);
     }
+    raster_frame_us = (uint32_t)(esp_timer_get_time() - raster_start);
     xEventGroupSetBits(
       raster_event_group,
       RASTER_DONE);
@@ -89,6 +144,27 @@ void MakeQueue(const uint32_t tri_count, const uint32_t block)
     }
     BlockA[block].size = tri_count; // Record size
     BlockA[block].count = 0; // and it's now empty
+    BlockA[block].sort_mode = SORT_OFF; // Default is to rasterise in the order queued
+}
+
+// Choose whether a queue is sorted front-to-back before rasterising
+// Must be called after MakeQueue and before the tasks start as the scratch area may be (re)allocated
+void SetQueueSort(const uint32_t block, const uint32_t sort_mode)
+{
+    BlockA[block].sort_mode = sort_mode;
+    if (sort_mode == SORT_OFF) return;
+
+    // The scratch area has to be able to hold the largest queue that is sorted
+    if (BlockA[block].size > sort_scratch_size)
+    {
+        free(sort_scratch);
+        sort_scratch = (TriToRaster*)malloc(sizeof(TriToRaster) * BlockA[block].size);
+        if (!sort_scratch)
+        {
+            show_error("Failed to allocate queue sort scratch");
+        }
+        sort_scratch_size = BlockA[block].size;
+    }
 }
 
 // Empty Queues
@@ -110,10 +186,25 @@ void EmptyQueue(const uint32_t block)
 // Put a triangle on the queue
 uint32_t QueueTriangle(const TriToRaster triangle, const uint32_t block)
 {
+    PROFILE_SCOPE(PROF_QUEUE);
     // sizeof(triangle) is >70  bytes with multiple elements of the struct
     // Put the passed triangle into the memory space as if an array
     // It's inefficient as tiles pass a matrix that's the same many times...
     BlockA[block].itemptr[BlockA[block].count] = triangle;
+    // Odd queues hold the trivially accepted tiles that need no edge checks
+    bool textured;
+    BlockA[block].itemptr[BlockA[block].count].kernel = ChooseKernel(triangle, block & 0x01, &textured);
+    BlockA[block].itemptr[BlockA[block].count].cost_class = (textured ? COST_CLASS_TEXTURED : 0) + ((block & 0x01) ? COST_CLASS_TILE : 0);
+    if (cost_model_enabled) CostModelQueued(BlockA[block].itemptr[BlockA[block].count], block >> 1); // Blocks 0 and 1 are list 0
+
+    if (BlockA[block].sort_mode != SORT_OFF)
+    {
+        // The nearest of the three vertices gives the key, clamped to the depth range in use
+        // and scaled so that 16 bits cover zero to farPlane
+        const float key_scale = 65535.0f / farPlane;
+        const float nearest = std::min(triangle.clip_zs.x, std::min(triangle.clip_zs.y, triangle.clip_zs.z));
+        BlockA[block].itemptr[BlockA[block].count].depth_key = (uint16_t)(std::clamp(nearest, 0.0f, farPlane) * key_scale);
+    }
 
     // Increment the counter
     BlockA[block].count++;
@@ -130,27 +221,105 @@ uint32_t QueueTriangle(const TriToRaster triangle, const uint32_t block)
         return(pixel_estimate);
 }
 
+// Sort a queue front-to-back on depth_key so that nearer primitives are rasterised first and
+// the depth test then rejects hidden pixels before any texture or shading work is done.
+// An LSD radix sort of two 8 bit passes moves the items into the scratch area and back
+// again, so the result finishes in the queue's own memory and the sort is stable.
+void SortQueue(const uint32_t block)
+{
+    const uint32_t count = BlockA[block].count;
+    if (count < 2) return; // Nothing to sort
+
+    TriToRaster * const items = BlockA[block].itemptr;
+
+    // Histogram both bytes of the key in one read of the queue
+    uint32_t low_start[256] = {0};
+    uint32_t high_start[256] = {0};
+    for (uint32_t i = 0; i < count; i++)
+    {
+        low_start[items[i].depth_key & 0xff]++;
+        high_start[items[i].depth_key >> 8]++;
+    }
+
+    // Convert the counts to the starting position of each bucket
+    uint32_t low_total = 0, high_total = 0;
+    for (uint32_t bucket = 0; bucket < 256; bucket++)
+    {
+        const uint32_t low_count = low_start[bucket];
+        const uint32_t high_count = high_start[bucket];
+        low_start[bucket] = low_total;
+        high_start[bucket] = high_total;
+        low_total += low_count;
+        high_total += high_count;
+    }
+
+    // Low byte from the queue into scratch, then high byte from scratch back into the queue
+    for (uint32_t i = 0; i < count; i++)
+    {
+        sort_scratch[low_start[items[i].depth_key & 0xff]++] = items[i];
+    }
+    for (uint32_t i = 0; i < count; i++)
+    {
+        items[high_start[sort_scratch[i].depth_key >> 8]++] = sort_scratch[i];
+    }
+} // End of SortQueue
+
 // Send all of the queued triangles or tiles to the rasteriser
 // Use block to choose RasteriseBox or NotRasteriseBox such that
 // an odd block goes to NotRasteriseBox
 void SendQueue(const uint32_t block)
 {
     // Loop through the queue items, the order doesn't matter as pixels
-    // placed based on z depth
+    // placed based on z depth, but sorting them front-to-back saves shading hidden pixels
     if (BlockA[block].count == 0) return; // Quit immediately if an empty queue
+    TRACE_SCOPE(TRACE_RASTER_TASK, (block & 0x01) ? TRACE_TILES : TRACE_TRIANGLES);
+
+    Sort_tracked & report = sort_report[block & 0x01];
+    const bool sort_this_frame = (BlockA[block].sort_mode == SORT_ON) ||
+                                 ((BlockA[block].sort_mode == SORT_ALTERNATE) && (sort_frame & 0x01));
+    // Times are only kept for queues that may be sorted, to compare the frames with and without
+    const bool timed = (BlockA[block].sort_mode != SORT_OFF);
+    int64_t start_time = timed ? esp_timer_get_time() : 0;
+    if (sort_this_frame)
+    {
+        SortQueue(block);
+        const int64_t sorted_time = esp_timer_get_time();
+        report.sort_us += (uint32_t)(sorted_time - start_time);
+        start_time = sorted_time;
+    }
+
     for (uint32_t cnt = 0; cnt < BlockA[block].count; cnt++)
     {
-        TriToRaster this_tri = BlockA[block].itemptr[cnt];
-        if (block & 0x01) // test bit zero for oddness
+        // The kernel was chosen when queued, the odd blocks having NotRasteriseBox's tile kernels
+        const TriToRaster & this_tri = BlockA[block].itemptr[cnt];
+        if (cost_model_enabled || PROFILE_ON)
+        {
+            // The cycle counter is cheap enough to read around every primitive
+            const uint32_t before = esp_cpu_get_cycle_count();
+            raster_kernels[this_tri.kernel](this_tri);
+            const uint32_t cycles = esp_cpu_get_cycle_count() - before;
+            if (cost_model_enabled) CostModelSample(this_tri, cycles);
+            PROFILE_ADD(PROF_KERNEL_FLAT + this_tri.cost_class, cycles);
+        }
+        else raster_kernels[this_tri.kernel](this_tri);
+    }
+    //std::cout << "Triangle queue size in " << block << " is " << BlockA[block].count << "\n";
+
+    // Only the raster part is timed here, sorting was recorded above
+    if (timed)
+    {
+        const uint32_t raster_time = (uint32_t)(esp_timer_get_time() - start_time);
+        if (sort_this_frame)
         {
-            NotRasteriseBox(this_tri);
+            report.sorted_frames++;
+            report.sorted_raster_us += raster_time;
         }
         else
         {
-            RasteriseBox(this_tri);
+            report.unsorted_frames++;
+            report.unsorted_raster_us += raster_time;
         }
     }
-    //std::cout << "Triangle queue size in " << block << " is " << BlockA[block].count << "\n";
     
     if (BlockA[block].count > max_raster_buf[block]) max_raster_buf[block] = BlockA[block].count; // track buffer usage
 
@@ -158,6 +327,48 @@ void SendQueue(const uint32_t block)
     //BlockA[block].count = 0; //reset queue counter at the end
 }
 
+// Log the average sorting and raster times per frame since the last call and reset them
+// Called from the once per second tracker so only integer arithmetic is used
+void ReportQueueSort()
+{
+    static const char *TAG = "QueueSort";
+    const char * const queue_names[2] = {"triangle", "tile"};
+
+    for (uint32_t q = 0; q < 2; q++)
+    {
+        Sort_tracked & report = sort_report[q];
+        if (report.sorted_frames == 0 && report.unsorted_frames == 0) continue; // Not sorted at all
+
+        const uint32_t sort_avg = report.sorted_frames ? report.sort_us / report.sorted_frames : 0;
+        const uint32_t sorted_avg = report.sorted_frames ? report.sorted_raster_us / report.sorted_frames : 0;
+        if (report.unsorted_frames)
+        {
+            // SORT_ALTERNATE gives both figures so the saving can be shown directly
+            const uint32_t unsorted_avg = report.unsorted_raster_us / report.unsorted_frames;
+            ESP_LOGI(TAG, "%s queue sort %dus raster sorted %dus unsorted %dus saving %dus",
+                queue_names[q], (int)sort_avg, (int)sorted_avg, (int)unsorted_avg, (int)unsorted_avg - (int)sorted_avg - (int)sort_avg);
+        }
+        else ESP_LOGI(TAG, "%s queue sort %dus raster %dus", queue_names[q], (int)sort_avg, (int)sorted_avg);
+
+        report = {0, 0, 0, 0, 0};
+    }
+} // End of ReportQueueSort
+
+// Log the high-water mark of each queue against its size and reset them
+// Called from the once per second tracker so only integer arithmetic is used
+void ReportQueueUse()
+{
+    static const char *TAG = "QueueUse";
+
+    for (uint32_t block = 0; block < 4; block++)
+    {
+        if (BlockA[block].size == 0) continue; // Not made
+        ESP_LOGI(TAG, "Queue %d most %d of %d, %d%%", (int)block, (int)max_raster_buf[block],
+            (int)BlockA[block].size, (int)(max_raster_buf[block] * 100 / BlockA[block].size));
+        max_raster_buf[block] = 0;
+    }
+} // End of ReportQueueUse
+
 // Send all of the queued triangles or tiles to be checked for an impact
 // Use block to choose whether to edge check or not such that
 // an odd block goes to simply checking the bounding box
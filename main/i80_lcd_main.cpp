@@ -41,6 +41,10 @@
 #include "ParseWorld.h"
 #include "TimeTracker.h"
 #include "EventManager.h"
+#include "ImpostorCache.h"
+#include "HorizonPanorama.h"
+#include "Benchmark.h"
+#include "RenderCheck.h"
 
 #define LO_PLAIN 0 // A static world 
 #define LO_FLIP 1  // Flip book with some sets of vertices 
@@ -73,6 +77,9 @@ uint16_t * frame_buffer_B;
 
 uint16_t * overlay_buffer; // For 2D operations
 
+// The view port chosen in menuconfig is drawn at the top left of the panel
+static_assert((g_scWidth <= EXAMPLE_LCD_H_RES) && (g_scHeight <= EXAMPLE_LCD_V_RES), "View port doesn't fit the panel in lcd_setup.h");
+
 esp_lcd_panel_handle_t panel_handle = NULL;
 
 bool flipped = true;
@@ -96,13 +103,17 @@ extern "C" void app_main(void)
     if ( pix == NULL) assert("malloc for full screen buffer failed");
 
     // Make frame buffers
+    // Internal RAM is fastest but the buffers for a larger view port may not fit so PSRAM is the fallback
     frame_buffer_A = (uint16_t *)heap_caps_malloc(sizeof(uint16_t) * g_scWidth * g_scHeight , MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA | MALLOC_CAP_32BIT);
+    if ( frame_buffer_A == NULL) frame_buffer_A = (uint16_t *)heap_caps_aligned_alloc(EXAMPLE_PSRAM_DATA_ALIGNMENT, sizeof(uint16_t) * g_scWidth * g_scHeight , MALLOC_CAP_SPIRAM | MALLOC_CAP_DMA);
     if ( frame_buffer_A == NULL) assert("malloc failed for frame_buffer_A");
 
     frame_buffer_B = (uint16_t *)heap_caps_malloc(sizeof(uint16_t) * g_scWidth * g_scHeight , MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA | MALLOC_CAP_32BIT);
+    if ( frame_buffer_B == NULL) frame_buffer_B = (uint16_t *)heap_caps_aligned_alloc(EXAMPLE_PSRAM_DATA_ALIGNMENT, sizeof(uint16_t) * g_scWidth * g_scHeight , MALLOC_CAP_SPIRAM | MALLOC_CAP_DMA);
     if ( frame_buffer_B == NULL) assert("malloc failed for frame_buffer_B");
 
     overlay_buffer = (uint16_t *)heap_caps_malloc(sizeof(uint16_t) * g_scWidth * g_scHeight , MALLOC_CAP_INTERNAL | MALLOC_CAP_32BIT);
+    if ( overlay_buffer == NULL) overlay_buffer = (uint16_t *)heap_caps_malloc(sizeof(uint16_t) * g_scWidth * g_scHeight , MALLOC_CAP_SPIRAM);
     if ( overlay_buffer == NULL) assert("malloc failed for overlay_buffer");
 
     // Attempt to create the event group  - before DMA callback is invoked
@@ -153,6 +164,7 @@ extern "C" void app_main(void)
 
     ESP_LOGI(TAG,"Making depth buffers and queues");
     MakeDepthBuffer();
+    ImpostorSetup(); // Image cache for distant chunks
 
     // The queues need to allow tiles to be sent to both queues so they have 
     // more spaces than even though chunks are sent.
@@ -164,6 +176,14 @@ extern "C" void app_main(void)
     MakeQueue(6000, 2); // To permit pingpong in dual core
     MakeQueue(5000, 3);
 
+    // Front-to-back sorting of the triangle and tile queues is chosen in menuconfig, pingpong pairs match
+    // SORT_ALTERNATE reports raster times with and without the sort to decide on a given world
+    // Any mode other than SORT_OFF allocates a scratch area the size of the largest sorted queue
+    SetQueueSort(0, SORT_TRIANGLES);
+    SetQueueSort(2, SORT_TRIANGLES);
+    SetQueueSort(1, SORT_TILES);
+    SetQueueSort(3, SORT_TILES);
+
     ProjectionMatrix(); // Make the projection/perspective matrix for triangle rendering
 
     ESP_LOGI(TAG,"Finding partition for textures and mapping memmory");
@@ -226,6 +246,13 @@ extern "C" void app_main(void)
     // Uses a ragged array to give offsets of world layouts in the partition
     ParseWorld ( w_ptr , texture_map_ptr );
 
+    // Draw the distant world into panoramas for the background, needs the world and projection
+    HorizonSetup();
+
+    // Time the kernels before the tasks start, if configured, which holds the title screen for a few seconds
+    RunBenchmarks(eye, direction);
+    RunRenderCheck(eye, direction);
+
     // Use the partition pointers to read the ROM world descriptors into a
     // structure of pointers, calculating the values from offsets for each case    
     //ReadWorld(w_map_ptr , world_header_ptr , texture_map_ptr);
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stdint.h>
+#include "geometry.h"
+
+// Times the renderer's kernels on the world and on synthetic walls of triangles as the game starts,
+// enabled with Amaze renderer > Benchmark kernels at start up in menuconfig, see Benchmark.cpp
+void RunBenchmarks(const Vec3f eye, const Vec3f direction);
@@ -8,6 +8,9 @@
 #define CLIP_TA 1 // totally accept and applied a bounding box as it's inside frustrum
 #define CLIP_MC 2 // triangle exits frustrum and so a bounding box of the whole screen is given which is then rasterised in tiles
 
+// Outcomes of the faces checked, see Check_tracked
+extern Check_tracked check_report;
+
 void ProjectionMatrix();
 
 // Checks every face and transforms prior to putting into rasteriser queue
@@ -20,5 +23,5 @@ float edge_function(const Vec3f a, const Vec3f b, const Vec3f p);
 float BaseTriangles(const Vec3f eye, const Vec3f direction, const uint32_t this_chunk, const WorldLayout* layo_ptr);
 
 // Calculated face shading based on normal and lighting
-void MakeShade(uint32_t idx, const Vec3f eye, const Vec3f direction, const WorldLayout* layo_ptr, Shade_params* surface_shade);
+void MakeShade(uint32_t idx, const Vec3f eye, const Vec3f direction, const WorldLayout* layo_ptr, const uint32_t chunk, Shade_params* surface_shade);
 
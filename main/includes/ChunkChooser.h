@@ -14,6 +14,8 @@ Vec2i find_chunk(const Vec3f location, const ChunkArr& chunk_param);
 
 uint32_t chunk_index(const Vec2i chunk, const ChunkArr& chunk_param);
 
+bool chunk_visible(const Vec2i eye_chunk, const uint32_t chosen_chunk, const WorldLayout* layo_ptr);
+
 uint32_t ChunkChooser(const Vec3f eye, Vec3f direction, const bool eye_moved, const WorldLayout* layo_ptr);
 
 uint32_t IndexChunkChooser(const Vec3f eye, Vec3f direction, uint32_t index, const WorldLayout* layo_ptr);
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdint.h>
+#include "structures.h"
+
+// Predicts the raster time of the frame being built from what has been queued so far, so that
+// ShowWorld stops adding chunks when the raster core will be busy for the frame rather than when
+// a count of bounding box pixels is reached. The costs are measured on the raster core as it runs.
+#define COST_CLASSES 4          // Flat and textured triangles, then flat and textured tiles
+#define COST_CLASS_TEXTURED 1   // Added to the class for texture mapped primitives
+#define COST_CLASS_TILE 2       // Added for trivially accepted tiles from the odd queues
+
+extern bool cost_model_enabled;
+
+// The last frame rasterised, kept for tuning
+extern uint32_t cost_predicted_us;
+extern uint32_t cost_actual_us;
+extern uint32_t cost_textured_percent; // Share of the kernel time that was in textured classes
+
+void CostModelNewFrame(const uint32_t list);
+
+void CostModelQueued(const TriToRaster & tri, const uint32_t list);
+
+bool CostModelUnderBudget(const uint32_t list);
+
+void CostModelSample(const TriToRaster & tri, const uint32_t cycles);
+
+void CostModelCalibrate(const uint32_t list);
+
+void ReportCostModel();
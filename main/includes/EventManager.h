@@ -27,6 +27,9 @@
 #define EVNT_FACES      0x20000000
     #define EF_DELETE   0x00100000  // Delete all faces with the exact same event code
 
+#define EVNT_RENDER     0x40000000  // Hints to the renderer rather than game play actions
+    #define ER_OCCLUDER 0x00010000  // Faces are solid walls that should hide chunks behind them
+
 #include <stdint.h>
 #include "structures.h"
 
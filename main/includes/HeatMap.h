@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include "globals.h"
+#include "PixelSimd.h"
+
+// A debug view of where the raster kernels spend their pixel work, enabled with Amaze renderer >
+// Overdraw and cost heat map in menuconfig. Holding A and B together steps through the views and
+// the frame is replaced by false colour before it is sent, see HeatMap.cpp.
+// When disabled nothing is added to the kernels.
+#ifdef CONFIG_AMAZE_HEAT_MAP
+#define HEAT_MAP_ON 1
+#else
+#define HEAT_MAP_ON 0
+#endif
+
+enum Heat_mode : uint32_t
+{
+    HEAT_OFF,       // The rendered image
+    HEAT_OVERDRAW,  // Pixels written at each screen pixel
+    HEAT_COST,      // Kernel cycles spent at each screen pixel
+    HEAT_MODES
+};
+
+#if HEAT_MAP_ON
+
+#include "esp_cpu.h"
+
+extern uint32_t heat_raster_mode; // The view of the frame being rasterised
+extern uint16_t * heat_buffer;
+
+inline uint32_t HeatTicks() { return (esp_cpu_get_cycle_count()); }
+
+// Adds a quad of the kernels to the heat buffer, a write to each pixel that passed for overdraw or
+// the cycles since start shared between the pixels covered for cost. Sums stop at the top.
+template <typename Mask>
+inline void HeatQuad(const uint32_t index, const Mask covered, const Mask passed, const uint32_t lanes, const uint32_t start)
+{
+    uint32_t covered_count = 0;
+    for (uint32_t k = 0; k < lanes; k++) if (Pixel::QuadLane(covered, k)) covered_count++;
+    const uint32_t cycles = (HeatTicks() - start) / std::max(covered_count, 1u);
+
+    for (uint32_t k = 0; k < lanes; k++)
+    {
+        const bool counted = (heat_raster_mode == HEAT_OVERDRAW) ? Pixel::QuadLane(passed, k) : Pixel::QuadLane(covered, k);
+        if (!counted) continue;
+        const uint32_t sum = heat_buffer[index + k] + ((heat_raster_mode == HEAT_OVERDRAW) ? 1 : cycles);
+        heat_buffer[index + k] = (uint16_t)std::min(sum, (uint32_t)UINT16_MAX);
+    }
+}
+
+// As HeatQuad() for one pixel of the per-pixel kernels, which is always covered
+inline void HeatPixel(const uint32_t index, const bool passed, const uint32_t start)
+{
+    if ((heat_raster_mode == HEAT_OVERDRAW) && !passed) return;
+    const uint32_t sum = heat_buffer[index] + ((heat_raster_mode == HEAT_OVERDRAW) ? 1 : (HeatTicks() - start));
+    heat_buffer[index] = (uint16_t)std::min(sum, (uint32_t)UINT16_MAX);
+}
+
+#endif
+
+void HeatMapControl(const bool held);
+
+void HeatMapNewFrame();
+
+void HeatMapFrame(uint16_t * frame_buffer, const uint32_t list);
+
+void ReportHeatMap();
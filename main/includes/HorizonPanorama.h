@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+#include "geometry.h"
+#include "structures.h"
+
+// A cylindrical image of the world beyond the chunk sequence's reach, made at startup
+// from a few reference positions and used as the background instead of the fog colour
+#define PANO_WIDTH (g_scWidth * 6) // Columns for 360 degrees, six screen widths at a 60 degree FOV
+#define PANO_HEIGHT g_scHeight  // Rows, the view only turns about the vertical axis
+#define PANO_GRID 2             // Reference positions in each direction across the world
+
+extern bool horizon_enabled;
+
+void HorizonSetup();
+
+void HorizonRedraw();
+
+void HorizonNewFrame(const Vec3f eye, const Vec3f direction);
+
+bool HorizonChunkBeyond(const Vec3f eye, const Vec3f direction, const WorldLayout* layo_ptr, const uint32_t this_chunk);
+
+bool HorizonClearFrame(uint16_t * frame_buffer, const uint32_t list);
+
+bool HorizonSpan(uint16_t * out, const uint32_t list, const uint32_t x, const uint32_t y, const uint32_t count);
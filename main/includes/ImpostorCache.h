@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+#include "geometry.h"
+#include "structures.h"
+
+// Distant chunks can be replaced by a small image of them, made from the viewpoint at the time,
+// which is drawn as a single quad until the view of the chunk changes too much
+#define IMPOSTOR_SIZE 32       // Texels in each direction of an impostor image
+#define IMPOSTOR_ENTRIES 16    // Images kept, the least recently used is replaced
+
+extern bool impostors_enabled;
+
+void ImpostorSetup();
+
+void ImpostorNewFrame(const Vec3f eye, const Vec3f direction);
+
+bool ImpostorDrawChunk(const Vec3f eye, const Vec3f direction, const WorldLayout* layo_ptr, const uint32_t this_chunk);
+
+void ImpostorFlush();
+
+void SendImpostors(const uint32_t list);
+
+void ReportImpostors();
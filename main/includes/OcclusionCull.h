@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+#include "geometry.h"
+#include "structures.h"
+#include "globals.h"
+
+// The occlusion buffer is a coarse depth map of the screen, each cell holding the furthest
+// depth of an occluder that completely covers it
+#define OCC_CELL (g_xTile / 2) // Pixels across a cell, 4x4 at 128x128 so 32 cells each way
+#define OCC_SIZE_X (g_scWidth / OCC_CELL)
+#define OCC_SIZE_Y (g_scHeight / OCC_CELL)
+
+// How culling is applied, held in occlusion_mode
+#define OCCLUSION_OFF 0         // Every chunk from the sequence is sent to CheckTriangles
+#define OCCLUSION_ON 1          // Hidden chunks are skipped
+#define OCCLUSION_ALTERNATE 2   // Cull on alternate frames and report frame times of each
+
+extern uint32_t occlusion_mode;
+
+// Set to also cull against the previous frame's depth buffer, see OcclusionCull.cpp
+extern bool occlusion_temporal;
+
+void OcclusionCapturePrevious();
+
+void OcclusionNewFrame(const Vec3f eye, const Vec3f direction);
+
+void OcclusionSequenceStep(const uint32_t step);
+
+bool OcclusionIsOccluder(const TriToRaster & tri);
+
+void OcclusionAddOccluder(const TriToRaster & tri);
+
+bool OcclusionTestChunk(const WorldLayout* layo_ptr, const uint32_t this_chunk);
+
+bool OcclusionTestTriangle(const TriToRaster & tri);
+
+void OcclusionFrameTime(const uint32_t frame_time);
+
+void ReportOcclusion();
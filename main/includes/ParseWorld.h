@@ -10,3 +10,5 @@
 void ParseWorld(const void * w_ptr , const void * texture_map_ptr);
 
 WorldLayout ReadWorld(const void * w_map_ptr , const void * map_ptr);
+
+void ReadPVS(const void * pvs_ptr, WorldLayout * layo_ptr);
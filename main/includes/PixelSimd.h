@@ -0,0 +1,228 @@
+#pragma once
+
+#include <stdint.h>
+
+// Four pixels at a time for the raster kernels: edge evaluation, 1/w and z/w interpolation,
+// the depth compare and select, and packing to rgb565.
+// Each backend is a namespace with the same functions so a host build can include two and
+// compare them, the scalar one is the reference that the others must match bit for bit.
+// Pixel:: is the one chosen by PIXEL_SIMD.
+#define PIXEL_SIMD_SCALAR 0  // Plain C++ on four element arrays
+#define PIXEL_SIMD_VECTOR 1  // GCC vector extensions, SSE or NEON on a host
+#define PIXEL_SIMD_PIE 2     // The ESP32-S3 PIE vector unit
+
+#ifndef PIXEL_SIMD
+#if defined(__XTENSA__)
+#define PIXEL_SIMD PIXEL_SIMD_SCALAR // Generic vectors would only be split back into scalar code
+#else
+#define PIXEL_SIMD PIXEL_SIMD_VECTOR
+#endif
+#endif
+
+namespace PixelScalar
+{
+struct quad_f { float v[4]; };      // Four floats, one per pixel
+struct quad_i { int32_t v[4]; };    // Masks of -1 or 0, and integer depth keys
+struct quad_u { uint32_t v[4]; };   // Colours
+
+inline float QuadLane(const quad_f q, const uint32_t k) { return (q.v[k]); }
+inline int32_t QuadLane(const quad_i q, const uint32_t k) { return (q.v[k]); }
+inline uint32_t QuadLane(const quad_u q, const uint32_t k) { return (q.v[k]); }
+inline void QuadSetLane(quad_f & q, const uint32_t k, const float value) { q.v[k] = value; }
+inline void QuadSetLane(quad_i & q, const uint32_t k, const int32_t value) { q.v[k] = value; }
+inline void QuadSetLane(quad_u & q, const uint32_t k, const uint32_t value) { q.v[k] = value; }
+
+// Values of an incrementally interpolated function at four pixels along x
+inline quad_f QuadRamp(const float base, const float step)
+{
+    quad_f q;
+    for (uint32_t k = 0; k < 4; k++) q.v[k] = base + step * (float)k;
+    return (q);
+}
+
+// All lanes below count set, for the end of a row
+inline quad_i QuadLaneMask(const uint32_t count)
+{
+    quad_i q;
+    for (uint32_t k = 0; k < 4; k++) q.v[k] = (k < count) ? -1 : 0;
+    return (q);
+}
+
+inline quad_i QuadAnd(const quad_i a, const quad_i b)
+{
+    quad_i q;
+    for (uint32_t k = 0; k < 4; k++) q.v[k] = a.v[k] & b.v[k];
+    return (q);
+}
+
+inline bool QuadAny(const quad_i mask) { return ((mask.v[0] | mask.v[1] | mask.v[2] | mask.v[3]) != 0); }
+
+// As CheckEdgeFunction(), a zero result is inside or not depending on the edge
+inline quad_i QuadEdgeMask(const quad_f result, const bool zero_inside)
+{
+    quad_i q;
+    for (uint32_t k = 0; k < 4; k++) q.v[k] = ((result.v[k] > 0.0f) || ((result.v[k] == 0.0f) && zero_inside)) ? -1 : 0;
+    return (q);
+}
+
+// The depth of four pixels from the buffer, lanes beyond count aren't read
+inline quad_i QuadLoadDepth(const uint16_t * depth, const uint32_t count)
+{
+    quad_i q = { { 0, 0, 0, 0 } };
+    for (uint32_t k = 0; k < count; k++) q.v[k] = depth[k];
+    return (q);
+}
+inline quad_f QuadLoadDepth(const float * depth, const uint32_t count)
+{
+    quad_f q = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+    for (uint32_t k = 0; k < count; k++) q.v[k] = depth[k];
+    return (q);
+}
+
+// Where the mask is set the stored value is replaced by the key in the frame's encoding
+inline void QuadStoreDepth(uint16_t * depth, const quad_i key, const quad_i mask, const int32_t base, const int32_t sign, const uint32_t count)
+{
+    for (uint32_t k = 0; k < count; k++) if (mask.v[k]) depth[k] = (uint16_t)(base + sign * key.v[k]);
+}
+inline void QuadStoreDepth(float * depth, const quad_f key, const quad_i mask, const float base, const float sign, const uint32_t count)
+{
+    for (uint32_t k = 0; k < count; k++) if (mask.v[k]) depth[k] = base + sign * key.v[k];
+}
+
+// Lanes where the key is no further than the stored depth, decoded as in DepthDecode()
+inline quad_i QuadDepthPass(const quad_i key, const quad_i stored, const int32_t base, const int32_t sign)
+{
+    quad_i q;
+    for (uint32_t k = 0; k < 4; k++) q.v[k] = (key.v[k] <= sign * (stored.v[k] - base)) ? -1 : 0;
+    return (q);
+}
+inline quad_i QuadDepthPass(const quad_f key, const quad_f stored, const float base, const float sign)
+{
+    quad_i q;
+    for (uint32_t k = 0; k < 4; k++) q.v[k] = (key.v[k] <= sign * (stored.v[k] - base)) ? -1 : 0;
+    return (q);
+}
+
+// Reciprocal depth keys, (near_inv - clamp(1/w)) * scale truncated as a cast would
+inline quad_i QuadKeyReciprocal(const quad_f oneOverW, const float low, const float high, const float near_inv, const float scale)
+{
+    quad_i q;
+    for (uint32_t k = 0; k < 4; k++)
+    {
+        const float clamped = (oneOverW.v[k] < low) ? low : ((oneOverW.v[k] > high) ? high : oneOverW.v[k]);
+        q.v[k] = (int32_t)((near_inv - clamped) * scale);
+    }
+    return (q);
+}
+
+// Mix four shaded rgb888 colours with fog by their shares and pack them to rgb565, as WritePixelMix()
+inline quad_u QuadPack565(const quad_u rgb888, const quad_u fog_depth, const uint32_t fog)
+{
+    quad_u q;
+    for (uint32_t k = 0; k < 4; k++)
+    {
+        const uint32_t fogged_rb = ((fog & 0x00ff00ff) * (255 - fog_depth.v[k])) + ((rgb888.v[k] & 0x00ff00ff) * fog_depth.v[k]);
+        const uint32_t fogged_g = ((fog & 0x0000ff00) * (255 - fog_depth.v[k])) + ((rgb888.v[k] & 0x0000ff00) * fog_depth.v[k]);
+        q.v[k] = ((fogged_rb >> 16) & 0xf800) | ((fogged_g >> 13) & 0x07e0) | ((fogged_rb >> 11) & 0x001f);
+    }
+    return (q);
+}
+} // End of namespace PixelScalar
+
+#if defined(__GNUC__)
+namespace PixelVector
+{
+typedef float quad_f __attribute__((vector_size(16)));
+typedef int32_t quad_i __attribute__((vector_size(16)));
+typedef uint32_t quad_u __attribute__((vector_size(16)));
+
+inline float QuadLane(const quad_f q, const uint32_t k) { return (q[k]); }
+inline int32_t QuadLane(const quad_i q, const uint32_t k) { return (q[k]); }
+inline uint32_t QuadLane(const quad_u q, const uint32_t k) { return (q[k]); }
+inline void QuadSetLane(quad_f & q, const uint32_t k, const float value) { q[k] = value; }
+inline void QuadSetLane(quad_i & q, const uint32_t k, const int32_t value) { q[k] = value; }
+inline void QuadSetLane(quad_u & q, const uint32_t k, const uint32_t value) { q[k] = value; }
+
+inline quad_f QuadRamp(const float base, const float step)
+{
+    const quad_f lane = { 0.0f, 1.0f, 2.0f, 3.0f };
+    return (base + step * lane);
+}
+
+inline quad_i QuadLaneMask(const uint32_t count)
+{
+    const quad_i lane = { 0, 1, 2, 3 };
+    return (lane < (int32_t)count);
+}
+
+inline quad_i QuadAnd(const quad_i a, const quad_i b) { return (a & b); }
+
+inline bool QuadAny(const quad_i mask) { return ((mask[0] | mask[1] | mask[2] | mask[3]) != 0); }
+
+inline quad_i QuadEdgeMask(const quad_f result, const bool zero_inside)
+{
+    const quad_i zero_mask = quad_i{ 0, 0, 0, 0 } - (int32_t)zero_inside;
+    return ((result > 0.0f) | ((result == 0.0f) & zero_mask));
+}
+
+// Lanes are gathered as a row may end before four pixels and the buffer may not be aligned
+inline quad_i QuadLoadDepth(const uint16_t * depth, const uint32_t count)
+{
+    quad_i q = { 0, 0, 0, 0 };
+    for (uint32_t k = 0; k < count; k++) q[k] = depth[k];
+    return (q);
+}
+inline quad_f QuadLoadDepth(const float * depth, const uint32_t count)
+{
+    quad_f q = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for (uint32_t k = 0; k < count; k++) q[k] = depth[k];
+    return (q);
+}
+
+inline void QuadStoreDepth(uint16_t * depth, const quad_i key, const quad_i mask, const int32_t base, const int32_t sign, const uint32_t count)
+{
+    const quad_i encoded = base + sign * key;
+    for (uint32_t k = 0; k < count; k++) if (mask[k]) depth[k] = (uint16_t)encoded[k];
+}
+inline void QuadStoreDepth(float * depth, const quad_f key, const quad_i mask, const float base, const float sign, const uint32_t count)
+{
+    const quad_f encoded = base + sign * key;
+    for (uint32_t k = 0; k < count; k++) if (mask[k]) depth[k] = encoded[k];
+}
+
+inline quad_i QuadDepthPass(const quad_i key, const quad_i stored, const int32_t base, const int32_t sign)
+{
+    return (key <= sign * (stored - base));
+}
+inline quad_i QuadDepthPass(const quad_f key, const quad_f stored, const float base, const float sign)
+{
+    return (key <= sign * (stored - base));
+}
+
+inline quad_i QuadKeyReciprocal(const quad_f oneOverW, const float low, const float high, const float near_inv, const float scale)
+{
+    quad_f clamped = oneOverW;
+    clamped = (clamped < low) ? low : clamped;
+    clamped = (clamped > high) ? high : clamped;
+    return (__builtin_convertvector((near_inv - clamped) * scale, quad_i));
+}
+
+inline quad_u QuadPack565(const quad_u rgb888, const quad_u fog_depth, const uint32_t fog)
+{
+    const quad_u clear = 255 - fog_depth;
+    const quad_u fogged_rb = ((fog & 0x00ff00ff) * clear) + ((rgb888 & 0x00ff00ff) * fog_depth);
+    const quad_u fogged_g = ((fog & 0x0000ff00) * clear) + ((rgb888 & 0x0000ff00) * fog_depth);
+    return (((fogged_rb >> 16) & 0xf800) | ((fogged_g >> 13) & 0x07e0) | ((fogged_rb >> 11) & 0x001f));
+}
+} // End of namespace PixelVector
+#endif
+
+#if PIXEL_SIMD == PIXEL_SIMD_SCALAR
+namespace Pixel = PixelScalar;
+#elif PIXEL_SIMD == PIXEL_SIMD_VECTOR
+namespace Pixel = PixelVector;
+#elif PIXEL_SIMD == PIXEL_SIMD_PIE
+// The PIE backend belongs here as namespace PixelPie with the functions above, written with the
+// S3's EE.* 128 bit instructions through inline assembly, and checked against PixelScalar
+#error "PIXEL_SIMD_PIE has no backend yet, use PIXEL_SIMD_SCALAR on the device"
+#endif
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdint.h>
+#include "globals.h"
+
+// Scoped timers for the stages of a frame, enabled with Amaze renderer > Profile frame stages in
+// menuconfig. When disabled the macros are empty so nothing is compiled in.
+// Stage times are summed over a frame and the timer task logs min, avg, max and p99 per second.
+#ifdef CONFIG_AMAZE_PROFILE
+#define PROFILE_ON 1
+#else
+#define PROFILE_ON 0
+#endif
+
+enum Profile_stage : uint32_t
+{
+    PROF_CHUNK_CHOOSE,      // ChunkChooser and IndexChunkChooser
+    PROF_BASE_TRIANGLES,    // Finding the ground height under the eye
+    PROF_VERTEX,            // VS and the viewport transform of each face
+    PROF_SETUP,             // Backface test, shading and the edge and interpolation set up
+    PROF_CLIP,              // ExecuteFullTriangleClipping
+    PROF_QUEUE,             // QueueTriangle, including kernel choice
+    PROF_KERNEL_FLAT,       // Raster kernels by cost class, see CostModel.h
+    PROF_KERNEL_TEXTURED,
+    PROF_KERNEL_FLAT_TILE,
+    PROF_KERNEL_TEXTURED_TILE,
+    PROF_CLEAR,             // Clears, or the resolve and upscale that replace them
+    PROF_RASTER_WAIT,       // Core 0 waiting for RASTER_DONE
+    PROF_DMA_WAIT,          // Core 0 waiting for CLEAR_READY as the last frame is sent
+    PROF_EVENTS,            // Handling of each game play event
+    PROF_STAGES
+};
+
+#if PROFILE_ON
+
+#if defined(ESP_PLATFORM)
+#include "esp_cpu.h"
+#ifdef CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ
+#define PROFILE_TICKS_PER_US CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ
+#else
+#define PROFILE_TICKS_PER_US 240
+#endif
+inline uint32_t ProfileTicks() { return (esp_cpu_get_cycle_count()); }
+#else
+// On a host the monotonic clock in nanoseconds stands in for the cycle counter
+#include <time.h>
+#define PROFILE_TICKS_PER_US 1000
+inline uint32_t ProfileTicks()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint32_t)(now.tv_sec * 1000000000ull + now.tv_nsec));
+}
+#endif
+
+void ProfileAdd(const uint32_t stage, const uint32_t ticks);
+
+void ProfileEndFrame();
+
+// Adds the time from its construction to the end of the enclosing block to a stage
+class Profile_scope
+{
+public:
+    explicit Profile_scope(const uint32_t stage) : stage(stage), start(ProfileTicks()) {}
+    ~Profile_scope() { ProfileAdd(stage, ProfileTicks() - start); }
+private:
+    const uint32_t stage;
+    const uint32_t start;
+};
+
+#define PROFILE_JOIN(a, b) a##b
+#define PROFILE_NAME(line) PROFILE_JOIN(profile_scope_, line)
+#define PROFILE_SCOPE(stage) Profile_scope PROFILE_NAME(__LINE__)(stage)
+#define PROFILE_ADD(stage, ticks) ProfileAdd(stage, ticks)
+#define PROFILE_MARK(mark) const uint32_t mark = ProfileTicks() // For stages that don't fit a block
+#define PROFILE_SINCE(stage, mark) ProfileAdd(stage, ProfileTicks() - mark)
+#define PROFILE_END_FRAME() ProfileEndFrame()
+
+#else
+
+#define PROFILE_SCOPE(stage)
+#define PROFILE_ADD(stage, ticks)
+#define PROFILE_MARK(mark)
+#define PROFILE_SINCE(stage, mark)
+#define PROFILE_END_FRAME()
+
+#endif
+
+void ReportProfile();
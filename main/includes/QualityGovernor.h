@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include "geometry.h"
+#include "structures.h"
+
+// Rendering settings that can be traded for frame time while running, grouped into knobs that each
+// have a ladder of levels with 0 the full quality, see QualityGovernor.cpp
+#define QUALITY_LEVELS 4
+
+// How the levels are chosen, held in quality_mode
+#define QUALITY_FIXED 0     // The levels in quality_fixed are used, so each knob can be timed
+#define QUALITY_GOVERNED 1  // Levels follow the frame time
+
+struct Quality_levels
+{
+    uint32_t texture;   // Distance and size below which texture images are used
+    uint32_t distance;  // Fog range, and so how far chunks are drawn when there's no panorama
+};
+
+struct Quality_params
+{
+    float texture_depth;        // Depth at which textures are disabled and base colour sent
+    float texture_min_triangle; // Bounding box sides a triangle needs to be textured, pixels
+    float texture_min_tile;     // The same for tiles, which are a known size so have a lower limit
+    float fog_start;            // Depth range over which pixels are mixed with fog
+    float fog_end;
+};
+
+extern uint32_t quality_mode;
+extern Quality_levels quality_fixed;
+
+// The settings for the frame being built on core 0
+extern Quality_params quality_build;
+
+void QualityNewFrame(const uint32_t frame_time, const uint32_t build_us, const uint32_t raster_us);
+
+void QualityRasterFrame(const uint32_t list);
+
+bool QualityChunkBeyond(const Vec3f eye, const Vec3f direction, const WorldLayout* layo_ptr, const uint32_t this_chunk);
+
+void ReportQuality();
@@ -1,27 +1,200 @@
 #pragma once
 #include <stdint.h>
+#include <algorithm>
 
 #include "globals.h"
 #include "geometry.h"
 #include "structures.h"
+#include "QualityGovernor.h"
+
+// Format of the depth buffer. The 16 bit formats halve it to 32KB so that it fits in internal
+// SRAM, linear spreads the precision evenly and reciprocal concentrates it near the viewer.
+// The reciprocal format is keyed on 1/w, which the rasteriser interpolates, so untextured
+// pixels are depth tested and fogged without a divide, where linear divides z/w by 1/w per pixel.
+// tools/DepthPrecision finds that on DiscWorld11 linear lets only 4 of the 1008 close overlapping
+// pairs of faces share a key before the 30m fog end, those under its 6.1mm step, where reciprocal
+// lets 220 do so from 6.2m with DEPTH_NEAR, or 307 from 4.0m starting at nearPlane, as its step
+// passes 6.1mm at 12m and is 40mm by 30m. Reciprocal is the default for the divide, linear suits
+// worlds with faces laid close over others, such as decals.
+#define DEPTH_FLOAT 0
+#define DEPTH_LINEAR16 1
+#define DEPTH_RECIPROCAL16 2
+#ifndef DEPTH_FORMAT // Host tools may build the others, chosen in menuconfig under Amaze renderer
+#if defined(CONFIG_AMAZE_DEPTH_FLOAT)
+#define DEPTH_FORMAT DEPTH_FLOAT
+#elif defined(CONFIG_AMAZE_DEPTH_LINEAR16)
+#define DEPTH_FORMAT DEPTH_LINEAR16
+#else
+#define DEPTH_FORMAT DEPTH_RECIPROCAL16
+#endif
+#endif
+
+#define DEPTH_FAR 200.0f     // Depth of a pixel that nothing has been drawn to
+// Reciprocal keys start here rather than at nearPlane, which would spend a fifth of the keys on
+// the first 0.5m and coarsen every step beyond it fivefold. Nearer pixels share key 0 and read back
+// as 0.5m. That is safe as the nearest depth that CheckCollide() finds only has to be inside
+// COLLISION_DISTANCE for ShowWorld to push the viewer back, which 0.5m still is, and the push repeats
+// each frame until clear. FindHitFace() compares DepthQuantise() depths, so ties resolve as drawn.
+#define DEPTH_NEAR 0.5f
+#define DEPTH_TILE 8         // Pixels on each side of a tile tracked for the end of frame resolve
+#define DEPTH_TILES ((g_scWidth / DEPTH_TILE) * (g_scHeight / DEPTH_TILE))
+
+// Keys of the 16 bit formats, both are always defined so that host tools can compare them
+#define DEPTH_KEY16_FAR 32767 // Half the range as clear-free frames store the key or twice this less the key
+
+inline int32_t DepthKeyLinear16(const float z)
+{
+    constexpr float scale = DEPTH_KEY16_FAR / DEPTH_FAR;
+    return ((int32_t)(std::clamp(z, 0.0f, DEPTH_FAR) * scale));
+}
+inline float DepthFromKeyLinear16(const int32_t key) { return (key * (DEPTH_FAR / DEPTH_KEY16_FAR)); }
+
+// Depths are the z of clip space after the divide by w, as the rasteriser interpolates z/w and 1/w,
+// which make_perspective() sets to DEPTH_Z_SCALE * w - DEPTH_Z_OFFSET, so this is the 1/w of a depth
+const float DEPTH_Z_SCALE = (farPlane + nearPlane) / (farPlane - nearPlane);
+const float DEPTH_Z_OFFSET = (2.0f * farPlane * nearPlane) / (farPlane - nearPlane);
+inline float DepthOneOverW(const float z) { return (DEPTH_Z_SCALE / (z + DEPTH_Z_OFFSET)); }
+
+// The key is a linear function of 1/w, zero at near and DEPTH_KEY16_FAR at DEPTH_FAR, and decodes to
+// the same depth as the other formats rather than to w, which is about 0.2m further
+inline int32_t DepthKeyReciprocal16(const float oneOverW, const float near = DEPTH_NEAR)
+{
+    const float range = DepthOneOverW(near) - DepthOneOverW(DEPTH_FAR);
+    const float scale = DEPTH_KEY16_FAR / range;
+    return ((int32_t)((DepthOneOverW(near) - std::clamp(oneOverW, DepthOneOverW(DEPTH_FAR), DepthOneOverW(near))) * scale));
+}
+inline float DepthFromKeyReciprocal16(const int32_t key, const float near = DEPTH_NEAR)
+{
+    const float range = DepthOneOverW(near) - DepthOneOverW(DEPTH_FAR);
+    return (DEPTH_Z_SCALE / (DepthOneOverW(near) - key * (range / DEPTH_KEY16_FAR)) - DEPTH_Z_OFFSET);
+}
+
+// A depth is tested and stored as a key that increases with distance, DEPTH_KEY_FAR being DEPTH_FAR
+#if DEPTH_FORMAT == DEPTH_FLOAT
+typedef float depth_t;
+typedef float depth_key_t;
+#define DEPTH_KEY_FAR DEPTH_FAR
+
+inline depth_key_t DepthKey(const float z) { return (z); }
+inline float DepthFromKey(const depth_key_t key) { return (key); }
+#else
+typedef uint16_t depth_t;
+typedef int32_t depth_key_t;
+#define DEPTH_KEY_FAR DEPTH_KEY16_FAR
+
+#if DEPTH_FORMAT == DEPTH_LINEAR16
+inline depth_key_t DepthKey(const float z) { return (DepthKeyLinear16(z)); }
+inline float DepthFromKey(const depth_key_t key) { return (DepthFromKeyLinear16(key)); }
+#else
+inline depth_key_t DepthKeyW(const float oneOverW) { return (DepthKeyReciprocal16(oneOverW)); }
+inline depth_key_t DepthKey(const float z) { return (DepthKeyW(DepthOneOverW(z))); }
+inline float DepthFromKey(const depth_key_t key) { return (DepthFromKeyReciprocal16(key)); }
+#endif
+#endif
+
+// The key of a pixel from the interpolated 1/w and z/w
+#if DEPTH_FORMAT == DEPTH_RECIPROCAL16
+inline depth_key_t DepthKeyInterp(const float oneOverW, const float zOverW) { return (DepthKeyW(oneOverW)); }
+#else
+inline depth_key_t DepthKeyInterp(const float oneOverW, const float zOverW) { return (DepthKey(zOverW / oneOverW)); }
+#endif
+
+// Clear-free frames store depth_base + depth_sign * key with the sign swapping every frame,
+// so a value left from the previous frame always tests as further than anything drawn now
+extern bool clear_free_frames;
+extern depth_key_t depth_base;
+extern depth_key_t depth_sign;
+
+// True depth of a stored value, and the value to store for a depth, in the current frame's encoding
+inline float DepthDecode(const depth_t stored) { return (DepthFromKey(depth_sign * (stored - depth_base))); }
+inline depth_t DepthEncode(const float z) { return ((depth_t)(depth_base + depth_sign * DepthKey(z))); }
+
+// A depth as the buffer would hold it, so that hit tests agree with what was drawn
+inline float DepthQuantise(const float z) { return (DepthFromKey(DepthKey(z))); }
 
 void MakeDepthBuffer();
 
 void ClearDepthBuffer(float farPlane);
 
+void DepthNewFrame();
+
+void DepthTouchRect(const Rect2D & box);
+
+void ResolveFrame(uint16_t * frame_buffer, const uint32_t list);
+
+void ForgetFrameBackground(const uint32_t list);
+
+void ForgetFrameRows(const uint32_t list, const uint32_t first_row, const uint32_t last_row);
+
+void ReportClearFree();
+
 void CheckCollide(Near_pix * near);
 
 bool CheckEdgeFunction(const Vec3f& E, const float result);
 
+// The raster kernel family, indexed by KernelIndex() and called through the index kept in each queue item
+#define RASTER_KERNELS 8
+extern const Raster_kernel raster_kernels[RASTER_KERNELS];
+
+constexpr uint32_t KernelIndex(const bool edge_test, const bool textured, const bool fogged)
+{
+    return ((edge_test ? 0 : 4) + (textured ? 2 : 0) + (fogged ? 1 : 0));
+}
+
+// Variants of the raster kernel taken four pixels at a time, one bit each by KernelIndex(), the rest
+// take one pixel at a time. None is by default: on a host tools/PixelBench finds every variant slower
+// four at a time with either backend, 0.67x overall on DiscWorld11, and the device's figures from
+// Benchmark.cpp are needed before a variant is moved over
+#ifdef CONFIG_AMAZE_QUAD_KERNELS
+#define QUAD_KERNELS CONFIG_AMAZE_QUAD_KERNELS
+#else
+#define QUAD_KERNELS 0x00
+#endif
+
+uint32_t ChooseKernel(const TriToRaster & tri, const bool tile_accepted, bool * textured = nullptr);
+
+// Only built with CONFIG_AMAZE_BENCHMARK, for timing both forms of each kernel whatever QUAD_KERNELS chooses
+Raster_kernel KernelVariant(const bool edge_test, const bool textured, const bool fogged, const bool per_pixel = false);
+
 void RasteriseBox(const TriToRaster & tri);
 
 void NotRasteriseBox(const TriToRaster & tri);
 
 uint32_t spec_shade_pixel (const uint32_t rgb888, const Shade_params surface_shade);
 
+// Mix a shaded pixel with fog by the fog_depth share and place it in the frame as rgb565.
+// Here rather than in RasteriseBox.cpp so that it stays inline and tools/PixelTest can check it
+inline void WritePixelMix(const uint32_t frame_index, const uint32_t rgb888, const uint32_t fog_depth)
+{
+    // The background colour for clearing screen which will also be fog
+    extern const uint32_t fog;
+    extern uint16_t * frame_buffer_this;
+    
+    // Red and blue are mixed together in one word, each in 16 bits, and green on its own.
+    // A channel mix is at most 255 * 255 so can't reach the next channel
+    const uint32_t fog_rb = fog & 0x00ff00ff;
+    const uint32_t fog_g = fog & 0x0000ff00;
+
+    const uint32_t fogged_rb = (fog_rb * (255 - fog_depth)) + ((rgb888 & 0x00ff00ff) * fog_depth);
+    const uint32_t fogged_g = (fog_g * (255 - fog_depth)) + ((rgb888 & 0x0000ff00) * fog_depth);
+
+    // The top bits of each mix are the 565 channel, as was the shift to divide by 'a' in intmix
+    uint16_t rgb565 = ((fogged_rb >> 16) & 0b1111100000000000) | ((fogged_g >> 13) & 0b0000011111100000) | ((fogged_rb >> 11) & 0b0000000000011111);
+    
+    // Using ESP-IDF the DMA routine will do the byte swap so here can be standard pack to 565
+    // We have a pixel in 565 format so send it to the appropriate viewer
+    frame_buffer_this[frame_index] = rgb565;
+} // end of WritePixelMix
+
 void WritePixel2Fog888(const uint32_t frame_index, const uint32_t rgb888, const float depth);
 
-float FogFunction(const float depth); // end and start are set in the function
+void WritePixelFogW(const uint32_t frame_index, const uint32_t rgb888, const float oneOverW);
+
+void MakeFogTable();
+
+void SetRasterQuality(const Quality_params & params);
+
+float FogFunction(const float depth); // end and start are from the quality settings being rasterised
 
 uint32_t intmix(const uint32_t x, const uint32_t y, const uint32_t a);
 
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+#include "geometry.h"
+
+// Renders fixed views of the world as the game starts and compares coarse pixel and depth statistics
+// and the CheckTriangles counters against goldens, enabled with Amaze renderer > Check rendering
+// against goldens in menuconfig, see RenderCheck.cpp
+#define RENDER_POSES 6 // Views drawn, see render_poses in RenderCheck.cpp
+#define RENDER_CELLS 8 // Cells in each direction of the coarse images compared
+
+// What is compared for each view
+struct Render_golden
+{
+    uint32_t triangles;         // Check_tracked counts
+    uint32_t tiles_accepted;
+    uint32_t tiles_partial;
+    uint32_t tiles_rejected;
+    uint32_t pixels;            // Pixels written, found as depths nearer than DEPTH_FAR
+    uint8_t luma[RENDER_CELLS * RENDER_CELLS];  // Mean brightness of each cell 0 to 255
+    uint8_t depth[RENDER_CELLS * RENDER_CELLS]; // Mean depth key of each cell scaled to 0 to 255
+};
+
+void RunRenderCheck(const Vec3f eye, const Vec3f direction);
+
+// The steps of RunRenderCheck(), which the host test in tools/RenderTest also uses,
+// only built with CONFIG_AMAZE_RENDER_CHECK
+void RenderCheckSetup();
+
+void RenderCheckPose(const uint32_t pose, const Vec3f eye, const Vec3f direction);
+
+void RenderCheckMeasure(Render_golden & measured);
+
+void RenderCheckLog(const uint32_t pose, const Render_golden & measured);
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "RenderCheck.h"
+
+// Goldens for RenderCheck.cpp, recorded from DiscWorld11.bin. The cells are of the frames and depths
+// that the renderer drew before its optimisations, as in tools/RenderTest/DiscWorld11.golden, with the
+// counters of the present CheckTriangles, which that renderer didn't keep, and the depth cells as
+// keys of the default 16 bit reciprocal format.
+// After an intended change to the image, replace them with the entries that RenderCheck logs, or
+// those that tools/RenderTest logs when it records its own goldens, which it makes from the same run.
+#define RENDER_GOLDEN_WIDTH 128
+#define RENDER_GOLDEN_HEIGHT 128
+
+static const Render_golden render_goldens[RENDER_POSES] = {
+    // Pose 0
+    { 344, 54, 964, 25862, 12461,
+      { 48,48,47,42,45,48,46,32,48,48,43,37,42,48,41,28,45,46,44,37,44,47,46,30,39,39,43,37,40,40,39,33,38,38,39,40,43,41,36,32,49,49,49,49,49,47,26,24,44,49,50,50,50,32,24,24,24,24,29,35,36,24,24,24 },
+      { 255,255,254,249,252,255,254,242,255,255,251,245,250,255,250,242,252,252,251,248,252,254,253,244,248,247,247,246,247,246,245,242,246,245,244,244,243,242,241,240,232,232,232,232,232,232,232,232,217,217,217,217,217,217,217,217,201,201,201,201,201,201,201,201 },
+    },
+    // Pose 1
+    { 22, 80, 268, 5028, 10363,
+      { 42,42,46,48,48,48,48,48,42,42,44,48,48,48,48,48,42,42,44,48,48,48,48,48,42,42,44,48,48,48,48,48,36,36,37,38,38,38,38,38,24,24,24,24,24,24,24,24,24,24,24,24,24,24,24,24,24,24,24,24,24,24,24,24 },
+      { 251,252,254,255,255,255,255,255,251,251,253,255,255,255,255,255,251,251,253,255,255,255,255,255,251,251,253,255,255,255,255,255,247,247,248,248,248,248,248,248,232,232,232,232,232,232,232,232,217,217,217,217,217,217,217,217,201,201,201,201,201,201,201,201 },
+    },
+    // Pose 2
+    { 13, 110, 487, 8107, 16384,
+      { 42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,36,36,36,36,36,36,36,36,24,24,24,24,24,24,24,24,24,24,24,24,24,24,24,24,24,24,24,24,24,24,24,24 },
+      { 251,251,251,251,251,250,250,250,251,251,251,251,251,250,250,250,251,251,251,251,251,250,250,250,251,251,251,251,251,250,250,250,247,247,247,247,247,247,247,247,232,232,232,232,232,232,232,232,217,217,217,217,217,217,217,217,201,201,201,201,201,201,201,201 },
+    },
+    // Pose 3
+    { 32, 68, 260, 5048, 9022,
+      { 48,48,48,48,48,48,48,48,44,47,48,48,48,48,48,48,37,41,47,48,48,48,48,48,37,41,47,48,48,48,48,48,34,36,38,38,38,38,38,38,24,24,24,24,24,24,24,24,24,24,24,24,24,24,24,24,24,24,24,24,24,24,24,24 },
+      { 255,255,255,255,255,255,255,255,251,254,255,255,255,255,255,255,245,248,254,255,255,255,255,255,245,248,254,255,255,255,255,255,244,246,248,248,248,248,248,248,232,232,232,232,232,232,232,232,217,217,217,217,217,217,217,217,201,201,201,201,201,201,201,201 },
+    },
+    // Pose 4
+    { 647, 68, 895, 21565, 12701,
+      { 48,48,39,37,41,48,48,38,48,47,33,33,37,48,48,42,42,44,40,39,41,46,44,42,33,41,38,35,38,38,38,38,32,33,34,38,42,41,38,35,41,42,42,43,42,45,45,35,47,48,48,48,48,48,48,45,48,48,48,48,48,48,48,48 },
+      { 255,255,246,243,248,255,255,247,255,254,243,242,248,255,255,250,249,250,249,249,250,253,251,249,245,244,244,244,244,243,242,240,244,242,241,240,239,238,237,236,232,232,232,232,232,232,232,231,217,217,217,217,217,217,217,217,201,201,201,201,201,201,201,201 },
+    },
+    // Pose 5
+    { 43, 99, 303, 5998, 12332,
+      { 48,48,48,48,48,48,45,34,48,48,48,48,48,48,43,32,41,41,41,41,41,42,41,34,25,28,30,30,30,30,30,32,24,25,26,26,26,26,26,26,24,24,25,25,26,26,26,26,24,24,24,24,24,24,25,25,24,24,24,24,24,24,24,24 },
+      { 255,255,255,255,255,255,253,246,255,255,255,255,255,255,251,245,250,250,250,250,250,250,248,244,235,235,235,235,235,235,235,235,220,220,220,220,220,220,220,220,205,205,205,205,205,205,205,205,190,190,190,190,190,190,190,190,175,175,175,175,175,175,175,175 },
+    },
+};
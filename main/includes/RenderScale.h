@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+#include "globals.h"
+
+// The world can be rasterised at a lower resolution into the top left of the frame buffers and
+// then stretched to fill them, the size is chosen per frame to keep frames within MAX_FRAME_DURATION
+// Sizes are whole tiles of CheckTriangles, which are also whole tiles of the clear-free resolve
+#define RENDER_SIZES 5
+
+struct Render_size
+{
+    uint32_t width;
+    uint32_t height;
+};
+
+extern bool render_scale_enabled;
+
+// The size of the frame being built on core 0, as used by the screen mapping
+extern uint32_t render_width;
+extern uint32_t render_height;
+
+// The size each list was built at so the rasteriser core finishes it at the same size
+extern Render_size render_size[2];
+
+void RenderScaleNewFrame(const uint32_t frame_time);
+
+uint32_t RenderScaleBudget(const uint32_t full_budget);
+
+void UpscaleFrame(uint16_t * frame_buffer, const uint32_t list);
+
+void ReportRenderScale();
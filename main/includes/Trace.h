@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdint.h>
+#include "globals.h"
+
+// A timeline of begin and end events from each task, enabled with Amaze renderer > Record a timeline
+// trace in menuconfig. Each task writes only its own ring so no locks are needed. After a set number
+// of seconds the rings are sent over the log UART and tools/TraceToChrome turns the log into
+// Chrome trace-event JSON, showing how the cores overlap and where each waits on raster_event_group.
+// When disabled the macros are empty so nothing is compiled in.
+#ifdef CONFIG_AMAZE_TRACE
+#define TRACE_ON 1
+#else
+#define TRACE_ON 0
+#endif
+
+// The tasks with a ring, the order matches trace_task_names in Trace.cpp
+enum Trace_task : uint32_t
+{
+    TRACE_BUILD_TASK,   // ShowWorld on core 0
+    TRACE_RASTER_TASK,  // rasteriseTask on core 1
+    TRACE_EVENT_TASK,   // GetGameEvent
+    TRACE_TASKS
+};
+
+// What each event is, the order matches trace_names in Trace.cpp which are sent with the trace
+enum Trace_name : uint32_t
+{
+    TRACE_BUILD,                // Choosing chunks and queueing triangles
+    TRACE_WAIT_RASTER_DONE,     // Core 0 waiting for the rasteriser
+    TRACE_WAIT_CLEAR_READY,     // Core 0 waiting for the panel DMA of the last frame
+    TRACE_PLAY,                 // Collision, movement and overlays after the waits
+    TRACE_CLEAR,                // Clearing the depth or frame buffer
+    TRACE_START_RASTER,         // Instant, START_RASTER set
+    TRACE_SEND_FRAME,           // Instant, DMA of a frame started
+    TRACE_WAIT_START_RASTER,    // Core 1 waiting for a list
+    TRACE_TRIANGLES,            // The triangle queue of a list
+    TRACE_TILES,                // The tile queue of a list
+    TRACE_IMPOSTORS,            // Cached distant chunks
+    TRACE_RESOLVE,              // Resolve and upscale
+    TRACE_EVENT,                // Handling a game play event
+    TRACE_NAMES
+};
+
+// Phases as in the trace-event format
+#define TRACE_PHASE_BEGIN 'B'
+#define TRACE_PHASE_END 'E'
+#define TRACE_PHASE_INSTANT 'i'
+
+#if TRACE_ON
+
+void TraceAdd(const uint32_t task, const uint32_t name, const uint8_t phase);
+
+// Begins an event on construction and ends it at the end of the enclosing block
+class Trace_scope
+{
+public:
+    Trace_scope(const uint32_t task, const uint32_t name) : task(task), name(name) { TraceAdd(task, name, TRACE_PHASE_BEGIN); }
+    ~Trace_scope() { TraceAdd(task, name, TRACE_PHASE_END); }
+private:
+    const uint32_t task;
+    const uint32_t name;
+};
+
+#define TRACE_JOIN(a, b) a##b
+#define TRACE_LABEL(line) TRACE_JOIN(trace_scope_, line)
+#define TRACE_SCOPE(task, name) Trace_scope TRACE_LABEL(__LINE__)(task, name)
+#define TRACE_BEGIN(task, name) TraceAdd(task, name, TRACE_PHASE_BEGIN)
+#define TRACE_END(task, name) TraceAdd(task, name, TRACE_PHASE_END)
+#define TRACE_INSTANT(task, name) TraceAdd(task, name, TRACE_PHASE_INSTANT)
+
+#else
+
+#define TRACE_SCOPE(task, name)
+#define TRACE_BEGIN(task, name)
+#define TRACE_END(task, name)
+#define TRACE_INSTANT(task, name)
+
+#endif
+
+void ReportTrace();
@@ -3,17 +3,45 @@
 #include "geometry.h"
 #include "structures.h"
 
+// Options for ordering a queue before it is rasterised, set per queue with SetQueueSort()
+#define SORT_OFF 0          // Rasterise in the order that CheckTriangles queued
+#define SORT_ON 1           // Radix sort front-to-back on every frame
+#define SORT_ALTERNATE 2    // Sort on alternate frames so that sorted and unsorted raster times can be compared
+
+// The sort of the triangle and of the tile queues, chosen in menuconfig under Amaze renderer
+#if defined(CONFIG_AMAZE_SORT_TRIANGLES_ON)
+#define SORT_TRIANGLES SORT_ON
+#elif defined(CONFIG_AMAZE_SORT_TRIANGLES_ALTERNATE)
+#define SORT_TRIANGLES SORT_ALTERNATE
+#else
+#define SORT_TRIANGLES SORT_OFF
+#endif
+#if defined(CONFIG_AMAZE_SORT_TILES_ON)
+#define SORT_TILES SORT_ON
+#elif defined(CONFIG_AMAZE_SORT_TILES_ALTERNATE)
+#define SORT_TILES SORT_ALTERNATE
+#else
+#define SORT_TILES SORT_OFF
+#endif
+
 void rasteriseTask(void * parameter);
 
 void MakeQueue(const uint32_t tri_count, const uint32_t block);
 
+void SetQueueSort(const uint32_t block, const uint32_t sort_mode);
+
 void EmptyQueue(const uint32_t block);
 
 void EmptyQueues();
 
 uint32_t QueueTriangle(const TriToRaster triangle, const uint32_t block);
 
+void SortQueue(const uint32_t block);
+
 void SendQueue(const uint32_t block);
 
-bool SendImpactQueue(const uint32_t block, Near_pix * to_test);
+void ReportQueueSort();
+
+void ReportQueueUse();
 
+bool SendImpactQueue(const uint32_t block, Near_pix * to_test);
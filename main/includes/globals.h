@@ -4,16 +4,52 @@
 #include <math.h>
 #include "geometry.h"
 
+#if __has_include("sdkconfig.h")
+#include "sdkconfig.h"
+#endif
+
 // Shared global variables
 
-// Size of the game view port 
-const uint32_t g_scWidth = 128; // This means that the constant is included at compile time multiple times
+// Size of the game view port, chosen in menuconfig under Amaze renderer
+// As compile time constants the raster kernels and buffer sizes are still specialised for it
+#ifdef CONFIG_AMAZE_VIEW_WIDTH
+const uint32_t g_scWidth = CONFIG_AMAZE_VIEW_WIDTH; // This means that the constant is included at compile time multiple times
+const uint32_t g_scHeight = CONFIG_AMAZE_VIEW_HEIGHT;
+#else
+const uint32_t g_scWidth = 128;
 const uint32_t g_scHeight = 128;
+#endif
+
+// If the triangle crosses the view frustrum it will be tiled before rasterisation and
+// clearly there's a trade-off as smaller allows more elimination but extended to 1px square it's
+// literally back to square one. 8x8 suits 128x128, larger views use 16x16 to keep the tile count down
+const uint32_t g_xTile = (g_scWidth > 128) ? 16 : 8;
+const uint32_t g_yTile = (g_scHeight > 128) ? 16 : 8;
+
+// Whole tiles are assumed by CheckTriangles, the clear-free resolve's 8 pixel tiles and the render sizes
+static_assert((g_scWidth % g_xTile == 0) && (g_scHeight % g_yTile == 0), "View port must be a whole number of tiles");
 
 const float farPlane = 100.0f;
+const float nearPlane = 0.1f;
 
 const float COLLISION_DISTANCE = 1.0f;
 
 const uint32_t MAX_FRAME_DURATION = 99;
 
+// What alone holds the frame to MAX_FRAME_DURATION, chosen in menuconfig under Amaze renderer
+// The others are off so that no two react to the same slow frame
+#define FRAME_CONTROL_PIXELS 0  // The chunk sequence stops at a pixel estimate that follows the frame time
+#define FRAME_CONTROL_SCALE 1   // The view is rasterised at a smaller size, see RenderScale.cpp
+#define FRAME_CONTROL_COST 2    // The chunk sequence stops when the raster core is predicted full, see CostModel.cpp
+#define FRAME_CONTROL_QUALITY 3 // Texture and fog distance are turned down, see QualityGovernor.cpp
+#if defined(CONFIG_AMAZE_FRAME_CONTROL_SCALE)
+#define FRAME_CONTROL FRAME_CONTROL_SCALE
+#elif defined(CONFIG_AMAZE_FRAME_CONTROL_COST)
+#define FRAME_CONTROL FRAME_CONTROL_COST
+#elif defined(CONFIG_AMAZE_FRAME_CONTROL_QUALITY)
+#define FRAME_CONTROL FRAME_CONTROL_QUALITY
+#else
+#define FRAME_CONTROL FRAME_CONTROL_PIXELS
+#endif
+
 const Vec3f IncidentLight = { 0.548821f, -0.329293f, 0.768350f }; // The direction by which light reaches the world, must be magnitude 1.0f
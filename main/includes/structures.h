@@ -42,6 +42,18 @@ struct world_partition_header // Defines how the worlds are placed in the partit
     const uint32_t world_start; // Use this as a starting memory location
 };
 
+// Descriptors in the world partition header, each followed by one offset per frame
+#define WORLD_DESC_LAYOUT   0x10000000 // Offsets to a world_header for each frame
+#define WORLD_DESC_PVS      0x20000000 // Optional, follows a layout with offsets to a pvs_header for each frame
+#define WORLD_DESC_FRAMES   0x00ff0000 // Frame count in either descriptor
+#define WORLD_DESC_FRAMES_SHIFT 16
+
+struct pvs_header // The potentially visible set of one frame of a layout, made by tools/PvsBuilder
+{
+    const uint32_t chunk_count; // Must match the layout's xcount * zcount
+    const uint32_t words;       // 32 bit words per chunk, followed by chunk_count bitsets
+};
+
 struct world_header // The header of a single world in the partition, constants mostly
 {
     //Vec3f eye;
@@ -53,7 +65,7 @@ struct world_header // The header of a single world in the partition, constants
     const uint32_t texels;// uint16_t*
     const uint32_t attributes; // uint16_t*
     const uint32_t thin_palette; // uint32_t*
-    const uint32_t chunks; // int16_t*
+    const uint32_t chunks; // int16_t*, the ChunkArr and a format word then an entry per chunk
     //const uint32_t next_world; // world_header*
     //const uint32_t next_frame; // link to the next frame of an animated world
 };
@@ -74,6 +86,30 @@ struct part_faceMaterials // To describe palette in the partition
     const uint32_t event_code;// An event word to be added here, for all cases or optional?
 };
 
+// The last word of a chunk block's ChunkArr header says what each chunk's entry holds
+#define CHUNK_FORMAT_LISTS  -1 // An offset to its face list and the count
+#define CHUNK_FORMAT_BASES  1  // These then the face, vertex and UV bases that the chunk's 16 bit indices
+                               // are relative to, so a layout can have more than 65536 faces or vertices
+#define CHUNK_FORMAT_QUANTISED 2 // As CHUNK_FORMAT_BASES with the layout's vertices as Quant_vertex and UVs as Quant_uv
+
+// Quantised vertices are steps from the corner of their chunk's square, 1.2mm for 10m chunks, which
+// reaches four chunks away to allow for overhanging faces and height. UVs are steps of a texture repeat.
+#define QUANT_CHUNK_STEPS 8192
+#define QUANT_UV_STEPS 1024
+
+struct Quant_vertex
+{
+    int16_t x;
+    int16_t y;
+    int16_t z;
+};
+
+struct Quant_uv
+{
+    int16_t u;
+    int16_t v;
+};
+
 struct ChunkArr // Describes the layout of chunks in an a given layer
 {
   int16_t xmin;
@@ -87,6 +123,19 @@ struct ChunkFaces
 {
     uint16_t  * faces_ptr; // Pointer to the array of faces for that chunk
     uint32_t face_count; // The length of the array
+    uint32_t face_base; // Added to each face in the list to give its index in the layout
+    union // The layout's vertices and UVs from the chunk's bases, which the nvertices and texel_verts
+    {     // of its faces index, quantised when the layout's vertex_step is set
+        const Vec3f * vertices;
+        const Quant_vertex * qvertices;
+    };
+    union
+    {
+        const Vec2f * vts;
+        const Quant_uv * qvts;
+    };
+    Vec3f bound_min; // Bounding box of the chunk's vertices, faces may overhang the chunk square
+    Vec3f bound_max; // so it is found from the faces themselves as the world is read
 };
 
 // In theory this box can be integer but I've tried to work this through the algorithm and lost pixels each time
@@ -111,8 +160,40 @@ struct WorldLayout
   uint16_t * attributes;    // Pointer to an array that selects from the palette per face 
   ChunkFaces * TheChunks;   // Pointer to the array of lists of faces per chunk
   ChunkArr ChAr;            // The arrangement of chunks used in this layout
+  const uint32_t * pvs;     // Optional bitset per chunk of the chunks that can be seen from it, nullptr if none
+  uint32_t pvs_words;       // The length of each chunk's bitset in 32 bit words
+  float vertex_step;        // Metres per step of quantised vertices, 0 when they are Vec3f
 };
 
+// The corner of a chunk's square that its quantised vertices are relative to
+inline Vec3f ChunkOrigin(const WorldLayout * layo_ptr, const uint32_t chunk)
+{
+    const ChunkArr & ChAr = layo_ptr->ChAr;
+    return Vec3f((float)(ChAr.xmin + (int32_t)(chunk % ChAr.xcount) * ChAr.size), 0.0f, (float)(ChAr.zmin + (int32_t)(chunk / ChAr.xcount) * ChAr.size));
+}
+
+// A corner of a face of a chunk in world space whichever format its vertices have, for the code
+// off the vertex path as CheckTriangles folds the quantisation into its matrix
+inline Vec3f FaceVertex(const WorldLayout * layo_ptr, const uint32_t chunk, const uint32_t idx, const uint32_t corner)
+{
+    const ChunkFaces & faces = layo_ptr->TheChunks[chunk];
+    const uint32_t vertex = layo_ptr->nvertices[idx * 3 + corner];
+    if (!layo_ptr->vertex_step) return (faces.vertices[vertex]);
+    const Quant_vertex & q = faces.qvertices[vertex];
+    return (ChunkOrigin(layo_ptr, chunk) + Vec3f(q.x, q.y, q.z) * layo_ptr->vertex_step);
+}
+
+// The least view depth of any point in a chunk's bounding box. Fog and textures go by view depth,
+// which is never more than the distance, so chunks are judged by this rather than by how far away they are
+inline float ChunkNearestDepth(const ChunkFaces & chunk, const Vec3f eye, const Vec3f direction)
+{
+    const Vec3f forward = direction * (1.0f / direction.length());
+    const Vec3f nearest((forward.x > 0.0f) ? chunk.bound_min.x : chunk.bound_max.x,
+                        (forward.y > 0.0f) ? chunk.bound_min.y : chunk.bound_max.y,
+                        (forward.z > 0.0f) ? chunk.bound_min.z : chunk.bound_max.z);
+    return ((nearest - eye).dotProduct(forward));
+}
+
 // A structure that stores the pointers to layouts and is set up as the world is parsed from partition
 // It will be a ragged array when built as the included vector will vary in length depending on layouts/frames
 struct EachLayout
@@ -137,18 +218,29 @@ struct Near_pix // To find and report on an impacted face at a pixel
 // for those to be calculated outside rasteriser in future?
 // Especially for tiles there is a degree of inefficiency of passing and re-calculating
 // a range of parameters
+struct TriToRaster;
+typedef void (*Raster_kernel)(const TriToRaster & tri); // One of the specialised kernels in RasteriseBox.cpp
+
 struct TriToRaster
 {
     const WorldLayout* layout;  // A ptr to structure of the world so the queue can have multiple layouts queued for rasterising
                             // Can't pass the struct as the constants aren't defined when this struct is declared
                             // and doing it by pointer probably faster and more transparent anyway.
     uint32_t idx; // Triangle index
+    union // The UVs of the triangle's chunk for texturing, quantised as its layout's vertices
+    {
+        const Vec2f * vts;
+        const Quant_uv * qvts;
+    };
     Vec3f clip_zs; // just z value of the 3 clipped vertices passed in this Vec3f
     Rect2D BoBox; // Bounding box
     Matrix33f invM; // Matrix to solve edge equations etc
     Vec3f C; // Constant function (derived from invM) paased to reduce Rasteriser load
     Vec3f Z; // Z interpolation 
     Shade_params face_brightness; // Based on the face and half normals to determine shading
+    uint16_t depth_key; // Nearest clip z quantised to 16 bits, only filled when the queue is sorted
+    uint8_t kernel; // Index into raster_kernels[] chosen by QueueTriangle so that material, fog and edge checks aren't decided per pixel
+    uint8_t cost_class; // Flat or textured, triangle or tile, for the frame cost model
  };
 
 // A struct to keep track of the TriToRaster queues, at least two are needed, one per rasteriser
@@ -158,4 +250,74 @@ struct TriQueue
     TriToRaster* itemptr;
     uint32_t size;
     uint32_t count;
+    uint32_t sort_mode; // SORT_OFF, SORT_ON or SORT_ALTERNATE as set by SetQueueSort()
+};
+
+// What CheckTriangles did with the faces it was given, reset by whoever reads them
+struct Check_tracked
+{
+    uint32_t faces;             // Faces checked
+    uint32_t backfacing;        // Faces turned away or edge on
+    uint32_t clip_rejected;     // Triangles wholly outside the view
+    uint32_t occluded;          // Triangles hidden in the previous frame's depth buffer
+    uint32_t triangles;         // Triangles inside the view queued with their bounding box
+    uint32_t tiles_accepted;    // Tiles of triangles crossing the view queued without edge checks
+    uint32_t tiles_partial;     // Tiles queued with edge checks
+    uint32_t tiles_rejected;    // Tiles outside the triangle
+};
+
+// Counters for chunks drawn from impostor images, reset when reported each second
+struct Impostor_tracked
+{
+    uint32_t chunks;            // Chunks drawn as impostors rather than faces
+    uint32_t faces_skipped;     // Faces that CheckTriangles didn't need to touch
+    uint32_t builds;            // Impostor images made
+    uint32_t evictions;         // Images replaced to make room
+    uint32_t no_slot;           // Chunks drawn normally as every image was in use
+};
+
+// Counters for chunk occlusion culling, reset when reported each second
+struct Occlusion_tracked
+{
+    uint32_t chunks_tested;     // Chunks checked against the occlusion buffer
+    uint32_t chunks_culled;     // Chunks hidden behind occluders
+    uint32_t chunks_outside;    // Chunks whose bounding box is off screen
+    uint32_t faces_skipped;     // Faces that CheckTriangles didn't need to touch
+    uint32_t occluders;         // Triangles drawn into the occlusion buffer
+    uint32_t temporal_chunks;   // Chunks hidden in the previous frame's depth buffer
+    uint32_t temporal_triangles; // Large triangles hidden in the previous frame's depth buffer
+    uint32_t temporal_skipped;  // Frames where the view changed too much to use the previous frame
+    uint32_t culled_frames;     // Frames built with culling, used for OCCLUSION_ALTERNATE timing
+    uint32_t unculled_frames;   // Frames built without culling
+    uint32_t culled_ms;         // Accumulated frame times with and without culling
+    uint32_t unculled_ms;
+};
+
+// Timings gathered by the rasteriser so that sorting cost can be weighed against raster time saved
+// Both queues of a pingpong pair are accumulated into the same record
+struct Sort_tracked
+{
+    uint32_t sorted_frames;     // Frames in which the queue was sorted before rasterising
+    uint32_t unsorted_frames;   // Frames in which it was rasterised in queued order
+    uint32_t sort_us;           // Microseconds spent in the radix sort
+    uint32_t sorted_raster_us;  // Microseconds rasterising the queue after a sort
+    uint32_t unsorted_raster_us;// Microseconds rasterising the queue unsorted
+};
+
+// Memory traffic of the clear-free end of frame resolve, reset when reported each second
+struct Clear_tracked
+{
+    uint32_t frames;            // Frames resolved
+    uint32_t bytes_read;        // Depth values read to find pixels left from the previous frame
+    uint32_t bytes_written;     // Depth and colour written for pixels nothing was drawn to
+    uint32_t tiles_skipped;     // Tiles that were already far and background so weren't touched
+};
+
+// Predicted and measured raster times of the frame cost model, reset when reported each second
+struct Cost_tracked
+{
+    uint32_t frames;            // Frames rasterised with a prediction
+    uint32_t predicted_us;      // Sum of the predicted raster times
+    uint32_t actual_us;         // Sum of the measured raster times
+    uint32_t error_us;          // Sum of the absolute differences
 };
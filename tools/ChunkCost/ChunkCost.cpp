@@ -0,0 +1,554 @@
+// Host tool to measure how much rendering each chunk of a world partition binary costs
+//
+// The eye is placed at the centre of every chunk of the first layout, at the height of the ground
+// there plus the world's eye level, and looks along the middle of each of the sectors of
+// ChunkChooser.cpp. For each view the chunks that IndexChunkChooser() gives are taken from every
+// layout, as ShowWorld does, and their faces go through the steps of CheckTriangles: the backface
+// test, ExecuteFullTriangleClipping() and tiling. The triangles and tiles are then rasterised in
+// queue order into a depth buffer of the view port size to count the pixels shaded and the texture
+// fetches, using quality level 0 of QualityGovernor.cpp.
+//
+// Occlusion culling, impostors, the panorama and the chunk budget aren't modelled, so the counts
+// are the work before those save anything, which is what a view must stay within when they can't help.
+// Animated layouts are measured at their first frame.
+//
+// A table is printed of each chunk with the costs of its most expensive view and the most pixels
+// its own faces shaded in any view, and a PNG heat map of the grid of chunks of the first layout is
+// written, coloured by the pixels shaded in the most expensive view from each. Views that shade more
+// than the budget, by default three times the view port, are marked in the table and white in the map.
+//
+// Build on the host with
+//   g++ -O2 -std=c++17 -include stdint.h -I../../main/includes ChunkCost.cpp ../../main/CameraWork.cpp ../../main/ChunkChooser.cpp ../../main/ClipBound.cpp -o ChunkCost
+// adding -DCONFIG_AMAZE_VIEW_WIDTH=w -DCONFIG_AMAZE_VIEW_HEIGHT=h if the view port isn't 128x128
+// Use with
+//   ./ChunkCost DiscWorld11.bin DiscWorld11_cost.png [budget pixels]
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+#include "globals.h"
+#include "geometry.h"
+#include "structures.h"
+#include "ParseWorld.h"
+#include "CameraWork.h"
+#include "ChunkChooser.h"
+#include "CheckTriangles.h"
+#include "ClipBound.h"
+
+// The raster size used by ExecuteFullTriangleClipping(), always the full view port here
+uint32_t render_width = g_scWidth;
+uint32_t render_height = g_scHeight;
+
+// From CheckTriangles.cpp
+const float FOV = 60.0f;
+
+// Quality level 0 from QualityGovernor.cpp
+const float TEXTURE_DEPTH = 22.0f;
+const float TEXTURE_MIN_TRIANGLE = 6.0f;
+const float TEXTURE_MIN_TILE = 3.0f;
+
+// The sectors of ChunkChooser.cpp, the eye looks along the middle of each
+const uint32_t SECTORS = 8;
+
+// Size of each chunk in the heat map
+const uint32_t PNG_SCALE = 8;
+
+// One frame of a layout read from the binary
+struct Layout
+{
+    const Vec3f * vertices;
+    const uint16_t * nvertices;
+    const uint16_t * attributes;
+    const part_faceMaterials * palette;
+    std::vector<std::vector<uint32_t>> chunk_faces; // Faces of the whole layout
+    std::vector<uint32_t> vertex_bases;             // Of each face, from its chunk's entry
+    std::vector<Vec3f> dequantised;                 // The vertices of CHUNK_FORMAT_QUANTISED in world space
+    WorldLayout chooser; // Only ChAr and the PVS are set, which is all IndexChunkChooser() uses
+};
+
+// The work of one view, or of one chunk within a view
+struct Cost
+{
+    uint32_t submitted;     // Faces of the chunks taken
+    uint32_t surviving;     // Not backfacing nor outside the frustum
+    uint32_t tiles;         // Accepted and partial tiles of triangles crossing the frustum
+    uint32_t pixels;        // Pixels that passed the depth test
+    uint32_t fetches;       // Of those, the ones texture mapped
+
+    void operator+=(const Cost & other)
+    {
+        submitted += other.submitted;
+        surviving += other.surviving;
+        tiles += other.tiles;
+        pixels += other.pixels;
+        fetches += other.fetches;
+    }
+};
+
+// A triangle or tile queued for rasterising, as TriToRaster
+struct Queued
+{
+    Rect2D box;
+    Matrix33f invM;
+    bool edge_test;
+    bool textured;
+    uint32_t chunk;     // Of the first layout's grid, for the cost of each chunk
+};
+
+static uint32_t read32(const uint8_t * ptr)
+{
+    uint32_t value;
+    memcpy(&value, ptr, sizeof(value)); // The world offsets are not always 4 byte aligned
+    return (value);
+}
+
+static Layout ReadLayout(const uint8_t * image, const uint32_t offset)
+{
+    Layout layout = {};
+    const uint8_t * base = image + offset;
+    const world_header * header = (const world_header *) base;
+
+    layout.vertices = (const Vec3f *)(base + header->vertices);
+    layout.nvertices = (const uint16_t *)(base + header->nvertices);
+    layout.attributes = (const uint16_t *)(base + header->attributes);
+    layout.palette = (const part_faceMaterials *)(base + header->thin_palette + sizeof(uint32_t));
+
+    // Chunk block is 5 parameters and the format then an offset and count for each chunk, which
+    // with CHUNK_FORMAT_BASES or CHUNK_FORMAT_QUANTISED are followed by its face, vertex and UV bases
+    const int16_t * chunk_params = (const int16_t *)(base + header->chunks);
+    layout.chooser.ChAr = { chunk_params[0], chunk_params[1], chunk_params[2], chunk_params[3], chunk_params[4] };
+    const bool quantised = (chunk_params[5] == CHUNK_FORMAT_QUANTISED);
+    const bool chunk_bases = (chunk_params[5] == CHUNK_FORMAT_BASES) || quantised;
+    const uint32_t entry_size = chunk_bases ? 20 : 8;
+
+    const uint8_t * chunk_block = (const uint8_t *) chunk_params;
+    const uint8_t * chunk_map = chunk_block + sizeof(uint16_t) * 6;
+    const uint32_t chunk_count = layout.chooser.ChAr.xcount * layout.chooser.ChAr.zcount;
+    layout.chunk_faces.resize(chunk_count);
+    for (uint32_t chunk = 0; chunk < chunk_count; chunk++)
+    {
+        const uint8_t * entry = chunk_map + chunk * entry_size;
+        const uint32_t face_count = read32(entry + 4);
+        const uint32_t face_base = chunk_bases ? read32(entry + 8) : 0;
+        const uint32_t vertex_base = chunk_bases ? read32(entry + 12) : 0;
+        const uint16_t * faces = (const uint16_t *)(chunk_block + read32(entry));
+        for (uint32_t face = 0; face < face_count; face++)
+        {
+            const uint32_t idx = face_base + faces[face];
+            if (idx >= layout.vertex_bases.size()) layout.vertex_bases.resize(idx + 1);
+            layout.vertex_bases[idx] = vertex_base;
+            layout.chunk_faces[chunk].push_back(idx);
+
+            // Each chunk has its own quantised vertices, from the corner of its square
+            for (uint32_t corner = 0; quantised && (corner < 3); corner++)
+            {
+                const uint32_t vertex = vertex_base + layout.nvertices[idx * 3 + corner];
+                const Quant_vertex & q = ((const Quant_vertex *)layout.vertices)[vertex];
+                const float step = (float)layout.chooser.ChAr.size / QUANT_CHUNK_STEPS;
+                if (vertex >= layout.dequantised.size()) layout.dequantised.resize(vertex + 1);
+                layout.dequantised[vertex] = Vec3f(layout.chooser.ChAr.xmin + (int32_t)(chunk % layout.chooser.ChAr.xcount) * layout.chooser.ChAr.size + q.x * step, q.y * step,
+                    layout.chooser.ChAr.zmin + (int32_t)(chunk / layout.chooser.ChAr.xcount) * layout.chooser.ChAr.size + q.z * step);
+            }
+        }
+    }
+    return (layout);
+}
+
+// As ReadPVS(), a set that doesn't match the layout is ignored
+static void ReadLayoutPVS(const uint8_t * image, const uint32_t offset, Layout & layout)
+{
+    const pvs_header * header = (const pvs_header *)(image + offset);
+    const uint32_t chunk_count = layout.chooser.ChAr.xcount * layout.chooser.ChAr.zcount;
+    if ((header->chunk_count != chunk_count) || (header->words < (chunk_count + 31) / 32)) return;
+    layout.chooser.pvs = (const uint32_t *)(header + 1);
+    layout.chooser.pvs_words = header->words;
+}
+
+static Vec3f FaceVertex(const Layout & layout, const uint32_t face, const uint32_t corner)
+{
+    const uint32_t vertex = layout.vertex_bases[face] + layout.nvertices[face * 3 + corner];
+    return (layout.dequantised.empty() ? layout.vertices[vertex] : layout.dequantised[vertex]);
+}
+
+// The highest face of the chunk under a point, as BaseTriangles() but without a previous height
+static float GroundHeight(const Layout & layout, const uint32_t chunk, const float x, const float z)
+{
+    float ground = 0.0f;
+    bool found = false;
+    for (const uint32_t face : layout.chunk_faces[chunk])
+    {
+        const Vec3f v0 = FaceVertex(layout, face, 0);
+        const Vec3f v1 = FaceVertex(layout, face, 1);
+        const Vec3f v2 = FaceVertex(layout, face, 2);
+        const float area = (v1.x - v0.x) * (v2.z - v0.z) - (v1.z - v0.z) * (v2.x - v0.x);
+        if (fabsf(area) < 1e-6f) continue; // Edge on from above
+        const float w1 = ((x - v0.x) * (v2.z - v0.z) - (z - v0.z) * (v2.x - v0.x)) / area;
+        const float w2 = ((v1.x - v0.x) * (z - v0.z) - (v1.z - v0.z) * (x - v0.x)) / area;
+        if ((w1 < 0.0f) || (w2 < 0.0f) || (w1 + w2 > 1.0f)) continue;
+        const float height = v0.y + w1 * (v1.y - v0.y) + w2 * (v2.y - v0.y);
+        if (!found || (height > ground)) ground = height;
+        found = true;
+    }
+    return (ground);
+}
+
+// Put the faces of one chunk through the steps of CheckTriangles, adding to the two queues
+static void CheckChunk(const Layout & layout, const uint32_t chunk, const Matrix44f & ViewProj, const uint32_t cost_chunk,
+    std::vector<Queued> & edge_queue, std::vector<Queued> & tile_queue, Cost & cost)
+{
+    const float half_width = g_scWidth * 0.5f;
+    const float half_height = g_scHeight * 0.5f;
+
+    for (const uint32_t face : layout.chunk_faces[chunk])
+    {
+        cost.submitted++;
+        Vec4f clip[3], raster[3];
+        for (uint32_t corner = 0; corner < 3; corner++)
+        {
+            ViewProj.multVecMatrix(FaceVertex(layout, face, corner), clip[corner]);
+            raster[corner] = Vec4f(half_width * (clip[corner].x + clip[corner].w), half_height * (clip[corner].w - clip[corner].y), clip[corner].z, clip[corner].w);
+        }
+        Matrix33f M =
+        {
+            raster[0].x, raster[1].x, raster[2].x,
+            raster[0].y, raster[1].y, raster[2].y,
+            raster[0].w, raster[1].w, raster[2].w,
+        };
+        if (M.determinant() >= 0.0f) continue; // Backfacing
+
+        Rect2D box;
+        const uint32_t clip_result = ExecuteFullTriangleClipping(clip[0], clip[1], clip[2], &box);
+        if (clip_result == CLIP_TR) continue;
+        cost.surviving++;
+
+        Queued tri = { box, M.inverse(), true, layout.palette[layout.attributes[face]].type == PAL_TEXOFF, cost_chunk };
+        if (clip_result == CLIP_TA)
+        {
+            tri.textured = tri.textured && ((box.m_MaxX - box.m_MinX) > TEXTURE_MIN_TRIANGLE) && ((box.m_MaxY - box.m_MinY) > TEXTURE_MIN_TRIANGLE);
+            edge_queue.push_back(tri);
+            continue;
+        }
+
+        // Tiles as CheckTriangles, tested at the corners of each tile against the normalised edges
+        tri.textured = tri.textured && (TEXTURE_MIN_TILE < g_xTile) && (TEXTURE_MIN_TILE < g_yTile);
+        Vec3f E[3];
+        for (uint32_t edge = 0; edge < 3; edge++)
+        {
+            E[edge] = { tri.invM[edge][0], tri.invM[edge][1], tri.invM[edge][2] };
+            E[edge] /= (fabsf(E[edge].x) + fabsf(E[edge].y));
+        }
+        for (uint32_t ty = 0; ty < g_scHeight / g_yTile; ty++)
+        {
+            for (uint32_t tx = 0; tx < g_scWidth / g_xTile; tx++)
+            {
+                bool rejected = false, accepted = true;
+                for (uint32_t edge = 0; edge < 3; edge++)
+                {
+                    const float x_reject = (E[edge].x >= 0.0f) ? (tx + 1) * g_xTile : tx * g_xTile;
+                    const float y_reject = (E[edge].y >= 0.0f) ? (ty + 1) * g_yTile : ty * g_yTile;
+                    const float x_accept = (E[edge].x >= 0.0f) ? tx * g_xTile : (tx + 1) * g_xTile;
+                    const float y_accept = (E[edge].y >= 0.0f) ? ty * g_yTile : (ty + 1) * g_yTile;
+                    rejected |= (E[edge].x * x_reject + E[edge].y * y_reject + E[edge].z) < 0.0f;
+                    accepted &= (E[edge].x * x_accept + E[edge].y * y_accept + E[edge].z) >= 0.0f;
+                }
+                if (rejected) continue;
+                cost.tiles++;
+
+                Queued tile = tri;
+                tile.box = { (float)(tx * g_xTile), (float)(ty * g_yTile), (float)((tx + 1) * g_xTile), (float)((ty + 1) * g_yTile) };
+                tile.edge_test = !accepted;
+                if (accepted) tile_queue.push_back(tile);
+                else edge_queue.push_back(tile);
+            }
+        }
+    }
+}
+
+// Rasterise a queue into the depth buffer, which holds 1/w so larger is nearer
+static void RasteriseQueue(const std::vector<Queued> & queue, std::vector<float> & depth, std::vector<Cost> & chunk_costs, Cost & cost)
+{
+    const float texture_inverse = 1.0f / TEXTURE_DEPTH;
+
+    for (const Queued & tri : queue)
+    {
+        Vec3f C;
+        tri.invM.multVecMatrix(Vec3f(1, 1, 1), C);
+        const uint32_t x_end = std::min((uint32_t)ceilf(tri.box.m_MaxX), g_scWidth);
+        const uint32_t y_end = std::min((uint32_t)ceilf(tri.box.m_MaxY), g_scHeight);
+        for (uint32_t y = (uint32_t)tri.box.m_MinY; y < y_end; y++)
+        {
+            for (uint32_t x = (uint32_t)tri.box.m_MinX; x < x_end; x++)
+            {
+                const Vec3f sample = { x + 0.5f, y + 0.5f, 1.0f };
+                if (tri.edge_test)
+                {
+                    bool inside = true;
+                    for (uint32_t edge = 0; edge < 3; edge++)
+                    {
+                        inside &= (tri.invM[edge][0] * sample.x + tri.invM[edge][1] * sample.y + tri.invM[edge][2]) >= 0.0f;
+                    }
+                    if (!inside) continue;
+                }
+                const float oneOverW = C.x * sample.x + C.y * sample.y + C.z;
+                if (oneOverW <= depth[y * g_scWidth + x]) continue;
+                depth[y * g_scWidth + x] = oneOverW;
+
+                const bool fetched = tri.textured && (oneOverW > texture_inverse);
+                cost.pixels++;
+                if (fetched) cost.fetches++;
+                if (tri.chunk != INVALID_CHUNK)
+                {
+                    chunk_costs[tri.chunk].pixels++;
+                    if (fetched) chunk_costs[tri.chunk].fetches++;
+                }
+            }
+        }
+    }
+}
+
+// Render one view, adding each chunk of the first layout's own work to chunk_costs
+static Cost MeasureView(const std::vector<Layout> & layouts, const Vec3f eye, const Vec3f direction, std::vector<Cost> & chunk_costs)
+{
+    Matrix44f view, proj;
+    make_camera(direction, eye, view);
+    make_perspective((2.0f * M_PI) * (FOV / 360.0f), ((float)g_scWidth / (float)g_scHeight), nearPlane, farPlane, proj);
+    const Matrix44f ViewProj = view * proj;
+
+    Cost cost = {};
+    std::vector<Queued> edge_queue, tile_queue;
+    for (uint32_t index = 0; ; index++)
+    {
+        for (uint32_t l = 0; l < layouts.size(); l++)
+        {
+            const uint32_t chunk = IndexChunkChooser(eye, direction, index, &layouts[l].chooser);
+            if (chunk == LAST_CHUNK) goto ChunksDone; // As ShowWorld
+            if (chunk == INVALID_CHUNK) continue;
+
+            Cost chunk_cost = {};
+            CheckChunk(layouts[l], chunk, ViewProj, (l == 0) ? chunk : INVALID_CHUNK, edge_queue, tile_queue, chunk_cost);
+            cost += chunk_cost;
+        }
+    }
+ChunksDone:
+    std::vector<float> depth(g_scWidth * g_scHeight, 1.0f / farPlane);
+    RasteriseQueue(edge_queue, depth, chunk_costs, cost); // Queue 0 then 1 as SendQueue()
+    RasteriseQueue(tile_queue, depth, chunk_costs, cost);
+    return (cost);
+}
+
+static uint32_t Crc32(const uint8_t * data, const size_t size, uint32_t crc = 0)
+{
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++)
+    {
+        crc ^= data[i];
+        for (uint32_t bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+    }
+    return (~crc);
+}
+
+static void PutBig32(std::vector<uint8_t> & out, const uint32_t value)
+{
+    for (int32_t shift = 24; shift >= 0; shift -= 8) out.push_back((uint8_t)(value >> shift));
+}
+
+static void PngChunk(std::vector<uint8_t> & png, const char * type, const std::vector<uint8_t> & data)
+{
+    PutBig32(png, data.size());
+    std::vector<uint8_t> body(type, type + 4);
+    body.insert(body.end(), data.begin(), data.end());
+    png.insert(png.end(), body.begin(), body.end());
+    PutBig32(png, Crc32(body.data(), body.size()));
+}
+
+// An RGB PNG with the image data in stored (uncompressed) deflate blocks, so no zlib is needed
+static bool WritePng(const char * name, const uint32_t width, const uint32_t height, const std::vector<uint8_t> & rgb)
+{
+    std::vector<uint8_t> raw;
+    for (uint32_t y = 0; y < height; y++)
+    {
+        raw.push_back(0); // No filter
+        raw.insert(raw.end(), rgb.begin() + y * width * 3, rgb.begin() + (y + 1) * width * 3);
+    }
+
+    std::vector<uint8_t> zlib = { 0x78, 0x01 };
+    for (size_t start = 0; start < raw.size() || start == 0; start += 65535)
+    {
+        const size_t length = std::min(raw.size() - start, (size_t)65535);
+        zlib.push_back((start + length == raw.size()) ? 1 : 0); // The last block
+        zlib.push_back(length & 0xff);
+        zlib.push_back(length >> 8);
+        zlib.push_back(~length & 0xff);
+        zlib.push_back((~length >> 8) & 0xff);
+        zlib.insert(zlib.end(), raw.begin() + start, raw.begin() + start + length);
+    }
+    uint32_t a = 1, b = 0;
+    for (const uint8_t byte : raw)
+    {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    PutBig32(zlib, (b << 16) | a);
+
+    std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    std::vector<uint8_t> header;
+    PutBig32(header, width);
+    PutBig32(header, height);
+    header.insert(header.end(), { 8, 2, 0, 0, 0 }); // 8 bit RGB
+    PngChunk(png, "IHDR", header);
+    PngChunk(png, "IDAT", zlib);
+    PngChunk(png, "IEND", {});
+
+    FILE * out = fopen(name, "wb");
+    if (!out) return (false);
+    const bool written = (fwrite(png.data(), 1, png.size(), out) == png.size());
+    fclose(out);
+    return (written);
+}
+
+// Black through blue, cyan, green, yellow and red as share goes from 0 to 1, as the heat map view of HeatMap.cpp
+static void HeatColour(const float share, uint8_t * rgb)
+{
+    static const uint8_t ramp[6][3] = { { 0, 0, 0 }, { 0, 0, 255 }, { 0, 255, 255 }, { 0, 255, 0 }, { 255, 255, 0 }, { 255, 0, 0 } };
+    const float position = std::clamp(share, 0.0f, 1.0f) * 5.0f;
+    const uint32_t low = std::min((uint32_t)position, 4u);
+    const float blend = position - low;
+    for (uint32_t channel = 0; channel < 3; channel++)
+    {
+        rgb[channel] = (uint8_t)(ramp[low][channel] + (ramp[low + 1][channel] - ramp[low][channel]) * blend);
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    if ((argc != 3) && (argc != 4))
+    {
+        fprintf(stderr, "Usage: %s world.bin heat_map.png [budget pixels]\n", argv[0]);
+        return (1);
+    }
+    const uint32_t budget = (argc == 4) ? (uint32_t)atoi(argv[3]) : 3 * g_scWidth * g_scHeight;
+
+    FILE * in = fopen(argv[1], "rb");
+    if (!in)
+    {
+        fprintf(stderr, "Can't open %s\n", argv[1]);
+        return (1);
+    }
+    std::vector<uint8_t> image;
+    uint8_t buffer[65536];
+    size_t got;
+    while ((got = fread(buffer, 1, sizeof(buffer), in)) > 0) image.insert(image.end(), buffer, buffer + got);
+    fclose(in);
+
+    // The first frame of each layout, with its PVS if it has one
+    const world_partition_header * partition = (const world_partition_header *) image.data();
+    std::vector<Layout> layouts;
+    uint32_t position = offsetof(world_partition_header, world_start);
+    uint32_t word;
+    while ((word = read32(&image[position])))
+    {
+        const uint32_t frames = (word & WORLD_DESC_FRAMES) >> WORLD_DESC_FRAMES_SHIFT;
+        const uint32_t first = read32(&image[position + sizeof(uint32_t)]);
+        if (word & WORLD_DESC_LAYOUT) layouts.push_back(ReadLayout(image.data(), first));
+        else if ((word & WORLD_DESC_PVS) && !layouts.empty()) ReadLayoutPVS(image.data(), first, layouts.back());
+        else
+        {
+            fprintf(stderr, "Unexpected descriptor %08x\n", word);
+            return (1);
+        }
+        position += (1 + frames) * sizeof(uint32_t);
+    }
+    if (layouts.empty())
+    {
+        fprintf(stderr, "No layouts in %s\n", argv[1]);
+        return (1);
+    }
+
+    // The eye is placed over the chunks of the first layout, which is the ground plan
+    const Layout & ground = layouts[0];
+    const ChunkArr & ChAr = ground.chooser.ChAr;
+    const uint32_t chunk_count = ChAr.xcount * ChAr.zcount;
+    const float eye_level = partition->eye.y;
+
+    std::vector<Cost> worst_views(chunk_count), own_costs(chunk_count);
+    std::vector<uint32_t> worst_sectors(chunk_count);
+    Cost total = {};
+    uint32_t over_budget = 0;
+
+    printf("Chunk grid %dx%d of %dm, view port %dx%d, budget %d pixels\n", ChAr.xcount, ChAr.zcount, ChAr.size, g_scWidth, g_scHeight, budget);
+    printf("   x   z  faces | worst sector submitted surviving  tiles  pixels fetches | own pixels fetches\n");
+    for (int32_t z = 0; z < ChAr.zcount; z++)
+    {
+        for (int32_t x = 0; x < ChAr.xcount; x++)
+        {
+            const uint32_t chunk = x + ChAr.xcount * z;
+            Vec3f eye = { ChAr.xmin + ChAr.size * (x + 0.5f), 0.0f, ChAr.zmin + ChAr.size * (z + 0.5f) };
+            eye.y = GroundHeight(ground, chunk, eye.x, eye.z) + eye_level;
+
+            for (uint32_t sector = 0; sector < SECTORS; sector++)
+            {
+                // The middle of the sector, inverting the angle that ChunkChooser() finds from the direction
+                const float angle = 2.0f * M_PI * (sector + 0.5f) / SECTORS - M_PI;
+                const Vec3f direction = { sinf(angle), 0.0f, -cosf(angle) };
+
+                std::vector<Cost> view_chunks(chunk_count, Cost{});
+                const Cost cost = MeasureView(layouts, eye, direction, view_chunks);
+                total += cost;
+                if ((sector == 0) || (cost.pixels > worst_views[chunk].pixels))
+                {
+                    worst_views[chunk] = cost;
+                    worst_sectors[chunk] = sector;
+                }
+                for (uint32_t other = 0; other < chunk_count; other++)
+                {
+                    own_costs[other].pixels = std::max(own_costs[other].pixels, view_chunks[other].pixels);
+                    own_costs[other].fetches = std::max(own_costs[other].fetches, view_chunks[other].fetches);
+                }
+            }
+        }
+    }
+
+    uint32_t most_pixels = 1;
+    for (uint32_t chunk = 0; chunk < chunk_count; chunk++)
+    {
+        const Cost & worst = worst_views[chunk];
+        const bool over = worst.pixels > budget;
+        if (over) over_budget++;
+        else most_pixels = std::max(most_pixels, worst.pixels);
+        printf("%4d %3d %6zu | %12d %9d %9d %6d %7d %7d | %10d %7d%s\n", chunk % ChAr.xcount, chunk / ChAr.xcount,
+            ground.chunk_faces[chunk].size(), worst_sectors[chunk], worst.submitted, worst.surviving, worst.tiles,
+            worst.pixels, worst.fetches, own_costs[chunk].pixels, own_costs[chunk].fetches, over ? "  over budget" : "");
+    }
+    const uint32_t views = chunk_count * SECTORS;
+    printf("Average view: %d submitted, %d surviving, %d tiles, %d pixels, %d fetches\n", total.submitted / views,
+        total.surviving / views, total.tiles / views, total.pixels / views, total.fetches / views);
+    printf("%d of %d chunks have a view over budget\n", over_budget, chunk_count);
+
+    // One block per chunk with x across and z down, white if over budget
+    const uint32_t width = ChAr.xcount * PNG_SCALE;
+    const uint32_t height = ChAr.zcount * PNG_SCALE;
+    std::vector<uint8_t> rgb(width * height * 3);
+    for (uint32_t y = 0; y < height; y++)
+    {
+        for (uint32_t x = 0; x < width; x++)
+        {
+            const uint32_t chunk = (x / PNG_SCALE) + ChAr.xcount * (y / PNG_SCALE);
+            uint8_t * pixel = &rgb[(y * width + x) * 3];
+            if (worst_views[chunk].pixels > budget) memset(pixel, 255, 3);
+            else HeatColour((float)worst_views[chunk].pixels / most_pixels, pixel);
+        }
+    }
+    if (!WritePng(argv[2], width, height, rgb))
+    {
+        fprintf(stderr, "Can't write %s\n", argv[2]);
+        return (1);
+    }
+    printf("Heat map written to %s\n", argv[2]);
+    return (0);
+}
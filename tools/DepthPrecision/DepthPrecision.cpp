@@ -0,0 +1,345 @@
+// Host tool to check whether the 16 bit depth formats can tell apart the faces of a world
+//
+// Z-fighting needs two faces that overlap on screen with so little between them that the depth
+// buffer gives both the same key. Every pair of faces across all layouts, at their first frame, that
+// face the same way to within PAIR_ANGLE, lie within PAIR_GAP of each other and overlap across their
+// planes is found. Seen face on the gap is the difference in view depth between them and at a slant
+// it is more, so the nearest depth at which DepthKey() gives both the same key seen face on is the
+// nearest that the pair can fight at. That is found for each format by stepping the depth out from
+// nearPlane to farPlane through the key functions of RasteriseBox.h.
+//
+// Faces back to back, such as the two sides of a thin wall, aren't paired as one of them is always
+// culled. Pairs that are coplanar fight in every format, float too, so are counted on their own.
+// The reciprocal format gives every depth nearer than its near limit the key 0, so the pairs are
+// stepped from that limit and the range within it is given with the depth steps.
+//
+// Build on the host with
+//   g++ -O2 -std=gnu++17 -include stdint.h -I../HostStubs -I../../main/includes DepthPrecision.cpp ../../main/ParseWorld.cpp -o DepthPrecision
+// Use with
+//   ./DepthPrecision DiscWorld11.bin 3dtextures2.bin [worst pairs to list] 2>/dev/null
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#include "globals.h"
+#include "geometry.h"
+#include "structures.h"
+#include "ParseWorld.h"
+#include "RasteriseBox.h"
+
+// The pairs that are checked
+const float PAIR_ANGLE = 5.0f;  // Degrees between the normals
+const float PAIR_GAP = 0.5f;    // Metres between the planes
+const float COPLANAR = 0.001f;  // A gap below this is coplanar
+const float OVERLAP = 0.001f;   // Faces must overlap by this across their plane, so ones sharing an edge don't count
+
+const float CELL = 2.0f;        // Of the grid across the ground that faces are sorted into to find pairs
+const float SCAN_STEP = 0.001f; // Depth step when looking for a shared key
+const float FOG_END = 30.0f;    // Quality level 0 of QualityGovernor.cpp, nothing is seen beyond it
+
+std::vector<EachLayout> world; // As i80_lcd_main.cpp, filled by ParseWorld()
+std::vector<WorldLayout> the_layouts;
+
+struct Face
+{
+    Vec3f v[3];
+    Vec3f normal;
+    Vec3f centre;
+    Vec3f low, high;    // Bounds
+    uint32_t layout;
+};
+
+struct Pair
+{
+    uint32_t a, b;
+    float gap;
+};
+
+// A depth format as a function from view depth to key
+struct Format
+{
+    const char * name;
+    float near;         // Keys are only distinct from here
+    int32_t (*key)(const float z, const float near);
+    float (*depth)(const int32_t key, const float near);
+};
+
+static int32_t KeyLinear(const float z, const float) { return (DepthKeyLinear16(z)); }
+static float DepthLinear(const int32_t key, const float) { return (DepthFromKeyLinear16(key)); }
+static int32_t KeyReciprocal(const float z, const float near) { return (DepthKeyReciprocal16(DepthOneOverW(z), near)); }
+static float DepthReciprocal(const int32_t key, const float near) { return (DepthFromKeyReciprocal16(key, near)); }
+
+// Float is compared by its bits, which order as the depths do when they are positive
+static int32_t KeyFloat(const float z, const float)
+{
+    int32_t bits;
+    memcpy(&bits, &z, sizeof(bits));
+    return (bits);
+}
+static float DepthFloat(const int32_t key, const float)
+{
+    float z;
+    memcpy(&z, &key, sizeof(z));
+    return (z);
+}
+
+// The nearest depth, from the format's near limit, where surfaces gap apart seen face on share a key,
+// or 0 if they never do before farPlane
+static float SharedKeyDepth(const Format & format, const float gap, std::map<int32_t, float> & known)
+{
+    const int32_t gap_id = (int32_t)lroundf(gap * 10000.0f); // To a tenth of a millimetre
+    const auto found = known.find(gap_id);
+    if (found != known.end()) return (found->second);
+
+    float shared = 0.0f;
+    for (float z = std::max(format.near, nearPlane); z < farPlane; z += SCAN_STEP)
+    {
+        if (format.key(z, format.near) == format.key(z + gap, format.near))
+        {
+            shared = z;
+            break;
+        }
+    }
+    known[gap_id] = shared;
+    return (shared);
+}
+
+// Projects a triangle onto a plane's axes
+static void Project(const Face & face, const Vec3f origin, const Vec3f u, const Vec3f w, Vec2f out[3])
+{
+    for (uint32_t corner = 0; corner < 3; corner++)
+    {
+        const Vec3f relative = face.v[corner] - origin;
+        out[corner] = Vec2f(relative.dotProduct(u), relative.dotProduct(w));
+    }
+}
+
+// True if the triangles overlap by more than OVERLAP in the plane of a, by separating axes
+static bool Overlap(const Face & a, const Face & b)
+{
+    Vec3f u = a.v[1] - a.v[0];
+    u.normalize();
+    const Vec3f w = a.normal.crossProduct(u);
+
+    Vec2f tri[2][3];
+    Project(a, a.v[0], u, w, tri[0]);
+    Project(b, a.v[0], u, w, tri[1]);
+
+    for (uint32_t t = 0; t < 2; t++)
+    {
+        for (uint32_t edge = 0; edge < 3; edge++)
+        {
+            const Vec2f from = tri[t][edge];
+            const Vec2f to = tri[t][(edge + 1) % 3];
+            Vec2f axis(from.y - to.y, to.x - from.x);
+            const float length = sqrtf(axis.x * axis.x + axis.y * axis.y);
+            if (length < 1.0e-6f) return (false);
+            axis = axis * (1.0f / length);
+
+            float low[2] = { 1.0e9f, 1.0e9f }, high[2] = { -1.0e9f, -1.0e9f };
+            for (uint32_t s = 0; s < 2; s++)
+            {
+                for (uint32_t corner = 0; corner < 3; corner++)
+                {
+                    const float along = tri[s][corner].x * axis.x + tri[s][corner].y * axis.y;
+                    low[s] = std::min(low[s], along);
+                    high[s] = std::max(high[s], along);
+                }
+            }
+            if ((high[0] < low[1] + OVERLAP) || (high[1] < low[0] + OVERLAP)) return (false);
+        }
+    }
+    return (true);
+}
+
+static std::vector<uint8_t> LoadFile(const char * name)
+{
+    std::vector<uint8_t> data;
+    FILE * in = fopen(name, "rb");
+    if (!in) return (data);
+    uint8_t buffer[65536];
+    size_t got;
+    while ((got = fread(buffer, 1, sizeof(buffer), in)) > 0) data.insert(data.end(), buffer, buffer + got);
+    fclose(in);
+    return (data);
+}
+
+int main(int argc, char ** argv)
+{
+    if ((argc != 3) && (argc != 4))
+    {
+        fprintf(stderr, "Usage: %s world.bin textures.bin [worst pairs to list]\n", argv[0]);
+        return (1);
+    }
+    const uint32_t listed = (argc == 4) ? (uint32_t)atoi(argv[3]) : 10;
+
+    std::vector<uint8_t> world_image = LoadFile(argv[1]);
+    std::vector<uint8_t> texture_image = LoadFile(argv[2]);
+    if (world_image.empty() || texture_image.empty())
+    {
+        fprintf(stderr, "Can't read %s or %s\n", argv[1], argv[2]);
+        return (1);
+    }
+    ParseWorld(world_image.data(), texture_image.data());
+
+    // Every face in world space
+    std::vector<Face> faces;
+    for (uint32_t layout = 0; layout < world.size(); layout++)
+    {
+        const WorldLayout * layo_ptr = &world[layout].frame_layouts[0];
+        const uint32_t chunks = layo_ptr->ChAr.xcount * layo_ptr->ChAr.zcount;
+        for (uint32_t chunk = 0; chunk < chunks; chunk++)
+        {
+            const ChunkFaces & chunk_faces = layo_ptr->TheChunks[chunk];
+            for (uint32_t face = 0; face < chunk_faces.face_count; face++)
+            {
+                Face f;
+                const uint32_t idx = chunk_faces.face_base + chunk_faces.faces_ptr[face];
+                for (uint32_t corner = 0; corner < 3; corner++) f.v[corner] = FaceVertex(layo_ptr, chunk, idx, corner);
+                f.normal = (f.v[1] - f.v[0]).crossProduct(f.v[2] - f.v[0]);
+                if (f.normal.length() < 1.0e-6f) continue; // No area
+                f.normal.normalize();
+                f.centre = (f.v[0] + f.v[1] + f.v[2]) * (1.0f / 3.0f);
+                f.low = Vec3f(std::min(std::min(f.v[0].x, f.v[1].x), f.v[2].x), std::min(std::min(f.v[0].y, f.v[1].y), f.v[2].y), std::min(std::min(f.v[0].z, f.v[1].z), f.v[2].z));
+                f.high = Vec3f(std::max(std::max(f.v[0].x, f.v[1].x), f.v[2].x), std::max(std::max(f.v[0].y, f.v[1].y), f.v[2].y), std::max(std::max(f.v[0].z, f.v[1].z), f.v[2].z));
+                f.layout = layout;
+                faces.push_back(f);
+            }
+        }
+    }
+
+    // Sort the faces into cells across the ground, a pair is tested in the cell holding the low corner of their shared bounds
+    std::map<std::pair<int32_t, int32_t>, std::vector<uint32_t>> cells;
+    for (uint32_t i = 0; i < faces.size(); i++)
+    {
+        const Face & f = faces[i];
+        for (int32_t cz = (int32_t)floorf((f.low.z - PAIR_GAP) / CELL); cz <= (int32_t)floorf((f.high.z + PAIR_GAP) / CELL); cz++)
+        {
+            for (int32_t cx = (int32_t)floorf((f.low.x - PAIR_GAP) / CELL); cx <= (int32_t)floorf((f.high.x + PAIR_GAP) / CELL); cx++)
+            {
+                cells[{ cx, cz }].push_back(i);
+            }
+        }
+    }
+
+    const float parallel = cosf(PAIR_ANGLE * (float)M_PI / 180.0f);
+    std::vector<Pair> pairs;
+    uint32_t coplanar = 0;
+    for (const auto & cell : cells)
+    {
+        const std::vector<uint32_t> & members = cell.second;
+        for (uint32_t m = 0; m < members.size(); m++)
+        {
+            const Face & a = faces[members[m]];
+            for (uint32_t n = m + 1; n < members.size(); n++)
+            {
+                const Face & b = faces[members[n]];
+                const float low_x = std::max(a.low.x, b.low.x) - PAIR_GAP;
+                const float low_z = std::max(a.low.z, b.low.z) - PAIR_GAP;
+                if ((low_x > std::min(a.high.x, b.high.x) + PAIR_GAP) || (low_z > std::min(a.high.z, b.high.z) + PAIR_GAP)) continue;
+                if ((std::max(a.low.y, b.low.y) > std::min(a.high.y, b.high.y) + PAIR_GAP)) continue;
+                if (((int32_t)floorf(low_x / CELL) != cell.first.first) || ((int32_t)floorf(low_z / CELL) != cell.first.second)) continue;
+
+                if (a.normal.dotProduct(b.normal) < parallel) continue;
+                const float gap = fabsf((b.centre - a.centre).dotProduct(a.normal));
+                if (gap > PAIR_GAP) continue;
+                if (!Overlap(a, b)) continue;
+
+                if (gap < COPLANAR) coplanar++;
+                else pairs.push_back({ members[m], members[n], gap });
+            }
+        }
+    }
+    std::sort(pairs.begin(), pairs.end(), [](const Pair & p, const Pair & q) { return (p.gap < q.gap); });
+
+    std::vector<Format> formats = {
+        { "linear16", 0.0f, KeyLinear, DepthLinear },
+        { "recip16 DEPTH_NEAR", DEPTH_NEAR, KeyReciprocal, DepthReciprocal },
+        { "recip16 nearPlane", nearPlane, KeyReciprocal, DepthReciprocal },
+        { "float", 0.0f, KeyFloat, DepthFloat } };
+    if (DEPTH_NEAR == nearPlane) formats.erase(formats.begin() + 2);
+
+    printf("%d faces in %d layouts, %d coplanar overlapping pairs which fight in every format\n", (int)faces.size(), (int)world.size(), coplanar);
+    printf("%d pairs facing the same way within %.0f degrees, overlapping and from %.0fmm to %.0fmm apart\n",
+        (int)pairs.size(), PAIR_ANGLE, COPLANAR * 1000.0f, PAIR_GAP * 1000.0f);
+    printf("DEPTH_NEAR %.2fm, nearPlane %.2fm, farPlane %.0fm, DEPTH_FAR %.0fm, fog end %.0fm\n\n", DEPTH_NEAR, nearPlane, farPlane, DEPTH_FAR, FOG_END);
+
+    // The step between keys at a few depths, which is what DepthQuantise() rounds to
+    const float depths[] = { 0.1f, 0.25f, 0.5f, 1.0f, 2.0f, 5.0f, 10.0f, 20.0f, 30.0f, 50.0f, 100.0f };
+    printf("Depth step in mm at depth\n%-20s", "");
+    for (const float z : depths) printf("%8.2fm", z);
+    printf("\n");
+    for (const Format & format : formats)
+    {
+        printf("%-20s", format.name);
+        for (const float z : depths)
+        {
+            const int32_t key = format.key(z, format.near);
+            if (z < format.near) printf("%9s", "all 0");
+            else printf("%9.2f", (format.depth(key + 1, format.near) - format.depth(key, format.near)) * 1000.0f);
+        }
+        printf("\n");
+    }
+
+    // The nearest depth that a pair of each range of gaps can share a key at
+    const float gap_ranges[] = { 0.005f, 0.01f, 0.02f, 0.05f, 0.1f, 0.2f, PAIR_GAP };
+    std::vector<std::map<int32_t, float>> known(formats.size());
+    printf("\nNearest depth in m that pairs can share a key at, - for none before farPlane\n%-20s", "gap up to  pairs");
+    for (const Format & format : formats) printf("%20s", format.name);
+    printf("\n");
+    uint32_t first = 0;
+    for (const float range : gap_ranges)
+    {
+        uint32_t last = first;
+        while ((last < pairs.size()) && (pairs[last].gap <= range)) last++;
+        printf("%7.0fmm %9d  ", range * 1000.0f, (int)(last - first));
+        for (uint32_t f = 0; f < formats.size(); f++)
+        {
+            if (last == first)
+            {
+                printf("%20s", "");
+                continue;
+            }
+            const float shared = SharedKeyDepth(formats[f], pairs[first].gap, known[f]); // The smallest gap is the first to share
+            if (shared > 0.0f) printf("%20.2f", shared);
+            else printf("%20s", "-");
+        }
+        printf("\n");
+        first = last;
+    }
+
+    printf("\nPairs that can share a key nearer than the fog end\n");
+    for (uint32_t f = 0; f < formats.size(); f++)
+    {
+        uint32_t fighting = 0;
+        for (const Pair & pair : pairs)
+        {
+            const float shared = SharedKeyDepth(formats[f], pair.gap, known[f]);
+            if ((shared > 0.0f) && (shared < FOG_END)) fighting++;
+        }
+        printf("%-20s %d of %d\n", formats[f].name, (int)fighting, (int)pairs.size());
+    }
+
+    if (listed && !pairs.empty()) printf("\nClosest pairs, centre of the first face, layouts, gap and the depth each format shares a key from\n");
+    for (uint32_t p = 0; p < std::min((uint32_t)pairs.size(), listed); p++)
+    {
+        const Pair & pair = pairs[p];
+        const Face & a = faces[pair.a];
+        printf("%8.2f %7.2f %8.2f  layouts %d,%d gap %6.1fmm", a.centre.x, a.centre.y, a.centre.z,
+            (int)a.layout, (int)faces[pair.b].layout, pair.gap * 1000.0f);
+        for (uint32_t f = 0; f < formats.size(); f++)
+        {
+            const float shared = SharedKeyDepth(formats[f], pair.gap, known[f]);
+            if (shared > 0.0f) printf("  %s %.2fm", formats[f].name, shared);
+            else printf("  %s -", formats[f].name);
+        }
+        printf("\n");
+    }
+    return (0);
+}
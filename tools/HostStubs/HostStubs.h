@@ -0,0 +1,72 @@
+#pragma once
+
+// Stand-ins for the few ESP-IDF and FreeRTOS calls that the renderer sources make, so that they can be
+// built on a desktop by the host tools that run the real kernels. Each of the headers beside this one
+// is named as the ESP-IDF header it replaces and only includes this file.
+//  - Logging goes to stderr with the tag, as the monitor shows it, leaving stdout to the tool
+//  - The cycle counter is the monotonic clock scaled to 240MHz, so benchmark figures are in ns of host time
+//  - Heap capabilities are ignored, everything comes from malloc()
+//  - esp_restart() ends the tool with an error
+//  - Tasks, queues and event groups are single threaded no-ops, SendQueue() rasterises on the caller
+// Add -I../HostStubs to the build of a tool before -I../../main/includes
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <time.h>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_ERROR_CHECK(x) (void)(x)
+
+#define ESP_LOGI(tag, fmt, ...) fprintf(stderr, "%s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) fprintf(stderr, "%s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGE(tag, fmt, ...) fprintf(stderr, "%s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOG_BUFFER_HEX_LEVEL(...)
+typedef int esp_log_level_t;
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t EventBits_t;
+typedef void * EventGroupHandle_t;
+typedef void * TaskHandle_t;
+typedef void * TimerHandle_t;
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define portMAX_DELAY 0xffffffff
+#define portTICK_PERIOD_MS 10
+
+static inline EventGroupHandle_t xEventGroupCreate() { return (nullptr); }
+static inline EventBits_t xEventGroupSetBits(EventGroupHandle_t, EventBits_t) { return (0); }
+static inline EventBits_t xEventGroupClearBits(EventGroupHandle_t, EventBits_t) { return (0); }
+static inline EventBits_t xEventGroupWaitBits(EventGroupHandle_t, EventBits_t, BaseType_t, BaseType_t, TickType_t) { return (0); }
+static inline void vTaskDelay(TickType_t) {}
+static inline void esp_restart() { exit(1); } // After show_error(), which the tool can't recover from
+
+static inline int64_t esp_timer_get_time()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec * 1000000ll + now.tv_nsec / 1000);
+}
+
+static inline uint32_t esp_cpu_get_cycle_count()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint32_t)((now.tv_sec * 1000000000ull + now.tv_nsec) * 240 / 1000));
+}
+
+static inline uint32_t esp_random() { return ((uint32_t)rand()); }
+
+#define MALLOC_CAP_INTERNAL 1
+#define MALLOC_CAP_DMA 2
+#define MALLOC_CAP_32BIT 4
+#define MALLOC_CAP_8BIT 8
+#define MALLOC_CAP_SPIRAM 16
+static inline void * heap_caps_malloc(const size_t size, const uint32_t) { return (malloc(size)); }
+static inline void * heap_caps_calloc(const size_t count, const size_t size, const uint32_t) { return (calloc(count, size)); }
@@ -0,0 +1,91 @@
+// Host run of the kernel benchmarks that the device runs at start up
+//
+// Benchmark.cpp is built here unchanged, so the host and the device time the same cases: the raster
+// kernels on the chunk the eye starts in and on synthetic walls of triangles of controlled size,
+// orientation, fog and texturing, each variant four pixels at a time against one at a time, and
+// CheckTriangles, ExecuteFullTriangleClipping, Matrix33::inverse, MakeShade, BaseTriangles,
+// IndexChunkChooser and WritePixel2Fog888, in ns per triangle, face or pixel. The cycle counter of
+// HostStubs is the monotonic clock scaled to the 240MHz that Benchmark.cpp divides by, so the
+// figures are ns of host time, and a change can be measured on the host before it is tried on the
+// device. The results are logged as the monitor would show them, on stderr.
+//
+// Build on the host with
+//   g++ -O2 -std=gnu++17 -include stdint.h -DCONFIG_AMAZE_BENCHMARK -I../HostStubs -I../../main/includes KernelBench.cpp
+//     ../../main/{Benchmark,CheckTriangles,RasteriseBox,ClipBound,CameraWork,ChunkChooser,TriangleQueues,OcclusionCull,
+//     RenderScale,CostModel,QualityGovernor,HorizonPanorama,ImpostorCache,ShowError,FindHitFace,ParseWorld,HeatMap}.cpp -o KernelBench
+// Use with
+//   ./KernelBench ../../DiscWorld11.bin ../../3dtextures2.bin
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+#include "globals.h"
+#include "geometry.h"
+#include "structures.h"
+#include "ParseWorld.h"
+#include "TriangleQueues.h"
+#include "CheckTriangles.h"
+#include "RasteriseBox.h"
+#include "QualityGovernor.h"
+#include "Benchmark.h"
+
+// The globals that the renderer expects from i80_lcd_main.cpp and EventManager.cpp
+std::vector<EachLayout> world;
+std::vector<WorldLayout> the_layouts;
+uint16_t * frame_buffer_A;
+uint16_t * frame_buffer_B;
+bool flipped = true;
+extern constexpr uint32_t fog = 0x00303030;
+extern constexpr uint16_t BackgroundColour = ((fog >> 8) & 0b1111100000000000) | ((fog >> 5) & 0b0000011111100000) | ((fog >> 3) & 0b0000000000011111);
+float eye_level;
+Vec3f eye, direction;
+Time_tracked time_report;
+
+static std::vector<uint8_t> LoadFile(const char * name)
+{
+    std::vector<uint8_t> data;
+    FILE * in = fopen(name, "rb");
+    if (!in) return (data);
+    uint8_t buffer[65536];
+    size_t got;
+    while ((got = fread(buffer, 1, sizeof(buffer), in)) > 0) data.insert(data.end(), buffer, buffer + got);
+    fclose(in);
+    return (data);
+}
+
+int main(int argc, char ** argv)
+{
+    if (argc != 3)
+    {
+        fprintf(stderr, "Usage: %s world.bin textures.bin\n", argv[0]);
+        return (1);
+    }
+
+    std::vector<uint8_t> world_image = LoadFile(argv[1]);
+    std::vector<uint8_t> texture_image = LoadFile(argv[2]);
+    if (world_image.empty() || texture_image.empty())
+    {
+        fprintf(stderr, "Can't read %s or %s\n", argv[1], argv[2]);
+        return (1);
+    }
+
+    // As app_main() up to the benchmarks
+    frame_buffer_A = new uint16_t[g_scWidth * g_scHeight];
+    frame_buffer_B = new uint16_t[g_scWidth * g_scHeight];
+    MakeDepthBuffer();
+    MakeQueue(6000, 0);
+    MakeQueue(5000, 1);
+    MakeQueue(6000, 2);
+    MakeQueue(5000, 3);
+    ProjectionMatrix();
+    const world_partition_header * header = (const world_partition_header *)world_image.data();
+    eye = header->eye;
+    direction = header->direction;
+    eye_level = eye.y;
+    ParseWorld(world_image.data(), texture_image.data());
+    SetRasterQuality(quality_build);
+
+    RunBenchmarks(eye, direction);
+    return (0);
+}
@@ -0,0 +1,510 @@
+// Host fuzz test of the PixelSimd.h backends and benchmark of the four-lane kernels
+//
+// PixelScalar is the reference that the other backends of PixelSimd.h must match bit for bit. Each
+// function of PixelVector is run against it on random lanes with the edge cases mixed in: zero and
+// negative zero edge results either side of zero_inside, denormals, infinities and NaN, depths at
+// both ends of each clear-free encoding, 1/w at and beyond the reciprocal clamp, and every row end
+// count. Any lane that differs is listed and the program exits with 1.
+//
+// The benchmark draws views of a world, keeps what CheckTriangles queued and then times each of
+// the eight variants of the raster kernel in its four-lane form, RasteriseKernel, against its
+// per-pixel form, RasteriseKernelPixel, which is the default, on the same triangles and tiles, and counts the pixels where the two draw differently. Times are
+// the host's, so only the ratios carry over to the device, where Benchmark.cpp gives the same
+// figures. Build with -DPIXEL_SIMD=0 to time the scalar backend, the device's, rather than vectors.
+//
+// Build on the host with
+//   g++ -O2 -std=gnu++17 -include stdint.h -DCONFIG_AMAZE_BENCHMARK -I../HostStubs -I../../main/includes PixelBench.cpp
+//     ../../main/{CheckTriangles,RasteriseBox,ClipBound,CameraWork,ChunkChooser,TriangleQueues,OcclusionCull,RenderScale,
+//     CostModel,QualityGovernor,HorizonPanorama,ImpostorCache,ShowError,FindHitFace,ParseWorld,HeatMap}.cpp -o PixelBench
+// Use with
+//   ./PixelBench [world.bin textures.bin] 2>/dev/null
+// the benchmark being skipped without a world
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "globals.h"
+#include "geometry.h"
+#include "structures.h"
+#include "ParseWorld.h"
+#include "ChunkChooser.h"
+#include "TriangleQueues.h"
+#include "CheckTriangles.h"
+#include "RasteriseBox.h"
+#include "QualityGovernor.h"
+#include "PixelSimd.h"
+
+#define FUZZ_ROUNDS 1000000 // Of each function
+#define REPORTED 8          // Differences listed of each function
+#define BENCH_REPEATS 8     // The best of these is reported
+#define BENCH_VIEWS 4       // Turns of 90 degrees from the world's starting direction
+#define BENCH_PLACES 4      // Views are also taken from a grid of this less one squared across the first layout
+
+// The globals that the renderer expects from i80_lcd_main.cpp and EventManager.cpp
+std::vector<EachLayout> world;
+std::vector<WorldLayout> the_layouts;
+uint16_t * frame_buffer_A;
+uint16_t * frame_buffer_B;
+bool flipped = true;
+extern constexpr uint32_t fog = 0x00303030;
+extern constexpr uint16_t BackgroundColour = ((fog >> 8) & 0b1111100000000000) | ((fog >> 5) & 0b0000011111100000) | ((fog >> 3) & 0b0000000000011111);
+float eye_level;
+Vec3f eye, direction;
+Time_tracked time_report;
+
+extern uint16_t * frame_buffer_this;
+extern depth_t * depthBuffer;
+extern TriQueue BlockA[4];
+
+// The lanes of both backends, told apart by their types
+using PixelScalar::QuadLane;
+using PixelScalar::QuadSetLane;
+using PixelVector::QuadLane;
+using PixelVector::QuadSetLane;
+
+static std::mt19937 rng(20240601);
+static uint32_t differences = 0;
+
+// ************************************************************************************************
+// Fuzzing
+
+// Floats across many magnitudes, one in eight being an edge case
+static float RandomFloat(const bool finite = false)
+{
+    static const float edges[] = { 0.0f, -0.0f, 1.0f, -1.0f, FLT_MIN, -FLT_MIN, 1.0e-40f, -1.0e-40f, FLT_MAX, -FLT_MAX,
+        INFINITY, -INFINITY, NAN };
+    const uint32_t edge_count = sizeof(edges) / sizeof(edges[0]) - (finite ? 3 : 0);
+    if ((rng() & 7) == 0) return (edges[rng() % edge_count]);
+    const float mantissa = std::uniform_real_distribution<float>(-1.0f, 1.0f)(rng);
+    return (ldexpf(mantissa, (int)(rng() % 41) - 20));
+}
+
+static bool SameFloat(const float a, const float b)
+{
+    if (isnan(a) && isnan(b)) return (true);
+    uint32_t bits_a, bits_b;
+    memcpy(&bits_a, &a, sizeof(a));
+    memcpy(&bits_b, &b, sizeof(b));
+    return (bits_a == bits_b);
+}
+
+// Both backends' quads from the same lanes
+template <typename Lane, typename Scalar, typename Vector>
+static void MakeQuads(const Lane lanes[4], Scalar & scalar, Vector & vector)
+{
+    scalar = {};
+    vector = Vector{};
+    for (uint32_t k = 0; k < 4; k++)
+    {
+        QuadSetLane(scalar, k, lanes[k]);
+        QuadSetLane(vector, k, lanes[k]);
+    }
+}
+
+static void Differs(const char * function, const uint32_t round, const uint32_t lane, const double scalar, const double vector)
+{
+    if (differences++ < REPORTED) printf("  %s round %d lane %d: scalar %g, vector %g\n", function, (int)round, (int)lane, scalar, vector);
+}
+
+template <typename Scalar, typename Vector>
+static void CompareInts(const char * function, const uint32_t round, const Scalar scalar, const Vector vector)
+{
+    for (uint32_t k = 0; k < 4; k++)
+    {
+        if ((uint32_t)QuadLane(scalar, k) != (uint32_t)QuadLane(vector, k)) Differs(function, round, k, QuadLane(scalar, k), QuadLane(vector, k));
+    }
+}
+
+static void CompareFloats(const char * function, const uint32_t round, const PixelScalar::quad_f scalar, const PixelVector::quad_f vector)
+{
+    for (uint32_t k = 0; k < 4; k++)
+    {
+        if (!SameFloat(QuadLane(scalar, k), QuadLane(vector, k))) Differs(function, round, k, QuadLane(scalar, k), QuadLane(vector, k));
+    }
+}
+
+// A mask lane, mostly all or nothing as the kernels make them
+static int32_t RandomMask()
+{
+    const uint32_t pick = rng() % 8;
+    return ((pick < 3) ? 0 : ((pick < 7) ? -1 : (int32_t)rng()));
+}
+
+// A clear-free encoding, as DepthNewFrame() swaps them
+static void RandomEncoding(int32_t & base, int32_t & sign)
+{
+    const bool swapped = rng() & 1;
+    base = swapped ? 2 * DEPTH_KEY16_FAR : 0;
+    sign = swapped ? -1 : 1;
+}
+
+// A 16 bit depth key, near either end a quarter of the time
+static int32_t RandomKey()
+{
+    const uint32_t pick = rng() % 8;
+    if (pick == 0) return ((int32_t)(rng() % 4));
+    if (pick == 1) return (DEPTH_KEY16_FAR - (int32_t)(rng() % 4));
+    return ((int32_t)(rng() % (DEPTH_KEY16_FAR + 1)));
+}
+
+static uint32_t FuzzFunction(const char * function, void (*fuzz)(const uint32_t round))
+{
+    differences = 0;
+    for (uint32_t round = 0; round < FUZZ_ROUNDS; round++) fuzz(round);
+    printf("%-18s %s\n", function, differences ? "DIFFERS" : "matches");
+    return (differences);
+}
+
+static void FuzzRamp(const uint32_t round)
+{
+    const float base = RandomFloat(), step = RandomFloat();
+    CompareFloats("QuadRamp", round, PixelScalar::QuadRamp(base, step), PixelVector::QuadRamp(base, step));
+}
+
+static void FuzzLaneMask(const uint32_t round)
+{
+    const uint32_t count = rng() % 6; // Beyond 4 too
+    CompareInts("QuadLaneMask", round, PixelScalar::QuadLaneMask(count), PixelVector::QuadLaneMask(count));
+}
+
+static void FuzzAndAny(const uint32_t round)
+{
+    int32_t a[4], b[4];
+    for (uint32_t k = 0; k < 4; k++)
+    {
+        a[k] = RandomMask();
+        b[k] = RandomMask();
+    }
+    PixelScalar::quad_i scalar_a, scalar_b;
+    PixelVector::quad_i vector_a, vector_b;
+    MakeQuads(a, scalar_a, vector_a);
+    MakeQuads(b, scalar_b, vector_b);
+    CompareInts("QuadAnd", round, PixelScalar::QuadAnd(scalar_a, scalar_b), PixelVector::QuadAnd(vector_a, vector_b));
+    const bool scalar_any = PixelScalar::QuadAny(scalar_a), vector_any = PixelVector::QuadAny(vector_a);
+    if (scalar_any != vector_any) Differs("QuadAny", round, 0, scalar_any, vector_any);
+}
+
+static void FuzzEdgeMask(const uint32_t round)
+{
+    float results[4];
+    for (uint32_t k = 0; k < 4; k++) results[k] = (rng() & 3) ? RandomFloat() : ((rng() & 1) ? 0.0f : -0.0f);
+    const bool zero_inside = rng() & 1;
+    PixelScalar::quad_f scalar;
+    PixelVector::quad_f vector;
+    MakeQuads(results, scalar, vector);
+    CompareInts("QuadEdgeMask", round, PixelScalar::QuadEdgeMask(scalar, zero_inside), PixelVector::QuadEdgeMask(vector, zero_inside));
+}
+
+// Load, pass and store on a 16 bit buffer with lanes beyond the row end left alone
+static void FuzzDepth16(const uint32_t round)
+{
+    int32_t base, sign;
+    RandomEncoding(base, sign);
+    const uint32_t count = 1 + rng() % 4;
+    uint16_t buffer[4];
+    int32_t keys[4], masks[4];
+    for (uint32_t k = 0; k < 4; k++)
+    {
+        buffer[k] = (uint16_t)(base + sign * RandomKey());
+        keys[k] = RandomKey();
+        masks[k] = RandomMask();
+    }
+    const PixelScalar::quad_i scalar_stored = PixelScalar::QuadLoadDepth(buffer, count);
+    const PixelVector::quad_i vector_stored = PixelVector::QuadLoadDepth(buffer, count);
+    CompareInts("QuadLoadDepth", round, scalar_stored, vector_stored);
+
+    PixelScalar::quad_i scalar_key, scalar_mask;
+    PixelVector::quad_i vector_key, vector_mask;
+    MakeQuads(keys, scalar_key, vector_key);
+    MakeQuads(masks, scalar_mask, vector_mask);
+    CompareInts("QuadDepthPass", round, PixelScalar::QuadDepthPass(scalar_key, scalar_stored, base, sign),
+        PixelVector::QuadDepthPass(vector_key, vector_stored, base, sign));
+
+    uint16_t scalar_buffer[4], vector_buffer[4];
+    memcpy(scalar_buffer, buffer, sizeof(buffer));
+    memcpy(vector_buffer, buffer, sizeof(buffer));
+    PixelScalar::QuadStoreDepth(scalar_buffer, scalar_key, scalar_mask, base, sign, count);
+    PixelVector::QuadStoreDepth(vector_buffer, vector_key, vector_mask, base, sign, count);
+    for (uint32_t k = 0; k < 4; k++)
+    {
+        if (scalar_buffer[k] != vector_buffer[k]) Differs("QuadStoreDepth", round, k, scalar_buffer[k], vector_buffer[k]);
+    }
+}
+
+// The same for a float buffer, keys being depths
+static void FuzzDepthFloat(const uint32_t round)
+{
+    const bool swapped = rng() & 1;
+    const float base = swapped ? 2.0f * DEPTH_FAR : 0.0f;
+    const float sign = swapped ? -1.0f : 1.0f;
+    const uint32_t count = 1 + rng() % 4;
+    float buffer[4], keys[4];
+    int32_t masks[4];
+    for (uint32_t k = 0; k < 4; k++)
+    {
+        buffer[k] = base + sign * fabsf(RandomFloat(true));
+        keys[k] = RandomFloat();
+        masks[k] = RandomMask();
+    }
+    const PixelScalar::quad_f scalar_stored = PixelScalar::QuadLoadDepth(buffer, count);
+    const PixelVector::quad_f vector_stored = PixelVector::QuadLoadDepth(buffer, count);
+    CompareFloats("QuadLoadDepth", round, scalar_stored, vector_stored);
+
+    PixelScalar::quad_f scalar_key;
+    PixelVector::quad_f vector_key;
+    PixelScalar::quad_i scalar_mask;
+    PixelVector::quad_i vector_mask;
+    MakeQuads(keys, scalar_key, vector_key);
+    MakeQuads(masks, scalar_mask, vector_mask);
+    CompareInts("QuadDepthPass", round, PixelScalar::QuadDepthPass(scalar_key, scalar_stored, base, sign),
+        PixelVector::QuadDepthPass(vector_key, vector_stored, base, sign));
+
+    float scalar_buffer[4], vector_buffer[4];
+    memcpy(scalar_buffer, buffer, sizeof(buffer));
+    memcpy(vector_buffer, buffer, sizeof(buffer));
+    PixelScalar::QuadStoreDepth(scalar_buffer, scalar_key, scalar_mask, base, sign, count);
+    PixelVector::QuadStoreDepth(vector_buffer, vector_key, vector_mask, base, sign, count);
+    for (uint32_t k = 0; k < 4; k++)
+    {
+        if (!SameFloat(scalar_buffer[k], vector_buffer[k])) Differs("QuadStoreDepth", round, k, scalar_buffer[k], vector_buffer[k]);
+    }
+}
+
+// 1/w about the clamp of the reciprocal format and beyond it, NaN excepted as a cast of it is undefined
+static void FuzzKeyReciprocal(const uint32_t round)
+{
+    const float low = DepthOneOverW(DEPTH_FAR), high = DepthOneOverW(DEPTH_NEAR);
+    const float scale = DEPTH_KEY16_FAR / (high - low);
+    float one_over_w[4];
+    for (uint32_t k = 0; k < 4; k++)
+    {
+        const uint32_t pick = rng() % 8;
+        if (pick == 0) one_over_w[k] = (rng() & 1) ? low : high;
+        else if (pick == 1) one_over_w[k] = nextafterf((rng() & 1) ? low : high, (rng() & 1) ? INFINITY : -INFINITY);
+        else if (pick == 2) one_over_w[k] = RandomFloat(true);
+        else one_over_w[k] = std::uniform_real_distribution<float>(0.0f, 2.5f)(rng);
+    }
+    PixelScalar::quad_f scalar;
+    PixelVector::quad_f vector;
+    MakeQuads(one_over_w, scalar, vector);
+    CompareInts("QuadKeyReciprocal", round, PixelScalar::QuadKeyReciprocal(scalar, low, high, high, scale),
+        PixelVector::QuadKeyReciprocal(vector, low, high, high, scale));
+}
+
+static void FuzzPack565(const uint32_t round)
+{
+    uint32_t colours[4], shares[4];
+    for (uint32_t k = 0; k < 4; k++)
+    {
+        colours[k] = rng();
+        shares[k] = (rng() & 3) ? rng() % 256 : ((rng() & 1) ? 0 : 255);
+    }
+    const uint32_t fog_colour = rng() & 0x00ffffff;
+    PixelScalar::quad_u scalar_colour, scalar_share;
+    PixelVector::quad_u vector_colour, vector_share;
+    MakeQuads(colours, scalar_colour, vector_colour);
+    MakeQuads(shares, scalar_share, vector_share);
+    CompareInts("QuadPack565", round, PixelScalar::QuadPack565(scalar_colour, scalar_share, fog_colour),
+        PixelVector::QuadPack565(vector_colour, vector_share, fog_colour));
+}
+
+static uint32_t FuzzBackends()
+{
+    printf("PixelVector against PixelScalar, %d rounds of each\n", FUZZ_ROUNDS);
+    uint32_t failed = 0;
+    failed += FuzzFunction("QuadRamp", FuzzRamp);
+    failed += FuzzFunction("QuadLaneMask", FuzzLaneMask);
+    failed += FuzzFunction("QuadAnd QuadAny", FuzzAndAny);
+    failed += FuzzFunction("QuadEdgeMask", FuzzEdgeMask);
+    failed += FuzzFunction("Depth 16 bit", FuzzDepth16);
+    failed += FuzzFunction("Depth float", FuzzDepthFloat);
+    failed += FuzzFunction("QuadKeyReciprocal", FuzzKeyReciprocal);
+    failed += FuzzFunction("QuadPack565", FuzzPack565);
+    return (failed);
+}
+
+// ************************************************************************************************
+// Benchmark
+
+static std::vector<uint8_t> LoadFile(const char * name)
+{
+    std::vector<uint8_t> data;
+    FILE * in = fopen(name, "rb");
+    if (!in) return (data);
+    uint8_t buffer[65536];
+    size_t got;
+    while ((got = fread(buffer, 1, sizeof(buffer), in)) > 0) data.insert(data.end(), buffer, buffer + got);
+    fclose(in);
+    return (data);
+}
+
+// What CheckTriangles queues for a view, as RenderCheck.cpp draws it
+static void QueueView(const Vec3f view_eye, const Vec3f view_direction, std::vector<TriToRaster> & items)
+{
+    EmptyQueues();
+    for (uint32_t index = 0; ; index++)
+    {
+        for (const EachLayout & layout : world)
+        {
+            const WorldLayout * layo_ptr = &layout.frame_layouts[0];
+            const uint32_t chunk = IndexChunkChooser(view_eye, view_direction, index, layo_ptr);
+            if (chunk == LAST_CHUNK) goto ChunksDone;
+            CheckTriangles(view_eye, view_direction, chunk, layo_ptr);
+        }
+    }
+ChunksDone:
+    const uint32_t block = flipped ? 2 : 0; // As CheckTriangles chooses
+    for (uint32_t queue = block; queue < block + 2; queue++)
+    {
+        items.insert(items.end(), BlockA[queue].itemptr, BlockA[queue].itemptr + BlockA[queue].count);
+    }
+    EmptyQueues();
+}
+
+static uint32_t BoxPixels(const std::vector<TriToRaster> & items)
+{
+    uint32_t pixels = 0;
+    for (const TriToRaster & item : items)
+    {
+        const float width = std::min(item.BoBox.m_MaxX, (float)g_scWidth) - std::max(item.BoBox.m_MinX, 0.0f);
+        const float height = std::min(item.BoBox.m_MaxY, (float)g_scHeight) - std::max(item.BoBox.m_MinY, 0.0f);
+        if (width > 0.0f && height > 0.0f) pixels += (uint32_t)(width * height);
+    }
+    return (pixels);
+}
+
+// Draws the items with one kernel into a cleared frame, returning the time of the best of BENCH_REPEATS
+static double DrawItems(const std::vector<TriToRaster> & items, const Raster_kernel kernel)
+{
+    double best = 1.0e30;
+    for (uint32_t repeat = 0; repeat < BENCH_REPEATS; repeat++)
+    {
+        ClearWorldFrame(frame_buffer_this);
+        ClearDepthBuffer(DEPTH_FAR);
+        const auto before = std::chrono::steady_clock::now();
+        for (const TriToRaster & item : items) kernel(item);
+        best = std::min(best, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - before).count());
+    }
+    return (best);
+}
+
+static void BenchKernels(const std::vector<TriToRaster> & all_items, const uint32_t views)
+{
+    const uint32_t pixels = g_scWidth * g_scHeight;
+    std::vector<uint16_t> quad_frame(pixels), pixel_frame(pixels);
+    std::vector<depth_t> quad_depth(pixels), pixel_depth(pixels);
+
+    printf("\n%d items from %d views, %s backend, best of %d\n", (int)all_items.size(), (int)views,
+        (PIXEL_SIMD == PIXEL_SIMD_SCALAR) ? "scalar" : "vector", BENCH_REPEATS);
+    printf("variant                   items   pixels   four-lane ns/px   per-pixel ns/px   speed up   pixels differ\n");
+    double quad_total = 0.0, pixel_total = 0.0;
+    for (uint32_t variant = 0; variant < 8; variant++)
+    {
+        const bool edge_test = !(variant & 4), textured = variant & 2, fogged = variant & 1;
+        const Raster_kernel quad_kernel = KernelVariant(edge_test, textured, fogged);
+        const Raster_kernel pixel_kernel = KernelVariant(edge_test, textured, fogged, true);
+
+        std::vector<TriToRaster> items;
+        for (const TriToRaster & item : all_items) if (item.kernel == KernelIndex(edge_test, textured, fogged)) items.push_back(item);
+        char name[32];
+        snprintf(name, sizeof(name), "%s %s %s", edge_test ? "edge" : "tile", textured ? "textured" : "flat", fogged ? "fogged" : "clear");
+        if (items.empty())
+        {
+            printf("%-24s %6d\n", name, 0);
+            continue;
+        }
+        const uint32_t box_pixels = BoxPixels(items);
+
+        const double quad_ns = DrawItems(items, quad_kernel);
+        std::copy(frame_buffer_this, frame_buffer_this + pixels, quad_frame.begin());
+        std::copy(depthBuffer, depthBuffer + pixels, quad_depth.begin());
+        const double pixel_ns = DrawItems(items, pixel_kernel);
+        std::copy(frame_buffer_this, frame_buffer_this + pixels, pixel_frame.begin());
+        std::copy(depthBuffer, depthBuffer + pixels, pixel_depth.begin());
+        quad_total += quad_ns;
+        pixel_total += pixel_ns;
+
+        uint32_t differ = 0;
+        for (uint32_t pixel = 0; pixel < pixels; pixel++)
+        {
+            if ((quad_frame[pixel] != pixel_frame[pixel]) || (quad_depth[pixel] != pixel_depth[pixel])) differ++;
+        }
+        printf("%-24s %6d %8d %17.2f %17.2f %9.2fx %15d\n", name, (int)items.size(), (int)box_pixels,
+            quad_ns / box_pixels, pixel_ns / box_pixels, pixel_ns / quad_ns, (int)differ);
+    }
+    if (quad_total > 0.0) printf("all variants %.0fus four-lane, %.0fus per-pixel, %.2fx\n", quad_total / 1000.0, pixel_total / 1000.0, pixel_total / quad_total);
+}
+
+int main(int argc, char ** argv)
+{
+    if ((argc != 1) && (argc != 3))
+    {
+        fprintf(stderr, "Usage: %s [world.bin textures.bin]\n", argv[0]);
+        return (1);
+    }
+
+    const uint32_t failed = FuzzBackends();
+    printf("PixelBench: %d lanes differ\n", (int)failed);
+    if (argc == 1) return (failed ? 1 : 0);
+
+    std::vector<uint8_t> world_image = LoadFile(argv[1]);
+    std::vector<uint8_t> texture_image = LoadFile(argv[2]);
+    if (world_image.empty() || texture_image.empty())
+    {
+        fprintf(stderr, "Can't read %s or %s\n", argv[1], argv[2]);
+        return (1);
+    }
+
+    // As app_main() up to the benchmarks
+    frame_buffer_A = new uint16_t[g_scWidth * g_scHeight];
+    frame_buffer_B = new uint16_t[g_scWidth * g_scHeight];
+    MakeDepthBuffer();
+    MakeQueue(6000, 0);
+    MakeQueue(5000, 1);
+    MakeQueue(6000, 2);
+    MakeQueue(5000, 3);
+    ProjectionMatrix();
+    const world_partition_header * header = (const world_partition_header *)world_image.data();
+    eye = header->eye;
+    direction = header->direction;
+    eye_level = eye.y;
+    ParseWorld(world_image.data(), texture_image.data());
+
+    // Frames are cleared rather than resolved, the depth encoding being the plain one
+    clear_free_frames = false;
+    depth_base = 0;
+    depth_sign = 1;
+    SetRasterQuality(quality_build);
+    frame_buffer_this = frame_buffer_A;
+
+    // Views from the start and from points across the first layout, so that each variant is met
+    std::vector<TriToRaster> items;
+    std::vector<Vec3f> places = { eye };
+    const ChunkArr & area = world[0].frame_layouts[0].ChAr;
+    for (uint32_t row = 1; row < BENCH_PLACES; row++)
+    {
+        for (uint32_t column = 1; column < BENCH_PLACES; column++)
+        {
+            places.push_back({ (float)(area.xmin + (int32_t)(area.xcount * area.size * column / BENCH_PLACES)), eye.y,
+                (float)(area.zmin + (int32_t)(area.zcount * area.size * row / BENCH_PLACES)) });
+        }
+    }
+    for (const Vec3f & place : places)
+    {
+        Vec3f view = direction;
+        for (uint32_t turn = 0; turn < BENCH_VIEWS; turn++)
+        {
+            QueueView(place, view, items);
+            view = { view.z, view.y, -view.x }; // 90 degrees to the left
+        }
+    }
+    BenchKernels(items, places.size() * BENCH_VIEWS);
+    return (failed ? 1 : 0);
+}
@@ -0,0 +1,197 @@
+// Host test of the packed pixel arithmetic against per channel references
+//
+// spec_shade_pixel() shades red and blue together in one word and saturates the specular addition
+// by turning a carry into the spare byte above each channel into a full channel. WritePixelMix() and
+// QuadPack565() mix red and blue with fog together too and take the top bits of each mix as the 565
+// channel. Both rely on no channel reaching its neighbour, which these check exhaustively: every
+// lambertian and specular share with every value of each channel, the other channels at 0, 255 and
+// a value that varies with it, and the top byte clear and set as the palette's flags leave it, then
+// every fog share against every fog and colour value of each channel, for each backend of PixelSimd.h.
+//
+// Build on the host with
+//   g++ -O2 -std=gnu++17 -include stdint.h -I../HostStubs -I../../main/includes PixelTest.cpp
+//     ../../main/{CheckTriangles,RasteriseBox,ClipBound,CameraWork,ChunkChooser,TriangleQueues,OcclusionCull,RenderScale,
+//     CostModel,QualityGovernor,HorizonPanorama,ImpostorCache,ShowError,FindHitFace,ParseWorld,HeatMap}.cpp -o PixelTest
+// Use with
+//   ./PixelTest
+// which exits with 1 if any result differs from its reference
+
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+
+#include "globals.h"
+#include "geometry.h"
+#include "structures.h"
+#include "RasteriseBox.h"
+#include "PixelSimd.h"
+
+// The globals that the renderer expects from i80_lcd_main.cpp and EventManager.cpp
+std::vector<EachLayout> world;
+std::vector<WorldLayout> the_layouts;
+uint16_t * frame_buffer_A;
+uint16_t * frame_buffer_B;
+bool flipped = true;
+extern constexpr uint32_t fog = 0x00303030;
+extern constexpr uint16_t BackgroundColour = ((fog >> 8) & 0b1111100000000000) | ((fog >> 5) & 0b0000011111100000) | ((fog >> 3) & 0b0000000000011111);
+float eye_level;
+Vec3f eye, direction;
+Time_tracked time_report;
+
+extern uint16_t * frame_buffer_this;
+
+#define REPORTED 8 // Failures listed of each check
+
+// The lanes of both backends, told apart by their types
+using PixelScalar::QuadLane;
+using PixelScalar::QuadSetLane;
+#if defined(__GNUC__)
+using PixelVector::QuadLane;
+using PixelVector::QuadSetLane;
+#endif
+
+static uint32_t failures = 0;
+
+static void Fail(const char * check, const uint32_t input, const uint32_t share, const uint32_t got, const uint32_t expected)
+{
+    if (failures++ < REPORTED) printf("  %s of %08x at %d gave %08x, expected %08x\n", check, (unsigned)input, (int)share, (unsigned)got, (unsigned)expected);
+}
+
+// The channel at shift 16, 8 or 0 set to value and the others to a pattern
+static uint32_t Colour(const uint32_t shift, const uint32_t value, const uint32_t pattern, const uint32_t top)
+{
+    const uint32_t other = (pattern == 0) ? 0 : ((pattern == 1) ? 255 : (value * 37 + 11) & 0xff);
+    const uint32_t others = (other << 16) | (other << 8) | other;
+    return (top | (others & ~(0xffu << shift)) | (value << shift));
+}
+
+// Each channel shaded on its own, as floats would but rounded down, then saturated
+static uint32_t ShadeReference(const uint32_t rgb888, const uint32_t lamb, const uint32_t spec)
+{
+    uint32_t result = 0;
+    for (uint32_t shift = 0; shift <= 16; shift += 8)
+    {
+        const uint32_t channel = (((rgb888 >> shift) & 0xff) * lamb >> 8) + spec;
+        result |= std::min(channel, (uint32_t)255) << shift;
+    }
+    return (result);
+}
+
+// Each channel mixed with fog on its own and its top bits taken
+static uint32_t MixReference(const uint32_t rgb888, const uint32_t fog_colour, const uint32_t share)
+{
+    const auto mix = [&](const uint32_t shift) { return (((fog_colour >> shift) & 0xff) * (255 - share) + ((rgb888 >> shift) & 0xff) * share); };
+    return (((mix(16) >> 11) << 11) | ((mix(8) >> 10) << 5) | (mix(0) >> 11));
+}
+
+static void CheckShade()
+{
+    for (uint32_t lamb = 0; lamb < 256; lamb++)
+    {
+        for (uint32_t spec = 0; spec < 256; spec++)
+        {
+            const Shade_params shade = { lamb, spec };
+            for (uint32_t shift = 0; shift <= 16; shift += 8)
+            {
+                for (uint32_t pattern = 0; pattern < 3; pattern++)
+                {
+                    for (const uint32_t top : { 0x00000000u, 0xff000000u })
+                    {
+                        for (uint32_t value = 0; value < 256; value++)
+                        {
+                            const uint32_t rgb888 = Colour(shift, value, pattern, top);
+                            const uint32_t got = spec_shade_pixel(rgb888, shade);
+                            const uint32_t expected = ShadeReference(rgb888, lamb, spec);
+                            if (got != expected) Fail("spec_shade_pixel", rgb888, (lamb << 8) | spec, got, expected);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// WritePixelMix() only mixes with the fog of i80_lcd_main.cpp
+static void CheckWritePixelMix()
+{
+    uint16_t pixel;
+    frame_buffer_this = &pixel;
+    for (uint32_t share = 0; share < 256; share++)
+    {
+        for (uint32_t shift = 0; shift <= 16; shift += 8)
+        {
+            for (uint32_t pattern = 0; pattern < 3; pattern++)
+            {
+                for (uint32_t value = 0; value < 256; value++)
+                {
+                    const uint32_t rgb888 = Colour(shift, value, pattern, 0xff000000);
+                    WritePixelMix(0, rgb888, share);
+                    const uint32_t expected = MixReference(rgb888, fog, share);
+                    if (pixel != expected) Fail("WritePixelMix", rgb888, share, pixel, expected);
+                }
+            }
+        }
+    }
+    frame_buffer_this = nullptr;
+}
+
+// Each lane gets a different colour so that lanes leaking into each other show
+template <typename Quad, typename Pack>
+static void CheckPack565(const char * check, Pack pack)
+{
+    for (uint32_t fog_value = 0; fog_value < 256; fog_value++)
+    {
+        for (uint32_t shift = 0; shift <= 16; shift += 8)
+        {
+            const uint32_t fog_colour = Colour(shift, fog_value, 2, 0);
+            for (uint32_t share = 0; share < 256; share++)
+            {
+                for (uint32_t value = 0; value < 256; value += 4)
+                {
+                    Quad rgb888, shares;
+                    for (uint32_t k = 0; k < 4; k++)
+                    {
+                        QuadSetLane(rgb888, k, Colour(shift, value + k, k % 3, 0xff000000));
+                        QuadSetLane(shares, k, (share + k * 64) & 0xff);
+                    }
+                    const Quad got = pack(rgb888, shares, fog_colour);
+                    for (uint32_t k = 0; k < 4; k++)
+                    {
+                        const uint32_t expected = MixReference(QuadLane(rgb888, k), fog_colour, QuadLane(shares, k));
+                        if (QuadLane(got, k) != expected) Fail(check, QuadLane(rgb888, k), QuadLane(shares, k), QuadLane(got, k), expected);
+                    }
+                }
+            }
+        }
+    }
+}
+
+int main()
+{
+    uint32_t failed = 0;
+
+    CheckShade();
+    printf("spec_shade_pixel %s\n", failures ? "FAILED" : "passed");
+    failed += failures;
+    failures = 0;
+
+    CheckWritePixelMix();
+    printf("WritePixelMix %s\n", failures ? "FAILED" : "passed");
+    failed += failures;
+    failures = 0;
+
+    CheckPack565<PixelScalar::quad_u>("PixelScalar::QuadPack565", PixelScalar::QuadPack565);
+    printf("PixelScalar::QuadPack565 %s\n", failures ? "FAILED" : "passed");
+    failed += failures;
+    failures = 0;
+
+#if defined(__GNUC__)
+    CheckPack565<PixelVector::quad_u>("PixelVector::QuadPack565", PixelVector::QuadPack565);
+    printf("PixelVector::QuadPack565 %s\n", failures ? "FAILED" : "passed");
+    failed += failures;
+#endif
+
+    printf("PixelTest: %d results differ\n", (int)failed);
+    return (failed ? 1 : 0);
+}
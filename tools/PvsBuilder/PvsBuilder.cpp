@@ -0,0 +1,407 @@
+// Host tool to add a potentially visible set (PVS) to a world partition binary
+//
+// For every chunk of every layout frame it finds which chunks of the same layout can be seen from
+// anywhere inside it, then writes a copy of the binary with a WORLD_DESC_PVS descriptor after each
+// layout and the bitsets appended at the end. The ESP then skips chunks that aren't in the set of the
+// chunk that the eye is in, see chunk_visible() in ChunkChooser.cpp.
+//
+// Visibility is found by casting segments from sample eye positions in the source chunk to sample
+// points on the faces of the target chunk. The segment is tested against the faces of each chunk
+// that it passes over, found by stepping along the chunk grid. Sampling can miss a view through a
+// narrow gap so increase the sample counts below for worlds with small windows.
+//
+// Faces that can be deleted in play are never used to hide anything and only faces of the same
+// layout are considered, so a building in one layout doesn't hide chunks of another.
+//
+// Build on the host with
+//   g++ -O2 -std=c++17 -include stdint.h -I../../main/includes PvsBuilder.cpp -o PvsBuilder
+// Use with
+//   ./PvsBuilder DiscWorld11.bin DiscWorld11_pvs.bin
+// The input must be straight from the world converter, not already have a PVS.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+#include "geometry.h"
+#include "structures.h"
+
+// EVNT_FACES from EventManager.h, which can't be included here as it needs FreeRTOS
+const uint32_t EVNT_FACES = 0x20000000;
+
+// Sample eye positions across a chunk square in each direction, and the number of heights
+const uint32_t EYE_SAMPLES = 4;
+const uint32_t EYE_HEIGHTS = 3;
+const float EYE_LEVEL = 1.5f; // Roughly the height of the eye above whatever the player stands on
+
+// The most points on the faces of a target chunk that are tried before deciding it is hidden
+const uint32_t TARGET_SAMPLES = 96;
+
+// Chunks further than this in either direction are marked visible without testing as the
+// chunk sequence in ChunkChooser.cpp doesn't reach that far
+const int32_t PVS_RADIUS = 6;
+
+// The world partition is 4MB in partitions_3D.csv
+const size_t PARTITION_SIZE = 4 * 1024 * 1024;
+
+// One frame of a layout read from the binary
+struct Layout
+{
+    const uint8_t * base;               // The world_header
+    const Vec3f * vertices;
+    const uint16_t * nvertices;
+    const uint16_t * attributes;
+    const part_faceMaterials * palette;
+    ChunkArr ChAr;
+    std::vector<std::vector<uint32_t>> chunk_faces; // Faces of the whole layout
+    std::vector<uint32_t> vertex_bases;             // Of each face, from its chunk's entry
+    std::vector<Vec3f> dequantised;                 // The vertices of CHUNK_FORMAT_QUANTISED in world space
+};
+
+// A descriptor and its offsets as found in the partition header
+struct Descriptor
+{
+    uint32_t word;
+    std::vector<uint32_t> offsets;
+};
+
+static uint32_t read32(const uint8_t * ptr)
+{
+    uint32_t value;
+    memcpy(&value, ptr, sizeof(value)); // The world offsets are not always 4 byte aligned
+    return (value);
+}
+
+static Layout ReadLayout(const uint8_t * image, const uint32_t offset)
+{
+    Layout layout;
+    const uint8_t * base = image + offset;
+    const world_header * header = (const world_header *) base;
+
+    layout.base = base;
+    layout.vertices = (const Vec3f *)(base + header->vertices);
+    layout.nvertices = (const uint16_t *)(base + header->nvertices);
+    layout.attributes = (const uint16_t *)(base + header->attributes);
+    layout.palette = (const part_faceMaterials *)(base + header->thin_palette + sizeof(uint32_t));
+
+    // Chunk block is 5 parameters and the format then an offset and count for each chunk, which
+    // with CHUNK_FORMAT_BASES or CHUNK_FORMAT_QUANTISED are followed by its face, vertex and UV bases
+    const int16_t * chunk_params = (const int16_t *)(base + header->chunks);
+    layout.ChAr = { chunk_params[0], chunk_params[1], chunk_params[2], chunk_params[3], chunk_params[4] };
+    const bool quantised = (chunk_params[5] == CHUNK_FORMAT_QUANTISED);
+    const bool chunk_bases = (chunk_params[5] == CHUNK_FORMAT_BASES) || quantised;
+    const uint32_t entry_size = chunk_bases ? 20 : 8;
+
+    const uint8_t * chunk_block = (const uint8_t *) chunk_params;
+    const uint8_t * chunk_map = chunk_block + sizeof(uint16_t) * 6;
+    const uint32_t chunk_count = layout.ChAr.xcount * layout.ChAr.zcount;
+    layout.chunk_faces.resize(chunk_count);
+    for (uint32_t chunk = 0; chunk < chunk_count; chunk++)
+    {
+        const uint8_t * entry = chunk_map + chunk * entry_size;
+        const uint32_t face_count = read32(entry + 4);
+        const uint32_t face_base = chunk_bases ? read32(entry + 8) : 0;
+        const uint32_t vertex_base = chunk_bases ? read32(entry + 12) : 0;
+        const uint16_t * faces = (const uint16_t *)(chunk_block + read32(entry));
+        for (uint32_t face = 0; face < face_count; face++)
+        {
+            const uint32_t idx = face_base + faces[face];
+            if (idx >= layout.vertex_bases.size()) layout.vertex_bases.resize(idx + 1);
+            layout.vertex_bases[idx] = vertex_base;
+            layout.chunk_faces[chunk].push_back(idx);
+
+            // Each chunk has its own quantised vertices, from the corner of its square
+            for (uint32_t corner = 0; quantised && (corner < 3); corner++)
+            {
+                const uint32_t vertex = vertex_base + layout.nvertices[idx * 3 + corner];
+                const Quant_vertex & q = ((const Quant_vertex *)layout.vertices)[vertex];
+                const float step = (float)layout.ChAr.size / QUANT_CHUNK_STEPS;
+                if (vertex >= layout.dequantised.size()) layout.dequantised.resize(vertex + 1);
+                layout.dequantised[vertex] = Vec3f(layout.ChAr.xmin + (int32_t)(chunk % layout.ChAr.xcount) * layout.ChAr.size + q.x * step, q.y * step,
+                    layout.ChAr.zmin + (int32_t)(chunk / layout.ChAr.xcount) * layout.ChAr.size + q.z * step);
+            }
+        }
+    }
+    return (layout);
+}
+
+static Vec3f FaceVertex(const Layout & layout, const uint32_t face, const uint32_t corner)
+{
+    const uint32_t vertex = layout.vertex_bases[face] + layout.nvertices[face * 3 + corner];
+    return (layout.dequantised.empty() ? layout.vertices[vertex] : layout.dequantised[vertex]);
+}
+
+// Faces with a delete event may vanish during play so they can't be relied on to hide anything
+static bool FaceOccludes(const Layout & layout, const uint32_t face)
+{
+    const uint32_t event = layout.palette[layout.attributes[face]].event_code;
+    return (!(event & EVNT_FACES));
+}
+
+// Moller-Trumbore test for the segment from p along d, only hits strictly between the ends count
+static bool SegmentHitsFace(const Vec3f & p, const Vec3f & d, const Vec3f & v0, const Vec3f & v1, const Vec3f & v2)
+{
+    const Vec3f e1 = v1 - v0;
+    const Vec3f e2 = v2 - v0;
+    const Vec3f h = d.crossProduct(e2);
+    const float a = e1.dotProduct(h);
+    if (fabsf(a) < 1e-9f) return (false); // Edge on to the segment
+
+    const float f = 1.0f / a;
+    const Vec3f s = p - v0;
+    const float u = f * s.dotProduct(h);
+    if ((u < 0.0f) || (u > 1.0f)) return (false);
+    const Vec3f q = s.crossProduct(e1);
+    const float v = f * d.dotProduct(q);
+    if ((v < 0.0f) || (u + v > 1.0f)) return (false);
+    const float t = f * e2.dotProduct(q);
+    return ((t > 1e-4f) && (t < 1.0f - 1e-3f));
+}
+
+// Step along the chunk grid under the segment and test it against the faces of each chunk passed
+static bool SegmentClear(const Layout & layout, const Vec3f & p, const Vec3f & q)
+{
+    const ChunkArr & ChAr = layout.ChAr;
+    const Vec3f d = q - p;
+
+    const float gx = (p.x - ChAr.xmin) / ChAr.size;
+    const float gz = (p.z - ChAr.zmin) / ChAr.size;
+    const float dx = d.x / ChAr.size;
+    const float dz = d.z / ChAr.size;
+
+    int32_t cx = (int32_t) floorf(gx);
+    int32_t cz = (int32_t) floorf(gz);
+    const int32_t end_x = (int32_t) floorf(gx + dx);
+    const int32_t end_z = (int32_t) floorf(gz + dz);
+    const int32_t step_x = (dx > 0) ? 1 : -1;
+    const int32_t step_z = (dz > 0) ? 1 : -1;
+    const float delta_x = (dx != 0.0f) ? fabsf(1.0f / dx) : INFINITY;
+    const float delta_z = (dz != 0.0f) ? fabsf(1.0f / dz) : INFINITY;
+    float next_x = (dx != 0.0f) ? (((dx > 0) ? (cx + 1 - gx) : (gx - cx)) * delta_x) : INFINITY;
+    float next_z = (dz != 0.0f) ? (((dz > 0) ? (cz + 1 - gz) : (gz - cz)) * delta_z) : INFINITY;
+
+    // One chunk for the start and one for each grid line crossed
+    const int32_t crossings = abs(end_x - cx) + abs(end_z - cz);
+    for (int32_t step = 0; step <= crossings; step++)
+    {
+        if ((cx >= 0) && (cx < ChAr.xcount) && (cz >= 0) && (cz < ChAr.zcount))
+        {
+            for (const uint32_t face : layout.chunk_faces[cx + ChAr.xcount * cz])
+            {
+                if (!FaceOccludes(layout, face)) continue;
+                if (SegmentHitsFace(p, d, FaceVertex(layout, face, 0), FaceVertex(layout, face, 1), FaceVertex(layout, face, 2))) return (false);
+            }
+        }
+        if (next_x < next_z)
+        {
+            cx += step_x;
+            next_x += delta_x;
+        }
+        else
+        {
+            cz += step_z;
+            next_z += delta_z;
+        }
+    }
+    return (true);
+}
+
+// Build the PVS bitsets of one layout frame
+static std::vector<uint32_t> BuildPVS(const Layout & layout, const uint32_t words)
+{
+    const ChunkArr & ChAr = layout.ChAr;
+    const uint32_t chunk_count = ChAr.xcount * ChAr.zcount;
+    std::vector<uint32_t> bits(chunk_count * words, 0);
+
+    // The vertical range of the layout sets the eye heights to try
+    float y_min = INFINITY, y_max = -INFINITY;
+    for (const auto & faces : layout.chunk_faces)
+    {
+        for (const uint32_t face : faces)
+        {
+            for (uint32_t corner = 0; corner < 3; corner++)
+            {
+                y_min = std::min(y_min, FaceVertex(layout, face, corner).y);
+                y_max = std::max(y_max, FaceVertex(layout, face, corner).y);
+            }
+        }
+    }
+    if (y_min > y_max) return (std::vector<uint32_t>(chunk_count * words, 0xffffffff)); // No faces at all
+
+    // Sample points on the faces of each chunk, pulled in slightly so they aren't on shared edges
+    std::vector<std::vector<Vec3f>> targets(chunk_count);
+    for (uint32_t chunk = 0; chunk < chunk_count; chunk++)
+    {
+        std::vector<Vec3f> points;
+        for (const uint32_t face : layout.chunk_faces[chunk])
+        {
+            const Vec3f v0 = FaceVertex(layout, face, 0);
+            const Vec3f v1 = FaceVertex(layout, face, 1);
+            const Vec3f v2 = FaceVertex(layout, face, 2);
+            const Vec3f centre = (v0 + v1 + v2) * (1.0f / 3.0f);
+            points.push_back(centre);
+            points.push_back(centre + (v0 - centre) * 0.9f);
+            points.push_back(centre + (v1 - centre) * 0.9f);
+            points.push_back(centre + (v2 - centre) * 0.9f);
+        }
+        // Keep an even spread of them if there are too many
+        const size_t stride = (points.size() + TARGET_SAMPLES - 1) / TARGET_SAMPLES;
+        for (size_t i = 0; i < points.size(); i += std::max(stride, (size_t)1)) targets[chunk].push_back(points[i]);
+    }
+
+    for (int32_t sz = 0; sz < ChAr.zcount; sz++)
+    {
+        for (int32_t sx = 0; sx < ChAr.xcount; sx++)
+        {
+            const uint32_t source = sx + ChAr.xcount * sz;
+            uint32_t * source_bits = &bits[source * words];
+
+            // Eye positions spread across the chunk and over the layout's heights
+            std::vector<Vec3f> eyes;
+            for (uint32_t h = 0; h < EYE_HEIGHTS; h++)
+            {
+                const float y = y_min + EYE_LEVEL + (y_max - y_min) * h / std::max(EYE_HEIGHTS - 1, (uint32_t)1);
+                for (uint32_t ez = 0; ez < EYE_SAMPLES; ez++)
+                {
+                    for (uint32_t ex = 0; ex < EYE_SAMPLES; ex++)
+                    {
+                        eyes.push_back(Vec3f(ChAr.xmin + ChAr.size * (sx + (ex + 0.5f) / EYE_SAMPLES), y,
+                                             ChAr.zmin + ChAr.size * (sz + (ez + 0.5f) / EYE_SAMPLES)));
+                    }
+                }
+            }
+
+            for (int32_t tz = 0; tz < ChAr.zcount; tz++)
+            {
+                for (int32_t tx = 0; tx < ChAr.xcount; tx++)
+                {
+                    const uint32_t target = tx + ChAr.xcount * tz;
+                    const int32_t reach = std::max(abs(tx - sx), abs(tz - sz));
+                    bool visible = false;
+
+                    if (targets[target].empty()) visible = false; // Nothing to draw
+                    else if ((reach <= 1) || (reach > PVS_RADIUS)) visible = true; // Neighbours and the far field
+                    else
+                    {
+                        for (size_t e = 0; !visible && (e < eyes.size()); e++)
+                        {
+                            for (size_t t = 0; !visible && (t < targets[target].size()); t++)
+                            {
+                                visible = SegmentClear(layout, eyes[e], targets[target][t]);
+                            }
+                        }
+                    }
+                    if (visible) source_bits[target >> 5] |= 1u << (target & 0x1f);
+                }
+            }
+        }
+    }
+    return (bits);
+}
+
+int main(int argc, char ** argv)
+{
+    if (argc != 3)
+    {
+        fprintf(stderr, "Usage: %s world.bin world_pvs.bin\n", argv[0]);
+        return (1);
+    }
+
+    FILE * in = fopen(argv[1], "rb");
+    if (!in)
+    {
+        fprintf(stderr, "Can't open %s\n", argv[1]);
+        return (1);
+    }
+    std::vector<uint8_t> image;
+    uint8_t buffer[65536];
+    size_t got;
+    while ((got = fread(buffer, 1, sizeof(buffer), in)) > 0) image.insert(image.end(), buffer, buffer + got);
+    fclose(in);
+
+    // Read the descriptors that follow the eye and direction in the partition header
+    const uint32_t list_start = offsetof(world_partition_header, world_start);
+    std::vector<Descriptor> descriptors;
+    uint32_t position = list_start;
+    uint32_t word;
+    while ((word = read32(&image[position])))
+    {
+        if (word & WORLD_DESC_PVS)
+        {
+            fprintf(stderr, "%s already has a PVS\n", argv[1]);
+            return (1);
+        }
+        if (!(word & WORLD_DESC_LAYOUT))
+        {
+            fprintf(stderr, "Unexpected descriptor %08x\n", word);
+            return (1);
+        }
+        Descriptor descriptor = { word, {} };
+        const uint32_t frames = (word & WORLD_DESC_FRAMES) >> WORLD_DESC_FRAMES_SHIFT;
+        position += sizeof(uint32_t);
+        for (uint32_t frame = 0; frame < frames; frame++)
+        {
+            descriptor.offsets.push_back(read32(&image[position]));
+            position += sizeof(uint32_t);
+        }
+        descriptors.push_back(descriptor);
+    }
+    const uint32_t list_end = position + sizeof(uint32_t); // After the terminator
+
+    // Each layout gains a PVS descriptor with an offset per frame, moving everything after the list
+    uint32_t added = 0;
+    for (const Descriptor & descriptor : descriptors) added += (1 + descriptor.offsets.size()) * sizeof(uint32_t);
+
+    std::vector<uint8_t> output(image.begin(), image.begin() + list_start);
+    std::vector<uint32_t> list;
+    std::vector<uint8_t> pvs_blocks;
+    const uint32_t data_end = image.size() + added;
+    const uint32_t pvs_start = (data_end + 3) & ~0x03; // Keep the bitsets word aligned
+
+    for (const Descriptor & descriptor : descriptors)
+    {
+        list.push_back(descriptor.word);
+        for (const uint32_t offset : descriptor.offsets) list.push_back(offset + added);
+
+        list.push_back(WORLD_DESC_PVS | (descriptor.word & (WORLD_DESC_FRAMES | 0x0000ffff)));
+        for (const uint32_t offset : descriptor.offsets)
+        {
+            const Layout layout = ReadLayout(image.data(), offset);
+            const uint32_t chunk_count = layout.ChAr.xcount * layout.ChAr.zcount;
+            const uint32_t words = (chunk_count + 31) / 32;
+            const std::vector<uint32_t> bits = BuildPVS(layout, words);
+
+            uint32_t visible = 0;
+            for (const uint32_t bitset : bits) visible += __builtin_popcount(bitset);
+            printf("Layout %08x at %06x: %dx%d chunks, average %.1f visible\n", descriptor.word, offset,
+                layout.ChAr.xcount, layout.ChAr.zcount, (float)visible / chunk_count);
+
+            list.push_back(pvs_start + pvs_blocks.size());
+            const uint32_t header[2] = { chunk_count, words };
+            pvs_blocks.insert(pvs_blocks.end(), (const uint8_t *) header, (const uint8_t *) header + sizeof(header));
+            pvs_blocks.insert(pvs_blocks.end(), (const uint8_t *) bits.data(), (const uint8_t *) bits.data() + bits.size() * sizeof(uint32_t));
+        }
+    }
+    list.push_back(0);
+
+    output.insert(output.end(), (const uint8_t *) list.data(), (const uint8_t *) list.data() + list.size() * sizeof(uint32_t));
+    output.insert(output.end(), image.begin() + list_end, image.end());
+    output.resize(pvs_start, 0);
+    output.insert(output.end(), pvs_blocks.begin(), pvs_blocks.end());
+
+    if (output.size() > PARTITION_SIZE) fprintf(stderr, "Warning, %zu bytes won't fit in the world partition\n", output.size());
+
+    FILE * out = fopen(argv[2], "wb");
+    if (!out || (fwrite(output.data(), 1, output.size(), out) != output.size()))
+    {
+        fprintf(stderr, "Can't write %s\n", argv[2]);
+        return (1);
+    }
+    fclose(out);
+    printf("Written %zu bytes, PVS is %zu bytes\n", output.size(), pvs_blocks.size());
+    return (0);
+}
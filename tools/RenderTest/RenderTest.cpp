@@ -0,0 +1,301 @@
+// Host test of the renderer against golden frame and depth buffers
+//
+// RenderCheck.cpp compares a coarse reduction of each of its views on the device. This draws the same
+// views with the same code on the host and compares every pixel of the RGB565 frame buffer and the
+// decoded depth buffer with a golden file, so a crack, a wrong texel or a depth error that the cell
+// means hide still fails. A pixel differs if a colour channel is more than FRAME_TOLERANCE steps out,
+// or its depth more than DEPTH_TOLERANCE_CM plus DEPTH_TOLERANCE_PERCENT. The CheckTriangles counters
+// are compared as RenderCheck does. A view fails if more than FAIL_PER_MILLE of its pixels differ.
+//
+// DiscWorld11.golden holds the frames and depths that the renderer drew before its optimisations,
+// with the counters of the present CheckTriangles, which that renderer didn't keep. The default
+// settings draw them within the tolerances: a frame pixel differs by at most one step of a channel,
+// in 128 to 1016 pixels of a view, as the fog table and the packed shading round differently from
+// the float fog and shading they replaced, and a depth by at most the 16 bit key step, 5cm nearer
+// than 30m and 9cm beyond.
+//
+// With record the golden file is written instead and the entries for RenderGoldens.h are logged, so
+// both sets of goldens come from the same run. Record after an intended change to the image and check
+// the frames first, such as by viewing the .ppm files that a failing view writes.
+//
+// Build on the host with
+//   g++ -O2 -std=gnu++17 -include stdint.h -DCONFIG_AMAZE_RENDER_CHECK -I../HostStubs -I../../main/includes RenderTest.cpp
+//     ../../main/{RenderCheck,CheckTriangles,RasteriseBox,ClipBound,CameraWork,ChunkChooser,TriangleQueues,OcclusionCull,
+//     RenderScale,CostModel,QualityGovernor,HorizonPanorama,ImpostorCache,ShowError,FindHitFace,ParseWorld,HeatMap}.cpp -o RenderTest
+// Use with
+//   ./RenderTest ../../DiscWorld11.bin ../../3dtextures2.bin DiscWorld11.golden [record]
+// which exits with 1 if any view fails
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+
+#include "globals.h"
+#include "geometry.h"
+#include "structures.h"
+#include "ParseWorld.h"
+#include "TriangleQueues.h"
+#include "CheckTriangles.h"
+#include "RasteriseBox.h"
+#include "RenderCheck.h"
+
+#define FRAME_TOLERANCE 2           // Steps of a 5 or 6 bit channel
+#define DEPTH_TOLERANCE_CM 5
+#define DEPTH_TOLERANCE_PERCENT 2
+#define FAIL_PER_MILLE 5            // Share of pixels that may differ
+#define COUNT_PERCENT 2             // As RenderCheck.cpp
+#define COUNT_SLACK 2
+
+// The globals that i80_lcd_main.cpp makes on the device
+std::vector<EachLayout> world;
+std::vector<WorldLayout> the_layouts;
+uint16_t * frame_buffer_A;
+uint16_t * frame_buffer_B;
+bool flipped = true;
+extern constexpr uint32_t fog = 0x00303030;
+extern constexpr uint16_t BackgroundColour = ((fog >> 8) & 0b1111100000000000) | ((fog >> 5) & 0b0000011111100000) | ((fog >> 3) & 0b0000000000011111);
+float eye_level;
+Vec3f eye, direction;
+Time_tracked time_report; // As EventManager.cpp
+
+extern uint16_t * frame_buffer_this;
+extern depth_t * depthBuffer;
+
+// The golden file is this header then, for each view, its Render_golden, frame and depth in cm
+struct Golden_header
+{
+    char magic[4];
+    uint32_t width;
+    uint32_t height;
+    uint32_t poses;
+};
+
+struct View
+{
+    Render_golden counters;
+    std::vector<uint16_t> frame;
+    std::vector<uint16_t> depth;
+};
+
+static std::vector<uint8_t> LoadFile(const char * name)
+{
+    std::vector<uint8_t> data;
+    FILE * in = fopen(name, "rb");
+    if (!in) return (data);
+    uint8_t buffer[65536];
+    size_t got;
+    while ((got = fread(buffer, 1, sizeof(buffer), in)) > 0) data.insert(data.end(), buffer, buffer + got);
+    fclose(in);
+    return (data);
+}
+
+// The buffers as they are after RenderCheckPose(), depth decoded so the goldens suit any depth format
+static void TakeView(View & view)
+{
+    RenderCheckMeasure(view.counters);
+    view.frame.assign(frame_buffer_this, frame_buffer_this + g_scWidth * g_scHeight);
+    view.depth.resize(g_scWidth * g_scHeight);
+    for (uint32_t pixel = 0; pixel < g_scWidth * g_scHeight; pixel++)
+    {
+        view.depth[pixel] = (uint16_t)lroundf(DepthDecode(depthBuffer[pixel]) * 100.0f);
+    }
+}
+
+static bool ReadGoldens(const char * name, std::vector<View> & views)
+{
+    const std::vector<uint8_t> data = LoadFile(name);
+    const size_t pixels = g_scWidth * g_scHeight;
+    const size_t view_size = sizeof(Render_golden) + 2 * pixels * sizeof(uint16_t);
+    Golden_header header;
+    if (data.size() < sizeof(header)) return (false);
+    memcpy(&header, data.data(), sizeof(header));
+    if (memcmp(header.magic, "AMRT", 4) || (header.width != g_scWidth) || (header.height != g_scHeight) ||
+        (header.poses != RENDER_POSES) || (data.size() != sizeof(header) + RENDER_POSES * view_size)) return (false);
+
+    const uint8_t * read = data.data() + sizeof(header);
+    views.resize(RENDER_POSES);
+    for (View & view : views)
+    {
+        memcpy(&view.counters, read, sizeof(Render_golden));
+        read += sizeof(Render_golden);
+        view.frame.resize(pixels);
+        memcpy(view.frame.data(), read, pixels * sizeof(uint16_t));
+        read += pixels * sizeof(uint16_t);
+        view.depth.resize(pixels);
+        memcpy(view.depth.data(), read, pixels * sizeof(uint16_t));
+        read += pixels * sizeof(uint16_t);
+    }
+    return (true);
+}
+
+static bool WriteGoldens(const char * name, const std::vector<View> & views)
+{
+    FILE * out = fopen(name, "wb");
+    if (!out) return (false);
+    const Golden_header header = { { 'A', 'M', 'R', 'T' }, g_scWidth, g_scHeight, RENDER_POSES };
+    fwrite(&header, sizeof(header), 1, out);
+    for (const View & view : views)
+    {
+        fwrite(&view.counters, sizeof(Render_golden), 1, out);
+        fwrite(view.frame.data(), sizeof(uint16_t), view.frame.size(), out);
+        fwrite(view.depth.data(), sizeof(uint16_t), view.depth.size(), out);
+    }
+    return (fclose(out) == 0);
+}
+
+// The frame as a binary PPM, to look at a view that fails
+static void WriteFrame(const char * name, const std::vector<uint16_t> & frame)
+{
+    FILE * out = fopen(name, "wb");
+    if (!out) return;
+    fprintf(out, "P6\n%d %d\n255\n", (int)g_scWidth, (int)g_scHeight);
+    for (const uint16_t rgb565 : frame)
+    {
+        const uint8_t rgb[3] = { (uint8_t)(((rgb565 >> 11) & 0x1f) * 255 / 31), (uint8_t)(((rgb565 >> 5) & 0x3f) * 255 / 63),
+            (uint8_t)((rgb565 & 0x1f) * 255 / 31) };
+        fwrite(rgb, 1, 3, out);
+    }
+    fclose(out);
+}
+
+static bool CountClose(const char * name, const uint32_t measured, const uint32_t golden)
+{
+    const uint32_t difference = (measured > golden) ? measured - golden : golden - measured;
+    if (difference <= golden * COUNT_PERCENT / 100 + COUNT_SLACK) return (true);
+    printf("  %s %d, golden %d\n", name, (int)measured, (int)golden);
+    return (false);
+}
+
+static bool PixelClose(const uint16_t measured, const uint16_t golden)
+{
+    const int red = abs((int)(measured >> 11) - (int)(golden >> 11));
+    const int green = abs((int)((measured >> 5) & 0x3f) - (int)((golden >> 5) & 0x3f));
+    const int blue = abs((int)(measured & 0x1f) - (int)(golden & 0x1f));
+    return ((red <= FRAME_TOLERANCE) && (green <= FRAME_TOLERANCE) && (blue <= FRAME_TOLERANCE));
+}
+
+static bool DepthClose(const uint16_t measured, const uint16_t golden)
+{
+    const int difference = abs((int)measured - (int)golden);
+    return (difference <= DEPTH_TOLERANCE_CM + golden * DEPTH_TOLERANCE_PERCENT / 100);
+}
+
+// Compares a view with its golden and reports where it differs
+static bool CompareView(const uint32_t pose, const View & measured, const View & golden)
+{
+    bool passed = true;
+    passed &= CountClose("triangles", measured.counters.triangles, golden.counters.triangles);
+    passed &= CountClose("tiles accepted", measured.counters.tiles_accepted, golden.counters.tiles_accepted);
+    passed &= CountClose("tiles partial", measured.counters.tiles_partial, golden.counters.tiles_partial);
+    passed &= CountClose("tiles rejected", measured.counters.tiles_rejected, golden.counters.tiles_rejected);
+    passed &= CountClose("pixels", measured.counters.pixels, golden.counters.pixels);
+
+    const uint32_t pixels = g_scWidth * g_scHeight;
+    uint32_t frame_differ = 0, depth_differ = 0;
+    uint32_t first_frame = pixels, first_depth = pixels;
+    for (uint32_t pixel = 0; pixel < pixels; pixel++)
+    {
+        if (!PixelClose(measured.frame[pixel], golden.frame[pixel]))
+        {
+            if (!frame_differ++) first_frame = pixel;
+        }
+        if (!DepthClose(measured.depth[pixel], golden.depth[pixel]))
+        {
+            if (!depth_differ++) first_depth = pixel;
+        }
+    }
+    if (frame_differ * 1000 > pixels * FAIL_PER_MILLE)
+    {
+        printf("  %d frame pixels differ, first at %d,%d\n", (int)frame_differ,
+            (int)(first_frame % g_scWidth), (int)(first_frame / g_scWidth));
+        passed = false;
+    }
+    if (depth_differ * 1000 > pixels * FAIL_PER_MILLE)
+    {
+        printf("  %d depth pixels differ, first at %d,%d %.2fm golden %.2fm\n", (int)depth_differ,
+            (int)(first_depth % g_scWidth), (int)(first_depth / g_scWidth),
+            measured.depth[first_depth] / 100.0f, golden.depth[first_depth] / 100.0f);
+        passed = false;
+    }
+    if (!passed)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "pose%d.ppm", (int)pose);
+        WriteFrame(name, measured.frame);
+        snprintf(name, sizeof(name), "pose%d_golden.ppm", (int)pose);
+        WriteFrame(name, golden.frame);
+    }
+    printf("Pose %d %s, %d frame and %d depth pixels differ\n", (int)pose, passed ? "passed" : "failed",
+        (int)frame_differ, (int)depth_differ);
+    return (passed);
+}
+
+int main(int argc, char ** argv)
+{
+    if ((argc != 4) && !((argc == 5) && !strcmp(argv[4], "record")))
+    {
+        fprintf(stderr, "Usage: %s world.bin textures.bin goldens [record]\n", argv[0]);
+        return (1);
+    }
+    const bool record = (argc == 5);
+
+    std::vector<uint8_t> world_image = LoadFile(argv[1]);
+    std::vector<uint8_t> texture_image = LoadFile(argv[2]);
+    if (world_image.empty() || texture_image.empty())
+    {
+        fprintf(stderr, "Can't read %s or %s\n", argv[1], argv[2]);
+        return (1);
+    }
+
+    // As app_main() up to the render check
+    frame_buffer_A = new uint16_t[g_scWidth * g_scHeight];
+    frame_buffer_B = new uint16_t[g_scWidth * g_scHeight];
+    MakeDepthBuffer();
+    MakeQueue(6000, 0);
+    MakeQueue(5000, 1);
+    MakeQueue(6000, 2);
+    MakeQueue(5000, 3);
+    ProjectionMatrix();
+    const world_partition_header * header = (const world_partition_header *)world_image.data();
+    eye = header->eye;
+    direction = header->direction;
+    eye_level = eye.y;
+    ParseWorld(world_image.data(), texture_image.data());
+
+    RenderCheckSetup();
+    std::vector<View> views(RENDER_POSES);
+    for (uint32_t pose = 0; pose < RENDER_POSES; pose++)
+    {
+        RenderCheckPose(pose, eye, direction);
+        TakeView(views[pose]);
+    }
+
+    if (record)
+    {
+        if (!WriteGoldens(argv[3], views))
+        {
+            fprintf(stderr, "Can't write %s\n", argv[3]);
+            return (1);
+        }
+        for (uint32_t pose = 0; pose < RENDER_POSES; pose++) RenderCheckLog(pose, views[pose].counters);
+        printf("Recorded %d views in %s\n", RENDER_POSES, argv[3]);
+        return (0);
+    }
+
+    std::vector<View> goldens;
+    if (!ReadGoldens(argv[3], goldens))
+    {
+        fprintf(stderr, "%s isn't a golden file for %dx%d and %d views\n", argv[3], (int)g_scWidth, (int)g_scHeight, RENDER_POSES);
+        return (1);
+    }
+    uint32_t failures = 0;
+    for (uint32_t pose = 0; pose < RENDER_POSES; pose++)
+    {
+        if (!CompareView(pose, views[pose], goldens[pose])) failures++;
+    }
+    printf("RenderTest: %d of %d views failed\n", (int)failures, RENDER_POSES);
+    return (failures ? 1 : 0);
+}
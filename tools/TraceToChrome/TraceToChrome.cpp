@@ -0,0 +1,241 @@
+// Host tool to turn a timeline trace from the ESP log into Chrome trace-event JSON
+//
+// With Amaze renderer > Record a timeline trace set in menuconfig the ESP sends the begin and end
+// events of ShowWorld, rasteriseTask and GetGameEvent once, as base64 in log lines starting "AMZT",
+// see Trace.cpp for the format. This finds them in a capture of the log, which may hold anything
+// else too, and writes JSON that chrome://tracing or ui.perfetto.dev will open. Each task is a row
+// so the overlap of the cores and the waits on START_RASTER, RASTER_DONE and CLEAR_READY can be seen.
+//
+// Build on the host with
+//   g++ -O2 -std=c++17 TraceToChrome.cpp -o TraceToChrome
+// Use with
+//   idf.py monitor | tee amaze.log
+//   ./TraceToChrome amaze.log amaze_trace.json
+// If the log holds more than one trace the last complete one is used.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+// Must match TRACE_VERSION and Trace_event in Trace.cpp
+const uint16_t TRACE_VERSION = 1;
+
+struct Trace_event
+{
+    uint32_t time_us;
+    uint16_t name;
+    uint8_t task;
+    uint8_t phase;
+};
+
+static int Base64Value(const char c)
+{
+    if (c >= 'A' && c <= 'Z') return (c - 'A');
+    if (c >= 'a' && c <= 'z') return (c - 'a' + 26);
+    if (c >= '0' && c <= '9') return (c - '0' + 52);
+    if (c == '+') return (62);
+    if (c == '/') return (63);
+    return (-1);
+}
+
+// Appends the bytes of one line of base64, which stops at the first character that isn't base64
+// so the colour codes the ESP log adds at the end are ignored
+static void DecodeLine(const char * text, std::vector<uint8_t> & bytes)
+{
+    uint32_t group = 0, bits = 0;
+    for (; Base64Value(*text) >= 0; text++)
+    {
+        group = (group << 6) | Base64Value(*text);
+        bits += 6;
+        if (bits >= 8)
+        {
+            bits -= 8;
+            bytes.push_back((uint8_t)(group >> bits));
+        }
+    }
+}
+
+// Finds the last complete trace in the log
+static bool ReadLog(FILE * log, std::vector<uint8_t> & trace)
+{
+    char line[1024];
+    std::vector<uint8_t> bytes;
+    bool inside = false, found = false;
+    uint32_t expected = 0;
+
+    while (fgets(line, sizeof(line), log))
+    {
+        const char * mark = strstr(line, "AMZT ");
+        if (!mark) continue;
+        mark += 5;
+        if (strncmp(mark, "begin ", 6) == 0)
+        {
+            bytes.clear();
+            expected = (uint32_t)atol(mark + 6);
+            inside = true;
+        }
+        else if (strncmp(mark, "end", 3) == 0)
+        {
+            if (inside && bytes.size() == expected)
+            {
+                trace = bytes;
+                found = true;
+            }
+            else if (inside) fprintf(stderr, "Skipping a trace of %u bytes that should be %u, were lines lost?\n", (unsigned)bytes.size(), (unsigned)expected);
+            inside = false;
+        }
+        else if (inside) DecodeLine(mark, bytes);
+    }
+    return (found);
+}
+
+// Names in the trace end with a zero
+static bool ReadNames(const std::vector<uint8_t> & trace, size_t & at, const uint32_t count, std::vector<std::string> & names)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const uint8_t * end = (const uint8_t *)memchr(trace.data() + at, 0, trace.size() - at);
+        if (!end) return (false);
+        names.push_back(std::string((const char *)trace.data() + at));
+        at = end - trace.data() + 1;
+    }
+    return (true);
+}
+
+// Quotes and backslashes can't be in the names sent but escape them anyway
+static std::string JsonString(const std::string & text)
+{
+    std::string quoted = "\"";
+    for (const char c : text)
+    {
+        if (c == '"' || c == '\\') quoted += '\\';
+        quoted += c;
+    }
+    return (quoted + "\"");
+}
+
+int main(int argc, char ** argv)
+{
+    if (argc != 3)
+    {
+        fprintf(stderr, "Usage: %s amaze.log trace.json\n", argv[0]);
+        return (1);
+    }
+
+    FILE * log = fopen(argv[1], "rb");
+    if (!log)
+    {
+        fprintf(stderr, "Can't open %s\n", argv[1]);
+        return (1);
+    }
+    std::vector<uint8_t> trace;
+    const bool found = ReadLog(log, trace);
+    fclose(log);
+    if (!found)
+    {
+        fprintf(stderr, "No complete trace found in %s\n", argv[1]);
+        return (1);
+    }
+
+    // The header
+    uint16_t version;
+    if (trace.size() < 8 || memcmp(trace.data(), "AMZT", 4) != 0)
+    {
+        fprintf(stderr, "The trace doesn't start with AMZT\n");
+        return (1);
+    }
+    memcpy(&version, trace.data() + 4, sizeof(version));
+    if (version != TRACE_VERSION)
+    {
+        fprintf(stderr, "Trace version %u but this tool reads %u\n", (unsigned)version, (unsigned)TRACE_VERSION);
+        return (1);
+    }
+    const uint32_t task_count = trace[6];
+    const uint32_t name_count = trace[7];
+    size_t at = 8;
+    std::vector<std::string> task_names, names;
+    uint32_t event_count;
+    if (!ReadNames(trace, at, task_count, task_names) || !ReadNames(trace, at, name_count, names) ||
+        trace.size() < at + sizeof(event_count))
+    {
+        fprintf(stderr, "The trace is truncated\n");
+        return (1);
+    }
+    memcpy(&event_count, trace.data() + at, sizeof(event_count));
+    at += sizeof(event_count);
+    if (trace.size() != at + event_count * sizeof(Trace_event))
+    {
+        fprintf(stderr, "The trace should hold %u events\n", (unsigned)event_count);
+        return (1);
+    }
+    std::vector<Trace_event> events(event_count);
+    memcpy(events.data(), trace.data() + at, event_count * sizeof(Trace_event));
+
+    // Times are the low 32 bits of a microsecond clock so are made relative to the newest event,
+    // which is right for any trace shorter than 35 minutes
+    uint32_t newest = 0;
+    bool first = true;
+    for (const Trace_event & event : events)
+    {
+        if (first || (int32_t)(event.time_us - newest) > 0) newest = event.time_us;
+        first = false;
+    }
+    int64_t oldest = 0;
+    for (const Trace_event & event : events) oldest = std::min(oldest, (int64_t)(int32_t)(event.time_us - newest));
+
+    // Sorted by time, keeping each task's own order for events at the same microsecond
+    std::stable_sort(events.begin(), events.end(), [newest](const Trace_event & a, const Trace_event & b)
+        { return ((int32_t)(a.time_us - newest) < (int32_t)(b.time_us - newest)); });
+
+    FILE * json = fopen(argv[2], "wb");
+    if (!json)
+    {
+        fprintf(stderr, "Can't write %s\n", argv[2]);
+        return (1);
+    }
+    fprintf(json, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (uint32_t task = 0; task < task_count; task++)
+    {
+        fprintf(json, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":%s}}",
+            task ? ",\n" : "", (unsigned)task, JsonString(task_names[task]).c_str());
+    }
+
+    // The ring of each task starts part way through, so an end with no begin is dropped
+    std::vector<std::vector<uint16_t>> open(task_count);
+    uint32_t written = 0, dropped = 0;
+    for (const Trace_event & event : events)
+    {
+        if (event.task >= task_count || event.name >= name_count)
+        {
+            dropped++;
+            continue;
+        }
+        std::vector<uint16_t> & stack = open[event.task];
+        if (event.phase == 'B') stack.push_back(event.name);
+        else if (event.phase == 'E')
+        {
+            if (stack.empty() || stack.back() != event.name)
+            {
+                dropped++;
+                continue;
+            }
+            stack.pop_back();
+        }
+        const int64_t ts = (int64_t)(int32_t)(event.time_us - newest) - oldest;
+        fprintf(json, "%s{\"name\":%s,\"ph\":\"%c\",\"ts\":%lld,\"pid\":0,\"tid\":%u%s}",
+            (written || task_count) ? ",\n" : "", JsonString(names[event.name]).c_str(), event.phase, (long long)ts,
+            (unsigned)event.task, (event.phase == 'i') ? ",\"s\":\"t\"" : "");
+        written++;
+    }
+    fprintf(json, "\n]}\n");
+    fclose(json);
+
+    printf("%u events from %u tasks over %lldus written to %s", (unsigned)written, (unsigned)task_count, (long long)-oldest, argv[2]);
+    if (dropped) printf(", %u unmatched or unknown events dropped", (unsigned)dropped);
+    printf("\n");
+    return (0);
+}
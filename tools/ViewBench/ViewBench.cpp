@@ -0,0 +1,187 @@
+// Host benchmark of a whole frame at the view port size it is built for
+//
+// The view port is a compile time constant, so each size is a separate build and the matrix of sizes
+// is made by building once per size, as below. Each build draws the same views of a world, from the
+// start and from a grid across the first layout turned four ways, sending every chunk in the sequence
+// as RenderCheck.cpp does, so that only the size differs between builds. A frame is timed in two
+// parts, as the two cores share it on the device: the build, being the chunk sequence and
+// CheckTriangles, and the raster, being the clears and the default raster kernels over what was
+// queued. The best of BENCH_REPEATS is kept for each view and the sums are given in ns per frame and
+// ns per pixel. Times are the host's, so only the ratios between sizes carry over to the device.
+//
+// Build on the host with
+//   g++ -O2 -std=gnu++17 -include stdint.h -DCONFIG_AMAZE_VIEW_WIDTH=128 -DCONFIG_AMAZE_VIEW_HEIGHT=128 -I../HostStubs
+//     -I../../main/includes ViewBench.cpp ../../main/{CheckTriangles,RasteriseBox,ClipBound,CameraWork,ChunkChooser,
+//     TriangleQueues,OcclusionCull,RenderScale,CostModel,QualityGovernor,HorizonPanorama,ImpostorCache,ShowError,
+//     FindHitFace,ParseWorld,HeatMap}.cpp -o ViewBench
+// Use with
+//   ./ViewBench ../../DiscWorld11.bin ../../3dtextures2.bin 2>/dev/null
+// and for the matrix of sizes, from bash
+//   for size in 128x128 160x160 240x160 240x240 320x240; do g++ ... -DCONFIG_AMAZE_VIEW_WIDTH=${size%x*}
+//     -DCONFIG_AMAZE_VIEW_HEIGHT=${size#*x} ... && ./ViewBench ../../DiscWorld11.bin ../../3dtextures2.bin 2>/dev/null; done
+
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "globals.h"
+#include "geometry.h"
+#include "structures.h"
+#include "ParseWorld.h"
+#include "ChunkChooser.h"
+#include "TriangleQueues.h"
+#include "CheckTriangles.h"
+#include "RasteriseBox.h"
+#include "QualityGovernor.h"
+
+#define BENCH_REPEATS 8     // The best of these is reported
+#define BENCH_VIEWS 4       // Turns of 90 degrees from the world's starting direction
+#define BENCH_PLACES 4      // Views are also taken from a grid of this less one squared across the first layout
+
+// The globals that the renderer expects from i80_lcd_main.cpp and EventManager.cpp
+std::vector<EachLayout> world;
+std::vector<WorldLayout> the_layouts;
+uint16_t * frame_buffer_A;
+uint16_t * frame_buffer_B;
+bool flipped = true;
+extern constexpr uint32_t fog = 0x00303030;
+extern constexpr uint16_t BackgroundColour = ((fog >> 8) & 0b1111100000000000) | ((fog >> 5) & 0b0000011111100000) | ((fog >> 3) & 0b0000000000011111);
+float eye_level;
+Vec3f eye, direction;
+Time_tracked time_report;
+
+extern uint16_t * frame_buffer_this;
+extern TriQueue BlockA[4];
+
+static std::vector<uint8_t> LoadFile(const char * name)
+{
+    std::vector<uint8_t> data;
+    FILE * in = fopen(name, "rb");
+    if (!in) return (data);
+    uint8_t buffer[65536];
+    size_t got;
+    while ((got = fread(buffer, 1, sizeof(buffer), in)) > 0) data.insert(data.end(), buffer, buffer + got);
+    fclose(in);
+    return (data);
+}
+
+static double Since(const std::chrono::steady_clock::time_point before)
+{
+    return (std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - before).count());
+}
+
+// Sends every chunk of the sequence for the view to CheckTriangles, leaving what it queued in BlockA
+static void BuildView(const Vec3f view_eye, const Vec3f view_direction)
+{
+    EmptyQueues();
+    for (uint32_t index = 0; ; index++)
+    {
+        for (const EachLayout & layout : world)
+        {
+            const WorldLayout * layo_ptr = &layout.frame_layouts[0];
+            const uint32_t chunk = IndexChunkChooser(view_eye, view_direction, index, layo_ptr);
+            if (chunk == LAST_CHUNK) return;
+            CheckTriangles(view_eye, view_direction, chunk, layo_ptr);
+        }
+    }
+}
+
+// Clears the frame and rasterises what BuildView queued with the kernels the device uses
+static void RasteriseView()
+{
+    ClearWorldFrame(frame_buffer_this);
+    ClearDepthBuffer(DEPTH_FAR);
+    const uint32_t block = flipped ? 2 : 0; // As CheckTriangles chooses
+    for (uint32_t queue = block; queue < block + 2; queue++)
+    {
+        for (uint32_t item = 0; item < BlockA[queue].count; item++)
+        {
+            const TriToRaster & this_tri = BlockA[queue].itemptr[item];
+            raster_kernels[this_tri.kernel](this_tri);
+        }
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    if (argc != 3)
+    {
+        fprintf(stderr, "Usage: %s world.bin textures.bin\n", argv[0]);
+        return (1);
+    }
+
+    std::vector<uint8_t> world_image = LoadFile(argv[1]);
+    std::vector<uint8_t> texture_image = LoadFile(argv[2]);
+    if (world_image.empty() || texture_image.empty())
+    {
+        fprintf(stderr, "Can't read %s or %s\n", argv[1], argv[2]);
+        return (1);
+    }
+
+    // As app_main() up to the tasks
+    frame_buffer_A = new uint16_t[g_scWidth * g_scHeight];
+    frame_buffer_B = new uint16_t[g_scWidth * g_scHeight];
+    MakeDepthBuffer();
+    MakeQueue(6000, 0);
+    MakeQueue(5000, 1);
+    MakeQueue(6000, 2);
+    MakeQueue(5000, 3);
+    ProjectionMatrix();
+    const world_partition_header * header = (const world_partition_header *)world_image.data();
+    eye = header->eye;
+    direction = header->direction;
+    eye_level = eye.y;
+    ParseWorld(world_image.data(), texture_image.data());
+
+    // Frames are cleared rather than resolved, the depth encoding being the plain one
+    clear_free_frames = false;
+    depth_base = 0;
+    depth_sign = 1;
+    SetRasterQuality(quality_build);
+    frame_buffer_this = frame_buffer_A;
+
+    std::vector<Vec3f> places = { eye };
+    const ChunkArr & area = world[0].frame_layouts[0].ChAr;
+    for (uint32_t row = 1; row < BENCH_PLACES; row++)
+    {
+        for (uint32_t column = 1; column < BENCH_PLACES; column++)
+        {
+            places.push_back({ (float)(area.xmin + (int32_t)(area.xcount * area.size * column / BENCH_PLACES)), eye.y,
+                (float)(area.zmin + (int32_t)(area.zcount * area.size * row / BENCH_PLACES)) });
+        }
+    }
+
+    double build_ns = 0.0, raster_ns = 0.0;
+    uint32_t frames = 0, items = 0;
+    for (const Vec3f & place : places)
+    {
+        Vec3f view = direction;
+        for (uint32_t turn = 0; turn < BENCH_VIEWS; turn++)
+        {
+            double best_build = 1.0e30, best_raster = 1.0e30;
+            for (uint32_t repeat = 0; repeat < BENCH_REPEATS; repeat++)
+            {
+                auto before = std::chrono::steady_clock::now();
+                BuildView(place, view);
+                best_build = std::min(best_build, Since(before));
+                before = std::chrono::steady_clock::now();
+                RasteriseView();
+                best_raster = std::min(best_raster, Since(before));
+            }
+            build_ns += best_build;
+            raster_ns += best_raster;
+            items += BlockA[flipped ? 2 : 0].count + BlockA[flipped ? 3 : 1].count;
+            frames++;
+            view = { view.z, view.y, -view.x }; // 90 degrees to the left
+        }
+    }
+    EmptyQueues();
+
+    const double pixels = (double)frames * g_scWidth * g_scHeight;
+    printf("%dx%d tiles %dx%d: %d frames, %d items per frame, build %.0fns raster %.0fns, %.0fns per frame, %.2fns per pixel\n",
+        (int)g_scWidth, (int)g_scHeight, (int)g_xTile, (int)g_yTile, (int)frames, (int)(items / frames),
+        build_ns / frames, raster_ns / frames, (build_ns + raster_ns) / frames, (build_ns + raster_ns) / pixels);
+    return (0);
+}
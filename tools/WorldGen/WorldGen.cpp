@@ -0,0 +1,518 @@
+// Host tool to generate stress worlds for measuring how the renderer scales
+//
+// Writes a world partition binary and a texture partition binary in the format that ParseWorld()
+// and ReadWorld() read, with everything set by parameters so that worlds can be made across orders
+// of magnitude of triangles, chunks, layouts, animation frames and textures.
+//  - Layout 0 is rolling terrain over a square grid of chunks, each chunk split into grid x grid
+//    squares of two triangles, with boxes standing on it. It is the ground plan that heights are found from.
+//  - Each further layer is a layout of more boxes on the same chunk grid, the first of them animated
+//    with the boxes rising and falling over the frames.
+//  - Each face takes one of eight block colours or, for the textured share of faces, one of the
+//    generated textures, which are checker and noise patterns.
+// Faces are put in the chunk under their centroid as the world converter does, and every block is
+// kept 4 byte aligned. A layout frame can't have more than 65536 vertices or faces as they are
+// indexed by 16 bits, unless bases=1 gives each chunk its own face and vertex bases to index from.
+// quantise=1 does that too and writes the vertices and UVs as int16 steps, CHUNK_FORMAT_QUANTISED.
+//
+// Build on the host with
+//   g++ -O2 -std=c++17 -include stdint.h -I../../main/includes WorldGen.cpp -o WorldGen
+// Use with
+//   ./WorldGen world.bin textures.bin [name=value ...]
+// where the names, with their defaults, are
+//   chunks=20 size=10 grid=2 hills=2 boxes=2 layers=0 animated=0 frames=8 textures=4 texsize=32 textured=0.25 bases=0 quantise=0 seed=1
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include "geometry.h"
+#include "structures.h"
+#include "ParseWorld.h"
+
+// The partitions in partitions_3D.csv
+const size_t WORLD_PARTITION_SIZE = 4 * 1024 * 1024;
+const size_t TEXTURE_PARTITION_SIZE = 1024 * 1024;
+
+// The converter sets these bits of a layout descriptor, they aren't read by ParseWorld()
+const uint32_t DESC_STATIC = 0x0f000000;
+const uint32_t DESC_ANIMATED = 0x0e000000;
+
+const uint32_t PLAIN_COLOURS = 8;
+const float EYE_LEVEL = 1.7f;
+const uint32_t INDEX_LIMIT = 65536; // Vertices or faces in a layout frame
+
+struct Settings
+{
+    int32_t chunks = 20;        // Chunks along each side of the square world
+    int32_t size = 10;          // Metres along the side of a chunk
+    int32_t grid = 2;           // Terrain squares along the side of a chunk
+    float hills = 2.0f;         // Height of the terrain's rolling in metres
+    int32_t boxes = 2;          // Boxes standing in each chunk of each layout
+    int32_t layers = 0;         // Layouts of boxes added to the terrain
+    int32_t animated = 0;       // How many of those layers are animated
+    int32_t frames = 8;         // Frames of each animated layer
+    int32_t textures = 4;       // Textures in the texture partition
+    int32_t texsize = 32;       // Pixels along the side of each texture
+    float textured = 0.25f;     // Share of faces that are textured
+    int32_t bases = 0;          // Write chunk entries with bases so layouts aren't limited by 16 bit indices
+    int32_t quantise = 0;       // Write the vertices and UVs as int16 steps, which needs bases
+    uint32_t seed = 1;
+};
+
+// One frame of a layout before it's written
+struct Mesh
+{
+    std::vector<Vec3f> vertices;
+    std::vector<uint32_t> nvertices;    // Three per face, checked against INDEX_LIMIT as it's written
+    std::vector<uint16_t> texels;       // Three per face, into the shared UVs
+    std::vector<uint16_t> attributes;   // One per face, into the palette
+};
+
+// Corners of a square of texture for the two triangles of each side, shared by every frame
+static const Vec2f uvs[4] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f }, { 0.0f, 1.0f } };
+
+static uint32_t random_state = 1;
+
+// A small xorshift so worlds are the same on every host
+static uint32_t Random()
+{
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return (random_state);
+}
+
+static float RandomFloat(const float low, const float high)
+{
+    return (low + (high - low) * (Random() & 0xffffff) / (float)0x1000000);
+}
+
+static void Put32(std::vector<uint8_t> & out, const uint32_t value)
+{
+    out.insert(out.end(), (const uint8_t *) &value, (const uint8_t *) &value + sizeof(value));
+}
+
+static void Align4(std::vector<uint8_t> & out)
+{
+    while (out.size() & 0x03) out.push_back(0);
+}
+
+template <typename T>
+static uint32_t PutBlock(std::vector<uint8_t> & out, const std::vector<T> & values)
+{
+    Align4(out);
+    const uint32_t offset = out.size();
+    out.insert(out.end(), (const uint8_t *) values.data(), (const uint8_t *) (values.data() + values.size()));
+    return (offset);
+}
+
+// The height of the terrain, a few long waves so it rolls without being noisy
+static float TerrainHeight(const Settings & settings, const float x, const float z)
+{
+    const float wave = 2.0f * M_PI / (settings.size * 3.0f);
+    return (settings.hills * 0.5f * (sinf(x * wave) * cosf(z * wave * 0.7f) + 0.5f * sinf((x + z) * wave * 1.9f)));
+}
+
+// A face's material, a block colour or one of the textures
+static uint16_t ChooseMaterial(const Settings & settings)
+{
+    if ((settings.textures > 0) && (RandomFloat(0.0f, 1.0f) < settings.textured)) return (PLAIN_COLOURS + Random() % settings.textures);
+    return (Random() % PLAIN_COLOURS);
+}
+
+// Add a triangle wound so that it faces out along normal, which is anticlockwise seen from there
+static void AddTriangle(Mesh & mesh, const uint32_t a, const uint32_t b, const uint32_t c, const Vec3f normal, const uint16_t ta, const uint16_t tb, const uint16_t tc, const uint16_t material)
+{
+    const Vec3f cross = (mesh.vertices[b] - mesh.vertices[a]).crossProduct(mesh.vertices[c] - mesh.vertices[a]);
+    const bool swap = cross.dotProduct(normal) < 0.0f;
+    mesh.nvertices.insert(mesh.nvertices.end(), { a, swap ? c : b, swap ? b : c });
+    mesh.texels.insert(mesh.texels.end(), { ta, swap ? tc : tb, swap ? tb : tc });
+    mesh.attributes.push_back(material);
+}
+
+// Add a quad of four vertices, in order around it, as two triangles
+static void AddQuad(Mesh & mesh, const uint32_t corners[4], const Vec3f normal, const uint16_t material)
+{
+    AddTriangle(mesh, corners[0], corners[1], corners[2], normal, 0, 1, 2, material);
+    AddTriangle(mesh, corners[0], corners[2], corners[3], normal, 0, 2, 3, material);
+}
+
+// A lattice of vertices shared by the squares, whose own texture corners come from the texels
+static void AddTerrain(const Settings & settings, Mesh & mesh)
+{
+    const int32_t side = settings.chunks * settings.grid;
+    const float step = (float)settings.size / settings.grid;
+    const float origin = -0.5f * settings.chunks * settings.size;
+
+    for (int32_t z = 0; z <= side; z++)
+    {
+        for (int32_t x = 0; x <= side; x++)
+        {
+            const float px = origin + x * step;
+            const float pz = origin + z * step;
+            mesh.vertices.push_back(Vec3f(px, TerrainHeight(settings, px, pz), pz));
+        }
+    }
+    for (int32_t z = 0; z < side; z++)
+    {
+        for (int32_t x = 0; x < side; x++)
+        {
+            const uint32_t first = z * (side + 1) + x;
+            const uint32_t corners[4] = { first, first + 1, first + side + 2, first + side + 1 };
+            AddQuad(mesh, corners, Vec3f(0.0f, 1.0f, 0.0f), ChooseMaterial(settings));
+        }
+    }
+}
+
+// A box standing on the terrain at its centre, without a base as that can't be seen
+struct Box
+{
+    Vec3f centre;   // Of the base
+    Vec3f half;     // Half the width, the full height and half the depth
+    uint16_t material;
+    float phase;    // Of its rise and fall when animated
+};
+
+static Box MakeBox(const Settings & settings)
+{
+    const float extent = 0.5f * settings.chunks * settings.size;
+    Box box;
+    box.half = Vec3f(RandomFloat(0.25f, 1.5f), RandomFloat(0.5f, 4.0f), RandomFloat(0.25f, 1.5f));
+    box.centre.x = RandomFloat(-extent + box.half.x, extent - box.half.x);
+    box.centre.z = RandomFloat(-extent + box.half.z, extent - box.half.z);
+    box.centre.y = TerrainHeight(settings, box.centre.x, box.centre.z) - 0.2f; // Sunk a little as the ground slopes
+    box.material = ChooseMaterial(settings);
+    box.phase = RandomFloat(0.0f, 2.0f * M_PI);
+    return (box);
+}
+
+static void AddBox(Mesh & mesh, const Box & box, const float lift)
+{
+    const float x0 = box.centre.x - box.half.x, x1 = box.centre.x + box.half.x;
+    const float z0 = box.centre.z - box.half.z, z1 = box.centre.z + box.half.z;
+    const float y0 = box.centre.y + lift, y1 = box.centre.y + lift + box.half.y;
+
+    // The corners around the base then around the top
+    const uint32_t first = mesh.vertices.size();
+    mesh.vertices.insert(mesh.vertices.end(), { Vec3f(x0, y0, z0), Vec3f(x1, y0, z0), Vec3f(x1, y0, z1), Vec3f(x0, y0, z1),
+        Vec3f(x0, y1, z0), Vec3f(x1, y1, z0), Vec3f(x1, y1, z1), Vec3f(x0, y1, z1) });
+
+    const uint32_t top[4] = { first + 4, first + 5, first + 6, first + 7 };
+    AddQuad(mesh, top, Vec3f(0.0f, 1.0f, 0.0f), box.material);
+    const Vec3f normals[4] = { Vec3f(0.0f, 0.0f, -1.0f), Vec3f(1.0f, 0.0f, 0.0f), Vec3f(0.0f, 0.0f, 1.0f), Vec3f(-1.0f, 0.0f, 0.0f) };
+    for (uint32_t side = 0; side < 4; side++)
+    {
+        const uint32_t next = (side + 1) & 3;
+        const uint32_t corners[4] = { first + side, first + next, first + 4 + next, first + 4 + side };
+        AddQuad(mesh, corners, normals[side], box.material);
+    }
+}
+
+// The chunk under each face's centroid, as the world converter assigns them
+static std::vector<std::vector<uint32_t>> AssignChunks(const Settings & settings, const Mesh & mesh, const ChunkArr & ChAr)
+{
+    std::vector<std::vector<uint32_t>> chunk_faces(settings.chunks * settings.chunks);
+    for (uint32_t face = 0; face < mesh.attributes.size(); face++)
+    {
+        Vec3f centre = { 0.0f, 0.0f, 0.0f };
+        for (uint32_t corner = 0; corner < 3; corner++) centre = centre + mesh.vertices[mesh.nvertices[face * 3 + corner]];
+        const int32_t cx = std::clamp((int32_t)floorf((centre.x / 3.0f - ChAr.xmin) / ChAr.size), 0, settings.chunks - 1);
+        const int32_t cz = std::clamp((int32_t)floorf((centre.z / 3.0f - ChAr.zmin) / ChAr.size), 0, settings.chunks - 1);
+        chunk_faces[cx + settings.chunks * cz].push_back(face);
+    }
+    return (chunk_faces);
+}
+
+// With chunk bases the faces of each chunk are put together, each chunk having its own copy of the
+// vertices it uses, so its indices only have to reach across the chunk
+static bool ChunkLocal(const Mesh & mesh, std::vector<std::vector<uint32_t>> & chunk_faces, Mesh & local,
+    std::vector<uint32_t> & face_bases, std::vector<uint32_t> & vertex_bases, const char * name)
+{
+    for (uint32_t chunk = 0; chunk < chunk_faces.size(); chunk++)
+    {
+        face_bases.push_back(local.attributes.size());
+        vertex_bases.push_back(local.vertices.size());
+        std::vector<int32_t> remap(mesh.vertices.size(), -1);
+        for (uint32_t & face : chunk_faces[chunk])
+        {
+            for (uint32_t corner = 0; corner < 3; corner++)
+            {
+                int32_t & vertex = remap[mesh.nvertices[face * 3 + corner]];
+                if (vertex < 0)
+                {
+                    vertex = local.vertices.size() - vertex_bases.back();
+                    local.vertices.push_back(mesh.vertices[mesh.nvertices[face * 3 + corner]]);
+                }
+                local.nvertices.push_back(vertex);
+                local.texels.push_back(mesh.texels[face * 3 + corner]);
+            }
+            local.attributes.push_back(mesh.attributes[face]);
+            face = local.attributes.size() - 1 - face_bases.back();
+        }
+        if ((chunk_faces[chunk].size() > INDEX_LIMIT) || (local.vertices.size() - vertex_bases.back() > INDEX_LIMIT))
+        {
+            fprintf(stderr, "%s chunk %d has more than 16 bit indices allow even from its bases, use a coarser grid or fewer boxes\n", name, chunk);
+            return (false);
+        }
+    }
+    return (true);
+}
+
+// Each chunk's vertices as steps from the corner of its square
+static bool Quantise(const Mesh & mesh, const ChunkArr & ChAr, const std::vector<uint32_t> & vertex_bases, std::vector<Quant_vertex> & quantised, const char * name)
+{
+    const float steps = (float)QUANT_CHUNK_STEPS / ChAr.size;
+    for (uint32_t chunk = 0; chunk < vertex_bases.size(); chunk++)
+    {
+        const uint32_t end = (chunk + 1 < vertex_bases.size()) ? vertex_bases[chunk + 1] : mesh.vertices.size();
+        const Vec3f origin((float)(ChAr.xmin + (int32_t)(chunk % ChAr.xcount) * ChAr.size), 0.0f, (float)(ChAr.zmin + (int32_t)(chunk / ChAr.xcount) * ChAr.size));
+        for (uint32_t vertex = vertex_bases[chunk]; vertex < end; vertex++)
+        {
+            const Vec3f relative = (mesh.vertices[vertex] - origin) * steps;
+            if ((std::max(std::max(fabsf(relative.x), fabsf(relative.y)), fabsf(relative.z)) > INT16_MAX))
+            {
+                fprintf(stderr, "%s chunk %d has a vertex too far from its corner to quantise\n", name, chunk);
+                return (false);
+            }
+            quantised.push_back({ (int16_t)lroundf(relative.x), (int16_t)lroundf(relative.y), (int16_t)lroundf(relative.z) });
+        }
+    }
+    return (true);
+}
+
+// Write one layout frame as a world_header and its blocks, returning false if it can't be indexed
+static bool WriteLayout(const Settings & settings, const Mesh & frame_mesh, const std::vector<uint32_t> & palette, std::vector<uint8_t> & out, const char * name)
+{
+    const int16_t origin = (int16_t)(-settings.chunks * settings.size / 2);
+    const ChunkArr ChAr = { origin, origin, (int16_t)settings.chunks, (int16_t)settings.chunks, (int16_t)settings.size };
+    std::vector<std::vector<uint32_t>> chunk_faces = AssignChunks(settings, frame_mesh, ChAr);
+
+    const bool chunk_bases = settings.bases || settings.quantise;
+    Mesh local;
+    std::vector<uint32_t> face_bases, vertex_bases;
+    if (chunk_bases && !ChunkLocal(frame_mesh, chunk_faces, local, face_bases, vertex_bases, name)) return (false);
+    const Mesh & mesh = chunk_bases ? local : frame_mesh;
+
+    const uint32_t face_count = mesh.attributes.size();
+    if (!chunk_bases && ((mesh.vertices.size() > INDEX_LIMIT) || (face_count > INDEX_LIMIT)))
+    {
+        fprintf(stderr, "%s has %zu vertices and %d faces, more than 16 bit indices allow, use bases=1, a coarser grid or fewer boxes in more layers\n",
+            name, mesh.vertices.size(), face_count);
+        return (false);
+    }
+
+    std::vector<uint8_t> body;
+    body.resize(sizeof(world_header)); // Offsets are from the header
+    uint32_t offsets[7];
+    if (settings.quantise)
+    {
+        std::vector<Quant_vertex> quantised;
+        if (!Quantise(mesh, ChAr, vertex_bases, quantised, name)) return (false);
+        offsets[0] = PutBlock(body, quantised);
+    }
+    else offsets[0] = PutBlock(body, mesh.vertices);
+    offsets[1] = PutBlock(body, std::vector<uint16_t>(mesh.nvertices.begin(), mesh.nvertices.end()));
+    if (settings.quantise)
+    {
+        std::vector<Quant_uv> quantised;
+        for (const Vec2f & uv : uvs) quantised.push_back({ (int16_t)lroundf(uv.x * QUANT_UV_STEPS), (int16_t)lroundf(uv.y * QUANT_UV_STEPS) });
+        offsets[2] = PutBlock(body, quantised);
+    }
+    else offsets[2] = PutBlock(body, std::vector<Vec2f>(uvs, uvs + 4));
+    offsets[3] = PutBlock(body, mesh.texels);
+    offsets[4] = PutBlock(body, mesh.attributes);
+    offsets[5] = PutBlock(body, palette);
+
+    // The chunk block is the ChunkArr and the format, an offset from the block and a count for each
+    // chunk, with bases the face, vertex and UV bases too, then the lists of faces. The few UVs are
+    // shared so their base is always 0.
+    Align4(body);
+    offsets[6] = body.size();
+    const int16_t chunk_params[6] = { ChAr.xmin, ChAr.zmin, ChAr.xcount, ChAr.zcount, ChAr.size,
+        (int16_t)(settings.quantise ? CHUNK_FORMAT_QUANTISED : settings.bases ? CHUNK_FORMAT_BASES : CHUNK_FORMAT_LISTS) };
+    std::vector<uint8_t> chunk_block((const uint8_t *) chunk_params, (const uint8_t *) chunk_params + sizeof(chunk_params));
+    std::vector<uint8_t> lists;
+    const uint32_t lists_start = chunk_block.size() + chunk_faces.size() * (chunk_bases ? 20 : 8);
+    for (uint32_t chunk = 0; chunk < chunk_faces.size(); chunk++)
+    {
+        const std::vector<uint16_t> faces(chunk_faces[chunk].begin(), chunk_faces[chunk].end());
+        Put32(chunk_block, lists_start + lists.size());
+        Put32(chunk_block, faces.size());
+        if (chunk_bases)
+        {
+            Put32(chunk_block, face_bases[chunk]);
+            Put32(chunk_block, vertex_bases[chunk]);
+            Put32(chunk_block, 0);
+        }
+        lists.insert(lists.end(), (const uint8_t *) faces.data(), (const uint8_t *) (faces.data() + faces.size()));
+    }
+    chunk_block.insert(chunk_block.end(), lists.begin(), lists.end());
+    body.insert(body.end(), chunk_block.begin(), chunk_block.end());
+
+    memcpy(body.data(), offsets, sizeof(offsets));
+    Align4(out);
+    out.insert(out.end(), body.begin(), body.end());
+    return (true);
+}
+
+// A DIB of 32 bit pixels as the texture partition holds, checks of two colours with some noise
+static void WriteTexture(const Settings & settings, std::vector<uint8_t> & out)
+{
+    const uint32_t side = settings.texsize;
+    const uint32_t checks = 2 + Random() % 4;
+    const uint32_t colours[2] = { Random() & 0x00ffffff, Random() & 0x00ffffff };
+
+    const uint32_t info[10] = { 40, side, side, 1 | (32 << 16), 0, side * side * 4, 0, 0, 0, 0 }; // BITMAPINFOHEADER
+    out.insert(out.end(), (const uint8_t *) info, (const uint8_t *) info + sizeof(info));
+    for (uint32_t y = 0; y < side; y++)
+    {
+        for (uint32_t x = 0; x < side; x++)
+        {
+            const uint32_t colour = colours[((x * checks / side) + (y * checks / side)) & 1];
+            const int32_t noise = (int32_t)(Random() % 32) - 16;
+            uint32_t pixel = 0xff000000;
+            for (uint32_t shift = 0; shift < 24; shift += 8)
+            {
+                pixel |= (uint32_t)std::clamp((int32_t)((colour >> shift) & 0xff) + noise, 0, 255) << shift;
+            }
+            Put32(out, pixel);
+        }
+    }
+}
+
+static bool ReadSetting(Settings & settings, const char * text)
+{
+    const char * equals = strchr(text, '=');
+    if (!equals) return (false);
+    const std::string name(text, equals - text);
+    const char * value = equals + 1;
+
+    if (name == "chunks") settings.chunks = atoi(value);
+    else if (name == "size") settings.size = atoi(value);
+    else if (name == "grid") settings.grid = atoi(value);
+    else if (name == "hills") settings.hills = atof(value);
+    else if (name == "boxes") settings.boxes = atoi(value);
+    else if (name == "layers") settings.layers = atoi(value);
+    else if (name == "animated") settings.animated = atoi(value);
+    else if (name == "frames") settings.frames = atoi(value);
+    else if (name == "textures") settings.textures = atoi(value);
+    else if (name == "texsize") settings.texsize = atoi(value);
+    else if (name == "textured") settings.textured = atof(value);
+    else if (name == "bases") settings.bases = atoi(value);
+    else if (name == "quantise") settings.quantise = atoi(value);
+    else if (name == "seed") settings.seed = strtoul(value, nullptr, 0);
+    else return (false);
+    return (true);
+}
+
+static bool WriteFile(const char * name, const std::vector<uint8_t> & data)
+{
+    FILE * out = fopen(name, "wb");
+    if (!out || (fwrite(data.data(), 1, data.size(), out) != data.size()))
+    {
+        fprintf(stderr, "Can't write %s\n", name);
+        return (false);
+    }
+    fclose(out);
+    return (true);
+}
+
+int main(int argc, char ** argv)
+{
+    Settings settings;
+    bool valid = (argc >= 3);
+    for (int arg = 3; valid && (arg < argc); arg++) valid = ReadSetting(settings, argv[arg]);
+    valid = valid && (settings.chunks > 0) && (settings.chunks * settings.size < 32768) && (settings.size > 0) && (settings.grid > 0) &&
+        (settings.boxes >= 0) && (settings.layers >= 0) && (settings.animated <= settings.layers) && (settings.frames >= 1) &&
+        (settings.frames <= 255) && (settings.textures >= 0) && (settings.texsize > 0);
+    if (!valid)
+    {
+        fprintf(stderr, "Usage: %s world.bin textures.bin [name=value ...]\n", argv[0]);
+        fprintf(stderr, "  chunks=20 size=10 grid=2 hills=2 boxes=2 layers=0 animated=0 frames=8 textures=4 texsize=32 textured=0.25 bases=0 quantise=0 seed=1\n");
+        return (1);
+    }
+    random_state = settings.seed ? settings.seed : 1;
+
+    // The textures, each at an offset recorded in the palette
+    std::vector<uint8_t> texture_bin;
+    std::vector<uint32_t> texture_offsets;
+    for (int32_t texture = 0; texture < settings.textures; texture++)
+    {
+        texture_offsets.push_back(texture_bin.size());
+        WriteTexture(settings, texture_bin);
+    }
+
+    // The thin palette is a count then a type, parameter and event for each material, shared by every layout
+    std::vector<uint32_t> palette = { PLAIN_COLOURS + (uint32_t)settings.textures };
+    for (uint32_t colour = 0; colour < PLAIN_COLOURS; colour++)
+    {
+        const uint32_t roughness = (Random() & 0x3f) << 24; // The top byte sets the specular highlight
+        palette.insert(palette.end(), { PAL_PLAIN, roughness | (Random() & 0x00ffffff), 0 });
+    }
+    for (const uint32_t offset : texture_offsets) palette.insert(palette.end(), { PAL_TEXOFF, offset, 0 });
+
+    // Every layout frame's mesh, frames of a layout together
+    std::vector<std::vector<Mesh>> layouts(1 + settings.layers);
+    layouts[0].resize(1);
+    AddTerrain(settings, layouts[0][0]);
+    for (int32_t layer = 0; layer <= settings.layers; layer++)
+    {
+        const bool animated = (layer > 0) && (layer <= settings.animated);
+        if (layer > 0) layouts[layer].resize(animated ? settings.frames : 1);
+
+        std::vector<Box> boxes;
+        for (int32_t box = 0; box < settings.boxes * settings.chunks * settings.chunks; box++) boxes.push_back(MakeBox(settings));
+        for (uint32_t frame = 0; frame < layouts[layer].size(); frame++)
+        {
+            for (const Box & box : boxes)
+            {
+                const float lift = animated ? 1.0f + sinf(box.phase + 2.0f * M_PI * frame / settings.frames) : 0.0f;
+                AddBox(layouts[layer][frame], box, lift);
+            }
+        }
+    }
+
+    // The partition header is the eye, with its height the eye level, and the direction then the
+    // descriptors each with an offset per frame and a zero to end
+    std::vector<uint8_t> world_bin;
+    const Vec3f eye_direction[2] = { Vec3f(0.0f, EYE_LEVEL, 0.0f), Vec3f(0.0f, 0.0f, -1.0f) };
+    world_bin.insert(world_bin.end(), (const uint8_t *) eye_direction, (const uint8_t *) eye_direction + sizeof(eye_direction));
+    const uint32_t list_start = world_bin.size();
+    for (const auto & frames : layouts) world_bin.resize(world_bin.size() + (1 + frames.size()) * sizeof(uint32_t));
+    world_bin.resize(world_bin.size() + sizeof(uint32_t));
+
+    std::vector<uint32_t> list;
+    uint32_t faces = 0, vertices = 0;
+    for (uint32_t layout = 0; layout < layouts.size(); layout++)
+    {
+        const uint32_t frames = layouts[layout].size();
+        list.push_back(WORLD_DESC_LAYOUT | ((frames > 1) ? DESC_ANIMATED : DESC_STATIC) | (frames << WORLD_DESC_FRAMES_SHIFT) | layout);
+        for (uint32_t frame = 0; frame < frames; frame++)
+        {
+            char name[32];
+            snprintf(name, sizeof(name), "Layout %d frame %d", layout, frame);
+            Align4(world_bin);
+            list.push_back(world_bin.size());
+            if (!WriteLayout(settings, layouts[layout][frame], palette, world_bin, name)) return (1);
+        }
+        faces += layouts[layout][0].attributes.size();
+        vertices += layouts[layout][0].vertices.size();
+    }
+    list.push_back(0);
+    memcpy(&world_bin[list_start], list.data(), list.size() * sizeof(uint32_t));
+
+    if (world_bin.size() > WORLD_PARTITION_SIZE) fprintf(stderr, "Warning, %zu bytes won't fit in the world partition\n", world_bin.size());
+    if (texture_bin.size() > TEXTURE_PARTITION_SIZE) fprintf(stderr, "Warning, %zu bytes won't fit in the texture partition\n", texture_bin.size());
+    if (!WriteFile(argv[1], world_bin) || !WriteFile(argv[2], texture_bin)) return (1);
+
+    printf("%zu layouts, %dx%d chunks, %d faces and %d vertices at the first frame of each\n", layouts.size(),
+        settings.chunks, settings.chunks, faces, vertices);
+    printf("Written %zu bytes of world and %zu bytes of textures\n", world_bin.size(), texture_bin.size());
+    return (0);
+}